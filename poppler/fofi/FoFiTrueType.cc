@@ -17,7 +17,7 @@
 #include "goo/gtypes.h"
 #include "goo/gmem.h"
 #include "goo/GooString.h"
-#include "goo/GooHash.h"
+#include "goo/GooStrHash.h"
 #include "FoFiType1C.h"
 #include "FoFiTrueType.h"
 
@@ -1975,7 +1975,6 @@ void FoFiTrueType::parse() {
 }
 
 void FoFiTrueType::readPostTable() {
-  GooString *name;
   int tablePos, postFmt, stringIdx, stringPos;
   GBool ok;
   int i, j, n, m;
@@ -1989,13 +1988,15 @@ void FoFiTrueType::readPostTable() {
   if (!ok) {
     goto err;
   }
+  // the glyph names are referenced in place, either in macGlyphNames
+  // or in the font data, so building the table doesn't copy them
   if (postFmt == 0x00010000) {
-    nameToGID = new GooHash(gTrue);
+    nameToGID = new GooStrHash(258);
     for (i = 0; i < 258; ++i) {
-      nameToGID->add(new GooString(macGlyphNames[i]), i);
+      nameToGID->addInt(macGlyphNames[i], strlen(macGlyphNames[i]), i,
+			gFalse);
     }
   } else if (postFmt == 0x00020000) {
-    nameToGID = new GooHash(gTrue);
     n = getU16BE(tablePos + 32, &ok);
     if (!ok) {
       goto err;
@@ -2003,13 +2004,14 @@ void FoFiTrueType::readPostTable() {
     if (n > nGlyphs) {
       n = nGlyphs;
     }
+    nameToGID = new GooStrHash(n);
     stringIdx = 0;
     stringPos = tablePos + 34 + 2*n;
     for (i = 0; i < n; ++i) {
       j = getU16BE(tablePos + 34 + 2*i, &ok);
       if (j < 258) {
-	nameToGID->removeInt(macGlyphNames[j]);
-	nameToGID->add(new GooString(macGlyphNames[j]), i);
+	nameToGID->addInt(macGlyphNames[j], strlen(macGlyphNames[j]), i,
+			  gFalse);
       } else {
 	j -= 258;
 	if (j != stringIdx) {
@@ -2024,23 +2026,21 @@ void FoFiTrueType::readPostTable() {
 	if (!ok || !checkRegion(stringPos + 1, m)) {
 	  goto err;
 	}
-	name = new GooString((char *)&file[stringPos + 1], m);
-	nameToGID->removeInt(name);
-	nameToGID->add(name, i);
+	nameToGID->addInt((char *)&file[stringPos + 1], m, i, gFalse);
 	++stringIdx;
 	stringPos += 1 + m;
       }
     }
   } else if (postFmt == 0x00028000) {
-    nameToGID = new GooHash(gTrue);
+    nameToGID = new GooStrHash(nGlyphs);
     for (i = 0; i < nGlyphs; ++i) {
       j = getU8(tablePos + 32 + i, &ok);
       if (!ok) {
 	goto err;
       }
       if (j < 258) {
-	nameToGID->removeInt(macGlyphNames[j]);
-	nameToGID->add(new GooString(macGlyphNames[j]), i);
+	nameToGID->addInt(macGlyphNames[j], strlen(macGlyphNames[j]), i,
+			  gFalse);
       }
     }
   }
@@ -17,7 +17,7 @@
 #include "FoFiBase.h"
 
 class GooString;
-class GooHash;
+class GooStrHash;
 struct TrueTypeTable;
 struct TrueTypeCmap;
 
@@ -173,7 +173,7 @@ private:
   int nGlyphs;
   int locaFmt;
   int bbox[4];
-  GooHash *nameToGID;
+  GooStrHash *nameToGID;
   GBool openTypeCFF;
 
   GBool parsedOk;
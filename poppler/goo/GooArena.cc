@@ -0,0 +1,177 @@
+//========================================================================
+//
+// GooArena.cc
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "gmem.h"
+#include "GooArena.h"
+
+//------------------------------------------------------------------------
+
+#define gooArenaAlign(n) (((n) + 7) & ~7)
+
+struct GooArenaChunk {
+  GooArenaChunk *next;
+  int size;			// size of data
+  int used;			// bytes of data in use
+};
+
+#define gooArenaChunkHdrSize gooArenaAlign((int)sizeof(GooArenaChunk))
+
+static inline char *gooArenaChunkData(GooArenaChunk *chunk) {
+  return (char *)chunk + gooArenaChunkHdrSize;
+}
+
+//------------------------------------------------------------------------
+// GooArena
+//------------------------------------------------------------------------
+
+GooArena::GooArena(int chunkSizeA) {
+  chunkSize = gooArenaAlign(chunkSizeA);
+  first = cur = spare = NULL;
+  last = NULL;
+  nChunkAllocs = 0;
+}
+
+GooArena::~GooArena() {
+  GooArenaChunk *chunk, *next;
+
+  for (chunk = first; chunk; chunk = next) {
+    next = chunk->next;
+    gfree(chunk);
+  }
+  gfree(spare);
+}
+
+GooArenaChunk *GooArena::newChunk(int size) {
+  GooArenaChunk *chunk;
+
+  if (size == chunkSize && spare) {
+    chunk = spare;
+    spare = NULL;
+  } else {
+    chunk = (GooArenaChunk *)gmalloc(gooArenaChunkHdrSize + size);
+    chunk->size = size;
+    ++nChunkAllocs;
+  }
+  chunk->next = NULL;
+  chunk->used = 0;
+  if (cur) {
+    cur->next = chunk;
+  } else {
+    first = chunk;
+  }
+  cur = chunk;
+  return chunk;
+}
+
+void *GooArena::alloc(int size) {
+  char *p;
+
+  size = gooArenaAlign(size);
+  if (!cur || cur->used + size > cur->size) {
+    newChunk(size > chunkSize / 4 ? size : chunkSize);
+  }
+  p = gooArenaChunkData(cur) + cur->used;
+  cur->used += size;
+  last = p;
+  return p;
+}
+
+void *GooArena::allocn(int nObjs, int objSize) {
+  if (nObjs == 0) {
+    return NULL;
+  }
+  if (objSize <= 0 || nObjs < 0 || nObjs >= (INT_MAX - 8) / objSize) {
+#if USE_EXCEPTIONS
+    throw GMemException();
+#else
+    fprintf(stderr, "Bogus memory allocation size\n");
+    exit(1);
+#endif
+  }
+  return alloc(nObjs * objSize);
+}
+
+void *GooArena::reallocn(void *p, int oldN, int newN, int objSize) {
+  char *q;
+  int oldSize, newSize;
+
+  if (!p) {
+    return allocn(newN, objSize);
+  }
+  if (newN == 0) {
+    return NULL;
+  }
+  if (objSize <= 0 || newN < 0 || newN >= (INT_MAX - 8) / objSize) {
+#if USE_EXCEPTIONS
+    throw GMemException();
+#else
+    fprintf(stderr, "Bogus memory allocation size\n");
+    exit(1);
+#endif
+  }
+
+  // resize the most recent allocation in place
+  oldSize = gooArenaAlign(oldN * objSize);
+  newSize = gooArenaAlign(newN * objSize);
+  if (p == last &&
+      (char *)p + newSize <= gooArenaChunkData(cur) + cur->size) {
+    cur->used += newSize - oldSize;
+    return p;
+  }
+
+  q = (char *)alloc(newN * objSize);
+  memcpy(q, p, (oldN < newN ? oldN : newN) * objSize);
+  return q;
+}
+
+GooArenaMark GooArena::getMark() {
+  GooArenaMark mark;
+
+  mark.chunk = cur;
+  mark.used = cur ? cur->used : 0;
+  return mark;
+}
+
+void GooArena::release(GooArenaMark *mark) {
+  GooArenaChunk *chunk, *next;
+
+  chunk = mark->chunk ? mark->chunk->next : first;
+  for (; chunk; chunk = next) {
+    next = chunk->next;
+    if (chunk->size == chunkSize && !spare) {
+      spare = chunk;
+    } else {
+      gfree(chunk);
+    }
+  }
+  if (mark->chunk) {
+    cur = mark->chunk;
+    cur->next = NULL;
+    cur->used = mark->used;
+  } else {
+    first = cur = NULL;
+  }
+  last = NULL;
+}
+
+void GooArena::reset() {
+  GooArenaMark mark;
+
+  // keep the first chunk around for the next round of allocations
+  mark.chunk = first;
+  mark.used = 0;
+  release(&mark);
+}
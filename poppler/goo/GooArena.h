@@ -0,0 +1,89 @@
+//========================================================================
+//
+// GooArena.h
+//
+// Bump allocator for short-lived objects that are all released
+// together.
+//
+//========================================================================
+
+#ifndef GOOARENA_H
+#define GOOARENA_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stddef.h>
+#include "gtypes.h"
+
+//------------------------------------------------------------------------
+
+// Default chunk size, in bytes.  Allocations larger than a quarter of
+// the chunk size get a chunk of their own.
+#define gooArenaChunkSize 16384
+
+struct GooArenaChunk;
+
+// A position in an arena, as returned by GooArena::getMark.
+struct GooArenaMark {
+  GooArenaChunk *chunk;
+  int used;
+};
+
+//------------------------------------------------------------------------
+// GooArena
+//------------------------------------------------------------------------
+
+class GooArena {
+public:
+
+  GooArena(int chunkSizeA = gooArenaChunkSize);
+
+  // Frees all chunks -- any objects still in the arena are not
+  // destroyed.
+  ~GooArena();
+
+  // Allocate <size> bytes, aligned for any type.  Memory can't be
+  // freed individually; it is reclaimed by release or reset.
+  void *alloc(int size);
+
+  // Allocate <nObjs> * <objSize> bytes, checking for overflow.
+  void *allocn(int nObjs, int objSize);
+
+  // Grow (or shrink) a block from allocn from <oldN> to <newN>
+  // objects.  The most recent allocation is resized in place if
+  // possible; otherwise the contents are copied to a new block.
+  void *reallocn(void *p, int oldN, int newN, int objSize);
+
+  // Get the current position, and free everything allocated after
+  // it.  Marks must be released in LIFO order.
+  GooArenaMark getMark();
+  void release(GooArenaMark *mark);
+
+  // Free everything.
+  void reset();
+
+  // Number of chunks obtained from gmalloc so far (for statistics).
+  int getNumChunkAllocs() { return nChunkAllocs; }
+
+private:
+
+  GooArenaChunk *newChunk(int size);
+
+  int chunkSize;
+  GooArenaChunk *first;		// first chunk (kept by reset)
+  GooArenaChunk *cur;		// chunk being allocated from
+  GooArenaChunk *spare;		// one released standard-size chunk
+  void *last;			// most recent allocation
+  int nChunkAllocs;
+};
+
+// Placement allocation: "new (arena) T(...)".  Objects allocated this
+// way must be destroyed with an explicit destructor call (if they
+// have anything to destroy), never with delete.
+inline void *operator new(size_t size, GooArena *arena)
+  { return arena->alloc((int)size); }
+inline void operator delete(void *p, GooArena *arena) {}
+
+#endif
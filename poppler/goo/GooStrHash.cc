@@ -0,0 +1,149 @@
+//========================================================================
+//
+// GooStrHash.cc
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "gmem.h"
+#include "GooArena.h"
+#include "GooStrHash.h"
+
+//------------------------------------------------------------------------
+
+struct GooStrHashEntry {
+  const char *key;		// NULL if the entry is empty
+  int keyLen;
+  Guint h;
+  union {
+    void *p;
+    int i;
+  } val;
+};
+
+// Smallest table allocated.
+#define gooStrHashMinSize 16
+
+// Chunk size for copied keys.
+#define gooStrHashKeyChunkSize 4096
+
+//------------------------------------------------------------------------
+// GooStrHash
+//------------------------------------------------------------------------
+
+GooStrHash::GooStrHash(int sizeHint) {
+  size = gooStrHashMinSize;
+  while (size < 2 * sizeHint) {
+    size <<= 1;
+  }
+  tab = (GooStrHashEntry *)gmallocn(size, sizeof(GooStrHashEntry));
+  memset(tab, 0, size * sizeof(GooStrHashEntry));
+  len = 0;
+  keys = NULL;
+}
+
+GooStrHash::~GooStrHash() {
+  gfree(tab);
+  delete keys;
+}
+
+void GooStrHash::add(const char *key, int keyLen, void *val,
+		     GBool copyKey) {
+  insert(key, keyLen, copyKey)->val.p = val;
+}
+
+void GooStrHash::addInt(const char *key, int keyLen, int val,
+			GBool copyKey) {
+  insert(key, keyLen, copyKey)->val.i = val;
+}
+
+void *GooStrHash::lookup(const char *key, int keyLen, Guint h) {
+  GooStrHashEntry *e;
+
+  e = find(key, keyLen, h);
+  return e->key ? e->val.p : NULL;
+}
+
+int GooStrHash::lookupInt(const char *key, int keyLen, Guint h) {
+  GooStrHashEntry *e;
+
+  e = find(key, keyLen, h);
+  return e->key ? e->val.i : 0;
+}
+
+// Return the entry for <key>, or the empty entry where it would go.
+GooStrHashEntry *GooStrHash::find(const char *key, int keyLen, Guint h) {
+  GooStrHashEntry *e;
+  int i;
+
+  i = h & (size - 1);
+  while ((e = &tab[i])->key) {
+    if (e->h == h && e->keyLen == keyLen &&
+	(e->key == key || !memcmp(e->key, key, keyLen))) {
+      break;
+    }
+    i = (i + 1) & (size - 1);
+  }
+  return e;
+}
+
+GooStrHashEntry *GooStrHash::insert(const char *key, int keyLen,
+				    GBool copyKey) {
+  GooStrHashEntry *e;
+  char *key2;
+  Guint h;
+
+  h = hash(key, keyLen);
+  e = find(key, keyLen, h);
+  if (e->key) {
+    return e;
+  }
+
+  // keep the table at most half full
+  if (2 * (len + 1) > size) {
+    expand();
+    e = find(key, keyLen, h);
+  }
+
+  if (copyKey) {
+    if (!keys) {
+      keys = new GooArena(gooStrHashKeyChunkSize);
+    }
+    key2 = (char *)keys->alloc(keyLen + 1);
+    memcpy(key2, key, keyLen);
+    key2[keyLen] = '\0';
+    key = key2;
+  }
+  e->key = key;
+  e->keyLen = keyLen;
+  e->h = h;
+  ++len;
+  return e;
+}
+
+void GooStrHash::expand() {
+  GooStrHashEntry *oldTab;
+  int oldSize, i, j;
+
+  oldTab = tab;
+  oldSize = size;
+  size *= 2;
+  tab = (GooStrHashEntry *)gmallocn(size, sizeof(GooStrHashEntry));
+  memset(tab, 0, size * sizeof(GooStrHashEntry));
+  for (i = 0; i < oldSize; ++i) {
+    if (oldTab[i].key) {
+      j = oldTab[i].h & (size - 1);
+      while (tab[j].key) {
+	j = (j + 1) & (size - 1);
+      }
+      tab[j] = oldTab[i];
+    }
+  }
+  gfree(oldTab);
+}
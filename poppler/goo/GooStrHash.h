@@ -0,0 +1,87 @@
+//========================================================================
+//
+// GooStrHash.h
+//
+// Open-addressing hash table keyed by strings.
+//
+//========================================================================
+
+#ifndef GOOSTRHASH_H
+#define GOOSTRHASH_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <string.h>
+#include "gtypes.h"
+
+class GooArena;
+struct GooStrHashEntry;
+
+//------------------------------------------------------------------------
+// GooStrHash
+//
+// A lighter replacement for GooHash on lookup-heavy paths.  Entries
+// live in a single array (linear probing, kept at most half full),
+// each with its precomputed hash, so inserts don't allocate and
+// lookups rarely touch the key bytes.  Keys are (pointer, length)
+// pairs; a key can either be referenced in place -- static tables,
+// font file data, name atoms -- or copied into storage owned by the
+// table.
+//
+// The hash function is the one used for name atoms (see objAtom), so
+// a caller holding an atom can pass objAtomHash(atom) directly.
+//------------------------------------------------------------------------
+
+class GooStrHash {
+public:
+
+  // Create an empty table, sized to hold <sizeHint> entries without
+  // rehashing.
+  GooStrHash(int sizeHint = 0);
+  ~GooStrHash();
+
+  // 32-bit FNV-1a.
+  static Guint hash(const char *s, int n) {
+    Guint h;
+    int i;
+
+    h = 0x811c9dc5;
+    for (i = 0; i < n; ++i) {
+      h = (h ^ (Guchar)s[i]) * 0x01000193;
+    }
+    return h;
+  }
+
+  // Map <key> (<keyLen> chars, not necessarily null-terminated) to
+  // <val>, replacing any existing value.  If <copyKey> is false, the
+  // table points at <key>, which must outlive the table.
+  void add(const char *key, int keyLen, void *val, GBool copyKey);
+  void addInt(const char *key, int keyLen, int val, GBool copyKey);
+
+  // Look up a key, given its hash.  Returns NULL / 0 if not found.
+  void *lookup(const char *key, int keyLen, Guint h);
+  int lookupInt(const char *key, int keyLen, Guint h);
+
+  // Look up a null-terminated key.
+  void *lookup(const char *key)
+    { int n = strlen(key); return lookup(key, n, hash(key, n)); }
+  int lookupInt(const char *key)
+    { int n = strlen(key); return lookupInt(key, n, hash(key, n)); }
+
+  int getLength() { return len; }
+
+private:
+
+  GooStrHashEntry *find(const char *key, int keyLen, Guint h);
+  GooStrHashEntry *insert(const char *key, int keyLen, GBool copyKey);
+  void expand();
+
+  GooStrHashEntry *tab;		// entries (key == NULL: empty)
+  int size;			// number of entries, a power of two
+  int len;			// number of entries in use
+  GooArena *keys;		// storage for copied keys, or NULL
+};
+
+#endif
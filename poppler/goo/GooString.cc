@@ -72,6 +72,97 @@ static const char *formatStrings[] = {
   NULL
 };
 
+//------------------------------------------------------------------------
+// free-lists
+//------------------------------------------------------------------------
+
+// The lexer and the text code create and destroy short strings at a
+// high rate, so GooString objects and small heap buffers are kept on
+// per-thread free-lists instead of going back to malloc.  Lists are
+// capped, which bounds what a thread leaves behind when it exits.
+
+#define gooStrPoolMaxBuf 128		// largest pooled buffer size
+#define gooStrPoolDepth 64		// max blocks kept per list
+
+struct GooStrFreeList {
+  void *head;			// blocks, linked through their first word
+  int n;			// number of blocks on the list
+};
+
+#if MULTITHREADED
+#define gooStrThreadLocal __thread
+#else
+#define gooStrThreadLocal
+#endif
+
+#ifndef DEBUG_MEM
+// buffer sizes are multiples of 8, so list i holds 8*i-byte blocks
+static gooStrThreadLocal GooStrFreeList gooStrBufPool[gooStrPoolMaxBuf / 8 + 1];
+static gooStrThreadLocal GooStrFreeList gooStrObjPool;
+#endif
+
+static inline void *gooStrPoolGet(GooStrFreeList *list, int size) {
+  void *p;
+
+  if ((p = list->head)) {
+    list->head = *(void **)p;
+    --list->n;
+    return p;
+  }
+  return gmalloc(size);
+}
+
+static inline void gooStrPoolPut(GooStrFreeList *list, void *p) {
+  if (list->n < gooStrPoolDepth) {
+    *(void **)p = list->head;
+    list->head = p;
+    ++list->n;
+  } else {
+    gfree(p);
+  }
+}
+
+void *GooString::operator new(size_t size) {
+#ifndef DEBUG_MEM
+  if (size == sizeof(GooString)) {
+    return gooStrPoolGet(&gooStrObjPool, (int)size);
+  }
+#endif
+  return gmalloc((int)size);
+}
+
+void GooString::operator delete(void *p, size_t size) {
+  if (!p) {
+    return;
+  }
+#ifndef DEBUG_MEM
+  if (size == sizeof(GooString)) {
+    gooStrPoolPut(&gooStrObjPool, p);
+    return;
+  }
+#endif
+  gfree(p);
+}
+
+char *GooString::allocBuf(int size) {
+#ifndef DEBUG_MEM
+  if (size <= gooStrPoolMaxBuf) {
+    return (char *)gooStrPoolGet(&gooStrBufPool[size >> 3], size);
+  }
+#endif
+  return (char *)gmalloc(size);
+}
+
+void GooString::freeBuf(char *p, int size) {
+#ifndef DEBUG_MEM
+  if (size <= gooStrPoolMaxBuf) {
+    gooStrPoolPut(&gooStrBufPool[size >> 3], p);
+    return;
+  }
+#endif
+  gfree(p);
+}
+
 //------------------------------------------------------------------------
 
 int inline GooString::roundedSize(int len) {
@@ -86,6 +177,7 @@ int inline GooString::roundedSize(int len) {
 // plus terminating 0.
 // We assume that if this is being called from the constructor, <s> was set
 // to NULL and <length> was set to 0 to indicate unused string before calling us.
+// A heap buffer is always exactly roundedSize(length) bytes.
 void inline GooString::resize(int newLength) {
   char *s1 = s;
 
@@ -95,12 +187,12 @@ void inline GooString::resize(int newLength) {
       s1 = sStatic;
     } else {
       // allocate a rounded amount
-      if (s == sStatic)
-	s1 = (char*)gmalloc(roundedSize(newLength));
+      if (!s || s == sStatic)
+	s1 = allocBuf(roundedSize(newLength));
       else
 	s1 = (char*)grealloc(s, roundedSize(newLength));
     }
-    if (s == sStatic || s1 == sStatic) {
+    if (s && (s == sStatic || s1 == sStatic)) {
       // copy the minimum, we only need to if are moving to or
       // from sStatic.
       // assert(s != s1) the roundedSize condition ensures this
@@ -109,6 +201,9 @@ void inline GooString::resize(int newLength) {
       } else {
 	memcpy(s1, s, length);
       }
+      if (s1 == sStatic) {
+	freeBuf(s, roundedSize(length));
+      }
     }
 
   }
@@ -218,7 +313,7 @@ GooString *GooString::formatv(const char *fmt, va_list argList) {
 
 GooString::~GooString() {
   if (s != sStatic)
-    free(s);
+    freeBuf(s, roundedSize(length));
 }
 
 GooString *GooString::clear() {
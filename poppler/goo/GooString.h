@@ -17,6 +17,7 @@
 
 #include <stdarg.h>
 #include <stdlib.h> // for NULL
+#include <stddef.h> // for size_t
 #include "gtypes.h"
 
 class GooString {
@@ -78,6 +79,10 @@ public:
   // Destructor.
   ~GooString();
 
+  // GooString objects are recycled through a free-list.
+  void *operator new(size_t size);
+  void operator delete(void *p, size_t size);
+
   // Get length.
   int getLength() { return length; }
 
@@ -133,6 +138,8 @@ private:
   static const int CALC_STRING_LEN = -1;
 
   int  roundedSize(int len);
+  static char *allocBuf(int size);
+  static void freeBuf(char *p, int size);
 
   char sStatic[STR_STATIC_SIZE];
   int length;
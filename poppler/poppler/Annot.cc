@@ -2919,19 +2919,19 @@ void AnnotWidget::generateFieldAppearance() {
 
   // build the appearance stream dictionary
   appearDict.initDict(xref);
-  appearDict.dictAdd(copyString("Length"),
+  appearDict.dictAdd("Length",
       obj1.initInt(appearBuf->getLength()));
-  appearDict.dictAdd(copyString("Subtype"), obj1.initName("Form"));
+  appearDict.dictAdd("Subtype", obj1.initName("Form"));
   obj1.initArray(xref);
   obj1.arrayAdd(obj2.initReal(0));
   obj1.arrayAdd(obj2.initReal(0));
   obj1.arrayAdd(obj2.initReal(rect->x2 - rect->x1));
   obj1.arrayAdd(obj2.initReal(rect->y2 - rect->y1));
-  appearDict.dictAdd(copyString("BBox"), &obj1);
+  appearDict.dictAdd("BBox", &obj1);
 
   // set the resource dictionary
   if (drObj.isDict()) {
-    appearDict.dictAdd(copyString("Resources"), drObj.copy(&obj1));
+    appearDict.dictAdd("Resources", drObj.copy(&obj1));
   }
   drObj.free();
 
@@ -43,6 +43,9 @@ public:
   // Accessors.
   Object *get(int i, Object *obj);
   Object *getNF(int i, Object *obj);
+  // Element <i> itself, without copying it or resolving references.
+  // The object still belongs to the array.
+  Object *getNFPtr(int i) { return &elems[i]; }
   GBool getString(int i, GooString *string);
 
 private:
@@ -55,6 +55,8 @@ static void str_term_source(j_decompress_ptr cinfo)
 DCTStream::DCTStream(Stream *strA, int colorXformA) :
   FilterStream(strA) {
   //fprintf(stderr, "[start_jpeg]");
+  scaleDenom = 1;
+  grayOut = gFalse;
   init();
 }
 
@@ -88,6 +90,8 @@ void DCTStream::init()
   jerr.error_exit = &exitErrorHandler;
   cinfo.err = &jerr;
   x = 0;
+  rowLen = 0;
+  rgbToGray = gFalse;
   row_buffer = NULL;
 }
 
@@ -140,9 +144,26 @@ void DCTStream::reset() {
   cinfo.dct_method = JDCT_IFAST;
   cinfo.do_fancy_upsampling = FALSE;
 
+  // reduced-size decoding: libjpeg scales the IDCT itself, so the
+  // dropped coefficients are never computed
+  if (scaleDenom > 1) {
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scaleDenom;
+  }
+  if (grayOut) {
+    if (cinfo.jpeg_color_space == JCS_YCbCr ||
+	cinfo.jpeg_color_space == JCS_GRAYSCALE) {
+      // Y is the gray value, chroma is skipped entirely
+      cinfo.out_color_space = JCS_GRAYSCALE;
+    } else if (cinfo.num_components == 3) {
+      rgbToGray = gTrue;
+    }
+  }
+
   jpeg_start_decompress(&cinfo);
 
   row_stride = cinfo.output_width * cinfo.output_components;
+  rowLen = rgbToGray ? cinfo.output_width : row_stride;
   row_buffer = cinfo.mem->alloc_sarray((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
 }
 
@@ -150,17 +171,24 @@ int DCTStream::getChar() {
   if (src.abort) return EOF;
   
   int c;
+  JSAMPROW p, q;
+  unsigned int i;
 
   if (x == 0) {
     if (cinfo.output_scanline < cinfo.output_height)
     {
       if (!jpeg_read_scanlines(&cinfo, row_buffer, 1)) return EOF;
+      if (rgbToGray) {
+	for (i = 0, p = q = row_buffer[0]; i < cinfo.output_width; ++i, p += 3) {
+	  *q++ = (p[0] * 77 + p[1] * 151 + p[2] * 28) >> 8;
+	}
+      }
     }
     else return EOF;
   }
   c = row_buffer[0][x];
   x++;
-  if (x == cinfo.output_width * cinfo.output_components)
+  if (x == rowLen)
     x = 0;
   return c;
 }
@@ -189,3 +217,23 @@ GooString *DCTStream::getPSFilter(int psLevel, const char *indent) {
 GBool DCTStream::isBinary(GBool last) {
   return str->isBinary(gTrue);
 }
+
+void DCTStream::setReducedDecode(int minWidth, int minHeight,
+				 int *widthA, int *heightA, GBool *grayA) {
+  int denom;
+
+  // libjpeg can scale by 1/2, 1/4 and 1/8 -- pick the largest
+  // reduction that still covers the requested size
+  denom = 1;
+  while (denom < 8 &&
+	 (*widthA + 2 * denom - 1) / (2 * denom) >= minWidth &&
+	 (*heightA + 2 * denom - 1) / (2 * denom) >= minHeight) {
+    denom *= 2;
+  }
+  scaleDenom = denom;
+
+  // same rounding as jpeg_calc_output_dimensions()
+  *widthA = (*widthA + denom - 1) / denom;
+  *heightA = (*heightA + denom - 1) / denom;
+  grayOut = *grayA;
+}
@@ -59,12 +59,18 @@ public:
   virtual int lookChar();
   virtual GooString *getPSFilter(int psLevel, const char *indent);
   virtual GBool isBinary(GBool last = gTrue);
+  virtual void setReducedDecode(int minWidth, int minHeight,
+				int *widthA, int *heightA, GBool *grayA);
   Stream *getRawStream() { return str; }
 
 private:
   void init();
 
   unsigned int x;
+  unsigned int rowLen;		// bytes per decoded row
+  int scaleDenom;		// IDCT scaling: 1, 2, 4 or 8
+  GBool grayOut;		// produce one gray component per pixel
+  GBool rgbToGray;		// gray requested from an RGB-coded JPEG
   struct jpeg_decompress_struct cinfo;
   struct jpeg_error_mgr jerr;
   struct str_src_mgr src;
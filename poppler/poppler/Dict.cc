@@ -19,6 +19,12 @@
 #include "XRef.h"
 #include "Dict.h"
 
+//------------------------------------------------------------------------
+
+// Dictionaries with at least this many entries get a hash index;
+// smaller ones are searched linearly.
+#define dictHashMinLength 12
+
 //------------------------------------------------------------------------
 // Dict
 //------------------------------------------------------------------------
@@ -28,16 +34,20 @@ Dict::Dict(XRef *xrefA) {
   entries = NULL;
   size = length = 0;
   ref = 1;
+  hashTab = NULL;
+  hashSize = 0;
 }
 
 Dict::Dict(Dict* dictA) {
   xref = dictA->xref;
   size = length = dictA->length;
   ref = 1;
+  hashTab = NULL;
+  hashSize = 0;
 
   entries = (DictEntry *)gmallocn(size, sizeof(DictEntry));
   for (int i=0; i<length; i++) {
-    entries[i].key = strdup(dictA->entries[i].key);
+    entries[i].key = dictA->entries[i].key;
     dictA->entries[i].val.copy(&entries[i].val);
   }
 }
@@ -46,10 +56,10 @@ Dict::~Dict() {
   int i;
 
   for (i = 0; i < length; ++i) {
-    gfree(entries[i].key);
     entries[i].val.free();
   }
   gfree(entries);
+  gfree(hashTab);
 }
 
 void Dict::add(const char *key, Object *val) {
@@ -61,17 +71,61 @@ void Dict::add(const char *key, Object *val) {
     }
     entries = (DictEntry *)greallocn(entries, size, sizeof(DictEntry));
   }
-  entries[length].key = (char *) key;
+  entries[length].key = objAtom(key);
   entries[length].val = *val;
   ++length;
+  if (hashTab) {
+    gfree(hashTab);
+    hashTab = NULL;
+  }
 }
 
-inline DictEntry *Dict::find(const char *key) {
-  int i;
+void Dict::buildHash() {
+  int i, h;
 
+  for (hashSize = 32; hashSize < 2 * length; hashSize <<= 1) ;
+  hashTab = (int *)gmallocn(hashSize, sizeof(int));
+  for (h = 0; h < hashSize; ++h) {
+    hashTab[h] = -1;
+  }
   for (i = 0; i < length; ++i) {
-    if (!strcmp(key, entries[i].key))
+    h = objAtomHash(entries[i].key) & (hashSize - 1);
+    while (hashTab[h] >= 0) {
+      // the first of any duplicate keys wins, as in a linear search
+      if (entries[hashTab[h]].key == entries[i].key) {
+	break;
+      }
+      h = (h + 1) & (hashSize - 1);
+    }
+    if (hashTab[h] < 0) {
+      hashTab[h] = i;
+    }
+  }
+}
+
+inline DictEntry *Dict::find(const char *key) {
+  char *atom;
+  int i, h;
+
+  if (!(atom = objFindAtom(key))) {
+    return NULL;
+  }
+  if (length < dictHashMinLength) {
+    for (i = 0; i < length; ++i) {
+      if (entries[i].key == atom)
+	return &entries[i];
+    }
+    return NULL;
+  }
+  if (!hashTab) {
+    buildHash();
+  }
+  h = objAtomHash(atom) & (hashSize - 1);
+  while ((i = hashTab[h]) >= 0) {
+    if (entries[i].key == atom) {
       return &entries[i];
+    }
+    h = (h + 1) & (hashSize - 1);
   }
   return NULL;
 }
@@ -89,6 +143,10 @@ void Dict::remove(const char *key) {
     }
   }
   if(!found) return;
+  if (hashTab) {
+    gfree(hashTab);
+    hashTab = NULL;
+  }
   //replace the deleted entry with the last entry
   length -= 1;
   tmp = entries[length];
@@ -103,7 +161,7 @@ void Dict::set(const char *key, Object *val) {
     e->val.free();
     e->val = *val;
   } else {
-    add (copyString(key), val);
+    add (key, val);
   }
 }
 
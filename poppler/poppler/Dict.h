@@ -20,7 +20,7 @@
 //------------------------------------------------------------------------
 
 struct DictEntry {
-  char *key;
+  char *key;			// atom (see objAtom)
   Object val;
 };
 
@@ -41,7 +41,8 @@ public:
   // Get number of entries.
   int getLength() { return length; }
 
-  // Add an entry.  NB: does not copy key.
+  // Add an entry.  The key is converted to an atom, so the caller
+  // keeps ownership of <key>.
   void add(const char *key, Object *val);
 
   // Update the value of an existing entry, otherwise create it
@@ -68,6 +69,9 @@ public:
   // parsed.
   void setXRef(XRef *xrefA) { xref = xrefA; }
 
+  // Get the xref table this dictionary belongs to.
+  XRef *getXRef() { return xref; }
+
 private:
 
   XRef *xref;			// the xref table for this PDF file
@@ -75,8 +79,12 @@ private:
   int size;			// size of <entries> array
   int length;			// number of entries in dictionary
   int ref;			// reference count
+  int *hashTab;			// entry index by key hash (-1 = empty),
+  int hashSize;			//   built on the first lookup in a
+				//   large dictionary
 
   DictEntry *find(const char *key);
+  void buildHash();
 };
 
 #endif
@@ -0,0 +1,1587 @@
+//========================================================================
+//
+// DisplayList.cc
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooList.h"
+#include "goo/GooArena.h"
+#include "Error.h"
+#include "Object.h"
+#include "Stream.h"
+#include "XRef.h"
+#include "Catalog.h"
+#include "Page.h"
+#include "PDFDoc.h"
+#include "Function.h"
+#include "GfxFont.h"
+#include "GfxState.h"
+#include "DisplayList.h"
+
+//------------------------------------------------------------------------
+
+// Inline images larger than this (in decoded bytes) are not recorded.
+#define displayListMaxInlineImage (1024 * 1024)
+
+// Number of drawing and clipping calls replayed between abort checks.
+#define displayListAbortCheckInterval 16
+
+enum DisplayListOp {
+  dlSaveState,
+  dlRestoreState,
+  dlUpdateAll,
+  dlUpdateCTM,			// ctm[6], m[6]
+  dlUpdateLineDash,		// length, start, dash[length]
+  dlUpdateFlatness,		// int
+  dlUpdateLineJoin,		// int
+  dlUpdateLineCap,		// int
+  dlUpdateMiterLimit,		// FP
+  dlUpdateLineWidth,		// FP
+  dlUpdateStrokeAdjust,		// int
+  dlUpdateAlphaIsShape,		// int
+  dlUpdateTextKnockout,		// int
+  dlUpdateFillColorSpace,	// GfxColorSpace *
+  dlUpdateStrokeColorSpace,	// GfxColorSpace *
+  dlUpdateFillColor,		// nComps, c[nComps]
+  dlUpdateStrokeColor,		// nComps, c[nComps]
+  dlUpdateBlendMode,		// int
+  dlUpdateFillOpacity,		// FP
+  dlUpdateStrokeOpacity,	// FP
+  dlUpdateFillOverprint,	// int
+  dlUpdateStrokeOverprint,	// int
+  dlUpdateTransfer,		// Function *[4]
+  dlUpdateFont,			// GfxFont *, FP size
+  dlUpdateTextMat,		// FP[6]
+  dlUpdateCharSpace,		// FP
+  dlUpdateRender,		// int
+  dlUpdateRise,			// FP
+  dlUpdateWordSpace,		// FP
+  dlUpdateHorizScaling,		// FP
+  dlUpdateTextPos,		// FP lineX, lineY
+  dlUpdateTextShift,		// FP shift
+  dlStroke,			// path
+  dlFill,			// path
+  dlEOFill,			// path
+  dlClip,			// path
+  dlEOClip,			// path
+  dlClipToStrokePath,		// path
+  dlBeginStringOp,
+  dlEndStringOp,
+  dlDrawChar,			// FP x, y, dx, dy, originX, originY,
+				//   code, nBytes, uLen, u[uLen]
+  dlDrawGlyphRun,		// nGlyphs, simple, glyphs (see drawGlyphRun)
+  dlEndTextObject,
+  dlDrawImageMask,		// image, width, height, invert
+  dlDrawImage,			// image, width, height, GfxImageColorMap *,
+				//   nMaskColors, maskColors[nMaskColors]
+  dlDrawMaskedImage,		// ref, width, height, GfxImageColorMap *,
+				//   maskWidth, maskHeight, maskInvert
+  dlDrawSoftMaskedImage,	// ref, width, height, GfxImageColorMap *,
+				//   maskWidth, maskHeight, GfxImageColorMap *
+  dlEnd
+};
+
+// An image is either a reference (inline = 0, num, gen) or inline
+// data (inline = 1, Guchar *, length).
+
+//------------------------------------------------------------------------
+// DisplayListReader
+//------------------------------------------------------------------------
+
+class DisplayListReader {
+public:
+
+  DisplayListReader(Guchar *dataA) { p = dataA; }
+  int getOp() { return *p++; }
+  int getInt() { int x; memcpy(&x, p, sizeof(int)); p += sizeof(int); return x; }
+  FixedPoint getFP() { return FixedPoint::make(getInt()); }
+  void *getPtr() { void *x; memcpy(&x, p, sizeof(void *)); p += sizeof(void *); return x; }
+  void getBytes(void *buf, int n) { memcpy(buf, p, n); p += n; }
+
+private:
+
+  Guchar *p;
+};
+
+//------------------------------------------------------------------------
+// DisplayList
+//------------------------------------------------------------------------
+
+DisplayList::DisplayList(int pageNumA, GBool useMediaBoxA, GBool cropA,
+			 GBool printingA) {
+  int i;
+
+  pageNum = pageNumA;
+  useMediaBox = useMediaBoxA;
+  crop = cropA;
+  printing = printingA;
+  ok = gTrue;
+  complete = gFalse;
+  dataSize = 4096;
+  data = (Guchar *)gmalloc(dataSize);
+  dataLen = 0;
+  extraSize = 0;
+  for (i = 0; i < 6; ++i) {
+    baseCTM[i] = 0;
+  }
+  colorSpaces = new GooList();
+  colorMaps = new GooList();
+  funcs = new GooList();
+  fonts = new GooList();
+  bufs = new GooList();
+}
+
+DisplayList::~DisplayList() {
+  int i;
+
+  gfree(data);
+  deleteGooList(colorSpaces, GfxColorSpace);
+  deleteGooList(colorMaps, GfxImageColorMap);
+  deleteGooList(funcs, Function);
+  for (i = 0; i < fonts->getLength(); ++i) {
+    ((GfxFont *)fonts->get(i))->decRefCnt();
+  }
+  delete fonts;
+  for (i = 0; i < bufs->getLength(); ++i) {
+    gfree(bufs->get(i));
+  }
+  delete bufs;
+}
+
+void DisplayList::putBytes(const void *p, int n) {
+  if (dataLen + n > dataSize) {
+    while (dataLen + n > dataSize) {
+      dataSize *= 2;
+    }
+    data = (Guchar *)grealloc(data, dataSize);
+  }
+  memcpy(data + dataLen, p, n);
+  dataLen += n;
+}
+
+void DisplayList::putOp(int op) {
+  Guchar c;
+
+  c = (Guchar)op;
+  putBytes(&c, 1);
+}
+
+void DisplayList::putInt(int x) {
+  putBytes(&x, sizeof(int));
+}
+
+void DisplayList::putPtr(void *p) {
+  putBytes(&p, sizeof(void *));
+}
+
+// Paths are stored in user space: the number of subpaths, then for
+// each subpath its point count, closed flag, coordinates and curve
+// flags.
+void DisplayList::putPath(GfxState *state) {
+  GfxPath *path;
+  GfxSubpath *subpath;
+  Guchar curve;
+  int i, j, n;
+
+  path = state->getPath();
+  putInt(path->getNumSubpaths());
+  for (i = 0; i < path->getNumSubpaths(); ++i) {
+    subpath = path->getSubpath(i);
+    n = subpath->getNumPoints();
+    putInt(n);
+    putInt(subpath->isClosed());
+    for (j = 0; j < n; ++j) {
+      putFP(subpath->getX(j));
+      putFP(subpath->getY(j));
+      curve = (Guchar)subpath->getCurve(j);
+      putBytes(&curve, 1);
+    }
+  }
+}
+
+void DisplayList::replayPath(DisplayListReader *r, GfxState *state) {
+  FixedPoint x[2], y[2], px, py;
+  Guchar curve;
+  int nSubpaths, i, j, k, n;
+  GBool closed;
+
+  state->clearPath();
+  nSubpaths = r->getInt();
+  for (i = 0; i < nSubpaths; ++i) {
+    n = r->getInt();
+    closed = r->getInt();
+    k = 0;
+    for (j = 0; j < n; ++j) {
+      px = r->getFP();
+      py = r->getFP();
+      r->getBytes(&curve, 1);
+      if (j == 0) {
+	state->moveTo(px, py);
+      } else if (curve && k < 2) {
+	// the two control points of a curve are flagged
+	x[k] = px;
+	y[k] = py;
+	++k;
+      } else if (k == 2) {
+	state->curveTo(x[0], y[0], x[1], y[1], px, py);
+	k = 0;
+      } else {
+	state->lineTo(px, py);
+      }
+    }
+    if (closed) {
+      state->closePath();
+    }
+  }
+}
+
+static Stream *fetchImage(XRef *xref, Ref ref, Object *obj) {
+  xref->fetch(ref.num, ref.gen, obj);
+  if (!obj->isStream()) {
+    error(-1, "Display list image %d %d R is not a stream", ref.num, ref.gen);
+    return NULL;
+  }
+  return obj->getStream();
+}
+
+static Stream *fetchMask(Object *obj, const char *key, Object *maskObj) {
+  obj->streamGetDict()->lookup((char *)key, maskObj);
+  if (!maskObj->isStream()) {
+    return NULL;
+  }
+  return maskObj->getStream();
+}
+
+GBool DisplayList::display(PDFDoc *doc, OutputDev *out, FixedPoint hDPI,
+			   FixedPoint vDPI, int rotate,
+			   GBool (*abortCheckCbk)(void *data),
+			   void *abortCheckCbkData) {
+  DisplayListReader r(data);
+  Catalog *catalog;
+  XRef *xref;
+  Page *page;
+  PDFRectangle box;
+  GooArena *pathArena;
+  GfxState *state;
+  GfxColorSpace *colorSpace;
+  GfxImageColorMap *colorMap, *maskColorMap;
+  GfxFont *font;
+  GfxColor color;
+  GfxGlyphPos *glyphs;
+  Function *transfer[4];
+  Object obj, maskObj, refObj;
+  Stream *str, *maskStr;
+  Unicode u[16];
+  FixedPoint ctm[6], m[6], x, y, dx, dy, originX, originY;
+  FixedPoint *dash;
+  double base[6], ibase[6], t[6], det;
+  CharCode code;
+  Ref ref;
+  Guchar *buf;
+  int maskColors[2 * gfxColorMaxComps];
+  int op, n, i, nBytes, uLen, width, height, maskWidth, maskHeight;
+  int nDrawn;
+  GBool crop2, identity, isInline, invert, aborted;
+
+  catalog = doc->getCatalog();
+  xref = doc->getXRef();
+  page = catalog->getPage(pageNum);
+  if (!out->checkPageSlice(page, hDPI, vDPI, rotate, useMediaBox, crop,
+			   -1, -1, -1, -1, printing, catalog,
+			   abortCheckCbk, abortCheckCbkData)) {
+    return gTrue;
+  }
+
+  rotate += page->getRotate();
+  if (rotate >= 360) {
+    rotate -= 360;
+  } else if (rotate < 0) {
+    rotate += 360;
+  }
+  crop2 = crop;
+  page->makeBox(hDPI, vDPI, rotate, useMediaBox, out->upsideDown(),
+		-1, -1, -1, -1, &box, &crop2);
+  state = new GfxState(hDPI, vDPI, &box, rotate, out->upsideDown());
+  pathArena = new GooArena();
+  state->setPathArena(pathArena);
+  out->startPage(pageNum, state);
+  out->setDefaultCTM(state->getCTM());
+
+  // recorded CTMs are mapped from the recording's default CTM to the
+  // new one: ctm' = ctm * inv(baseCTM) * newBaseCTM
+  identity = gTrue;
+  for (i = 0; i < 6; ++i) {
+    if (baseCTM[i] != state->getCTM()[i]) {
+      identity = gFalse;
+    }
+  }
+  if (!identity) {
+    for (i = 0; i < 6; ++i) {
+      base[i] = (double)baseCTM[i];
+      t[i] = (double)state->getCTM()[i];
+    }
+    det = 1 / (base[0] * base[3] - base[1] * base[2]);
+    ibase[0] = base[3] * det;
+    ibase[1] = -base[1] * det;
+    ibase[2] = -base[2] * det;
+    ibase[3] = base[0] * det;
+    ibase[4] = (base[2] * base[5] - base[3] * base[4]) * det;
+    ibase[5] = (base[1] * base[4] - base[0] * base[5]) * det;
+    base[0] = ibase[0] * t[0] + ibase[1] * t[2];
+    base[1] = ibase[0] * t[1] + ibase[1] * t[3];
+    base[2] = ibase[2] * t[0] + ibase[3] * t[2];
+    base[3] = ibase[2] * t[1] + ibase[3] * t[3];
+    base[4] = ibase[4] * t[0] + ibase[5] * t[2] + t[4];
+    base[5] = ibase[4] * t[1] + ibase[5] * t[3] + t[5];
+    for (i = 0; i < 6; ++i) {
+      t[i] = base[i];
+    }
+  }
+
+  nDrawn = 0;
+  aborted = gFalse;
+  while (!aborted && (op = r.getOp()) != dlEnd) {
+    switch (op) {
+
+    case dlSaveState:
+      out->saveState(state);
+      state = state->save();
+      break;
+    case dlRestoreState:
+      if (state->hasSaves()) {
+	state = state->restore();
+	out->restoreState(state);
+      }
+      break;
+
+    // the recording always starts from a fresh GfxState, as does the
+    // replay, so there is nothing to set here
+    case dlUpdateAll:
+      out->updateAll(state);
+      break;
+
+    case dlUpdateCTM:
+      for (i = 0; i < 6; ++i) {
+	ctm[i] = r.getFP();
+      }
+      for (i = 0; i < 6; ++i) {
+	m[i] = r.getFP();
+      }
+      if (identity) {
+	state->setCTM(ctm[0], ctm[1], ctm[2], ctm[3], ctm[4], ctm[5]);
+      } else {
+	state->setCTM((double)ctm[0] * t[0] + (double)ctm[1] * t[2],
+		      (double)ctm[0] * t[1] + (double)ctm[1] * t[3],
+		      (double)ctm[2] * t[0] + (double)ctm[3] * t[2],
+		      (double)ctm[2] * t[1] + (double)ctm[3] * t[3],
+		      (double)ctm[4] * t[0] + (double)ctm[5] * t[2] + t[4],
+		      (double)ctm[4] * t[1] + (double)ctm[5] * t[3] + t[5]);
+      }
+      out->updateCTM(state, m[0], m[1], m[2], m[3], m[4], m[5]);
+      break;
+
+    case dlUpdateLineDash:
+      n = r.getInt();
+      x = r.getFP();
+      dash = n > 0 ? (FixedPoint *)gmallocn(n, sizeof(FixedPoint)) : NULL;
+      for (i = 0; i < n; ++i) {
+	dash[i] = r.getFP();
+      }
+      state->setLineDash(dash, n, x);
+      out->updateLineDash(state);
+      break;
+    case dlUpdateFlatness:
+      state->setFlatness(r.getInt());
+      out->updateFlatness(state);
+      break;
+    case dlUpdateLineJoin:
+      state->setLineJoin(r.getInt());
+      out->updateLineJoin(state);
+      break;
+    case dlUpdateLineCap:
+      state->setLineCap(r.getInt());
+      out->updateLineCap(state);
+      break;
+    case dlUpdateMiterLimit:
+      state->setMiterLimit(r.getFP());
+      out->updateMiterLimit(state);
+      break;
+    case dlUpdateLineWidth:
+      state->setLineWidth(r.getFP());
+      out->updateLineWidth(state);
+      break;
+    case dlUpdateStrokeAdjust:
+      state->setStrokeAdjust(r.getInt());
+      out->updateStrokeAdjust(state);
+      break;
+    case dlUpdateAlphaIsShape:
+      state->setAlphaIsShape(r.getInt());
+      out->updateAlphaIsShape(state);
+      break;
+    case dlUpdateTextKnockout:
+      state->setTextKnockout(r.getInt());
+      out->updateTextKnockout(state);
+      break;
+    case dlUpdateFillColorSpace:
+      colorSpace = (GfxColorSpace *)r.getPtr();
+      state->setFillColorSpace(colorSpace->copy());
+      out->updateFillColorSpace(state);
+      break;
+    case dlUpdateStrokeColorSpace:
+      colorSpace = (GfxColorSpace *)r.getPtr();
+      state->setStrokeColorSpace(colorSpace->copy());
+      out->updateStrokeColorSpace(state);
+      break;
+    case dlUpdateFillColor:
+      n = r.getInt();
+      memset(&color, 0, sizeof(color));
+      r.getBytes(color.c, n * sizeof(GfxColorComp));
+      state->setFillColor(&color);
+      out->updateFillColor(state);
+      break;
+    case dlUpdateStrokeColor:
+      n = r.getInt();
+      memset(&color, 0, sizeof(color));
+      r.getBytes(color.c, n * sizeof(GfxColorComp));
+      state->setStrokeColor(&color);
+      out->updateStrokeColor(state);
+      break;
+    case dlUpdateBlendMode:
+      state->setBlendMode((GfxBlendMode)r.getInt());
+      out->updateBlendMode(state);
+      break;
+    case dlUpdateFillOpacity:
+      state->setFillOpacity(r.getFP());
+      out->updateFillOpacity(state);
+      break;
+    case dlUpdateStrokeOpacity:
+      state->setStrokeOpacity(r.getFP());
+      out->updateStrokeOpacity(state);
+      break;
+    case dlUpdateFillOverprint:
+      state->setFillOverprint(r.getInt());
+      out->updateFillOverprint(state);
+      break;
+    case dlUpdateStrokeOverprint:
+      state->setStrokeOverprint(r.getInt());
+      out->updateStrokeOverprint(state);
+      break;
+    case dlUpdateTransfer:
+      for (i = 0; i < 4; ++i) {
+	transfer[i] = (Function *)r.getPtr();
+	if (transfer[i]) {
+	  transfer[i] = transfer[i]->copy();
+	}
+      }
+      state->setTransfer(transfer);
+      out->updateTransfer(state);
+      break;
+
+    case dlUpdateFont:
+      font = (GfxFont *)r.getPtr();
+      x = r.getFP();
+      if (font) {
+	font->incRefCnt();
+      }
+      state->setFont(font, x);
+      out->updateFont(state);
+      break;
+    case dlUpdateTextMat:
+      for (i = 0; i < 6; ++i) {
+	m[i] = r.getFP();
+      }
+      state->setTextMat(m[0], m[1], m[2], m[3], m[4], m[5]);
+      out->updateTextMat(state);
+      break;
+    case dlUpdateCharSpace:
+      state->setCharSpace(r.getFP());
+      out->updateCharSpace(state);
+      break;
+    case dlUpdateRender:
+      state->setRender(r.getInt());
+      out->updateRender(state);
+      break;
+    case dlUpdateRise:
+      state->setRise(r.getFP());
+      out->updateRise(state);
+      break;
+    case dlUpdateWordSpace:
+      state->setWordSpace(r.getFP());
+      out->updateWordSpace(state);
+      break;
+    case dlUpdateHorizScaling:
+      state->setHorizScalingFactor(r.getFP());
+      out->updateHorizScaling(state);
+      break;
+    case dlUpdateTextPos:
+      x = r.getFP();
+      y = r.getFP();
+      state->textMoveTo(x, y);
+      out->updateTextPos(state);
+      break;
+    case dlUpdateTextShift:
+      // the current point isn't replayed -- the recorded drawing
+      // calls carry their own positions
+      out->updateTextShift(state, r.getFP());
+      break;
+
+    case dlStroke:
+      replayPath(&r, state);
+      out->stroke(state);
+      ++nDrawn;
+      break;
+    case dlFill:
+      replayPath(&r, state);
+      out->fill(state);
+      ++nDrawn;
+      break;
+    case dlEOFill:
+      replayPath(&r, state);
+      out->eoFill(state);
+      ++nDrawn;
+      break;
+    case dlClip:
+      replayPath(&r, state);
+      state->clip();
+      out->clip(state);
+      ++nDrawn;
+      break;
+    case dlEOClip:
+      replayPath(&r, state);
+      state->clip();
+      out->eoClip(state);
+      ++nDrawn;
+      break;
+    case dlClipToStrokePath:
+      replayPath(&r, state);
+      state->clipToStrokePath();
+      out->clipToStrokePath(state);
+      ++nDrawn;
+      break;
+
+    case dlBeginStringOp:
+      out->beginStringOp(state);
+      break;
+    case dlEndStringOp:
+      out->endStringOp(state);
+      break;
+    case dlDrawChar:
+      x = r.getFP();
+      y = r.getFP();
+      dx = r.getFP();
+      dy = r.getFP();
+      originX = r.getFP();
+      originY = r.getFP();
+      code = (CharCode)r.getInt();
+      nBytes = r.getInt();
+      uLen = r.getInt();
+      r.getBytes(u, uLen * sizeof(Unicode));
+      out->drawChar(state, x, y, dx, dy, originX, originY, code, nBytes,
+		    uLen ? u : (Unicode *)NULL, uLen);
+      ++nDrawn;
+      break;
+    case dlDrawGlyphRun:
+      n = r.getInt();
+      glyphs = (GfxGlyphPos *)gmallocn(n, sizeof(GfxGlyphPos));
+      if (r.getInt()) {
+	for (i = 0; i < n; ++i) {
+	  glyphs[i].x = r.getFP();
+	  glyphs[i].y = r.getFP();
+	  glyphs[i].dx = r.getFP();
+	  glyphs[i].dy = 0;
+	  glyphs[i].originX = glyphs[i].originY = 0;
+	  glyphs[i].code = (CharCode)r.getInt();
+	  glyphs[i].nBytes = 1;
+	}
+      } else {
+	r.getBytes(glyphs, n * sizeof(GfxGlyphPos));
+      }
+      out->drawGlyphRun(state, glyphs, n);
+      gfree(glyphs);
+      ++nDrawn;
+      break;
+    case dlEndTextObject:
+      out->endTextObject(state);
+      break;
+
+    case dlDrawImageMask:
+    case dlDrawImage:
+    case dlDrawMaskedImage:
+    case dlDrawSoftMaskedImage:
+      isInline = r.getInt();
+      buf = NULL;
+      n = 0;
+      ref.num = ref.gen = 0;
+      if (isInline) {
+	buf = (Guchar *)r.getPtr();
+	n = r.getInt();
+      } else {
+	ref.num = r.getInt();
+	ref.gen = r.getInt();
+      }
+      width = r.getInt();
+      height = r.getInt();
+      maskObj.initNull();
+      if (isInline) {
+	obj.initNull();
+	str = new MemStream((char *)buf, 0, n, &obj);
+	refObj.initNull();
+      } else {
+	str = fetchImage(xref, ref, &obj);
+	refObj.initRef(ref.num, ref.gen);
+      }
+      switch (op) {
+      case dlDrawImageMask:
+	invert = r.getInt();
+	if (str) {
+	  out->drawImageMask(state, isInline ? (Object *)NULL : &refObj, str,
+			     width, height, invert, isInline);
+	}
+	break;
+      case dlDrawImage:
+	colorMap = (GfxImageColorMap *)r.getPtr();
+	n = r.getInt();
+	r.getBytes(maskColors, n * sizeof(int));
+	if (str) {
+	  out->drawImage(state, isInline ? (Object *)NULL : &refObj, str,
+			 width, height, colorMap,
+			 n ? maskColors : (int *)NULL, isInline);
+	}
+	break;
+      case dlDrawMaskedImage:
+	colorMap = (GfxImageColorMap *)r.getPtr();
+	maskWidth = r.getInt();
+	maskHeight = r.getInt();
+	invert = r.getInt();
+	if (str && (maskStr = fetchMask(&obj, "Mask", &maskObj))) {
+	  out->drawMaskedImage(state, &refObj, str, width, height, colorMap,
+			       maskStr, maskWidth, maskHeight, invert);
+	}
+	break;
+      case dlDrawSoftMaskedImage:
+	colorMap = (GfxImageColorMap *)r.getPtr();
+	maskWidth = r.getInt();
+	maskHeight = r.getInt();
+	maskColorMap = (GfxImageColorMap *)r.getPtr();
+	if (str && (maskStr = fetchMask(&obj, "SMask", &maskObj))) {
+	  out->drawSoftMaskedImage(state, &refObj, str, width, height,
+				   colorMap, maskStr, maskWidth, maskHeight,
+				   maskColorMap);
+	}
+	break;
+      }
+      if (isInline) {
+	delete str;
+      }
+      maskObj.free();
+      obj.free();
+      refObj.free();
+      ++nDrawn;
+      break;
+
+    default:
+      error(-1, "Bad display list op %d", op);
+      aborted = gTrue;
+      break;
+    }
+
+    // check for an abort
+    if (abortCheckCbk && nDrawn >= displayListAbortCheckInterval) {
+      nDrawn = 0;
+      if ((*abortCheckCbk)(abortCheckCbkData)) {
+	aborted = gTrue;
+      }
+    }
+  }
+
+  while (state->hasSaves()) {
+    state = state->restore();
+    out->restoreState(state);
+  }
+  out->endPage();
+  delete state;
+  delete pathArena;
+  return !aborted;
+}
+
+//------------------------------------------------------------------------
+// DisplayListOutputDev
+//------------------------------------------------------------------------
+
+DisplayListOutputDev::DisplayListOutputDev(OutputDev *outA,
+					   DisplayList *listA) {
+  int i;
+
+  out = outA;
+  list = listA;
+  for (i = 0; i <= csDeviceCMYK; ++i) {
+    deviceColorSpaces[i] = NULL;
+  }
+}
+
+DisplayListOutputDev::~DisplayListOutputDev() {
+}
+
+void DisplayListOutputDev::setDefaultCTM(FixedPoint *ctm) {
+  OutputDev::setDefaultCTM(ctm);
+  out->setDefaultCTM(ctm);
+}
+
+GBool DisplayListOutputDev::checkPageSlice(Page *page, FixedPoint hDPI,
+					   FixedPoint vDPI, int rotate,
+					   GBool useMediaBox, GBool crop,
+					   int sliceX, int sliceY,
+					   int sliceW, int sliceH,
+					   GBool printing, Catalog *catalog,
+					   GBool (*abortCheckCbk)(void *data),
+					   void *abortCheckCbkData) {
+  if (sliceX >= 0 || sliceY >= 0) {
+    list->setBad();
+  }
+  return out->checkPageSlice(page, hDPI, vDPI, rotate, useMediaBox, crop,
+			     sliceX, sliceY, sliceW, sliceH, printing,
+			     catalog, abortCheckCbk, abortCheckCbkData);
+}
+
+void DisplayListOutputDev::startPage(int pageNum, GfxState *state) {
+  int i;
+
+  for (i = 0; i < 6; ++i) {
+    list->baseCTM[i] = state->getCTM()[i];
+  }
+  out->startPage(pageNum, state);
+}
+
+void DisplayListOutputDev::endPage() {
+  out->endPage();
+  list->putOp(dlEnd);
+  list->data = (Guchar *)grealloc(list->data, list->dataLen);
+  list->dataSize = list->dataLen;
+  list->complete = gTrue;
+}
+
+void DisplayListOutputDev::dump() {
+  out->dump();
+}
+
+void DisplayListOutputDev::saveState(GfxState *state) {
+  out->saveState(state);
+  list->putOp(dlSaveState);
+}
+
+void DisplayListOutputDev::restoreState(GfxState *state) {
+  out->restoreState(state);
+  list->putOp(dlRestoreState);
+}
+
+void DisplayListOutputDev::updateAll(GfxState *state) {
+  out->updateAll(state);
+  list->putOp(dlUpdateAll);
+}
+
+void DisplayListOutputDev::updateCTM(GfxState *state, FixedPoint m11,
+				     FixedPoint m12, FixedPoint m21,
+				     FixedPoint m22, FixedPoint m31,
+				     FixedPoint m32) {
+  int i;
+
+  out->updateCTM(state, m11, m12, m21, m22, m31, m32);
+  list->putOp(dlUpdateCTM);
+  for (i = 0; i < 6; ++i) {
+    list->putFP(state->getCTM()[i]);
+  }
+  list->putFP(m11);
+  list->putFP(m12);
+  list->putFP(m21);
+  list->putFP(m22);
+  list->putFP(m31);
+  list->putFP(m32);
+}
+
+void DisplayListOutputDev::updateLineDash(GfxState *state) {
+  FixedPoint *dash;
+  FixedPoint start;
+  int length, i;
+
+  out->updateLineDash(state);
+  state->getLineDash(&dash, &length, &start);
+  list->putOp(dlUpdateLineDash);
+  list->putInt(length);
+  list->putFP(start);
+  for (i = 0; i < length; ++i) {
+    list->putFP(dash[i]);
+  }
+}
+
+void DisplayListOutputDev::updateFlatness(GfxState *state) {
+  out->updateFlatness(state);
+  list->putOp(dlUpdateFlatness);
+  list->putInt(state->getFlatness());
+}
+
+void DisplayListOutputDev::updateLineJoin(GfxState *state) {
+  out->updateLineJoin(state);
+  list->putOp(dlUpdateLineJoin);
+  list->putInt(state->getLineJoin());
+}
+
+void DisplayListOutputDev::updateLineCap(GfxState *state) {
+  out->updateLineCap(state);
+  list->putOp(dlUpdateLineCap);
+  list->putInt(state->getLineCap());
+}
+
+void DisplayListOutputDev::updateMiterLimit(GfxState *state) {
+  out->updateMiterLimit(state);
+  list->putOp(dlUpdateMiterLimit);
+  list->putFP(state->getMiterLimit());
+}
+
+void DisplayListOutputDev::updateLineWidth(GfxState *state) {
+  out->updateLineWidth(state);
+  list->putOp(dlUpdateLineWidth);
+  list->putFP(state->getLineWidth());
+}
+
+void DisplayListOutputDev::updateStrokeAdjust(GfxState *state) {
+  out->updateStrokeAdjust(state);
+  list->putOp(dlUpdateStrokeAdjust);
+  list->putInt(state->getStrokeAdjust());
+}
+
+void DisplayListOutputDev::updateAlphaIsShape(GfxState *state) {
+  out->updateAlphaIsShape(state);
+  list->putOp(dlUpdateAlphaIsShape);
+  list->putInt(state->getAlphaIsShape());
+}
+
+void DisplayListOutputDev::updateTextKnockout(GfxState *state) {
+  out->updateTextKnockout(state);
+  list->putOp(dlUpdateTextKnockout);
+  list->putInt(state->getTextKnockout());
+}
+
+// Gfx creates a new color space object for every color operator, so
+// the device spaces (which have no parameters) are only copied once
+// per list.
+GfxColorSpace *DisplayListOutputDev::copyColorSpace(GfxColorSpace *colorSpace) {
+  GfxColorSpaceMode mode;
+
+  mode = colorSpace->getMode();
+  if (mode == csDeviceGray || mode == csDeviceRGB || mode == csDeviceCMYK) {
+    if (!deviceColorSpaces[mode]) {
+      deviceColorSpaces[mode] = colorSpace->copy();
+      list->colorSpaces->append(deviceColorSpaces[mode]);
+    }
+    return deviceColorSpaces[mode];
+  }
+  colorSpace = colorSpace->copy();
+  list->colorSpaces->append(colorSpace);
+  list->extraSize += 64;
+  return colorSpace;
+}
+
+void DisplayListOutputDev::updateFillColorSpace(GfxState *state) {
+  out->updateFillColorSpace(state);
+  list->putOp(dlUpdateFillColorSpace);
+  list->putPtr(copyColorSpace(state->getFillColorSpace()));
+}
+
+void DisplayListOutputDev::updateStrokeColorSpace(GfxState *state) {
+  out->updateStrokeColorSpace(state);
+  list->putOp(dlUpdateStrokeColorSpace);
+  list->putPtr(copyColorSpace(state->getStrokeColorSpace()));
+}
+
+static int getColorNComps(GfxColorSpace *colorSpace) {
+  int n;
+
+  n = colorSpace->getNComps();
+  if (n < 1 || n > gfxColorMaxComps) {
+    n = gfxColorMaxComps;
+  }
+  return n;
+}
+
+void DisplayListOutputDev::updateFillColor(GfxState *state) {
+  int n;
+
+  out->updateFillColor(state);
+  n = getColorNComps(state->getFillColorSpace());
+  list->putOp(dlUpdateFillColor);
+  list->putInt(n);
+  list->putBytes(state->getFillColor()->c, n * sizeof(GfxColorComp));
+}
+
+void DisplayListOutputDev::updateStrokeColor(GfxState *state) {
+  int n;
+
+  out->updateStrokeColor(state);
+  n = getColorNComps(state->getStrokeColorSpace());
+  list->putOp(dlUpdateStrokeColor);
+  list->putInt(n);
+  list->putBytes(state->getStrokeColor()->c, n * sizeof(GfxColorComp));
+}
+
+void DisplayListOutputDev::updateBlendMode(GfxState *state) {
+  out->updateBlendMode(state);
+  list->putOp(dlUpdateBlendMode);
+  list->putInt(state->getBlendMode());
+}
+
+void DisplayListOutputDev::updateFillOpacity(GfxState *state) {
+  out->updateFillOpacity(state);
+  list->putOp(dlUpdateFillOpacity);
+  list->putFP(state->getFillOpacity());
+}
+
+void DisplayListOutputDev::updateStrokeOpacity(GfxState *state) {
+  out->updateStrokeOpacity(state);
+  list->putOp(dlUpdateStrokeOpacity);
+  list->putFP(state->getStrokeOpacity());
+}
+
+void DisplayListOutputDev::updateFillOverprint(GfxState *state) {
+  out->updateFillOverprint(state);
+  list->putOp(dlUpdateFillOverprint);
+  list->putInt(state->getFillOverprint());
+}
+
+void DisplayListOutputDev::updateStrokeOverprint(GfxState *state) {
+  out->updateStrokeOverprint(state);
+  list->putOp(dlUpdateStrokeOverprint);
+  list->putInt(state->getStrokeOverprint());
+}
+
+void DisplayListOutputDev::updateTransfer(GfxState *state) {
+  Function *func;
+  int i;
+
+  out->updateTransfer(state);
+  list->putOp(dlUpdateTransfer);
+  for (i = 0; i < 4; ++i) {
+    func = state->getTransfer()[i];
+    if (func) {
+      func = func->copy();
+      list->funcs->append(func);
+      list->extraSize += 256;
+    }
+    list->putPtr(func);
+  }
+}
+
+void DisplayListOutputDev::updateFont(GfxState *state) {
+  GfxFont *font;
+
+  out->updateFont(state);
+  font = state->getFont();
+  if (font) {
+    font->incRefCnt();
+    list->fonts->append(font);
+  }
+  list->putOp(dlUpdateFont);
+  list->putPtr(font);
+  list->putFP(state->getFontSize());
+}
+
+void DisplayListOutputDev::updateTextMat(GfxState *state) {
+  int i;
+
+  out->updateTextMat(state);
+  list->putOp(dlUpdateTextMat);
+  for (i = 0; i < 6; ++i) {
+    list->putFP(state->getTextMat()[i]);
+  }
+}
+
+void DisplayListOutputDev::updateCharSpace(GfxState *state) {
+  out->updateCharSpace(state);
+  list->putOp(dlUpdateCharSpace);
+  list->putFP(state->getCharSpace());
+}
+
+void DisplayListOutputDev::updateRender(GfxState *state) {
+  out->updateRender(state);
+  list->putOp(dlUpdateRender);
+  list->putInt(state->getRender());
+}
+
+void DisplayListOutputDev::updateRise(GfxState *state) {
+  out->updateRise(state);
+  list->putOp(dlUpdateRise);
+  list->putFP(state->getRise());
+}
+
+void DisplayListOutputDev::updateWordSpace(GfxState *state) {
+  out->updateWordSpace(state);
+  list->putOp(dlUpdateWordSpace);
+  list->putFP(state->getWordSpace());
+}
+
+void DisplayListOutputDev::updateHorizScaling(GfxState *state) {
+  out->updateHorizScaling(state);
+  list->putOp(dlUpdateHorizScaling);
+  list->putFP(state->getHorizScaling());
+}
+
+void DisplayListOutputDev::updateTextPos(GfxState *state) {
+  out->updateTextPos(state);
+  list->putOp(dlUpdateTextPos);
+  list->putFP(state->getLineX());
+  list->putFP(state->getLineY());
+}
+
+void DisplayListOutputDev::updateTextShift(GfxState *state, FixedPoint shift) {
+  out->updateTextShift(state, shift);
+  list->putOp(dlUpdateTextShift);
+  list->putFP(shift);
+}
+
+void DisplayListOutputDev::stroke(GfxState *state) {
+  out->stroke(state);
+  list->putOp(dlStroke);
+  list->putPath(state);
+}
+
+void DisplayListOutputDev::fill(GfxState *state) {
+  out->fill(state);
+  list->putOp(dlFill);
+  list->putPath(state);
+}
+
+void DisplayListOutputDev::eoFill(GfxState *state) {
+  out->eoFill(state);
+  list->putOp(dlEOFill);
+  list->putPath(state);
+}
+
+void DisplayListOutputDev::tilingPatternFill(GfxState *state, Object *str,
+					     int paintType, Dict *resDict,
+					     FixedPoint *mat, FixedPoint *bbox,
+					     int x0, int y0, int x1, int y1,
+					     FixedPoint xStep,
+					     FixedPoint yStep) {
+  list->setBad();
+  out->tilingPatternFill(state, str, paintType, resDict, mat, bbox,
+			 x0, y0, x1, y1, xStep, yStep);
+}
+
+// Whether a shading can be drawn natively depends on the device
+// transform (and Gfx falls back to filling the shape if not), so
+// shaded fills aren't recorded.
+GBool DisplayListOutputDev::functionShadedFill(GfxState *state,
+					       GfxFunctionShading *shading) {
+  list->setBad();
+  return out->functionShadedFill(state, shading);
+}
+
+GBool DisplayListOutputDev::axialShadedFill(GfxState *state,
+					    GfxAxialShading *shading) {
+  list->setBad();
+  return out->axialShadedFill(state, shading);
+}
+
+GBool DisplayListOutputDev::radialShadedFill(GfxState *state,
+					     GfxRadialShading *shading) {
+  list->setBad();
+  return out->radialShadedFill(state, shading);
+}
+
+void DisplayListOutputDev::clip(GfxState *state) {
+  out->clip(state);
+  list->putOp(dlClip);
+  list->putPath(state);
+}
+
+void DisplayListOutputDev::eoClip(GfxState *state) {
+  out->eoClip(state);
+  list->putOp(dlEOClip);
+  list->putPath(state);
+}
+
+void DisplayListOutputDev::clipToStrokePath(GfxState *state) {
+  out->clipToStrokePath(state);
+  list->putOp(dlClipToStrokePath);
+  list->putPath(state);
+}
+
+void DisplayListOutputDev::beginStringOp(GfxState *state) {
+  out->beginStringOp(state);
+  list->putOp(dlBeginStringOp);
+}
+
+void DisplayListOutputDev::endStringOp(GfxState *state) {
+  out->endStringOp(state);
+  list->putOp(dlEndStringOp);
+}
+
+// The string brackets are passed on but not recorded: the characters
+// themselves are (drawChar / drawGlyphRun).
+void DisplayListOutputDev::beginString(GfxState *state, GooString *s) {
+  out->beginString(state, s);
+}
+
+void DisplayListOutputDev::endString(GfxState *state) {
+  out->endString(state);
+}
+
+void DisplayListOutputDev::drawChar(GfxState *state,
+				    FixedPoint x, FixedPoint y,
+				    FixedPoint dx, FixedPoint dy,
+				    FixedPoint originX, FixedPoint originY,
+				    CharCode code, int nBytes,
+				    Unicode *u, int uLen) {
+  out->drawChar(state, x, y, dx, dy, originX, originY, code, nBytes, u, uLen);
+  if (!u || uLen > 16) {
+    uLen = 0;
+  }
+  list->putOp(dlDrawChar);
+  list->putFP(x);
+  list->putFP(y);
+  list->putFP(dx);
+  list->putFP(dy);
+  list->putFP(originX);
+  list->putFP(originY);
+  list->putInt((int)code);
+  list->putInt(nBytes);
+  list->putInt(uLen);
+  list->putBytes(u, uLen * sizeof(Unicode));
+}
+
+// Whole strings are only drawn by devices that don't use drawChar,
+// which aren't recorded.
+void DisplayListOutputDev::drawString(GfxState *state, GooString *s) {
+  list->setBad();
+  out->drawString(state, s);
+}
+
+// Runs of horizontal single-byte glyphs -- nearly all of them -- are
+// stored as x, y, dx and code only.
+void DisplayListOutputDev::drawGlyphRun(GfxState *state, GfxGlyphPos *glyphs,
+					int nGlyphs) {
+  GBool simple;
+  int i;
+
+  out->drawGlyphRun(state, glyphs, nGlyphs);
+  simple = gTrue;
+  for (i = 0; i < nGlyphs; ++i) {
+    if (glyphs[i].dy != 0 || glyphs[i].originX != 0 ||
+	glyphs[i].originY != 0 || glyphs[i].nBytes != 1) {
+      simple = gFalse;
+      break;
+    }
+  }
+  list->putOp(dlDrawGlyphRun);
+  list->putInt(nGlyphs);
+  list->putInt(simple);
+  if (simple) {
+    for (i = 0; i < nGlyphs; ++i) {
+      list->putFP(glyphs[i].x);
+      list->putFP(glyphs[i].y);
+      list->putFP(glyphs[i].dx);
+      list->putInt((int)glyphs[i].code);
+    }
+  } else {
+    list->putBytes(glyphs, nGlyphs * sizeof(GfxGlyphPos));
+  }
+}
+
+// Type 3 glyphs are cached as bitmaps at the current transform, and
+// the char procs are only run on a cache miss.
+GBool DisplayListOutputDev::beginType3Char(GfxState *state,
+					   FixedPoint x, FixedPoint y,
+					   FixedPoint dx, FixedPoint dy,
+					   CharCode code, Unicode *u, int uLen) {
+  list->setBad();
+  return out->beginType3Char(state, x, y, dx, dy, code, u, uLen);
+}
+
+void DisplayListOutputDev::endType3Char(GfxState *state) {
+  out->endType3Char(state);
+}
+
+void DisplayListOutputDev::endTextObject(GfxState *state) {
+  out->endTextObject(state);
+  list->putOp(dlEndTextObject);
+}
+
+// Read an inline image's <n> decoded bytes into a buffer owned by
+// the list, and return a stream over them.
+Stream *DisplayListOutputDev::readInlineImage(Stream *str, int n) {
+  Guchar *buf;
+  Object obj;
+  int i;
+
+  buf = (Guchar *)gmalloc(n);
+  str->reset();
+  i = str->getChars(n, buf);
+  str->close();
+  memset(buf + i, 0, n - i);
+  list->bufs->append(buf);
+  list->extraSize += n;
+  list->putInt(gTrue);
+  list->putPtr(buf);
+  list->putInt(n);
+  obj.initNull();
+  return new MemStream((char *)buf, 0, n, &obj);
+}
+
+void DisplayListOutputDev::drawImageMask(GfxState *state, Object *ref,
+					 Stream *str, int width, int height,
+					 GBool invert, GBool inlineImg) {
+  Stream *memStr;
+  int n;
+
+  n = height * ((width + 7) / 8);
+  if (!list->ok ||
+      (inlineImg ? n <= 0 || n > displayListMaxInlineImage
+                 : !ref || !ref->isRef())) {
+    list->setBad();
+    out->drawImageMask(state, ref, str, width, height, invert, inlineImg);
+    return;
+  }
+  list->putOp(dlDrawImageMask);
+  if (inlineImg) {
+    memStr = readInlineImage(str, n);
+    out->drawImageMask(state, ref, memStr, width, height, invert, inlineImg);
+    delete memStr;
+  } else {
+    out->drawImageMask(state, ref, str, width, height, invert, inlineImg);
+    list->putInt(gFalse);
+    list->putInt(ref->getRefNum());
+    list->putInt(ref->getRefGen());
+  }
+  list->putInt(width);
+  list->putInt(height);
+  list->putInt(invert);
+}
+
+void DisplayListOutputDev::drawImage(GfxState *state, Object *ref,
+				     Stream *str, int width, int height,
+				     GfxImageColorMap *colorMap,
+				     int *maskColors, GBool inlineImg) {
+  GfxImageColorMap *colorMap2;
+  Stream *memStr;
+  int nComps, n;
+
+  nComps = colorMap->getNumPixelComps();
+  n = (width * nComps * colorMap->getBits() + 7) / 8;
+  if (!list->ok ||
+      (inlineImg ? n <= 0 || height > displayListMaxInlineImage / n
+                 : !ref || !ref->isRef())) {
+    list->setBad();
+    out->drawImage(state, ref, str, width, height, colorMap, maskColors,
+		   inlineImg);
+    return;
+  }
+  list->putOp(dlDrawImage);
+  if (inlineImg) {
+    memStr = readInlineImage(str, height * n);
+    out->drawImage(state, ref, memStr, width, height, colorMap, maskColors,
+		   inlineImg);
+    delete memStr;
+  } else {
+    out->drawImage(state, ref, str, width, height, colorMap, maskColors,
+		   inlineImg);
+    list->putInt(gFalse);
+    list->putInt(ref->getRefNum());
+    list->putInt(ref->getRefGen());
+  }
+  list->putInt(width);
+  list->putInt(height);
+  colorMap2 = colorMap->copy();
+  list->colorMaps->append(colorMap2);
+  list->extraSize += 1024 * nComps;
+  list->putPtr(colorMap2);
+  if (maskColors) {
+    list->putInt(2 * nComps);
+    list->putBytes(maskColors, 2 * nComps * sizeof(int));
+  } else {
+    list->putInt(0);
+  }
+}
+
+// Masked images can't be inline, so the mask is looked up again
+// through the image's dictionary when the list is replayed.
+void DisplayListOutputDev::drawMaskedImage(GfxState *state, Object *ref,
+					   Stream *str, int width, int height,
+					   GfxImageColorMap *colorMap,
+					   Stream *maskStr,
+					   int maskWidth, int maskHeight,
+					   GBool maskInvert) {
+  GfxImageColorMap *colorMap2;
+
+  out->drawMaskedImage(state, ref, str, width, height, colorMap,
+		       maskStr, maskWidth, maskHeight, maskInvert);
+  if (!ref || !ref->isRef()) {
+    list->setBad();
+    return;
+  }
+  list->putOp(dlDrawMaskedImage);
+  list->putInt(gFalse);
+  list->putInt(ref->getRefNum());
+  list->putInt(ref->getRefGen());
+  list->putInt(width);
+  list->putInt(height);
+  colorMap2 = colorMap->copy();
+  list->colorMaps->append(colorMap2);
+  list->extraSize += 1024 * colorMap->getNumPixelComps();
+  list->putPtr(colorMap2);
+  list->putInt(maskWidth);
+  list->putInt(maskHeight);
+  list->putInt(maskInvert);
+}
+
+void DisplayListOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
+					       Stream *str,
+					       int width, int height,
+					       GfxImageColorMap *colorMap,
+					       Stream *maskStr,
+					       int maskWidth, int maskHeight,
+					       GfxImageColorMap *maskColorMap) {
+  GfxImageColorMap *colorMap2, *maskColorMap2;
+
+  out->drawSoftMaskedImage(state, ref, str, width, height, colorMap,
+			   maskStr, maskWidth, maskHeight, maskColorMap);
+  if (!ref || !ref->isRef()) {
+    list->setBad();
+    return;
+  }
+  list->putOp(dlDrawSoftMaskedImage);
+  list->putInt(gFalse);
+  list->putInt(ref->getRefNum());
+  list->putInt(ref->getRefGen());
+  list->putInt(width);
+  list->putInt(height);
+  colorMap2 = colorMap->copy();
+  list->colorMaps->append(colorMap2);
+  list->putPtr(colorMap2);
+  list->putInt(maskWidth);
+  list->putInt(maskHeight);
+  maskColorMap2 = maskColorMap->copy();
+  list->colorMaps->append(maskColorMap2);
+  list->putPtr(maskColorMap2);
+  list->extraSize += 1024 * (colorMap->getNumPixelComps() + 1);
+}
+
+// Marked content, OPI comments and links don't draw anything; they
+// are passed on but not recorded.
+void DisplayListOutputDev::endMarkedContent(GfxState *state) {
+  out->endMarkedContent(state);
+}
+
+void DisplayListOutputDev::beginMarkedContent(char *name) {
+  out->beginMarkedContent(name);
+}
+
+void DisplayListOutputDev::beginMarkedContent(char *name, Dict *properties) {
+  out->beginMarkedContent(name, properties);
+}
+
+void DisplayListOutputDev::markPoint(char *name) {
+  out->markPoint(name);
+}
+
+void DisplayListOutputDev::markPoint(char *name, Dict *properties) {
+  out->markPoint(name, properties);
+}
+
+#if OPI_SUPPORT
+void DisplayListOutputDev::opiBegin(GfxState *state, Dict *opiDict) {
+  out->opiBegin(state, opiDict);
+}
+
+void DisplayListOutputDev::opiEnd(GfxState *state, Dict *opiDict) {
+  out->opiEnd(state, opiDict);
+}
+#endif
+
+void DisplayListOutputDev::type3D0(GfxState *state, FixedPoint wx,
+				   FixedPoint wy) {
+  list->setBad();
+  out->type3D0(state, wx, wy);
+}
+
+void DisplayListOutputDev::type3D1(GfxState *state, FixedPoint wx,
+				   FixedPoint wy, FixedPoint llx,
+				   FixedPoint lly, FixedPoint urx,
+				   FixedPoint ury) {
+  list->setBad();
+  out->type3D1(state, wx, wy, llx, lly, urx, ury);
+}
+
+void DisplayListOutputDev::drawForm(Ref id) {
+  list->setBad();
+  out->drawForm(id);
+}
+
+void DisplayListOutputDev::psXObject(Stream *psStream, Stream *level1Stream) {
+  list->setBad();
+  out->psXObject(psStream, level1Stream);
+}
+
+void DisplayListOutputDev::beginTransparencyGroup(GfxState *state,
+						  FixedPoint *bbox,
+						  GfxColorSpace *blendingColorSpace,
+						  GBool isolated,
+						  GBool knockout,
+						  GBool forSoftMask) {
+  list->setBad();
+  out->beginTransparencyGroup(state, bbox, blendingColorSpace,
+			      isolated, knockout, forSoftMask);
+}
+
+void DisplayListOutputDev::endTransparencyGroup(GfxState *state) {
+  list->setBad();
+  out->endTransparencyGroup(state);
+}
+
+void DisplayListOutputDev::paintTransparencyGroup(GfxState *state,
+						  FixedPoint *bbox) {
+  list->setBad();
+  out->paintTransparencyGroup(state, bbox);
+}
+
+void DisplayListOutputDev::setSoftMask(GfxState *state, FixedPoint *bbox,
+				       GBool alpha, Function *transferFunc,
+				       GfxColor *backdropColor) {
+  list->setBad();
+  out->setSoftMask(state, bbox, alpha, transferFunc, backdropColor);
+}
+
+void DisplayListOutputDev::clearSoftMask(GfxState *state) {
+  list->setBad();
+  out->clearSoftMask(state);
+}
+
+void DisplayListOutputDev::processLink(Link *link, Catalog *catalog) {
+  out->processLink(link, catalog);
+}
+
+//------------------------------------------------------------------------
+// DisplayListCache
+//------------------------------------------------------------------------
+
+struct DisplayListCacheEntry {
+  DisplayList *list;
+  DisplayListCacheEntry *next;	// next entry, in MRU order
+};
+
+// Abort callback wrapper, to find out whether a recording finished.
+struct DisplayListAbortCheck {
+  GBool (*cbk)(void *data);
+  void *data;
+  GBool aborted;
+};
+
+static GBool displayListAbortCheck(void *data) {
+  DisplayListAbortCheck *check;
+
+  check = (DisplayListAbortCheck *)data;
+  if ((*check->cbk)(check->data)) {
+    check->aborted = gTrue;
+  }
+  return check->aborted;
+}
+
+DisplayListCache::DisplayListCache(int maxBytesA) {
+  entries = NULL;
+  maxBytes = maxBytesA;
+  bytes = 0;
+  hits = misses = 0;
+}
+
+DisplayListCache::~DisplayListCache() {
+  clear();
+}
+
+void DisplayListCache::displayPage(PDFDoc *doc, OutputDev *out, int page,
+				   FixedPoint hDPI, FixedPoint vDPI,
+				   int rotate, GBool useMediaBox, GBool crop,
+				   GBool printing,
+				   GBool (*abortCheckCbk)(void *data),
+				   void *abortCheckCbkData) {
+  DisplayListCacheEntry *entry, *prev;
+  DisplayListOutputDev *recorder;
+  DisplayList *list;
+  DisplayListAbortCheck check;
+
+  // replay a cached list
+  for (prev = NULL, entry = entries; entry; prev = entry, entry = entry->next) {
+    if (entry->list->getPageNum() == page &&
+	entry->list->matches(useMediaBox, crop, printing)) {
+      if (prev) {
+	prev->next = entry->next;
+	entry->next = entries;
+	entries = entry;
+      }
+      ++hits;
+      entry->list->display(doc, out, hDPI, vDPI, rotate,
+			   abortCheckCbk, abortCheckCbkData);
+      return;
+    }
+  }
+  ++misses;
+
+  // display the page, recording a new list
+  list = new DisplayList(page, useMediaBox, crop, printing);
+  recorder = new DisplayListOutputDev(out, list);
+  if (abortCheckCbk) {
+    check.cbk = abortCheckCbk;
+    check.data = abortCheckCbkData;
+    check.aborted = gFalse;
+    doc->displayPage(recorder, page, hDPI, vDPI, rotate,
+		     useMediaBox, crop, printing,
+		     &displayListAbortCheck, &check);
+    if (check.aborted) {
+      list->setBad();
+    }
+  } else {
+    doc->displayPage(recorder, page, hDPI, vDPI, rotate,
+		     useMediaBox, crop, printing);
+  }
+  delete recorder;
+
+  if (!list->isOk() || 2 * list->getSize() > maxBytes) {
+    delete list;
+    return;
+  }
+  entry = new DisplayListCacheEntry;
+  entry->list = list;
+  entry->next = entries;
+  entries = entry;
+  bytes += list->getSize();
+  shrink(maxBytes);
+}
+
+void DisplayListCache::clear() {
+  shrink(0);
+}
+
+void DisplayListCache::setMaxBytes(int maxBytesA) {
+  maxBytes = maxBytesA;
+  shrink(maxBytes);
+}
+
+// Throw out least recently used entries until the cache is no larger
+// than <maxBytesA>.
+void DisplayListCache::shrink(int maxBytesA) {
+  DisplayListCacheEntry *entry, **p;
+
+  while (bytes > maxBytesA && entries) {
+    for (p = &entries; (*p)->next; p = &(*p)->next) ;
+    entry = *p;
+    *p = NULL;
+    bytes -= entry->list->getSize();
+    delete entry->list;
+    delete entry;
+  }
+}
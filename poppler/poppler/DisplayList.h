@@ -0,0 +1,337 @@
+//========================================================================
+//
+// DisplayList.h
+//
+// Recorded page drawing calls, for re-rendering a page at a new
+// resolution or rotation without interpreting its content stream.
+//
+//========================================================================
+
+#ifndef DISPLAYLIST_H
+#define DISPLAYLIST_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "goo/gtypes.h"
+#include "OutputDev.h"
+#include "GfxState.h"
+
+class GooList;
+class PDFDoc;
+class DisplayListReader;
+
+// default size limit for the display list cache, in bytes
+#define displayListCacheSize (4 * 1024 * 1024)
+
+//------------------------------------------------------------------------
+// DisplayList
+//
+// The OutputDev calls made while displaying one page, in a form that
+// doesn't depend on the device transform: paths and glyph positions
+// are kept in user space, CTMs relative to the page's default CTM,
+// fonts by reference, and images by their object reference (inline
+// images by their decoded data).  Replaying the list drives an
+// OutputDev through the same calls Gfx would have made for the page
+// at the new resolution and rotation.
+//
+// Pages that use shaded fills, transparency groups, soft masks, Type
+// 3 glyphs or other calls whose effect depends on the device
+// resolution can't be recorded; their lists are marked bad.
+//------------------------------------------------------------------------
+
+class DisplayList {
+public:
+
+  DisplayList(int pageNumA, GBool useMediaBoxA, GBool cropA,
+	      GBool printingA);
+  ~DisplayList();
+
+  // Was the whole page recorded?
+  GBool isOk() { return ok && complete; }
+
+  int getPageNum() { return pageNum; }
+
+  // Does the list match the given display parameters?
+  GBool matches(GBool useMediaBoxA, GBool cropA, GBool printingA)
+    { return useMediaBox == useMediaBoxA && crop == cropA &&
+	     printing == printingA; }
+
+  // Approximate memory used by the list, in bytes.
+  int getSize() { return dataSize + extraSize; }
+
+  // Replay the list to <out>.  Returns false if the replay was
+  // aborted.
+  GBool display(PDFDoc *doc, OutputDev *out, FixedPoint hDPI,
+		FixedPoint vDPI, int rotate,
+		GBool (*abortCheckCbk)(void *data) = NULL,
+		void *abortCheckCbkData = NULL);
+
+private:
+
+  void setBad() { ok = gFalse; }
+  void putOp(int op);
+  void putInt(int x);
+  void putFP(FixedPoint x) { putInt(x.getRaw()); }
+  void putPtr(void *p);
+  void putBytes(const void *p, int n);
+  void putPath(GfxState *state);
+  void replayPath(DisplayListReader *r, GfxState *state);
+
+  int pageNum;
+  GBool useMediaBox, crop, printing;
+  GBool ok;			// false if a call couldn't be recorded
+  GBool complete;		// set at the end of the page
+
+  Guchar *data;			// the recorded calls
+  int dataLen;			// bytes in use
+  int dataSize;			// bytes allocated
+  int extraSize;		// estimated size of owned objects
+  FixedPoint baseCTM[6];	// default CTM when recorded
+
+  // owned objects
+  GooList *colorSpaces;		// GfxColorSpace
+  GooList *colorMaps;		// GfxImageColorMap
+  GooList *funcs;		// Function
+  GooList *fonts;		// GfxFont (one reference each)
+  GooList *bufs;		// inline image data (gmalloc)
+
+  friend class DisplayListOutputDev;
+  friend class DisplayListCache;
+};
+
+//------------------------------------------------------------------------
+// DisplayListOutputDev
+//
+// Passes every call on to another OutputDev, and records it into a
+// DisplayList.  Display a full page through it to get the page's
+// list.
+//------------------------------------------------------------------------
+
+class DisplayListOutputDev: public OutputDev {
+public:
+
+  // Record into <listA>, drawing to <outA>.
+  DisplayListOutputDev(OutputDev *outA, DisplayList *listA);
+  virtual ~DisplayListOutputDev();
+
+  //----- get info about output device
+
+  virtual GBool upsideDown() { return out->upsideDown(); }
+  virtual GBool useDrawChar() { return out->useDrawChar(); }
+  virtual GBool useDrawGlyphRun() { return out->useDrawGlyphRun(); }
+  virtual GBool useTilingPatternFill() { return out->useTilingPatternFill(); }
+  virtual GBool useShadedFills() { return out->useShadedFills(); }
+  virtual GBool useDrawForm() { return out->useDrawForm(); }
+  virtual GBool interpretType3Chars() { return out->interpretType3Chars(); }
+  virtual GBool needNonText() { return out->needNonText(); }
+
+  //----- initialization and control
+  virtual void setDefaultCTM(FixedPoint *ctm);
+  virtual GBool checkPageSlice(Page *page, FixedPoint hDPI, FixedPoint vDPI,
+			       int rotate, GBool useMediaBox, GBool crop,
+			       int sliceX, int sliceY, int sliceW, int sliceH,
+			       GBool printing, Catalog *catalog,
+			       GBool (*abortCheckCbk)(void *data) = NULL,
+			       void *abortCheckCbkData = NULL);
+  virtual void startPage(int pageNum, GfxState *state);
+  virtual void endPage();
+  virtual void dump();
+
+  //----- save/restore graphics state
+  virtual void saveState(GfxState *state);
+  virtual void restoreState(GfxState *state);
+
+  //----- update graphics state
+  virtual void updateAll(GfxState *state);
+  virtual void updateCTM(GfxState *state, FixedPoint m11, FixedPoint m12,
+			 FixedPoint m21, FixedPoint m22,
+			 FixedPoint m31, FixedPoint m32);
+  virtual void updateLineDash(GfxState *state);
+  virtual void updateFlatness(GfxState *state);
+  virtual void updateLineJoin(GfxState *state);
+  virtual void updateLineCap(GfxState *state);
+  virtual void updateMiterLimit(GfxState *state);
+  virtual void updateLineWidth(GfxState *state);
+  virtual void updateStrokeAdjust(GfxState *state);
+  virtual void updateAlphaIsShape(GfxState *state);
+  virtual void updateTextKnockout(GfxState *state);
+  virtual void updateFillColorSpace(GfxState *state);
+  virtual void updateStrokeColorSpace(GfxState *state);
+  virtual void updateFillColor(GfxState *state);
+  virtual void updateStrokeColor(GfxState *state);
+  virtual void updateBlendMode(GfxState *state);
+  virtual void updateFillOpacity(GfxState *state);
+  virtual void updateStrokeOpacity(GfxState *state);
+  virtual void updateFillOverprint(GfxState *state);
+  virtual void updateStrokeOverprint(GfxState *state);
+  virtual void updateTransfer(GfxState *state);
+
+  //----- update text state
+  virtual void updateFont(GfxState *state);
+  virtual void updateTextMat(GfxState *state);
+  virtual void updateCharSpace(GfxState *state);
+  virtual void updateRender(GfxState *state);
+  virtual void updateRise(GfxState *state);
+  virtual void updateWordSpace(GfxState *state);
+  virtual void updateHorizScaling(GfxState *state);
+  virtual void updateTextPos(GfxState *state);
+  virtual void updateTextShift(GfxState *state, FixedPoint shift);
+
+  //----- path painting
+  virtual void stroke(GfxState *state);
+  virtual void fill(GfxState *state);
+  virtual void eoFill(GfxState *state);
+  virtual void tilingPatternFill(GfxState *state, Object *str,
+				 int paintType, Dict *resDict,
+				 FixedPoint *mat, FixedPoint *bbox,
+				 int x0, int y0, int x1, int y1,
+				 FixedPoint xStep, FixedPoint yStep);
+  virtual GBool functionShadedFill(GfxState *state,
+				   GfxFunctionShading *shading);
+  virtual GBool axialShadedFill(GfxState *state, GfxAxialShading *shading);
+  virtual GBool radialShadedFill(GfxState *state, GfxRadialShading *shading);
+
+  //----- path clipping
+  virtual void clip(GfxState *state);
+  virtual void eoClip(GfxState *state);
+  virtual void clipToStrokePath(GfxState *state);
+
+  //----- text drawing
+  virtual void beginStringOp(GfxState *state);
+  virtual void endStringOp(GfxState *state);
+  virtual void beginString(GfxState *state, GooString *s);
+  virtual void endString(GfxState *state);
+  virtual void drawChar(GfxState *state, FixedPoint x, FixedPoint y,
+			FixedPoint dx, FixedPoint dy,
+			FixedPoint originX, FixedPoint originY,
+			CharCode code, int nBytes, Unicode *u, int uLen);
+  virtual void drawString(GfxState *state, GooString *s);
+  virtual void drawGlyphRun(GfxState *state, GfxGlyphPos *glyphs,
+			    int nGlyphs);
+  virtual GBool beginType3Char(GfxState *state, FixedPoint x, FixedPoint y,
+			       FixedPoint dx, FixedPoint dy,
+			       CharCode code, Unicode *u, int uLen);
+  virtual void endType3Char(GfxState *state);
+  virtual void endTextObject(GfxState *state);
+
+  //----- image drawing
+  virtual void drawImageMask(GfxState *state, Object *ref, Stream *str,
+			     int width, int height, GBool invert,
+			     GBool inlineImg);
+  virtual void drawImage(GfxState *state, Object *ref, Stream *str,
+			 int width, int height, GfxImageColorMap *colorMap,
+			 int *maskColors, GBool inlineImg);
+  virtual void drawMaskedImage(GfxState *state, Object *ref, Stream *str,
+			       int width, int height,
+			       GfxImageColorMap *colorMap,
+			       Stream *maskStr, int maskWidth, int maskHeight,
+			       GBool maskInvert);
+  virtual void drawSoftMaskedImage(GfxState *state, Object *ref, Stream *str,
+				   int width, int height,
+				   GfxImageColorMap *colorMap,
+				   Stream *maskStr,
+				   int maskWidth, int maskHeight,
+				   GfxImageColorMap *maskColorMap);
+
+  //----- grouping operators
+  virtual void endMarkedContent(GfxState *state);
+  virtual void beginMarkedContent(char *name);
+  virtual void beginMarkedContent(char *name, Dict *properties);
+  virtual void markPoint(char *name);
+  virtual void markPoint(char *name, Dict *properties);
+
+#if OPI_SUPPORT
+  //----- OPI functions
+  virtual void opiBegin(GfxState *state, Dict *opiDict);
+  virtual void opiEnd(GfxState *state, Dict *opiDict);
+#endif
+
+  //----- Type 3 font operators
+  virtual void type3D0(GfxState *state, FixedPoint wx, FixedPoint wy);
+  virtual void type3D1(GfxState *state, FixedPoint wx, FixedPoint wy,
+		       FixedPoint llx, FixedPoint lly, FixedPoint urx, FixedPoint ury);
+
+  //----- form XObjects
+  virtual void drawForm(Ref id);
+
+  //----- PostScript XObjects
+  virtual void psXObject(Stream *psStream, Stream *level1Stream);
+
+  //----- Profiling
+  virtual GooHash *getProfileHash() { return out->getProfileHash(); }
+
+  //----- transparency groups and soft masks
+  virtual void beginTransparencyGroup(GfxState *state, FixedPoint *bbox,
+				      GfxColorSpace *blendingColorSpace,
+				      GBool isolated, GBool knockout,
+				      GBool forSoftMask);
+  virtual void endTransparencyGroup(GfxState *state);
+  virtual void paintTransparencyGroup(GfxState *state, FixedPoint *bbox);
+  virtual void setSoftMask(GfxState *state, FixedPoint *bbox, GBool alpha,
+			   Function *transferFunc, GfxColor *backdropColor);
+  virtual void clearSoftMask(GfxState *state);
+
+  //----- links
+  virtual void processLink(Link *link, Catalog *catalog);
+
+  virtual GBool getVectorAntialias() { return out->getVectorAntialias(); }
+  virtual void setVectorAntialias(GBool vaa) { out->setVectorAntialias(vaa); }
+
+private:
+
+  GfxColorSpace *copyColorSpace(GfxColorSpace *colorSpace);
+  Stream *readInlineImage(Stream *str, int n);
+
+  OutputDev *out;		// output device being drawn to
+  DisplayList *list;		// list being recorded
+  GfxColorSpace *		// device color spaces already in the
+    deviceColorSpaces[csDeviceCMYK + 1];	//   list, indexed by mode
+};
+
+//------------------------------------------------------------------------
+// DisplayListCache
+//
+// Display lists of recently displayed pages, up to a size limit.
+//------------------------------------------------------------------------
+
+struct DisplayListCacheEntry;
+
+class DisplayListCache {
+public:
+
+  DisplayListCache(int maxBytesA = displayListCacheSize);
+  ~DisplayListCache();
+
+  // Display a full page, like PDFDoc::displayPage.  If the page's
+  // list is cached it is replayed; otherwise the page is drawn
+  // normally and its list recorded on the way.
+  void displayPage(PDFDoc *doc, OutputDev *out, int page,
+		   FixedPoint hDPI, FixedPoint vDPI, int rotate,
+		   GBool useMediaBox, GBool crop, GBool printing,
+		   GBool (*abortCheckCbk)(void *data) = NULL,
+		   void *abortCheckCbkData = NULL);
+
+  // Remove all entries (the lists refer to the document's fonts and
+  // xref, so this must be done before the document is deleted).
+  void clear();
+
+  // Change the size limit.
+  void setMaxBytes(int maxBytesA);
+
+  int getHits() { return hits; }
+  int getMisses() { return misses; }
+  int getBytes() { return bytes; }
+
+private:
+
+  void shrink(int maxBytesA);
+
+  DisplayListCacheEntry *entries; // cached lists, MRU first
+  int maxBytes;			// size limit, in bytes
+  int bytes;			// current size, in bytes
+  int hits, misses;		// lookup statistics
+};
+
+#endif
@@ -0,0 +1,342 @@
+//========================================================================
+//
+// EmbFontCache.cc
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#include "goo/gmem.h"
+#include "goo/gfile.h"
+#include "goo/GooString.h"
+#include "Object.h"
+#include "Stream.h"
+#include "XRef.h"
+#include "CharCodeToUnicode.h"
+#include "GfxFont.h"
+#include "EmbFontCache.h"
+#include <inkview.h>
+
+//------------------------------------------------------------------------
+
+// Cache file layout: a three-word header (magic, font program length,
+// code-to-GID map length), the decoded font program, then the map.
+// Files are written in native byte order -- the cache never leaves
+// the device.
+#define embFontCacheMagic 0x31434650	// "PFC1"
+#define embFontCacheExt ".fnt"
+
+typedef unsigned long long EmbFontHash;
+
+#define embFontHashInit 0xcbf29ce484222325ULL
+
+// 64-bit FNV-1a.
+static inline void embFontHash(EmbFontHash *h, const void *p, int n) {
+  const Guchar *s;
+  EmbFontHash x;
+  int i;
+
+  s = (const Guchar *)p;
+  x = *h;
+  for (i = 0; i < n; ++i) {
+    x = (x ^ s[i]) * 0x100000001b3ULL;
+  }
+  *h = x;
+}
+
+static inline void embFontHashInt(EmbFontHash *h, int x) {
+  embFontHash(h, &x, sizeof(int));
+}
+
+// Hash the char code -> Unicode mapping for codes [0, n).
+static void embFontHashToUnicode(EmbFontHash *h, CharCodeToUnicode *ctu,
+				 int n) {
+  Unicode *u;
+  int c, len;
+
+  for (c = 0; c < n; ++c) {
+    len = ctu->mapToUnicode((CharCode)c, &u);
+    embFontHashInt(h, len);
+    if (len > 0) {
+      embFontHash(h, u, len * sizeof(Unicode));
+    }
+  }
+}
+
+struct EmbFontCacheFile {
+  GooString *path;
+  long size;
+  time_t mtime;
+};
+
+static int cmpEmbFontCacheFiles(const void *p1, const void *p2) {
+  const EmbFontCacheFile *f1 = (const EmbFontCacheFile *)p1;
+  const EmbFontCacheFile *f2 = (const EmbFontCacheFile *)p2;
+
+  if (f1->mtime != f2->mtime) {
+    return f1->mtime < f2->mtime ? -1 : 1;
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------------
+// EmbFontCache
+//------------------------------------------------------------------------
+
+EmbFontCache::EmbFontCache(GooString *dirA) {
+  dir = dirA->copy();
+  mkdir(dir->getCString(), 0700);
+}
+
+EmbFontCache::~EmbFontCache() {
+  delete dir;
+}
+
+GBool EmbFontCache::needsCodeToGIDMap(GfxFont *font) {
+  switch (font->getType()) {
+  case fontTrueType:
+  case fontTrueTypeOT:
+    return gTrue;
+  case fontCIDType2:
+  case fontCIDType2OT:
+    return ((GfxCIDFont *)font)->getCIDToGID() == NULL;
+  default:
+    return gFalse;
+  }
+}
+
+GooString *EmbFontCache::getKey(GfxFont *font, XRef *xref) {
+  Ref embRef;
+  Object refObj, strObj;
+  Stream *str;
+  CharCodeToUnicode *ctu;
+  EmbFontHash progHash, mapHash;
+  Guchar buf[4096];
+  char key[64];
+  char **enc;
+  Guint len;
+  int n, i;
+
+  if (xref->isEncrypted() || !font->getEmbeddedFontID(&embRef)) {
+    return NULL;
+  }
+  refObj.initRef(embRef.num, embRef.gen);
+  refObj.fetch(xref, &strObj);
+  refObj.free();
+  if (!strObj.isStream()) {
+    strObj.free();
+    return NULL;
+  }
+
+  // hash the raw (still compressed) stream data -- the decoded
+  // program is a function of it, and reading it is much cheaper than
+  // running the filters
+  progHash = embFontHashInit;
+  len = 0;
+  str = strObj.getStream()->getUndecodedStream();
+  str->reset();
+  while ((n = str->getChars(sizeof(buf), buf)) > 0) {
+    embFontHash(&progHash, buf, n);
+    len += n;
+  }
+  str->close();
+  strObj.free();
+
+  // hash the inputs of the code-to-GID map computation
+  mapHash = 0;
+  if (needsCodeToGIDMap(font)) {
+    mapHash = embFontHashInit;
+    if (font->isCIDFont()) {
+      embFontHash(&mapHash, ((GfxCIDFont *)font)->getCollection()->getCString(),
+		  ((GfxCIDFont *)font)->getCollection()->getLength());
+      embFontHashInt(&mapHash, font->getWMode());
+      if ((ctu = font->getToUnicode())) {
+	embFontHashToUnicode(&mapHash, ctu, (int)ctu->getLength());
+	ctu->decRefCnt();
+      }
+    } else {
+      embFontHashInt(&mapHash, ((Gfx8BitFont *)font)->getHasEncoding());
+      embFontHashInt(&mapHash, ((Gfx8BitFont *)font)->getUsesMacRomanEnc());
+      embFontHashInt(&mapHash, font->getFlags() & fontSymbolic);
+      enc = ((Gfx8BitFont *)font)->getEncoding();
+      for (i = 0; i < 256; ++i) {
+	if (enc[i]) {
+	  embFontHash(&mapHash, enc[i], strlen(enc[i]) + 1);
+	} else {
+	  embFontHashInt(&mapHash, -1);
+	}
+      }
+      if ((ctu = font->getToUnicode())) {
+	embFontHashToUnicode(&mapHash, ctu, 256);
+	ctu->decRefCnt();
+      }
+    }
+  }
+
+  snprintf(key, sizeof(key), "%016llx%08x%02x%016llx",
+	   progHash, len, (int)font->getType(), mapHash);
+  return new GooString(key);
+}
+
+GBool EmbFontCache::lookup(GooString *key, char **buf, int *bufLen,
+			   Gushort **map, int *mapLen) {
+  GooString *path;
+  FILE *f;
+  Guint hdr[3];
+  char *bufA;
+  Gushort *mapA;
+  long size;
+
+  path = appendToPath(dir->copy(), key->getCString());
+  path->append(embFontCacheExt);
+  if (!(f = iv_fopen(path->getCString(), "rb"))) {
+    delete path;
+    return gFalse;
+  }
+  if (iv_fread(hdr, sizeof(Guint), 3, f) != 3 ||
+      hdr[0] != embFontCacheMagic ||
+      hdr[1] == 0 || hdr[1] > 0x7fffffff / 2 ||
+      hdr[2] > 0x10000 ||
+      iv_fseek(f, 0, SEEK_END) != 0) {
+    iv_fclose(f);
+    delete path;
+    return gFalse;
+  }
+  size = iv_ftell(f);
+  if (size != (long)(sizeof(hdr) + hdr[1] + hdr[2] * sizeof(Gushort)) ||
+      iv_fseek(f, sizeof(hdr), SEEK_SET) != 0) {
+    iv_fclose(f);
+    delete path;
+    return gFalse;
+  }
+  bufA = (char *)gmalloc(hdr[1]);
+  mapA = hdr[2] ? (Gushort *)gmallocn(hdr[2], sizeof(Gushort))
+                : (Gushort *)NULL;
+  if (iv_fread(bufA, 1, hdr[1], f) != hdr[1] ||
+      (mapA && iv_fread(mapA, sizeof(Gushort), hdr[2], f) != hdr[2])) {
+    gfree(bufA);
+    gfree(mapA);
+    iv_fclose(f);
+    delete path;
+    return gFalse;
+  }
+  iv_fclose(f);
+
+  // prune() evicts by modification time, so touching the entry on
+  // every hit makes the eviction order least recently used
+  utime(path->getCString(), NULL);
+  delete path;
+
+  *buf = bufA;
+  *bufLen = (int)hdr[1];
+  *map = mapA;
+  *mapLen = (int)hdr[2];
+  return gTrue;
+}
+
+void EmbFontCache::store(GooString *key, char *buf, int bufLen,
+			 Gushort *map, int mapLen) {
+  GooString *path, *tmpPath;
+  FILE *f;
+  Guint hdr[3];
+  GBool ok;
+
+  if (bufLen <= 0 || bufLen > embFontCacheSize / 2 ||
+      mapLen < 0 || mapLen > 0x10000 || (mapLen && !map)) {
+    return;
+  }
+  path = appendToPath(dir->copy(), key->getCString());
+  path->append(embFontCacheExt);
+  tmpPath = path->copy();
+  tmpPath->append(".tmp");
+
+  // write to a temporary name and rename, so that a crash or a full
+  // disk never leaves a truncated entry behind
+  ok = gFalse;
+  if ((f = iv_fopen(tmpPath->getCString(), "wb"))) {
+    hdr[0] = embFontCacheMagic;
+    hdr[1] = (Guint)bufLen;
+    hdr[2] = (Guint)mapLen;
+    ok = iv_fwrite(hdr, sizeof(Guint), 3, f) == 3 &&
+         iv_fwrite(buf, 1, bufLen, f) == (size_t)bufLen &&
+         (!mapLen ||
+	  iv_fwrite(map, sizeof(Gushort), mapLen, f) == (size_t)mapLen);
+    if (iv_fclose(f) != 0) {
+      ok = gFalse;
+    }
+    if (ok) {
+      ok = rename(tmpPath->getCString(), path->getCString()) == 0;
+    }
+    if (!ok) {
+      unlink(tmpPath->getCString());
+    }
+  }
+  delete tmpPath;
+  delete path;
+
+  if (ok) {
+    prune();
+  }
+}
+
+// Remove the least recently used entries (oldest modification time,
+// see lookup) until the directory fits in embFontCacheSize.
+void EmbFontCache::prune() {
+  GDir *d;
+  GDirEntry *ent;
+  EmbFontCacheFile *files;
+  struct stat st;
+  GooString *name;
+  long total;
+  int nFiles, filesSize, extLen, i;
+
+  d = new GDir(dir->getCString(), gFalse);
+  files = NULL;
+  nFiles = filesSize = 0;
+  total = 0;
+  extLen = strlen(embFontCacheExt);
+  while ((ent = d->getNextEntry())) {
+    name = ent->getName();
+    if (name->getLength() > extLen &&
+	!strcmp(name->getCString() + name->getLength() - extLen,
+		embFontCacheExt) &&
+	stat(ent->getFullPath()->getCString(), &st) == 0) {
+      if (nFiles == filesSize) {
+	filesSize = filesSize ? 2 * filesSize : 32;
+	files = (EmbFontCacheFile *)greallocn(files, filesSize,
+					      sizeof(EmbFontCacheFile));
+      }
+      files[nFiles].path = ent->getFullPath()->copy();
+      files[nFiles].size = (long)st.st_size;
+      files[nFiles].mtime = st.st_mtime;
+      total += files[nFiles].size;
+      ++nFiles;
+    }
+    delete ent;
+  }
+  delete d;
+
+  if (total > embFontCacheSize) {
+    qsort(files, nFiles, sizeof(EmbFontCacheFile), &cmpEmbFontCacheFiles);
+    for (i = 0; i < nFiles && total > embFontCacheSize; ++i) {
+      if (unlink(files[i].path->getCString()) == 0) {
+	total -= files[i].size;
+      }
+    }
+  }
+  for (i = 0; i < nFiles; ++i) {
+    delete files[i].path;
+  }
+  gfree(files);
+}
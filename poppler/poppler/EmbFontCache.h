@@ -0,0 +1,72 @@
+//========================================================================
+//
+// EmbFontCache.h
+//
+// On-disk cache of decoded embedded font programs and their
+// code-to-GID maps, shared by all documents.
+//
+//========================================================================
+
+#ifndef EMBFONTCACHE_H
+#define EMBFONTCACHE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "goo/gtypes.h"
+
+class GooString;
+class GfxFont;
+class XRef;
+
+//------------------------------------------------------------------------
+
+// Upper bound on the total size of the cache directory, in bytes.
+#define embFontCacheSize (8 * 1024 * 1024)
+
+//------------------------------------------------------------------------
+// EmbFontCache
+//------------------------------------------------------------------------
+
+class EmbFontCache {
+public:
+
+  // Use (and create, if necessary, readable only by the owner) the
+  // directory <dirA>.
+  EmbFontCache(GooString *dirA);
+
+  ~EmbFontCache();
+
+  // Return the cache key for the embedded font program of <font>, or
+  // NULL if the font has no embedded font file or the document is
+  // encrypted (decrypted font programs are never written to disk).
+  // The key is computed
+  // from the undecoded font stream, the font type and -- for TrueType
+  // fonts that need one -- everything the code-to-GID map depends
+  // on, so it is cheap compared to decoding the stream.
+  GooString *getKey(GfxFont *font, XRef *xref);
+
+  // Look up <key>.  On a hit, returns true and sets <buf>/<bufLen> to
+  // the decoded font program and <map>/<mapLen> to the code-to-GID
+  // map (NULL/0 if none was stored); both are allocated with gmalloc
+  // and owned by the caller.  A hit marks the entry as recently used.
+  GBool lookup(GooString *key, char **buf, int *bufLen,
+	       Gushort **map, int *mapLen);
+
+  // Store a font program and its code-to-GID map under <key>.
+  void store(GooString *key, char *buf, int bufLen,
+	     Gushort *map, int mapLen);
+
+  // Return true if the font needs a code-to-GID map built from the
+  // font program (i.e., one that is worth caching).
+  static GBool needsCodeToGIDMap(GfxFont *font);
+
+private:
+
+  void prune();
+
+  GooString *dir;
+};
+
+#endif
@@ -31,10 +31,36 @@
 // Function
 //------------------------------------------------------------------------
 
+// Values of Function::lutState.
+#define funcLUTOff      0	// not used
+#define funcLUTCounting 1	// counting calls until the table is built
+#define funcLUTBuilding 2	// sampling the function
+#define funcLUTReady    3	// table is in use
+
+// Number of calls after which the lookup table is built.
+#define funcLUTMinCalls 512
+
+// Maximum size of the lookup table, in samples.
+#define funcLUTMaxSize 8192
+
+// Maximum interpolation error, as a fraction of the output range.
+#define funcLUTErrorShift 9
+
+// Interpolation is checked at this many points per cell along each
+// input.
+#define funcLUTCheckSteps 4
+
+// Maximum number of points at which interpolation is checked.
+#define funcLUTMaxChecks (16 * funcLUTMaxSize)
+
 Function::Function() {
+  lutState = funcLUTOff;
+  lutCalls = 0;
+  lut = NULL;
 }
 
 Function::~Function() {
+  gfree(lut);
 }
 
 Function *Function::parse(Object *funcObj) {
@@ -154,6 +180,209 @@ GBool Function::init(Dict *dict) {
   return gFalse;
 }
 
+void Function::enableLUT() {
+  int i;
+
+  if (m < 1 || m > funcLUTMaxInputs || n < 1) {
+    return;
+  }
+  for (i = 0; i < m; ++i) {
+    if (domain[i][1] <= domain[i][0] ||
+	(FixPtInt64)domain[i][1].getRaw() - domain[i][0].getRaw()
+	  > 0x7fffffff) {
+      return;
+    }
+  }
+  lutState = funcLUTCounting;
+  lutCalls = 0;
+}
+
+void Function::copyLUT() {
+  FixedPoint *lutA;
+  int size, i;
+
+  if (lut) {
+    size = n;
+    for (i = 0; i < m; ++i) {
+      size *= lutGridSize;
+    }
+    lutA = (FixedPoint *)gmallocn(size, sizeof(FixedPoint));
+    memcpy(lutA, lut, size * sizeof(FixedPoint));
+    lut = lutA;
+  }
+}
+
+GBool Function::lookupLUT(FixedPoint *in, FixedPoint *out) {
+  switch (lutState) {
+  case funcLUTReady:
+    interpolateLUT(in, out);
+    return gTrue;
+  case funcLUTCounting:
+    if (++lutCalls < funcLUTMinCalls) {
+      return gFalse;
+    }
+    lutState = funcLUTBuilding;
+    if (!buildLUT()) {
+      lutState = funcLUTOff;
+      return gFalse;
+    }
+    lutState = funcLUTReady;
+    interpolateLUT(in, out);
+    return gTrue;
+  default:
+    return gFalse;
+  }
+}
+
+// Sample the function on grids of increasing resolution, until
+// interpolation is accurate enough everywhere on a finer check grid
+// (or the table or the check would get too large).  The check grid
+// splits each cell into funcLUTCheckSteps steps per input, so it
+// covers the cell centers, the cell edges and the points between
+// samples.
+GBool Function::buildLUT() {
+  FixedPoint in[funcMaxInputs], out[funcMaxOutputs], out2[funcMaxOutputs];
+  int maxErr[funcMaxOutputs];
+  int g, size, fg, nChecks, i, j, k;
+  GBool ok, sample;
+
+  for (j = 0; j < n; ++j) {
+    if (hasRange) {
+      maxErr[j] = (range[j][1].getRaw() - range[j][0].getRaw())
+	          >> funcLUTErrorShift;
+    } else {
+      maxErr[j] = 0x10000 >> funcLUTErrorShift;
+    }
+    if (maxErr[j] < 1) {
+      maxErr[j] = 1;
+    }
+  }
+
+  for (g = (m == 1) ? 17 : 5; ; g = 2 * g - 1) {
+    size = n;
+    nChecks = 1;
+    fg = funcLUTCheckSteps * (g - 1) + 1;
+    for (i = 0; i < m; ++i) {
+      size *= g;
+      nChecks *= fg;
+    }
+    if (size > funcLUTMaxSize || nChecks > funcLUTMaxChecks) {
+      break;
+    }
+    lutGridSize = g;
+    for (i = 0; i < m; ++i) {
+      lutMul[i] = ((FixPtInt64)(g - 1) << 32) /
+	          (domain[i][1].getRaw() - domain[i][0].getRaw());
+    }
+    gfree(lut);
+    lut = (FixedPoint *)gmallocn(size, sizeof(FixedPoint));
+
+    // sample the grid points (input 0 varies fastest)
+    for (k = 0; k < size / n; ++k) {
+      for (i = 0, j = k; i < m; ++i, j /= g) {
+	in[i] = FixedPoint::make(domain[i][0].getRaw() +
+		  (int)(((FixPtInt64)(domain[i][1].getRaw() -
+				      domain[i][0].getRaw()) * (j % g))
+			/ (g - 1)));
+      }
+      transform(in, lut + k * n);
+    }
+
+    // check the points of the finer grid that aren't samples
+    ok = gTrue;
+    for (k = 0; ok && k < nChecks; ++k) {
+      sample = gTrue;
+      for (i = 0, j = k; i < m; ++i, j /= fg) {
+	if ((j % fg) % funcLUTCheckSteps) {
+	  sample = gFalse;
+	}
+	in[i] = FixedPoint::make(domain[i][0].getRaw() +
+		  (int)(((FixPtInt64)(domain[i][1].getRaw() -
+				      domain[i][0].getRaw()) * (j % fg))
+			/ (fg - 1)));
+      }
+      if (sample) {
+	continue;
+      }
+      transform(in, out);
+      interpolateLUT(in, out2);
+      for (j = 0; j < n; ++j) {
+	if (abs(out[j].getRaw() - out2[j].getRaw()) > maxErr[j]) {
+	  ok = gFalse;
+	  break;
+	}
+      }
+    }
+    if (ok) {
+      return gTrue;
+    }
+  }
+
+  gfree(lut);
+  lut = NULL;
+  return gFalse;
+}
+
+void Function::interpolateLUT(FixedPoint *in, FixedPoint *out) {
+  int e[funcLUTMaxInputs], efrac[funcLUTMaxInputs];
+  int sBuf[1 << funcLUTMaxInputs];
+  FixedPoint *p;
+  FixPtInt64 pos;
+  int x, stride, idx, i, j, k, t;
+
+  // map input values into the grid
+  for (i = 0; i < m; ++i) {
+    x = in[i].getRaw();
+    if (x < domain[i][0].getRaw()) {
+      x = domain[i][0].getRaw();
+    } else if (x > domain[i][1].getRaw()) {
+      x = domain[i][1].getRaw();
+    }
+    pos = ((FixPtInt64)(x - domain[i][0].getRaw()) * lutMul[i]) >> 16;
+    e[i] = (int)(pos >> 16);
+    efrac[i] = (int)(pos & 0xffff);
+    if (e[i] >= lutGridSize - 1) {
+      e[i] = lutGridSize - 2;
+      efrac[i] = 0x10000;
+    }
+  }
+
+  if (m == 1) {
+    p = lut + e[0] * n;
+    for (j = 0; j < n; ++j, ++p) {
+      out[j] = FixedPoint::make(p[0].getRaw() +
+		 (int)(((FixPtInt64)(p[n].getRaw() - p[0].getRaw())
+			* efrac[0]) >> 16));
+    }
+    return;
+  }
+
+  for (j = 0; j < n; ++j) {
+
+    // pull 2^m values out of the table
+    for (k = 0; k < (1 << m); ++k) {
+      idx = j;
+      stride = n;
+      for (i = 0, t = k; i < m; ++i, t >>= 1) {
+	idx += (e[i] + (t & 1)) * stride;
+	stride *= lutGridSize;
+      }
+      sBuf[k] = lut[idx].getRaw();
+    }
+
+    // do m sets of interpolations
+    for (i = 0, t = (1 << m); i < m; ++i, t >>= 1) {
+      for (k = 0; k < t; k += 2) {
+	sBuf[k >> 1] = sBuf[k] +
+	               (int)(((FixPtInt64)(sBuf[k+1] - sBuf[k]) * efrac[i])
+			     >> 16);
+      }
+    }
+
+    out[j] = FixedPoint::make(sBuf[0]);
+  }
+}
+
 //------------------------------------------------------------------------
 // IdentityFunction
 //------------------------------------------------------------------------
@@ -380,6 +609,34 @@ void SampledFunction::transform(FixedPoint *in, FixedPoint *out) {
   int i, j, k, idx, t;
   FixedPoint ONE = (FixedPoint)1;
 
+  // fast path for the common one-input case: this is the same
+  // computation as below, without the generic m-linear machinery
+  if (m == 1) {
+    x = (in[0] - domain[0][0]) * inputMul[0] + encode[0][0];
+    if (x < 0) {
+      x = 0;
+    } else if (x > sampleSize[0] - 1) {
+      x = sampleSize[0] - 1;
+    }
+    e[0][0] = (int)x;
+    if ((e[0][1] = e[0][0] + 1) >= sampleSize[0]) {
+      e[0][1] = e[0][0];
+    }
+    efrac1[0] = x - e[0][0];
+    efrac0[0] = ONE - efrac1[0];
+    for (i = 0; i < n; ++i) {
+      x = efrac0[0] * samples[e[0][0] * n + i] +
+	  efrac1[0] * samples[e[0][1] * n + i];
+      out[i] = x * (decode[i][1] - decode[i][0]) + decode[i][0];
+      if (out[i] < range[i][0]) {
+	out[i] = range[i][0];
+      } else if (out[i] > range[i][1]) {
+	out[i] = range[i][1];
+      }
+    }
+    return;
+  }
+
   // map input values into sample array
   for (i = 0; i < m; ++i) {
     x = (in[i] - domain[i][0]) * inputMul[i] + encode[i][0];
@@ -503,6 +760,11 @@ ExponentialFunction::ExponentialFunction(Object *funcObj, Dict *dict) {
   e = obj1.getFP();
   obj1.free();
 
+  // x^1 is cheap; anything else goes through FixedPoint::pow
+  if (e != 1) {
+    enableLUT();
+  }
+
   ok = gTrue;
   return;
 
@@ -519,12 +781,16 @@ ExponentialFunction::~ExponentialFunction() {
 
 ExponentialFunction::ExponentialFunction(ExponentialFunction *func) {
   memcpy(this, func, sizeof(ExponentialFunction));
+  copyLUT();
 }
 
 void ExponentialFunction::transform(FixedPoint *in, FixedPoint *out) {
-  FixedPoint x;
+  FixedPoint x, y;
   int i;
 
+  if (lookupLUT(in, out)) {
+    return;
+  }
   if (in[0] < domain[0][0]) {
     x = domain[0][0];
   } else if (in[0] > domain[0][1]) {
@@ -532,8 +798,9 @@ void ExponentialFunction::transform(FixedPoint *in, FixedPoint *out) {
   } else {
     x = in[0];
   }
+  y = (e == 1) ? x : FixedPoint::pow(x, e);
   for (i = 0; i < n; ++i) {
-    out[i] = c0[i] + FixedPoint::pow(x, e) * (c1[i] - c0[i]);
+    out[i] = c0[i] + y * (c1[i] - c0[i]);
     if (hasRange) {
       if (out[i] < range[i][0]) {
 	out[i] = range[i][0];
@@ -1011,6 +1278,849 @@ void PSStack::pop() {
   ++sp;
 }
 
+//------------------------------------------------------------------------
+// PostScript function compiler
+//------------------------------------------------------------------------
+
+// The code array is compiled into a sequence of register instructions.
+// Since PostScript functions have no loops, the stack depth and the
+// type of each stack entry at every point of the code are known at
+// compile time, so each stack entry becomes a register, the stack
+// manipulation operators (dup, exch, copy, index, roll, pop) become
+// compile-time bookkeeping, and the type checks and int/real
+// dispatch are done once.  Operations on constant operands are
+// evaluated at compile time.  Code that doesn't fit this model
+// (e.g., stack underflow, type errors, copy/index/roll with computed
+// operands, or if/ifelse branches that leave different stacks) is
+// not compiled, and the function falls back to the interpreter.
+//
+// Register values are ints: 16.16 fixed point for reals, 0/1 for
+// booleans.
+
+enum PSInstrOp {
+  // control
+  psInstrMov,			// dst = src1
+  psInstrLoad,			// dst = (constant) src1
+  psInstrJmp,			// pc += dst
+  psInstrJz,			// if (!src1) pc += dst
+  // integer (and boolean)
+  psInstrAddI,
+  psInstrSubI,
+  psInstrMulI,
+  psInstrIdivI,
+  psInstrModI,
+  psInstrNegI,
+  psInstrAbsI,
+  psInstrAndI,
+  psInstrOrI,
+  psInstrXorI,
+  psInstrNotI,
+  psInstrNotB,
+  psInstrBitshiftI,
+  psInstrEqI,
+  psInstrNeI,
+  psInstrGeI,
+  psInstrGtI,
+  psInstrLeI,
+  psInstrLtI,
+  psInstrCvrI,			// int -> real
+  // real
+  psInstrAddR,
+  psInstrSubR,
+  psInstrMulR,
+  psInstrDivR,
+  psInstrNegR,
+  psInstrAbsR,
+  psInstrEqR,
+  psInstrNeR,
+  psInstrGeR,
+  psInstrGtR,
+  psInstrLeR,
+  psInstrLtR,
+  psInstrAtanR,
+  psInstrExpR,
+  psInstrCeilingR,
+  psInstrFloorR,
+  psInstrRoundR,
+  psInstrTruncateR,
+  psInstrSqrtR,
+  psInstrSinR,
+  psInstrCosR,
+  psInstrLnR,
+  psInstrLogR,
+  psInstrCviR			// real -> int
+};
+
+struct PSInstr {
+  int op;			// PSInstrOp
+  int dst;
+  int src1, src2;
+};
+
+// Evaluate an arithmetic instruction.  This does exactly what
+// PostScriptFunction::exec does for the same operator and operand
+// types (except that integer division by zero gives zero).
+static inline int psEvalInstr(int op, int a, int b) {
+  FixedPoint r1, r2, result;
+
+  switch (op) {
+  case psInstrAddI:      return a + b;
+  case psInstrSubI:      return a - b;
+  case psInstrMulI:      return a * b;
+  case psInstrIdivI:     return b ? a / b : 0;
+  case psInstrModI:      return b ? a % b : 0;
+  case psInstrNegI:      return -a;
+  case psInstrAbsI:      return abs(a);
+  case psInstrAndI:      return a & b;
+  case psInstrOrI:       return a | b;
+  case psInstrXorI:      return a ^ b;
+  case psInstrNotI:      return ~a;
+  case psInstrNotB:      return !a;
+  case psInstrBitshiftI:
+    if (b > 0) {
+      return a << b;
+    } else if (b < 0) {
+      return (int)((Guint)a >> -b);
+    }
+    return a;
+  case psInstrEqI:       return a == b;
+  case psInstrNeI:       return a != b;
+  case psInstrGeI:       return a >= b;
+  case psInstrGtI:       return a > b;
+  case psInstrLeI:       return a <= b;
+  case psInstrLtI:       return a < b;
+  case psInstrCvrI:      return ((FixedPoint)a).getRaw();
+  case psInstrEqR:       return a == b;
+  case psInstrNeR:       return a != b;
+  case psInstrGeR:       return a >= b;
+  case psInstrGtR:       return a > b;
+  case psInstrLeR:       return a <= b;
+  case psInstrLtR:       return a < b;
+  default:
+    break;
+  }
+
+  r1 = FixedPoint::make(a);
+  r2 = FixedPoint::make(b);
+  switch (op) {
+  case psInstrAddR:
+    result = r1 + r2;
+    break;
+  case psInstrSubR:
+    result = r1 - r2;
+    break;
+  case psInstrMulR:
+    result = r1 * r2;
+    break;
+  case psInstrDivR:
+    result = r1 / r2;
+    break;
+  case psInstrNegR:
+    result = -r1;
+    break;
+  case psInstrAbsR:
+    result = FixedPoint::abs(r1);
+    break;
+  case psInstrAtanR:
+    result = atan2(r1, r2) * 180.0 / M_PI;
+    if (result < 0) result += 360.0;
+    break;
+  case psInstrExpR:
+    result = FixedPoint::pow(r1, r2);
+    break;
+  case psInstrCeilingR:
+    result = FixedPoint::ceil(r1);
+    break;
+  case psInstrFloorR:
+    result = floor(r1);
+    break;
+  case psInstrRoundR:
+    result = (r1 >= 0) ? floor(r1 + 0.5) : ceil(r1 - 0.5);
+    break;
+  case psInstrTruncateR:
+    result = (r1 >= 0) ? floor(r1) : ceil(r1);
+    break;
+  case psInstrSqrtR:
+    result = sqrt(r1);
+    break;
+  case psInstrSinR:
+    result = sin(r1 * M_PI / 180.0);
+    break;
+  case psInstrCosR:
+    result = cos(r1 * M_PI / 180.0);
+    break;
+  case psInstrLnR:
+    result = log(r1);
+    break;
+  case psInstrLogR:
+    result = log10(r1);
+    break;
+  case psInstrCviR:
+    return (int)r1;
+  }
+  return result.getRaw();
+}
+
+// Returns true if the compiled program is a continuous function of
+// its inputs, i.e., it has no branches, comparisons, rounding, or
+// integer/bitwise operations on computed values.  Only such programs
+// can be checked for interpolation error by sampling: a step can hide
+// between any two check points.  (Operations on constants were folded
+// at compile time, so they don't show up here.)
+static GBool psProgIsContinuous(PSInstr *prog, int progLen) {
+  int i;
+
+  for (i = 0; i < progLen; ++i) {
+    switch (prog[i].op) {
+    case psInstrJmp:
+    case psInstrJz:
+    case psInstrIdivI:
+    case psInstrModI:
+    case psInstrAndI:
+    case psInstrOrI:
+    case psInstrXorI:
+    case psInstrNotI:
+    case psInstrNotB:
+    case psInstrBitshiftI:
+    case psInstrEqI:
+    case psInstrNeI:
+    case psInstrGeI:
+    case psInstrGtI:
+    case psInstrLeI:
+    case psInstrLtI:
+    case psInstrEqR:
+    case psInstrNeR:
+    case psInstrGeR:
+    case psInstrGtR:
+    case psInstrLeR:
+    case psInstrLtR:
+    case psInstrCeilingR:
+    case psInstrFloorR:
+    case psInstrRoundR:
+    case psInstrTruncateR:
+    case psInstrCviR:
+      return gFalse;
+    default:
+      break;
+    }
+  }
+  return gTrue;
+}
+
+// Maximum number of registers in a compiled function.
+#define psCompMaxRegs 4096
+
+// A stack entry at compile time: either a constant or a register.
+struct PSCompSlot {
+  PSObjectType type;		// psBool, psInt, or psReal
+  GBool isConst;
+  int val;			// value (if isConst) or register
+};
+
+struct PSCompStack {
+  PSCompSlot slots[psStackSize];
+  int depth;
+};
+
+// A growable instruction sequence.
+class PSInstrBuf {
+public:
+
+  PSInstrBuf() { instrs = NULL; len = size = 0; }
+  ~PSInstrBuf() { gfree(instrs); }
+  void emit(int op, int dst, int src1, int src2);
+  void append(PSInstrBuf *buf);
+
+  PSInstr *instrs;
+  int len, size;
+};
+
+void PSInstrBuf::emit(int op, int dst, int src1, int src2) {
+  if (len == size) {
+    size = size ? 2 * size : 32;
+    instrs = (PSInstr *)greallocn(instrs, size, sizeof(PSInstr));
+  }
+  instrs[len].op = op;
+  instrs[len].dst = dst;
+  instrs[len].src1 = src1;
+  instrs[len].src2 = src2;
+  ++len;
+}
+
+void PSInstrBuf::append(PSInstrBuf *buf) {
+  int i;
+
+  for (i = 0; i < buf->len; ++i) {
+    emit(buf->instrs[i].op, buf->instrs[i].dst,
+	 buf->instrs[i].src1, buf->instrs[i].src2);
+  }
+}
+
+class PSCompiler {
+public:
+
+  PSCompiler(PSObject *codeA);
+  ~PSCompiler();
+
+  // Compile the code starting at <codePtr> (up to its psOpReturn),
+  // updating <stack> and appending to <buf>.
+  GBool compileBlock(int codePtr, PSCompStack *stack, PSInstrBuf *buf);
+
+  // Allocate a register.
+  int newReg(int init);
+
+  // Return a register holding the value of <slot>, converted to a
+  // real if <toReal> is set.
+  int getReg(PSCompSlot *slot, GBool toReal, PSInstrBuf *buf);
+
+  int *regInit;
+  int nRegs;
+  GBool ok;
+
+private:
+
+  GBool op1(PSCompStack *stack, PSInstrBuf *buf, int op,
+	    PSObjectType argType, PSObjectType resType);
+  GBool op2(PSCompStack *stack, PSInstrBuf *buf, int op,
+	    PSObjectType argType, PSObjectType resType);
+  GBool opArith(PSCompStack *stack, PSInstrBuf *buf,
+		int opI, int opR, int opB, GBool cmp);
+  GBool ifElse(PSCompStack *stack, PSInstrBuf *buf,
+	       int thenPtr, int elsePtr);
+
+  PSObject *code;
+  int regInitSize;
+};
+
+PSCompiler::PSCompiler(PSObject *codeA) {
+  code = codeA;
+  regInit = NULL;
+  nRegs = regInitSize = 0;
+  ok = gTrue;
+}
+
+PSCompiler::~PSCompiler() {
+  gfree(regInit);
+}
+
+int PSCompiler::newReg(int init) {
+  if (nRegs == psCompMaxRegs) {
+    ok = gFalse;
+    return 0;
+  }
+  if (nRegs == regInitSize) {
+    regInitSize = regInitSize ? 2 * regInitSize : 32;
+    regInit = (int *)greallocn(regInit, regInitSize, sizeof(int));
+  }
+  regInit[nRegs] = init;
+  return nRegs++;
+}
+
+int PSCompiler::getReg(PSCompSlot *slot, GBool toReal, PSInstrBuf *buf) {
+  int reg;
+
+  if (slot->isConst) {
+    if (toReal && slot->type == psInt) {
+      return newReg(psEvalInstr(psInstrCvrI, slot->val, 0));
+    }
+    return newReg(slot->val);
+  }
+  if (toReal && slot->type == psInt) {
+    reg = newReg(0);
+    buf->emit(psInstrCvrI, reg, slot->val, 0);
+    return reg;
+  }
+  return slot->val;
+}
+
+// Compile a one-operand operator.  <argType> is the operand type
+// (psReal accepts ints, which are converted).
+GBool PSCompiler::op1(PSCompStack *stack, PSInstrBuf *buf, int op,
+		      PSObjectType argType, PSObjectType resType) {
+  PSCompSlot *a;
+  int reg;
+
+  if (stack->depth < 1) {
+    return gFalse;
+  }
+  a = &stack->slots[stack->depth - 1];
+  if (argType == psReal ? a->type == psBool : a->type != argType) {
+    return gFalse;
+  }
+  if (a->isConst) {
+    a->val = psEvalInstr(op, (argType == psReal && a->type == psInt)
+			       ? psEvalInstr(psInstrCvrI, a->val, 0)
+			       : a->val,
+			 0);
+  } else {
+    reg = newReg(0);
+    buf->emit(op, reg, getReg(a, argType == psReal, buf), 0);
+    a->val = reg;
+  }
+  a->type = resType;
+  return ok;
+}
+
+// Compile a two-operand operator.
+GBool PSCompiler::op2(PSCompStack *stack, PSInstrBuf *buf, int op,
+		      PSObjectType argType, PSObjectType resType) {
+  PSCompSlot *a, *b;
+  int reg, src1, src2;
+
+  if (stack->depth < 2) {
+    return gFalse;
+  }
+  a = &stack->slots[stack->depth - 2];
+  b = &stack->slots[stack->depth - 1];
+  if (argType == psReal ? (a->type == psBool || b->type == psBool)
+                        : (a->type != argType || b->type != argType)) {
+    return gFalse;
+  }
+  if (a->isConst && b->isConst) {
+    if (argType == psReal && a->type == psInt) {
+      a->val = psEvalInstr(psInstrCvrI, a->val, 0);
+    }
+    if (argType == psReal && b->type == psInt) {
+      b->val = psEvalInstr(psInstrCvrI, b->val, 0);
+    }
+    a->val = psEvalInstr(op, a->val, b->val);
+  } else {
+    src1 = getReg(a, argType == psReal, buf);
+    src2 = getReg(b, argType == psReal, buf);
+    reg = newReg(0);
+    buf->emit(op, reg, src1, src2);
+    a->isConst = gFalse;
+    a->val = reg;
+  }
+  a->type = resType;
+  --stack->depth;
+  return ok;
+}
+
+// Compile a two-operand operator that has an integer form <opI> and
+// (if >= 0) a real form <opR> and a boolean form <opB>, following the
+// interpreter's dispatch: two ints use the integer form, two booleans
+// the boolean one, and any other pair of numbers the real one.
+// Comparisons (<cmp> set) return a boolean.
+GBool PSCompiler::opArith(PSCompStack *stack, PSInstrBuf *buf,
+			  int opI, int opR, int opB, GBool cmp) {
+  PSObjectType t1, t2;
+
+  if (stack->depth < 2) {
+    return gFalse;
+  }
+  t1 = stack->slots[stack->depth - 2].type;
+  t2 = stack->slots[stack->depth - 1].type;
+  if (t1 == psInt && t2 == psInt) {
+    return op2(stack, buf, opI, psInt, cmp ? psBool : psInt);
+  }
+  if (t1 == psBool && t2 == psBool) {
+    return opB >= 0 && op2(stack, buf, opB, psBool, psBool);
+  }
+  return opR >= 0 && op2(stack, buf, opR, psReal, cmp ? psBool : psReal);
+}
+
+// If <slot> is a real, or an integer constant that converts exactly
+// to a real, make it a real and return true.  This lets branches like
+// "{ pop 0 }" merge with ones that leave a real: all later uses of
+// the entry (as a real) then give the same values as the interpreter.
+static GBool psCompConstToReal(PSCompSlot *slot) {
+  if (slot->type == psReal) {
+    return gTrue;
+  }
+  if (slot->type != psInt || !slot->isConst ||
+      slot->val < -32767 || slot->val > 32767) {
+    return gFalse;
+  }
+  slot->type = psReal;
+  slot->val = psEvalInstr(psInstrCvrI, slot->val, 0);
+  return gTrue;
+}
+
+// Compile an if (<elsePtr> < 0) or ifelse whose condition is on top
+// of the stack.
+GBool PSCompiler::ifElse(PSCompStack *stack, PSInstrBuf *buf,
+			 int thenPtr, int elsePtr) {
+  PSCompSlot cond, *s1, *s2;
+  PSCompStack *thenStack, *elseStack;
+  PSInstrBuf thenBuf, elseBuf;
+  GBool res;
+  int reg, i;
+
+  if (stack->depth < 1 || stack->slots[stack->depth - 1].type != psBool) {
+    return gFalse;
+  }
+  cond = stack->slots[--stack->depth];
+
+  // constant condition: compile the branch that is taken in line
+  if (cond.isConst) {
+    if (cond.val) {
+      return compileBlock(thenPtr, stack, buf);
+    } else if (elsePtr >= 0) {
+      return compileBlock(elsePtr, stack, buf);
+    }
+    return gTrue;
+  }
+
+  thenStack = (PSCompStack *)gmalloc(sizeof(PSCompStack));
+  elseStack = (PSCompStack *)gmalloc(sizeof(PSCompStack));
+  *thenStack = *stack;
+  *elseStack = *stack;
+  res = gFalse;
+  if (!compileBlock(thenPtr, thenStack, &thenBuf) ||
+      (elsePtr >= 0 && !compileBlock(elsePtr, elseStack, &elseBuf)) ||
+      thenStack->depth != elseStack->depth) {
+    goto done;
+  }
+
+  // merge the two stacks: entries that differ are moved into a new
+  // register at the end of each branch
+  for (i = 0; i < thenStack->depth; ++i) {
+    s1 = &thenStack->slots[i];
+    s2 = &elseStack->slots[i];
+    if (s1->type != s2->type &&
+	!(psCompConstToReal(s1) && psCompConstToReal(s2))) {
+      goto done;
+    }
+    if (s1->isConst == s2->isConst && s1->val == s2->val) {
+      stack->slots[i] = *s1;
+    } else {
+      reg = newReg(0);
+      thenBuf.emit(s1->isConst ? psInstrLoad : psInstrMov, reg, s1->val, 0);
+      elseBuf.emit(s2->isConst ? psInstrLoad : psInstrMov, reg, s2->val, 0);
+      stack->slots[i].type = s1->type;
+      stack->slots[i].isConst = gFalse;
+      stack->slots[i].val = reg;
+    }
+  }
+  stack->depth = thenStack->depth;
+
+  if (elseBuf.len > 0) {
+    buf->emit(psInstrJz, thenBuf.len + 1, cond.val, 0);
+    buf->append(&thenBuf);
+    buf->emit(psInstrJmp, elseBuf.len, 0, 0);
+    buf->append(&elseBuf);
+  } else {
+    buf->emit(psInstrJz, thenBuf.len, cond.val, 0);
+    buf->append(&thenBuf);
+  }
+  res = ok;
+
+ done:
+  gfree(thenStack);
+  gfree(elseStack);
+  return res;
+}
+
+GBool PSCompiler::compileBlock(int codePtr, PSCompStack *stack,
+			       PSInstrBuf *buf) {
+  PSCompSlot *top, tmp;
+  PSObjectType t;
+  int nArg, jArg, i, k;
+
+  while (ok) {
+    switch (code[codePtr].type) {
+    case psInt:
+    case psReal:
+      if (stack->depth == psStackSize) {
+	return gFalse;
+      }
+      top = &stack->slots[stack->depth++];
+      top->type = code[codePtr].type;
+      top->isConst = gTrue;
+      top->val = code[codePtr].type == psInt ? code[codePtr].intg
+	                                      : code[codePtr].real;
+      ++codePtr;
+      break;
+    case psOperator:
+      top = stack->depth > 0 ? &stack->slots[stack->depth - 1]
+	                     : (PSCompSlot *)NULL;
+      t = top ? top->type : psBool;
+      switch (code[codePtr++].op) {
+      case psOpAbs:
+	if (!(t == psInt ? op1(stack, buf, psInstrAbsI, psInt, psInt)
+	                 : op1(stack, buf, psInstrAbsR, psReal, psReal))) {
+	  return gFalse;
+	}
+	break;
+      case psOpAdd:
+	if (!opArith(stack, buf, psInstrAddI, psInstrAddR, -1, gFalse)) {
+	  return gFalse;
+	}
+	break;
+      case psOpAnd:
+	if (!opArith(stack, buf, psInstrAndI, -1, psInstrAndI, gFalse)) {
+	  return gFalse;
+	}
+	break;
+      case psOpAtan:
+	if (!op2(stack, buf, psInstrAtanR, psReal, psReal)) {
+	  return gFalse;
+	}
+	break;
+      case psOpBitshift:
+	if (!op2(stack, buf, psInstrBitshiftI, psInt, psInt)) {
+	  return gFalse;
+	}
+	break;
+      case psOpCeiling:
+	if (t != psInt && !op1(stack, buf, psInstrCeilingR, psReal, psReal)) {
+	  return gFalse;
+	}
+	break;
+      case psOpCopy:
+	if (!top || !top->isConst || t != psInt) {
+	  return gFalse;
+	}
+	nArg = top->val;
+	--stack->depth;
+	if (nArg < 0 || nArg > stack->depth ||
+	    stack->depth + nArg > psStackSize) {
+	  return gFalse;
+	}
+	for (i = 0; i < nArg; ++i) {
+	  stack->slots[stack->depth + i] =
+	      stack->slots[stack->depth - nArg + i];
+	}
+	stack->depth += nArg;
+	break;
+      case psOpCos:
+	if (!op1(stack, buf, psInstrCosR, psReal, psReal)) {
+	  return gFalse;
+	}
+	break;
+      case psOpCvi:
+	if (t != psInt && !op1(stack, buf, psInstrCviR, psReal, psInt)) {
+	  return gFalse;
+	}
+	break;
+      case psOpCvr:
+	if (t == psInt) {
+	  if (!op1(stack, buf, psInstrCvrI, psInt, psReal)) {
+	    return gFalse;
+	  }
+	} else if (t != psReal) {
+	  return gFalse;
+	}
+	break;
+      case psOpDiv:
+	if (!op2(stack, buf, psInstrDivR, psReal, psReal)) {
+	  return gFalse;
+	}
+	break;
+      case psOpDup:
+	if (!top || stack->depth == psStackSize) {
+	  return gFalse;
+	}
+	stack->slots[stack->depth] = *top;
+	++stack->depth;
+	break;
+      case psOpEq:
+	if (!opArith(stack, buf, psInstrEqI, psInstrEqR, psInstrEqI, gTrue)) {
+	  return gFalse;
+	}
+	break;
+      case psOpExch:
+	if (stack->depth < 2) {
+	  return gFalse;
+	}
+	tmp = stack->slots[stack->depth - 1];
+	stack->slots[stack->depth - 1] = stack->slots[stack->depth - 2];
+	stack->slots[stack->depth - 2] = tmp;
+	break;
+      case psOpExp:
+	if (!op2(stack, buf, psInstrExpR, psReal, psReal)) {
+	  return gFalse;
+	}
+	break;
+      case psOpFalse:
+      case psOpTrue:
+	if (stack->depth == psStackSize) {
+	  return gFalse;
+	}
+	top = &stack->slots[stack->depth++];
+	top->type = psBool;
+	top->isConst = gTrue;
+	top->val = code[codePtr - 1].op == psOpTrue;
+	break;
+      case psOpFloor:
+	if (t != psInt && !op1(stack, buf, psInstrFloorR, psReal, psReal)) {
+	  return gFalse;
+	}
+	break;
+      case psOpGe:
+	if (!opArith(stack, buf, psInstrGeI, psInstrGeR, -1, gTrue)) {
+	  return gFalse;
+	}
+	break;
+      case psOpGt:
+	if (!opArith(stack, buf, psInstrGtI, psInstrGtR, -1, gTrue)) {
+	  return gFalse;
+	}
+	break;
+      case psOpIdiv:
+	if (!op2(stack, buf, psInstrIdivI, psInt, psInt)) {
+	  return gFalse;
+	}
+	break;
+      case psOpIndex:
+	if (!top || !top->isConst || t != psInt) {
+	  return gFalse;
+	}
+	nArg = top->val;
+	--stack->depth;
+	if (nArg < 0 || nArg >= stack->depth) {
+	  return gFalse;
+	}
+	stack->slots[stack->depth] = stack->slots[stack->depth - 1 - nArg];
+	++stack->depth;
+	break;
+      case psOpLe:
+	if (!opArith(stack, buf, psInstrLeI, psInstrLeR, -1, gTrue)) {
+	  return gFalse;
+	}
+	break;
+      case psOpLn:
+	if (!op1(stack, buf, psInstrLnR, psReal, psReal)) {
+	  return gFalse;
+	}
+	break;
+      case psOpLog:
+	if (!op1(stack, buf, psInstrLogR, psReal, psReal)) {
+	  return gFalse;
+	}
+	break;
+      case psOpLt:
+	if (!opArith(stack, buf, psInstrLtI, psInstrLtR, -1, gTrue)) {
+	  return gFalse;
+	}
+	break;
+      case psOpMod:
+	if (!op2(stack, buf, psInstrModI, psInt, psInt)) {
+	  return gFalse;
+	}
+	break;
+      case psOpMul:
+	if (!opArith(stack, buf, psInstrMulI, psInstrMulR, -1, gFalse)) {
+	  return gFalse;
+	}
+	break;
+      case psOpNe:
+	if (!opArith(stack, buf, psInstrNeI, psInstrNeR, psInstrNeI, gTrue)) {
+	  return gFalse;
+	}
+	break;
+      case psOpNeg:
+	if (!(t == psInt ? op1(stack, buf, psInstrNegI, psInt, psInt)
+	                 : op1(stack, buf, psInstrNegR, psReal, psReal))) {
+	  return gFalse;
+	}
+	break;
+      case psOpNot:
+	if (!(t == psInt ? op1(stack, buf, psInstrNotI, psInt, psInt)
+	                 : op1(stack, buf, psInstrNotB, psBool, psBool))) {
+	  return gFalse;
+	}
+	break;
+      case psOpOr:
+	if (!opArith(stack, buf, psInstrOrI, -1, psInstrOrI, gFalse)) {
+	  return gFalse;
+	}
+	break;
+      case psOpPop:
+	if (!top) {
+	  return gFalse;
+	}
+	--stack->depth;
+	break;
+      case psOpRoll:
+	if (stack->depth < 2 ||
+	    !stack->slots[stack->depth - 1].isConst ||
+	    stack->slots[stack->depth - 1].type != psInt ||
+	    !stack->slots[stack->depth - 2].isConst ||
+	    stack->slots[stack->depth - 2].type != psInt) {
+	  return gFalse;
+	}
+	jArg = stack->slots[stack->depth - 1].val;
+	nArg = stack->slots[stack->depth - 2].val;
+	stack->depth -= 2;
+	if (nArg < 0 || nArg > stack->depth) {
+	  return gFalse;
+	}
+	if (nArg > 0) {
+	  // same as PSStack::roll: move the top entry below the next
+	  // n-1 entries, j times
+	  if (jArg >= 0) {
+	    jArg %= nArg;
+	  } else {
+	    jArg = -jArg % nArg;
+	    if (jArg != 0) {
+	      jArg = nArg - jArg;
+	    }
+	  }
+	  for (i = 0; i < jArg; ++i) {
+	    tmp = stack->slots[stack->depth - 1];
+	    for (k = stack->depth - 1; k > stack->depth - nArg; --k) {
+	      stack->slots[k] = stack->slots[k - 1];
+	    }
+	    stack->slots[stack->depth - nArg] = tmp;
+	  }
+	}
+	break;
+      case psOpRound:
+	if (t != psInt && !op1(stack, buf, psInstrRoundR, psReal, psReal)) {
+	  return gFalse;
+	}
+	break;
+      case psOpSin:
+	if (!op1(stack, buf, psInstrSinR, psReal, psReal)) {
+	  return gFalse;
+	}
+	break;
+      case psOpSqrt:
+	if (!op1(stack, buf, psInstrSqrtR, psReal, psReal)) {
+	  return gFalse;
+	}
+	break;
+      case psOpSub:
+	if (!opArith(stack, buf, psInstrSubI, psInstrSubR, -1, gFalse)) {
+	  return gFalse;
+	}
+	break;
+      case psOpTruncate:
+	if (t != psInt &&
+	    !op1(stack, buf, psInstrTruncateR, psReal, psReal)) {
+	  return gFalse;
+	}
+	break;
+      case psOpXor:
+	if (!opArith(stack, buf, psInstrXorI, -1, psInstrXorI, gFalse)) {
+	  return gFalse;
+	}
+	break;
+      case psOpIf:
+	if (!ifElse(stack, buf, codePtr + 2, -1)) {
+	  return gFalse;
+	}
+	codePtr = code[codePtr + 1].blk;
+	break;
+      case psOpIfelse:
+	if (!ifElse(stack, buf, codePtr + 2, code[codePtr].blk)) {
+	  return gFalse;
+	}
+	codePtr = code[codePtr + 1].blk;
+	break;
+      case psOpReturn:
+	return gTrue;
+      }
+      break;
+    default:
+      return gFalse;
+    }
+  }
+  return gFalse;
+}
+
 PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict) {
   Stream *str;
   int codePtr;
@@ -1019,6 +2129,10 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict) {
   code = NULL;
   codeString = NULL;
   codeSize = 0;
+  prog = NULL;
+  progLen = 0;
+  regInit = regs = NULL;
+  nRegs = 0;
   ok = gFalse;
 
   //----- initialize the generic stuff
@@ -1054,6 +2168,13 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict) {
   }
   str->close();
 
+  // interpreted code, and code with steps (comparisons, if/ifelse,
+  // rounding), isn't memoized
+  compile();
+  if (prog && psProgIsContinuous(prog, progLen)) {
+    enableLUT();
+  }
+
   ok = gTrue;
 
  err2:
@@ -1067,35 +2188,132 @@ PostScriptFunction::PostScriptFunction(PostScriptFunction *func) {
   code = (PSObject *)gmallocn(codeSize, sizeof(PSObject));
   memcpy(code, func->code, codeSize * sizeof(PSObject));
   codeString = func->codeString->copy();
+  if (prog) {
+    prog = (PSInstr *)gmallocn(progLen + 1, sizeof(PSInstr));
+    memcpy(prog, func->prog, progLen * sizeof(PSInstr));
+    regInit = (int *)gmallocn(nRegs, sizeof(int));
+    memcpy(regInit, func->regInit, nRegs * sizeof(int));
+    regs = (int *)gmallocn(nRegs, sizeof(int));
+  }
+  copyLUT();
 }
 
 PostScriptFunction::~PostScriptFunction() {
   gfree(code);
   delete codeString;
+  gfree(prog);
+  gfree(regInit);
+  gfree(regs);
+}
+
+void PostScriptFunction::compile() {
+  PSCompiler *comp;
+  PSCompStack *stack;
+  PSInstrBuf buf;
+  PSCompSlot *slot;
+  int i;
+
+  comp = new PSCompiler(code);
+  stack = (PSCompStack *)gmalloc(sizeof(PSCompStack));
+  for (i = 0; i < m; ++i) {
+    stack->slots[i].type = psReal;
+    stack->slots[i].isConst = gFalse;
+    stack->slots[i].val = comp->newReg(0);
+  }
+  stack->depth = m;
+  if (comp->compileBlock(0, stack, &buf) && stack->depth >= n) {
+    for (i = 0; i < n; ++i) {
+      slot = &stack->slots[stack->depth - n + i];
+      if (slot->type == psBool) {
+	break;
+      }
+      outReg[i] = comp->getReg(slot, gTrue, &buf);
+    }
+    if (i == n && comp->ok) {
+      progLen = buf.len;
+      prog = (PSInstr *)gmallocn(progLen + 1, sizeof(PSInstr));
+      memcpy(prog, buf.instrs, progLen * sizeof(PSInstr));
+      nRegs = comp->nRegs;
+      regInit = (int *)gmallocn(nRegs, sizeof(int));
+      memcpy(regInit, comp->regInit, nRegs * sizeof(int));
+      regs = (int *)gmallocn(nRegs, sizeof(int));
+    }
+  }
+  gfree(stack);
+  delete comp;
+}
+
+void PostScriptFunction::run() {
+  PSInstr *instr, *end;
+
+  instr = prog;
+  end = prog + progLen;
+  while (instr < end) {
+    switch (instr->op) {
+    case psInstrMov:
+      regs[instr->dst] = regs[instr->src1];
+      ++instr;
+      break;
+    case psInstrLoad:
+      regs[instr->dst] = instr->src1;
+      ++instr;
+      break;
+    case psInstrJmp:
+      instr += instr->dst + 1;
+      break;
+    case psInstrJz:
+      instr += regs[instr->src1] ? 1 : instr->dst + 1;
+      break;
+    default:
+      regs[instr->dst] = psEvalInstr(instr->op, regs[instr->src1],
+				     regs[instr->src2]);
+      ++instr;
+      break;
+    }
+  }
 }
 
 void PostScriptFunction::transform(FixedPoint *in, FixedPoint *out) {
-  PSStack *stack;
+  PSStack stack;
   int i;
 
-  stack = new PSStack();
+  if (lookupLUT(in, out)) {
+    return;
+  }
+
+  if (prog) {
+    memcpy(regs, regInit, nRegs * sizeof(int));
+    for (i = 0; i < m; ++i) {
+      regs[i] = in[i].getRaw();
+    }
+    run();
+    for (i = 0; i < n; ++i) {
+      out[i] = FixedPoint::make(regs[outReg[i]]);
+      if (out[i] < range[i][0]) {
+	out[i] = range[i][0];
+      } else if (out[i] > range[i][1]) {
+	out[i] = range[i][1];
+      }
+    }
+    return;
+  }
+
   for (i = 0; i < m; ++i) {
     //~ may need to check for integers here
-    stack->pushReal(in[i]);
+    stack.pushReal(in[i]);
   }
-  exec(stack, 0);
+  exec(&stack, 0);
   for (i = n - 1; i >= 0; --i) {
-    out[i] = stack->popNum();
+    out[i] = stack.popNum();
     if (out[i] < range[i][0]) {
       out[i] = range[i][0];
     } else if (out[i] > range[i][1]) {
       out[i] = range[i][1];
     }
   }
-  // if (!stack->empty()) {
+  // if (!stack.empty()) {
   //   error(-1, "Extra values on stack at end of PostScript function");
   // }
-  delete stack;
 }
 
 GBool PostScriptFunction::parseCode(Stream *str, int *codePtr) {
@@ -20,6 +20,7 @@ class Dict;
 class Stream;
 struct PSObject;
 class PSStack;
+struct PSInstr;
 
 //------------------------------------------------------------------------
 // Function
@@ -28,6 +29,7 @@ class PSStack;
 #define funcMaxInputs        32
 #define funcMaxOutputs       32
 #define sampledFuncMaxInputs 16
+#define funcLUTMaxInputs     4
 
 class Function {
 public:
@@ -69,12 +71,40 @@ public:
 
 protected:
 
+  // Allow transform() to be memoized in a lookup table (see
+  // lookupLUT).  Only functions with up to funcLUTMaxInputs inputs
+  // are eligible.
+  void enableLUT();
+
+  // Once the function has been called often enough, it is sampled on
+  // a regular grid; if m-linear interpolation between the samples
+  // reproduces the function to within 1/512 of the output range, the
+  // table is kept and used from then on.  Returns true if <out> was
+  // set from the table, false if the caller needs to evaluate the
+  // function itself.
+  GBool lookupLUT(FixedPoint *in, FixedPoint *out);
+
+  // Make a private copy of the lookup table (after a memcpy copy).
+  void copyLUT();
+
   int m, n;			// size of input and output tuples
   FixedPoint			// min and max values for function domain
     domain[funcMaxInputs][2];
   FixedPoint			// min and max values for function range
     range[funcMaxOutputs][2];
   GBool hasRange;		// set if range is defined
+
+private:
+
+  GBool buildLUT();
+  void interpolateLUT(FixedPoint *in, FixedPoint *out);
+
+  int lutState;			// funcLUTxxx
+  int lutCalls;			// number of calls before the table is built
+  int lutGridSize;		// number of samples along each input
+  FixPtInt64			// input -> grid position multipliers (Q32)
+    lutMul[funcLUTMaxInputs];
+  FixedPoint *lut;		// the samples
 };
 
 //------------------------------------------------------------------------
@@ -217,10 +247,23 @@ private:
   GooString *getToken(Stream *str);
   void resizeCode(int newSize);
   void exec(PSStack *stack, int codePtr);
+  void compile();
+  void run();
 
   GooString *codeString;
   PSObject *code;
   int codeSize;
+
+  // Compiled form of the code: a sequence of register instructions
+  // (NULL if the function couldn't be compiled, in which case the
+  // code is interpreted).
+  PSInstr *prog;
+  int progLen;
+  int *regInit;			// initial register values (constants)
+  int *regs;			// registers, used by transform
+  int nRegs;
+  int outReg[funcMaxOutputs];	// registers holding the outputs
+
   GBool ok;
 };
 
@@ -20,6 +20,7 @@
 #include "goo/gmem.h"
 #include "goo/GooTimer.h"
 #include "goo/GooHash.h"
+#include "goo/GooArena.h"
 #include "GlobalParams.h"
 #include "CharTypes.h"
 #include "Object.h"
@@ -263,6 +264,23 @@ Operator Gfx::opTab[] = {
 
 #define numOps (sizeof(opTab) / sizeof(Operator))
 
+Operator *Gfx::cmdOps[objNumCmds];
+GBool Gfx::cmdOpsInit = gFalse;
+
+// Object types accepted by each TchkType, as bit masks indexed by
+// ObjType.
+static const int tchkObjTypes[] = {
+  1 << objBool,					// tchkBool
+  1 << objInt,					// tchkInt
+  (1 << objInt) | (1 << objReal),		// tchkNum
+  1 << objString,				// tchkString
+  1 << objName,					// tchkName
+  1 << objArray,				// tchkArray
+  (1 << objDict) | (1 << objName),		// tchkProps
+  (1 << objInt) | (1 << objReal) | (1 << objName), // tchkSCN
+  0						// tchkNone
+};
+
 //------------------------------------------------------------------------
 // GfxResources
 //------------------------------------------------------------------------
@@ -465,6 +483,7 @@ Gfx::Gfx(XRef *xrefA, OutputDev *outA, int pageNum, Dict *resDict, Catalog *cata
 	 void *abortCheckCbkDataA) {
   int i;
 
+  initCmdOps();
   xref = xrefA;
   catalog = catalogA;
   subPage = gFalse;
@@ -477,6 +496,8 @@ Gfx::Gfx(XRef *xrefA, OutputDev *outA, int pageNum, Dict *resDict, Catalog *cata
   // initialize
   out = outA;
   state = new GfxState(hDPI, vDPI, box, rotate, out->upsideDown());
+  pathArena = new GooArena();
+  state->setPathArena(pathArena);
   fontChanged = gFalse;
   clip = clipNone;
   ignoreUndef = 0;
@@ -487,8 +508,11 @@ Gfx::Gfx(XRef *xrefA, OutputDev *outA, int pageNum, Dict *resDict, Catalog *cata
     baseMatrix[i] = state->getCTM()[i];
   }
   formDepth = 0;
+  glyphRun = NULL;
+  glyphRunSize = 0;
   abortCheckCbk = abortCheckCbkA;
   abortCheckCbkData = abortCheckCbkDataA;
+  aborted = gFalse;
 
   // set crop box
   if (cropBox) {
@@ -509,6 +533,7 @@ Gfx::Gfx(XRef *xrefA, OutputDev *outA, Dict *resDict, Catalog *catalogA,
 	 void *abortCheckCbkDataA) {
   int i;
 
+  initCmdOps();
   xref = xrefA;
   catalog = catalogA;
   subPage = gTrue;
@@ -520,6 +545,8 @@ Gfx::Gfx(XRef *xrefA, OutputDev *outA, Dict *resDict, Catalog *catalogA,
   // initialize
   out = outA;
   state = new GfxState(72, 72, box, 0, gFalse);
+  pathArena = new GooArena();
+  state->setPathArena(pathArena);
   fontChanged = gFalse;
   clip = clipNone;
   ignoreUndef = 0;
@@ -527,8 +554,11 @@ Gfx::Gfx(XRef *xrefA, OutputDev *outA, Dict *resDict, Catalog *catalogA,
     baseMatrix[i] = state->getCTM()[i];
   }
   formDepth = 0;
+  glyphRun = NULL;
+  glyphRunSize = 0;
   abortCheckCbk = abortCheckCbkA;
   abortCheckCbkData = abortCheckCbkDataA;
+  aborted = gFalse;
 
   // set crop box
   if (cropBox) {
@@ -556,6 +586,8 @@ Gfx::~Gfx() {
   if (state) {
     delete state;
   }
+  delete pathArena;
+  gfree(glyphRun);
 }
 
 void Gfx::display(Object *obj, GBool topLevel) {
@@ -588,8 +620,12 @@ void Gfx::go(GBool topLevel) {
   int numArgs, i;
   int lastAbortCheck;
 
-  // scan a sequence of objects
-  updateLevel = lastAbortCheck = 0;
+  // scan a sequence of objects -- nested content streams (forms,
+  // patterns, Type 3 glyphs) keep counting toward the next abort check
+  if (topLevel) {
+    updateLevel = 0;
+  }
+  lastAbortCheck = updateLevel;
   numArgs = 0;
   parser->getObj(&obj);
   while (!obj.isEOF()) {
@@ -640,10 +676,15 @@ void Gfx::go(GBool topLevel) {
 	updateLevel = 0;
       }
 
-      // check for an abort
+      // check for an abort (updateLevel drops when dump() resets it);
+      // an abort inside a form also stops the content streams around it
       if (abortCheckCbk) {
-	if (updateLevel - lastAbortCheck > 10) {
+	if (aborted) {
+	  break;
+	}
+	if (updateLevel - lastAbortCheck > 10 || updateLevel < lastAbortCheck) {
 	  if ((*abortCheckCbk)(abortCheckCbkData)) {
+	    aborted = gTrue;
 	    break;
 	  }
 	  lastAbortCheck = updateLevel;
@@ -693,15 +734,29 @@ void Gfx::go(GBool topLevel) {
   }
 }
 
+void Gfx::initCmdOps() {
+  int i;
+
+  if (cmdOpsInit) {
+    return;
+  }
+  for (i = 0; i < objNumCmds; ++i) {
+    cmdOps[i] = findOp((char *)objCmdNames[i]);
+  }
+  cmdOpsInit = gTrue;
+}
+
 void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
   Operator *op;
   char *name;
   Object *argPtr;
   int i;
 
-  // find operator
+  // find operator -- every operator is in objCmdNames, so a command
+  // that isn't is unknown
   name = cmd->getCmd();
-  if (!(op = findOp(name))) {
+  i = cmd->getCmdIndex();
+  if (i < 0 || !(op = cmdOps[i])) {
     if (ignoreUndef == 0)
       error(getPos(), "Unknown operator '%s'", name);
     return;
@@ -765,18 +820,7 @@ Operator *Gfx::findOp(char *name) {
 }
 
 GBool Gfx::checkArg(Object *arg, TchkType type) {
-  switch (type) {
-  case tchkBool:   return arg->isBool();
-  case tchkInt:    return arg->isInt();
-  case tchkNum:    return arg->isNum();
-  case tchkString: return arg->isString();
-  case tchkName:   return arg->isName();
-  case tchkArray:  return arg->isArray();
-  case tchkProps:  return arg->isDict() || arg->isName();
-  case tchkSCN:    return arg->isNum() || arg->isName();
-  case tchkNone:   return gFalse;
-  }
-  return gFalse;
+  return (tchkObjTypes[type] >> arg->getType()) & 1;
 }
 
 int Gfx::getPos() {
@@ -3236,7 +3280,7 @@ void Gfx::opMoveSetShowText(Object args[], int numArgs) {
 
 void Gfx::opShowSpaceText(Object args[], int numArgs) {
   Array *a;
-  Object obj;
+  Object obj, *elem;
   int wMode;
   int i;
 
@@ -3252,20 +3296,26 @@ void Gfx::opShowSpaceText(Object args[], int numArgs) {
   wMode = state->getFont()->getWMode();
   a = args[0].getArray();
   for (i = 0; i < a->getLength(); ++i) {
-    a->get(i, &obj);
-    if (obj.isNum()) {
+    // borrow the element rather than copying its string
+    elem = a->getNFPtr(i);
+    if (elem->isRef()) {
+      elem = elem->fetch(xref, &obj);
+    } else {
+      obj.initNull();
+    }
+    if (elem->isNum()) {
       // this uses the absolute value of the font size to match
       // Acrobat's behavior
       if (wMode) {
-	state->textShift(0, -obj.getFP() * (FixedPoint)0.001 *
+	state->textShift(0, -elem->getFP() * (FixedPoint)0.001 *
 			    fabs(state->getFontSize()));
       } else {
-	state->textShift(-obj.getFP() * (FixedPoint)0.001 *
+	state->textShift(-elem->getFP() * (FixedPoint)0.001 *
 			 fabs(state->getFontSize()), 0);
       }
-      out->updateTextShift(state, obj.getFP());
-    } else if (obj.isString()) {
-      doShowText(obj.getString());
+      out->updateTextShift(state, elem->getFP());
+    } else if (elem->isString()) {
+      doShowText(elem->getString());
     } else {
       error(getPos(), "Element of show/space array must be number or string");
     }
@@ -3289,7 +3339,9 @@ void Gfx::doShowText(GooString *s) {
   Dict *resDict;
   Parser *oldParser;
   char *p;
-  int len, n, uLen, nChars, nSpaces, i;
+  GfxGlyphPos *glyph;
+  GBool useRun;
+  int len, n, uLen, nChars, nSpaces, nGlyphs, i;
 
   font = state->getFont();
   wMode = font->getWMode();
@@ -3376,6 +3428,8 @@ void Gfx::doShowText(GooString *s) {
 
   } else if (out->useDrawChar()) {
 
+    useRun = out->useDrawGlyphRun();
+    nGlyphs = 0;
     mat = state->getTextMat();
     fsize = state->getFontSize();
     cspace = state->getCharSpace();
@@ -3417,12 +3471,33 @@ void Gfx::doShowText(GooString *s) {
       } else {
 	tOriginX = tOriginY = 0;
       }
-      out->drawChar(state, state->getCurX() + riseX, state->getCurY() + riseY,
-		    tdx, tdy, tOriginX, tOriginY, code, n, u, uLen);
+      if (useRun) {
+	if (nGlyphs == glyphRunSize) {
+	  glyphRunSize = glyphRunSize ? 2 * glyphRunSize : 64;
+	  glyphRun = (GfxGlyphPos *)greallocn(glyphRun, glyphRunSize,
+					      sizeof(GfxGlyphPos));
+	}
+	glyph = &glyphRun[nGlyphs++];
+	glyph->x = state->getCurX() + riseX;
+	glyph->y = state->getCurY() + riseY;
+	glyph->dx = tdx;
+	glyph->dy = tdy;
+	glyph->originX = tOriginX;
+	glyph->originY = tOriginY;
+	glyph->code = code;
+	glyph->nBytes = n;
+      } else {
+	out->drawChar(state, state->getCurX() + riseX,
+		      state->getCurY() + riseY,
+		      tdx, tdy, tOriginX, tOriginY, code, n, u, uLen);
+      }
       state->shift(tdx, tdy);
       p += n;
       len -= n;
     }
+    if (nGlyphs > 0) {
+      out->drawGlyphRun(state, glyphRun, nGlyphs);
+    }
 
   } else {
     dx = dy = 0;
@@ -4094,11 +4169,10 @@ Stream *Gfx::buildImageStream() {
       error(getPos(), "Inline image dictionary key must be a name object");
       obj.free();
     } else {
-      key = copyString(obj.getName());
+      key = obj.getName();
       obj.free();
       parser->getObj(&obj);
       if (obj.isEOF() || obj.isError()) {
-	gfree(key);
 	break;
       }
       dict.dictAdd(key, &obj);
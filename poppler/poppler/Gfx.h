@@ -38,7 +38,9 @@ class GfxRadialShading;
 class GfxGouraudTriangleShading;
 class GfxPatchMeshShading;
 struct GfxPatch;
+struct GfxGlyphPos;
 class GfxState;
+class GooArena;
 struct GfxColor;
 class GfxColorSpace;
 class Gfx;
@@ -159,6 +161,7 @@ private:
   GBool ocSuppressed;		// are we ignoring content based on OptionalContent?
 
   GfxState *state;		// current graphics state
+  GooArena *pathArena;		// storage for the current path
   GBool fontChanged;		// set if font or text matrix has changed
   GfxClipType clip;		// do a clip?
   int ignoreUndef;		// current BX/EX nesting level
@@ -170,15 +173,24 @@ private:
 
   Parser *parser;		// parser for page content stream(s)
 
+  GfxGlyphPos *glyphRun;	// buffer for strings passed to
+  int glyphRunSize;		//   OutputDev::drawGlyphRun
+
   GBool				// callback to check for an abort
     (*abortCheckCbk)(void *data);
   void *abortCheckCbkData;
+  GBool aborted;		// set once abortCheckCbk returns true
 
   static Operator opTab[];	// table of operators
+  static Operator *		// opTab entry for each command in
+    cmdOps[objNumCmds];		//   objCmdNames (NULL if none)
+  static GBool cmdOpsInit;
+
+  static void initCmdOps();
 
   void go(GBool topLevel);
   void execOp(Object *cmd, Object args[], int numArgs);
-  Operator *findOp(char *name);
+  static Operator *findOp(char *name);
   GBool checkArg(Object *arg, TchkType type);
   int getPos();
 
@@ -2015,7 +2015,9 @@ GfxFontDict::GfxFontDict(XRef *xref, Ref *fontDictRef, Dict *fontDict) {
 
   numFonts = fontDict->getLength();
   fonts = (GfxFont **)gmallocn(numFonts, sizeof(GfxFont *));
+  tags = (char **)gmallocn(numFonts, sizeof(char *));
   for (i = 0; i < numFonts; ++i) {
+    tags[i] = fontDict->getKey(i);
     fontDict->getValNF(i, &obj1);
     obj1.fetch(xref, &obj2);
     if (obj2.isDict()) {
@@ -2060,13 +2062,18 @@ GfxFontDict::~GfxFontDict() {
     }
   }
   gfree(fonts);
+  gfree(tags);
 }
 
 GfxFont *GfxFontDict::lookup(char *tag) {
+  char *atom;
   int i;
 
+  if (!(atom = objFindAtom(tag))) {
+    return NULL;
+  }
   for (i = 0; i < numFonts; ++i) {
-    if (fonts[i] && fonts[i]->matches(tag)) {
+    if (fonts[i] && tags[i] == atom) {
       return fonts[i];
     }
   }
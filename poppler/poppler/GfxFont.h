@@ -367,6 +367,7 @@ public:
 private:
 
   GfxFont **fonts;		// list of fonts
+  char **tags;			// font tags (atoms)
   int numFonts;			// number of fonts
 };
 
@@ -3404,6 +3404,8 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
   for (k = 0; k < gfxColorMaxComps; ++k) {
     lookup[k] = NULL;
   }
+  grayLineMode = grayLineNone;
+  grayLineTab = NULL;
 
   // get decode map
   if (decode->isNull()) {
@@ -3523,6 +3525,10 @@ GfxImageColorMap::GfxImageColorMap(GfxImageColorMap *colorMap) {
     lookup[k] = NULL;
   }
   n = 1 << bits;
+  if (n > 256) {
+    // see the 16 bit hack in the main constructor
+    n = 256;
+  }
   if (colorSpace->getMode() == csIndexed) {
     colorSpace2 = ((GfxIndexedColorSpace *)colorSpace)->getBase();
     for (k = 0; k < nComps2; ++k) {
@@ -3541,6 +3547,14 @@ GfxImageColorMap::GfxImageColorMap(GfxImageColorMap *colorMap) {
       memcpy(lookup[k], colorMap->lookup[k], n * sizeof(GfxColorComp));
     }
   }
+  byte_lookup = NULL;
+  if (colorMap->byte_lookup) {
+    k = colorSpace2 ? nComps2 : nComps;
+    byte_lookup = (Guchar *)gmallocn(n, k);
+    memcpy(byte_lookup, colorMap->byte_lookup, n * k);
+  }
+  grayLineMode = grayLineNone;
+  grayLineTab = NULL;
   for (i = 0; i < nComps; ++i) {
     decodeLow[i] = colorMap->decodeLow[i];
     decodeRange[i] = colorMap->decodeRange[i];
@@ -3556,6 +3570,7 @@ GfxImageColorMap::~GfxImageColorMap() {
     gfree(lookup[i]);
   }
   gfree(byte_lookup);
+  gfree(grayLineTab);
 }
 
 void GfxImageColorMap::getGray(Guchar *x, GfxGray *gray) {
@@ -3592,34 +3607,124 @@ void GfxImageColorMap::getRGB(Guchar *x, GfxRGB *rgb) {
   }
 }
 
-void GfxImageColorMap::getGrayLine(Guchar *in, Guchar *out, int length) {
-  int i, j;
-  Guchar *inp, *tmp_line;
+// Choose the row converter for getGrayLine and build its tables.
+// Decode arrays (and, for Indexed and Separation images, the palette
+// or tint transform) are folded into the tables, so converting a row
+// takes only table lookups, adds and shifts.
+void GfxImageColorMap::initGrayLine() {
+  GfxColorSpace *cs;
+  GfxGray gray;
+  Guchar pix;
+  int *tab;
+  int n, i, k, s;
 
-  switch (colorSpace->getMode()) {
-  case csIndexed:
-  case csSeparation:
-    tmp_line = (Guchar *) gmalloc (length * nComps2);
-    for (i = 0; i < length; i++) {
-      for (j = 0; j < nComps2; j++) {
-	tmp_line[i * nComps2 + j] = byte_lookup[in[i] * nComps2 + j];
+  n = 1 << bits;
+  if (n > 256) {
+    n = 256;
+  }
+  cs = colorSpace;
+  if (cs->getMode() == csICCBased) {
+    cs = ((GfxICCBasedColorSpace *)cs)->getAlt();
+  }
+
+  if (nComps == 1) {
+    // gray, Indexed, Separation, ...: one entry per pixel value
+    grayLineMode = grayLineOneComp;
+    grayLineTab = (int *)gmallocn(256, sizeof(int));
+    for (i = 0; i < 256; ++i) {
+      pix = (Guchar)(i < n ? i : n - 1);
+      getGray(&pix, &gray);
+      grayLineTab[i] = colToByte(gray);
+    }
+
+  } else if (nComps == 3 && byte_lookup &&
+	     (cs->getMode() == csDeviceRGB || cs->getMode() == csCalRGB)) {
+    // RGB: the luminance weights (which add up to 256) are
+    // premultiplied into the decoded component values
+    grayLineMode = grayLineRGB;
+    grayLineTab = (int *)gmallocn(3 * 256, sizeof(int));
+    for (i = 0; i < n; ++i) {
+      grayLineTab[i] = 77 * byte_lookup[i * 3];
+      grayLineTab[256 + i] = 151 * byte_lookup[i * 3 + 1];
+      grayLineTab[512 + i] = 28 * byte_lookup[i * 3 + 2];
+    }
+
+  } else if (nComps == 4 && byte_lookup && cs->getMode() == csDeviceCMYK) {
+    // CMYK: decoded component values, followed by the contributions of
+    // each of the c+k, m+k and y+k ink sums (0..510)
+    grayLineMode = grayLineCMYK;
+    grayLineTab = (int *)gmallocn(4 * 256 + 3 * 511, sizeof(int));
+    for (k = 0; k < 4; ++k) {
+      for (i = 0; i < n; ++i) {
+	grayLineTab[k * 256 + i] = byte_lookup[i * 4 + k];
       }
     }
-    colorSpace2->getGrayLine(tmp_line, out, length);
-    gfree (tmp_line);
+    tab = grayLineTab + 4 * 256;
+    for (s = 0; s < 511; ++s) {
+      tab[s] = 3 * (255 - s) / 10;
+      tab[511 + s] = 6 * (255 - s) / 10;
+      tab[2 * 511 + s] = (255 - s) / 9;
+    }
+
+  } else {
+    grayLineMode = grayLineGeneric;
+  }
+}
+
+void GfxImageColorMap::getGrayLine(Guchar *in, Guchar *out, int length) {
+  GfxGray gray;
+  Guchar *p, *last;
+  int *tab, *tabC, *tabM, *tabY, *tabK, *sumC, *sumM, *sumY;
+  int g, i, k;
+
+  if (grayLineMode == grayLineNone) {
+    initGrayLine();
+  }
+  tab = grayLineTab;
+
+  switch (grayLineMode) {
+  case grayLineOneComp:
+    for (i = 0; i < length; ++i) {
+      out[i] = (Guchar)tab[in[i]];
+    }
+    break;
+
+  case grayLineRGB:
+    for (i = 0, p = in; i < length; ++i, p += 3) {
+      out[i] = (Guchar)((tab[p[0]] + tab[256 + p[1]] + tab[512 + p[2]]) >> 8);
+    }
+    break;
+
+  case grayLineCMYK:
+    tabC = tab;
+    tabM = tab + 256;
+    tabY = tab + 512;
+    tabK = tab + 768;
+    sumC = tab + 1024;
+    sumM = sumC + 511;
+    sumY = sumM + 511;
+    for (i = 0, p = in; i < length; ++i, p += 4) {
+      k = tabK[p[3]];
+      g = sumC[tabC[p[0]] + k] + sumM[tabM[p[1]] + k] + sumY[tabY[p[2]] + k];
+      out[i] = (Guchar)(g < 0 ? 0 : g > 255 ? 255 : g);
+    }
     break;
 
   default:
-    inp = in;
-    for (j = 0; j < length; j++)
-      for (i = 0; i < nComps; i++) {
-	*inp = byte_lookup[*inp * nComps + i];
-	inp++;
+    // images tend to have runs of identical pixels, so only convert
+    // a pixel if it differs from the previous one
+    last = NULL;
+    g = 0;
+    for (i = 0, p = in; i < length; ++i, p += nComps) {
+      if (!last || memcmp(p, last, nComps)) {
+	getGray(p, &gray);
+	g = colToByte(gray);
+	last = p;
       }
-    colorSpace->getGrayLine(in, out, length);
+      out[i] = (Guchar)g;
+    }
     break;
   }
-
 }
 
 void GfxImageColorMap::getRGBLine(Guchar *in, unsigned int *out, int length) {
@@ -3682,11 +3787,18 @@ void GfxImageColorMap::getColor(Guchar *x, GfxColor *color) {
 // GfxSubpath and GfxPath
 //------------------------------------------------------------------------
 
-GfxSubpath::GfxSubpath(FixedPoint x1, FixedPoint y1) {
+GfxSubpath::GfxSubpath(FixedPoint x1, FixedPoint y1, GooArena *arenaA) {
+  arena = arenaA;
   size = 16;
-  x = (FixedPoint *)gmallocn(size, sizeof(FixedPoint));
-  y = (FixedPoint *)gmallocn(size, sizeof(FixedPoint));
-  curve = (GBool *)gmallocn(size, sizeof(GBool));
+  if (arena) {
+    x = (FixedPoint *)arena->allocn(size, sizeof(FixedPoint));
+    y = (FixedPoint *)arena->allocn(size, sizeof(FixedPoint));
+    curve = (GBool *)arena->allocn(size, sizeof(GBool));
+  } else {
+    x = (FixedPoint *)gmallocn(size, sizeof(FixedPoint));
+    y = (FixedPoint *)gmallocn(size, sizeof(FixedPoint));
+    curve = (GBool *)gmallocn(size, sizeof(GBool));
+  }
   n = 1;
   x[0] = x1;
   y[0] = y1;
@@ -3695,30 +3807,49 @@ GfxSubpath::GfxSubpath(FixedPoint x1, FixedPoint y1) {
 }
 
 GfxSubpath::~GfxSubpath() {
-  gfree(x);
-  gfree(y);
-  gfree(curve);
+  if (!arena) {
+    gfree(x);
+    gfree(y);
+    gfree(curve);
+  }
 }
 
 // Used for copy().
-GfxSubpath::GfxSubpath(GfxSubpath *subpath) {
+GfxSubpath::GfxSubpath(GfxSubpath *subpath, GooArena *arenaA) {
+  arena = arenaA;
   size = subpath->size;
   n = subpath->n;
-  x = (FixedPoint *)gmallocn(size, sizeof(FixedPoint));
-  y = (FixedPoint *)gmallocn(size, sizeof(FixedPoint));
-  curve = (GBool *)gmallocn(size, sizeof(GBool));
+  if (arena) {
+    x = (FixedPoint *)arena->allocn(size, sizeof(FixedPoint));
+    y = (FixedPoint *)arena->allocn(size, sizeof(FixedPoint));
+    curve = (GBool *)arena->allocn(size, sizeof(GBool));
+  } else {
+    x = (FixedPoint *)gmallocn(size, sizeof(FixedPoint));
+    y = (FixedPoint *)gmallocn(size, sizeof(FixedPoint));
+    curve = (GBool *)gmallocn(size, sizeof(GBool));
+  }
   memcpy(x, subpath->x, n * sizeof(FixedPoint));
   memcpy(y, subpath->y, n * sizeof(FixedPoint));
   memcpy(curve, subpath->curve, n * sizeof(GBool));
   closed = subpath->closed;
 }
 
+void GfxSubpath::grow(int newSize) {
+  if (arena) {
+    x = (FixedPoint *)arena->reallocn(x, size, newSize, sizeof(FixedPoint));
+    y = (FixedPoint *)arena->reallocn(y, size, newSize, sizeof(FixedPoint));
+    curve = (GBool *)arena->reallocn(curve, size, newSize, sizeof(GBool));
+  } else {
+    x = (FixedPoint *)greallocn(x, newSize, sizeof(FixedPoint));
+    y = (FixedPoint *)greallocn(y, newSize, sizeof(FixedPoint));
+    curve = (GBool *)greallocn(curve, newSize, sizeof(GBool));
+  }
+  size = newSize;
+}
+
 void GfxSubpath::lineTo(FixedPoint x1, FixedPoint y1) {
   if (n >= size) {
-    size += 16;
-    x = (FixedPoint *)greallocn(x, size, sizeof(FixedPoint));
-    y = (FixedPoint *)greallocn(y, size, sizeof(FixedPoint));
-    curve = (GBool *)greallocn(curve, size, sizeof(GBool));
+    grow(size + 16);
   }
   x[n] = x1;
   y[n] = y1;
@@ -3729,10 +3860,7 @@ void GfxSubpath::lineTo(FixedPoint x1, FixedPoint y1) {
 void GfxSubpath::curveTo(FixedPoint x1, FixedPoint y1, FixedPoint x2, FixedPoint y2,
 			 FixedPoint x3, FixedPoint y3) {
   if (n+3 > size) {
-    size += (16 + (size >> 2));
-    x = (FixedPoint *)greallocn(x, size, sizeof(FixedPoint));
-    y = (FixedPoint *)greallocn(y, size, sizeof(FixedPoint));
-    curve = (GBool *)greallocn(curve, size, sizeof(GBool));
+    grow(size + 16 + (size >> 2));
   }
   x[n] = x1;
   y[n] = y1;
@@ -3761,20 +3889,28 @@ void GfxSubpath::offset(FixedPoint dx, FixedPoint dy) {
   }
 }
 
-GfxPath::GfxPath() {
+GfxPath::GfxPath(GooArena *arenaA) {
+  arena = arenaA;
   justMoved = gFalse;
   size = 16;
   n = 0;
   firstX = firstY = 0;
-  subpaths = (GfxSubpath **)gmallocn(size, sizeof(GfxSubpath *));
+  if (arena) {
+    subpaths = (GfxSubpath **)arena->allocn(size, sizeof(GfxSubpath *));
+  } else {
+    subpaths = (GfxSubpath **)gmallocn(size, sizeof(GfxSubpath *));
+  }
 }
 
 GfxPath::~GfxPath() {
   int i;
 
-  for (i = 0; i < n; ++i)
-    delete subpaths[i];
-  gfree(subpaths);
+  // arena subpaths have nothing to free
+  if (!arena) {
+    for (i = 0; i < n; ++i)
+      delete subpaths[i];
+    gfree(subpaths);
+  }
 }
 
 // Used for copy().
@@ -3782,6 +3918,7 @@ GfxPath::GfxPath(GBool justMoved1, FixedPoint firstX1, FixedPoint firstY1,
 		 GfxSubpath **subpaths1, int n1, int size1) {
   int i;
 
+  arena = NULL;
   justMoved = justMoved1;
   firstX = firstX1;
   firstY = firstY1;
@@ -3792,6 +3929,27 @@ GfxPath::GfxPath(GBool justMoved1, FixedPoint firstX1, FixedPoint firstY1,
     subpaths[i] = subpaths1[i]->copy();
 }
 
+// Start a new subpath at (firstX, firstY).
+GfxSubpath *GfxPath::newSubpath() {
+  if (n >= size) {
+    if (arena) {
+      subpaths = (GfxSubpath **)arena->reallocn(subpaths, size, size + 16,
+						sizeof(GfxSubpath *));
+    } else {
+      subpaths = (GfxSubpath **)
+	           greallocn(subpaths, size + 16, sizeof(GfxSubpath *));
+    }
+    size += 16;
+  }
+  if (arena) {
+    subpaths[n] = new (arena) GfxSubpath(firstX, firstY, arena);
+  } else {
+    subpaths[n] = new GfxSubpath(firstX, firstY);
+  }
+  justMoved = gFalse;
+  return subpaths[n++];
+}
+
 void GfxPath::moveTo(FixedPoint x, FixedPoint y) {
   justMoved = gTrue;
   firstX = x;
@@ -3800,14 +3958,7 @@ void GfxPath::moveTo(FixedPoint x, FixedPoint y) {
 
 void GfxPath::lineTo(FixedPoint x, FixedPoint y) {
   if (justMoved) {
-    if (n >= size) {
-      size += 16;
-      subpaths = (GfxSubpath **)
-	           greallocn(subpaths, size, sizeof(GfxSubpath *));
-    }
-    subpaths[n] = new GfxSubpath(firstX, firstY);
-    ++n;
-    justMoved = gFalse;
+    newSubpath();
   }
   subpaths[n-1]->lineTo(x, y);
 }
@@ -3815,14 +3966,7 @@ void GfxPath::lineTo(FixedPoint x, FixedPoint y) {
 void GfxPath::curveTo(FixedPoint x1, FixedPoint y1, FixedPoint x2, FixedPoint y2,
 	     FixedPoint x3, FixedPoint y3) {
   if (justMoved) {
-    if (n >= size) {
-      size += 16;
-      subpaths = (GfxSubpath **) 
- 	         greallocn(subpaths, size, sizeof(GfxSubpath *));
-    }
-    subpaths[n] = new GfxSubpath(firstX, firstY);
-    ++n;
-    justMoved = gFalse;
+    newSubpath();
   }
   subpaths[n-1]->curveTo(x1, y1, x2, y2, x3, y3);
 }
@@ -3831,14 +3975,7 @@ void GfxPath::close() {
   // this is necessary to handle the pathological case of
   // moveto/closepath/clip, which defines an empty clipping region
   if (justMoved) {
-    if (n >= size) {
-      size += 16;
-      subpaths = (GfxSubpath **)
-	greallocn(subpaths, size, sizeof(GfxSubpath *));
-    }
-    subpaths[n] = new GfxSubpath(firstX, firstY);
-    ++n;
-    justMoved = gFalse;
+    newSubpath();
   }
   subpaths[n-1]->close();
 }
@@ -3847,12 +3984,21 @@ void GfxPath::append(GfxPath *path) {
   int i;
 
   if (n + path->n > size) {
+    if (arena) {
+      subpaths = (GfxSubpath **)arena->reallocn(subpaths, size, n + path->n,
+						sizeof(GfxSubpath *));
+    } else {
+      subpaths = (GfxSubpath **)
+                   greallocn(subpaths, n + path->n, sizeof(GfxSubpath *));
+    }
     size = n + path->n;
-    subpaths = (GfxSubpath **)
-                 greallocn(subpaths, size, sizeof(GfxSubpath *));
   }
   for (i = 0; i < path->n; ++i) {
-    subpaths[n++] = path->subpaths[i]->copy();
+    if (arena) {
+      subpaths[n++] = new (arena) GfxSubpath(path->subpaths[i], arena);
+    } else {
+      subpaths[n++] = path->subpaths[i]->copy();
+    }
   }
   justMoved = gFalse;
 }
@@ -3956,6 +4102,7 @@ GfxState::GfxState(FixedPoint hDPIA, FixedPoint vDPIA, PDFRectangle *pageBox,
   render = 0;
 
   path = new GfxPath();
+  pathArena = NULL;
   curX = curY = 0;
   lineX = lineY = 0;
 
@@ -3990,7 +4137,7 @@ GfxState::~GfxState() {
   gfree(lineDash);
   if (path) {
     // this gets set to NULL by restore()
-    delete path;
+    freePath();
   }
   if (saved) {
     delete saved;
@@ -4033,10 +4180,23 @@ GfxState::GfxState(GfxState *state) {
 }
 
 void GfxState::setPath(GfxPath *pathA) {
-  delete path;
+  freePath();
   path = pathA;
 }
 
+void GfxState::freePath() {
+  GooArena *arena;
+
+  // an arena path is the only thing in its arena, so the whole arena
+  // can be recycled
+  if ((arena = path->getArena())) {
+    path->~GfxPath();
+    arena->reset();
+  } else {
+    delete path;
+  }
+}
+
 void GfxState::getUserClipBBox(FixedPoint *xMin, FixedPoint *yMin,
 			       FixedPoint *xMax, FixedPoint *yMax) {
   FixedPoint ictm[6];
@@ -4237,8 +4397,12 @@ void GfxState::setLineDash(FixedPoint *dash, int length, FixedPoint start) {
 }
 
 void GfxState::clearPath() {
-  delete path;
-  path = new GfxPath();
+  freePath();
+  if (pathArena) {
+    path = new (pathArena) GfxPath(pathArena);
+  } else {
+    path = new GfxPath();
+  }
 }
 
 void GfxState::clip() {
@@ -15,6 +15,7 @@
 
 #include "goo/gtypes.h"
 #include "goo/FixedPoint.h"
+#include "goo/GooArena.h"
 #include "Object.h"
 #include "Function.h"
 
@@ -870,6 +871,16 @@ private:
 // GfxImageColorMap
 //------------------------------------------------------------------------
 
+// Row converters for GfxImageColorMap::getGrayLine, chosen once per
+// color map.
+enum GfxImageGrayLineMode {
+  grayLineNone,			// not chosen yet
+  grayLineOneComp,		// any one-component space: one table
+  grayLineRGB,			// RGB: weighted per-component tables
+  grayLineCMYK,			// CMYK: per-component and ink-sum tables
+  grayLineGeneric		// anything else: getGray per pixel
+};
+
 class GfxImageColorMap {
 public:
 
@@ -900,13 +911,17 @@ public:
   void getGray(Guchar *x, GfxGray *gray);
   void getRGB(Guchar *x, GfxRGB *rgb);
   void getRGBLine(Guchar *in, unsigned int *out, int length);
-  void getGrayLine(Guchar *in, Guchar *out, int length);
   void getCMYK(Guchar *x, GfxCMYK *cmyk);
   void getColor(Guchar *x, GfxColor *color);
 
+  // Convert a row of <length> pixels, as returned by
+  // ImageStream::getLine, to 8-bit gray.  <in> is not modified.
+  void getGrayLine(Guchar *in, Guchar *out, int length);
+
 private:
 
   GfxImageColorMap(GfxImageColorMap *colorMap);
+  void initGrayLine();
 
   GfxColorSpace *colorSpace;	// the image color space
   int bits;			// bits per component
@@ -916,7 +931,9 @@ private:
   GfxColorComp *		// lookup table
     lookup[gfxColorMaxComps];
   Guchar *byte_lookup;
-  Guchar *tmp_line;
+  GfxImageGrayLineMode		// row converter used by getGrayLine
+    grayLineMode;
+  int *grayLineTab;		// tables for the row converter
   FixedPoint			// minimum values for each component
     decodeLow[gfxColorMaxComps];
   FixedPoint			// max - min value for each component
@@ -931,14 +948,15 @@ private:
 class GfxSubpath {
 public:
 
-  // Constructor.
-  GfxSubpath(FixedPoint x1, FixedPoint y1);
+  // Constructor.  If <arenaA> is non-NULL, the points are allocated
+  // from it (and the subpath itself should be too).
+  GfxSubpath(FixedPoint x1, FixedPoint y1, GooArena *arenaA = NULL);
 
   // Destructor.
   ~GfxSubpath();
 
-  // Copy.
-  GfxSubpath *copy() { return new GfxSubpath(this); }
+  // Copy (to the heap).
+  GfxSubpath *copy() { return new GfxSubpath(this, NULL); }
 
   // Get points.
   int getNumPoints() { return n; }
@@ -972,23 +990,32 @@ private:
   int n;			// number of points
   int size;			// size of x/y arrays
   GBool closed;			// set if path is closed
+  GooArena *arena;		// arena holding the points, or NULL
+
+  GfxSubpath(GfxSubpath *subpath, GooArena *arenaA);
+  void grow(int newSize);
 
-  GfxSubpath(GfxSubpath *subpath);
+  friend class GfxPath;
 };
 
 class GfxPath {
 public:
 
-  // Constructor.
-  GfxPath();
+  // Constructor.  If <arenaA> is non-NULL, the subpaths are
+  // allocated from it; the path itself must then be allocated from
+  // the arena too, with new (arenaA) GfxPath(arenaA).
+  GfxPath(GooArena *arenaA = NULL);
 
   // Destructor.
   ~GfxPath();
 
-  // Copy.
+  // Copy (to the heap).
   GfxPath *copy()
     { return new GfxPath(justMoved, firstX, firstY, subpaths, n, size); }
 
+  // Get the arena this path was allocated from, or NULL.
+  GooArena *getArena() { return arena; }
+
   // Is there a current point?
   GBool isCurPt() { return n > 0 || justMoved; }
 
@@ -1029,6 +1056,9 @@ private:
   GfxSubpath **subpaths;	// subpaths
   int n;			// number of subpaths
   int size;			// size of subpaths array
+  GooArena *arena;		// arena holding the path, or NULL
+
+  GfxSubpath *newSubpath();
 
   GfxPath(GBool justMoved1, FixedPoint firstX1, FixedPoint firstY1,
 	  GfxSubpath **subpaths1, int n1, int size1);
@@ -1110,6 +1140,10 @@ public:
   int getRender() { return render; }
   GfxPath *getPath() { return path; }
   void setPath(GfxPath *pathA);
+  // Build paths in <arenaA>, which is reset every time the path is
+  // cleared.  The path belongs to the current state only (see
+  // restore), so the arena is shared by the whole state stack.
+  void setPathArena(GooArena *arenaA) { pathArena = arenaA; }
   FixedPoint getCurX() { return curX; }
   FixedPoint getCurY() { return curY; }
   void getClipBBox(FixedPoint *xMin, FixedPoint *yMin, FixedPoint *xMax, FixedPoint *yMax)
@@ -1180,6 +1214,8 @@ public:
     { wordSpace = space; }
   void setHorizScaling(FixedPoint scale)
     { horizScaling = (FixedPoint)0.01 * scale; }
+  void setHorizScalingFactor(FixedPoint factor)
+    { horizScaling = factor; }
   void setLeading(FixedPoint leadingA)
     { leading = leadingA; }
   void setRise(FixedPoint riseA)
@@ -1265,6 +1301,7 @@ private:
   int render;			// text rendering mode
 
   GfxPath *path;		// array of path elements
+  GooArena *pathArena;		// arena for the current path, or NULL
   FixedPoint curX, curY;		// current point (user coords)
   FixedPoint lineX, lineY;		// start of current text line (text coords)
 
@@ -1274,6 +1311,7 @@ private:
   GfxState *saved;		// next GfxState on stack
 
   GfxState(GfxState *state);
+  void freePath();
 };
 
 #endif
@@ -550,10 +550,10 @@ GlobalParams::GlobalParams() {
 
   // scan the encoding in reverse because we want the lowest-numbered
   // index for each char name ('space' is encoded twice)
-  macRomanReverseMap = new NameToCharCode();
+  macRomanReverseMap = new NameToCharCode(256);
   for (i = 255; i >= 0; --i) {
     if (macRomanEncoding[i]) {
-      macRomanReverseMap->add(macRomanEncoding[i], (CharCode)i);
+      macRomanReverseMap->addStatic(macRomanEncoding[i], (CharCode)i);
     }
   }
 
@@ -563,7 +563,8 @@ GlobalParams::GlobalParams() {
 #else
   baseDir = appendToPath(getHomeDir(), ".xpdf");
 #endif
-  nameToUnicode = new NameToCharCode();
+  nameToUnicode = new NameToCharCode(sizeof(nameToUnicodeTab) /
+				     sizeof(nameToUnicodeTab[0]));
   cidToUnicodes = new GooHash(gTrue);
   unicodeToUnicodes = new GooHash(gTrue);
   residentUnicodeMaps = new GooHash();
@@ -601,6 +602,7 @@ GlobalParams::GlobalParams() {
   antialias = gTrue;
   vectorAntialias = gTrue;
   strokeAdjust = gTrue;
+  fontCacheDir = NULL;
   screenType = screenUnset;
   screenSize = -1;
   screenDotRadius = -1;
@@ -630,7 +632,8 @@ GlobalParams::GlobalParams() {
 
   // set up the initial nameToUnicode table
   for (i = 0; nameToUnicodeTab[i].name; ++i) {
-    nameToUnicode->add(nameToUnicodeTab[i].name, nameToUnicodeTab[i].u);
+    nameToUnicode->addStatic(nameToUnicodeTab[i].name,
+			     nameToUnicodeTab[i].u);
   }
 
   // set up the residentUnicodeMaps table
@@ -780,6 +783,9 @@ GlobalParams::~GlobalParams() {
   deleteGooList(psFonts16, PSFontParam);
   delete textEncoding;
   deleteGooList(fontDirs, GooString);
+  if (fontCacheDir) {
+    delete fontCacheDir;
+  }
 
   GooHashIter *iter;
   GooString *key;
@@ -1382,6 +1388,15 @@ GBool GlobalParams::getStrokeAdjust() {
   return f;
 }
 
+GooString *GlobalParams::getFontCacheDir() {
+  GooString *s;
+
+  lockGlobalParams;
+  s = fontCacheDir ? fontCacheDir->copy() : (GooString *)NULL;
+  unlockGlobalParams;
+  return s;
+}
+
 ScreenType GlobalParams::getScreenType() {
   ScreenType t;
 
@@ -1687,6 +1702,15 @@ void GlobalParams::setStrokeAdjust(GBool adjust)
   unlockGlobalParams;
 }
 
+void GlobalParams::setFontCacheDir(char *dir) {
+  lockGlobalParams;
+  if (fontCacheDir) {
+    delete fontCacheDir;
+  }
+  fontCacheDir = dir ? new GooString(dir) : (GooString *)NULL;
+  unlockGlobalParams;
+}
+
 void GlobalParams::setScreenType(ScreenType st)
 {
   lockGlobalParams;
@@ -185,6 +185,7 @@ public:
   GBool getAntialias();
   GBool getVectorAntialias();
   GBool getStrokeAdjust();
+  GooString *getFontCacheDir();
   ScreenType getScreenType();
   int getScreenSize();
   int getScreenDotRadius();
@@ -226,6 +227,7 @@ public:
   GBool setAntialias(char *s);
   GBool setVectorAntialias(char *s);
   void setStrokeAdjust(GBool strokeAdjust);
+  void setFontCacheDir(char *dir);
   void setScreenType(ScreenType st);
   void setScreenSize(int size);
   void setScreenDotRadius(int radius);
@@ -309,6 +311,8 @@ private:
   GBool antialias;		// anti-aliasing enable flag
   GBool vectorAntialias;	// vector anti-aliasing enable flag
   GBool strokeAdjust;		// stroke adjustment enable flag
+  GooString *fontCacheDir;	// directory for the converted embedded
+				//   font cache (NULL = no cache)
   ScreenType screenType;	// halftone screen type
   int screenSize;		// screen matrix size
   int screenDotRadius;		// screen dot radius
@@ -665,8 +665,10 @@ public:
   void getPixelPtr(int x, int y, JBIG2BitmapPtr *ptr);
   int nextPixel(JBIG2BitmapPtr *ptr);
   void duplicateRow(int yDest, int ySrc);
+  void getRowShifted(int y, int x, Guchar *dest, int n);
   void combine(JBIG2Bitmap *bitmap, int x, int y, Guint combOp);
   Guchar *getDataPtr() { return data; }
+  int getLineSize() { return line; }
   int getDataSize() { return h * line; }
 
 private:
@@ -799,6 +801,57 @@ void JBIG2Bitmap::duplicateRow(int yDest, int ySrc) {
   memcpy(data + yDest * line, data + ySrc * line, line);
 }
 
+// Copy <n> bytes of row <y>, starting at pixel <x> (which may be
+// negative or unaligned), to <dest>.  Pixels outside the bitmap,
+// including the padding bits at the end of each row, read as zero.
+void JBIG2Bitmap::getRowShifted(int y, int x, Guchar *dest, int n) {
+  Guchar *src;
+  Guint lastMask, b0, b1;
+  int q, s, i;
+
+  if (y < 0 || y >= h) {
+    memset(dest, 0, n);
+    return;
+  }
+  src = data + y * line;
+  lastMask = (0xff << ((line << 3) - w)) & 0xff;
+  s = x & 7;
+  q = (x - s) / 8;
+  b0 = (q >= 0 && q < line) ? src[q] : 0;
+  if (q == line - 1) {
+    b0 &= lastMask;
+  }
+  for (i = 0; i < n; ++i) {
+    ++q;
+    b1 = (q >= 0 && q < line) ? src[q] : 0;
+    if (q == line - 1) {
+      b1 &= lastMask;
+    }
+    dest[i] = (Guchar)((b0 << s) | (b1 >> (8 - s)));
+    b0 = b1;
+  }
+}
+
+//------------------------------------------------------------------------
+
+// The generic and refinement region decoders keep a 32-bit window for
+// each context row: bit 15 holds the pixel in the current column, the
+// bits above it hold the 16 pixels to its left, and the bits below it
+// hold at least 8 pixels to its right.  The windows are refilled a
+// byte at a time, so the context for a pixel is built with a few shifts
+// instead of one bitmap access per context pixel.  Adaptive template
+// pixels that fall outside the windows are fetched from the bitmap.
+static inline Guint jbig2WindowPixel(Guint buf0, Guint buf1, Guint buf2,
+				     int row, int shift, JBIG2Bitmap *bitmap,
+				     JBIG2BitmapPtr *ptr) {
+  switch (row) {
+  case 0:  return (buf0 >> shift) & 1;
+  case 1:  return (buf1 >> shift) & 1;
+  case 2:  return (buf2 >> shift) & 1;
+  default: return bitmap->nextPixel(ptr);
+  }
+}
+
 void JBIG2Bitmap::combine(JBIG2Bitmap *bitmap, int x, int y,
 			  Guint combOp) {
   int x0, x1, y0, y1, xx, yy;
@@ -1103,11 +1156,147 @@ JBIG2CodeTable::~JBIG2CodeTable() {
   gfree(table);
 }
 
+//------------------------------------------------------------------------
+// JBIG2Globals
+//------------------------------------------------------------------------
+
+// The segments decoded from a JBIG2Globals stream.  Once decoded they
+// are only read, so they can be shared by any number of JBIG2Streams.
+class JBIG2Globals {
+public:
+
+  JBIG2Globals(GooList *segmentsA);
+  ~JBIG2Globals();
+  GooList *getSegments() { return segments; }
+  void incRefCnt();
+  void decRefCnt();
+
+private:
+
+  GooList *segments;		// [JBIG2Segment]
+  int refCnt;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+};
+
+JBIG2Globals::JBIG2Globals(GooList *segmentsA) {
+  segments = segmentsA;
+  refCnt = 1;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+JBIG2Globals::~JBIG2Globals() {
+  deleteGooList(segments, JBIG2Segment);
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+void JBIG2Globals::incRefCnt() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  ++refCnt;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+}
+
+void JBIG2Globals::decRefCnt() {
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  done = --refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (done) {
+    delete this;
+  }
+}
+
+//------------------------------------------------------------------------
+// JBIG2GlobalsCache
+//------------------------------------------------------------------------
+
+struct JBIG2GlobalsCacheEntry {
+  Ref ref;
+  JBIG2Globals *globals;
+};
+
+JBIG2GlobalsCache::JBIG2GlobalsCache() {
+  entries = new GooList();
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+JBIG2GlobalsCache::~JBIG2GlobalsCache() {
+  JBIG2GlobalsCacheEntry *entry;
+  int i;
+
+  for (i = 0; i < entries->getLength(); ++i) {
+    entry = (JBIG2GlobalsCacheEntry *)entries->get(i);
+    entry->globals->decRefCnt();
+    delete entry;
+  }
+  delete entries;
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+JBIG2Globals *JBIG2GlobalsCache::lookup(Ref ref) {
+  JBIG2GlobalsCacheEntry *entry;
+  JBIG2Globals *globals;
+  int i;
+
+  globals = NULL;
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  for (i = 0; i < entries->getLength(); ++i) {
+    entry = (JBIG2GlobalsCacheEntry *)entries->get(i);
+    if (entry->ref.num == ref.num && entry->ref.gen == ref.gen) {
+      globals = entry->globals;
+      globals->incRefCnt();
+      break;
+    }
+  }
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return globals;
+}
+
+void JBIG2GlobalsCache::add(Ref ref, JBIG2Globals *globals) {
+  JBIG2GlobalsCacheEntry *entry;
+
+  entry = new JBIG2GlobalsCacheEntry;
+  entry->ref = ref;
+  entry->globals = globals;
+  globals->incRefCnt();
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  entries->append(entry);
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+}
+
 //------------------------------------------------------------------------
 // JBIG2Stream
 //------------------------------------------------------------------------
 
-JBIG2Stream::JBIG2Stream(Stream *strA, Object *globalsStreamA):
+JBIG2Stream::JBIG2Stream(Stream *strA, Object *globalsStreamA,
+			 Object *globalsStreamRefA,
+			 JBIG2GlobalsCache *globalsCacheA):
   FilterStream(strA)
 {
   pageBitmap = NULL;
@@ -1133,6 +1322,13 @@ JBIG2Stream::JBIG2Stream(Stream *strA, Object *globalsStreamA):
   mmrDecoder = new JBIG2MMRDecoder();
 
   globalsStreamA->copy(&globalsStream);
+  if (globalsStreamRefA && globalsStreamRefA->isRef()) {
+    globalsStreamRefA->copy(&globalsStreamRef);
+  } else {
+    globalsStreamRef.initNull();
+  }
+  globalsCache = globalsCacheA;
+  globals = NULL;
   segments = globalSegments = NULL;
   curStr = NULL;
   dataPtr = dataEnd = NULL;
@@ -1141,6 +1337,7 @@ JBIG2Stream::JBIG2Stream(Stream *strA, Object *globalsStreamA):
 JBIG2Stream::~JBIG2Stream() {
   close();
   globalsStream.free();
+  globalsStreamRef.free();
   delete arithDecoder;
   delete genericRegionStats;
   delete refinementRegionStats;
@@ -1164,18 +1361,30 @@ JBIG2Stream::~JBIG2Stream() {
 }
 
 void JBIG2Stream::reset() {
-  // read the globals stream
-  globalSegments = new GooList();
-  if (globalsStream.isStream()) {
-    segments = globalSegments;
-    curStr = globalsStream.getStream();
-    curStr->reset();
-    arithDecoder->setStream(curStr);
-    huffDecoder->setStream(curStr);
-    mmrDecoder->setStream(curStr);
-    readSegments();
-    curStr->close();
-  }
+  // read the globals stream, unless another image in this document
+  // has already decoded it
+  if (globalsCache && globalsStreamRef.isRef()) {
+    globals = globalsCache->lookup(globalsStreamRef.getRef());
+  }
+  if (!globals) {
+    globalSegments = new GooList();
+    if (globalsStream.isStream()) {
+      segments = globalSegments;
+      curStr = globalsStream.getStream();
+      curStr->reset();
+      arithDecoder->setStream(curStr);
+      huffDecoder->setStream(curStr);
+      mmrDecoder->setStream(curStr);
+      readSegments();
+      curStr->close();
+    }
+    globals = new JBIG2Globals(globalSegments);
+    if (globalsCache && globalsStreamRef.isRef() &&
+	globalsStream.isStream()) {
+      globalsCache->add(globalsStreamRef.getRef(), globals);
+    }
+  }
+  globalSegments = globals->getSegments();
 
   // read the main stream
   segments = new GooList();
@@ -1203,8 +1412,9 @@ void JBIG2Stream::close() {
     deleteGooList(segments, JBIG2Segment);
     segments = NULL;
   }
-  if (globalSegments) {
-    deleteGooList(globalSegments, JBIG2Segment);
+  if (globals) {
+    globals->decRefCnt();
+    globals = NULL;
     globalSegments = NULL;
   }
   dataPtr = dataEnd = NULL;
@@ -1306,7 +1516,7 @@ void JBIG2Stream::readSegments() {
     }
 
     // keep track of the start of the segment data 
-    segDataPos = getPos();
+    segDataPos = curStr->getPos();
 
     // read the segment data
     switch (segType) {
@@ -1391,7 +1601,7 @@ void JBIG2Stream::readSegments() {
 
     if (segLength != 0xffffffff) {
 
-      int segExtraBytes = segDataPos + segLength - getPos();
+      int segExtraBytes = segDataPos + segLength - curStr->getPos();
       if (segExtraBytes > 0) {
 
 	// If we didn't read all of the bytes in the segment data,
@@ -2571,15 +2781,17 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
 					    int mmrDataLength) {
   JBIG2Bitmap *bitmap;
   GBool ltp;
-  Guint ltpCX, cx, cx0, cx1, cx2;
-  JBIG2BitmapPtr cxPtr0 = {0, 0, 0}, cxPtr1 = {0, 0, 0};
-  JBIG2BitmapPtr atPtr0 = {0, 0, 0}, atPtr1 = {0, 0, 0}, atPtr2 = {0, 0, 0}, atPtr3 = {0, 0, 0};
+  Guint ltpCX, cx, buf0, buf1, buf2, skipBuf, out, mask;
+  JBIG2BitmapPtr atPtr[4];
+  int atRow[4], atShift[4];
+  Guchar *rowPtr, *p0, *p1, *sp;
   int *refLine, *codingLine;
   int code1, code2, code3;
-  int x, y, a0, pix, i, refI, codingI;
+  int x0, x1, y, a0, n, nAT, line, i, refI, codingI;
 
   bitmap = new JBIG2Bitmap(0, w, h);
   bitmap->clearToZero();
+  line = bitmap->getLineSize();
 
   //----- MMR decode
 
@@ -2712,11 +2924,22 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
       } while (a0 < w);
       codingLine[codingI++] = w;
 
-      // convert the run lengths to a bitmap line
+      // convert the run lengths to a bitmap line, filling whole bytes
+      // at a time
+      rowPtr = bitmap->getDataPtr() + y * line;
       i = 0;
       while (codingLine[i] < w) {
-	for (x = codingLine[i]; x < codingLine[i+1]; ++x) {
-	  bitmap->setPixel(x, y);
+	x0 = codingLine[i] < 0 ? 0 : codingLine[i];
+	x1 = codingLine[i+1] > w ? w : codingLine[i+1];
+	if (x0 < x1) {
+	  --x1;
+	  if ((x0 >> 3) == (x1 >> 3)) {
+	    rowPtr[x0 >> 3] |= (0xff >> (x0 & 7)) & (0xff << (7 - (x1 & 7)));
+	  } else {
+	    rowPtr[x0 >> 3] |= 0xff >> (x0 & 7);
+	    memset(rowPtr + (x0 >> 3) + 1, 0xff, (x1 >> 3) - (x0 >> 3) - 1);
+	    rowPtr[x1 >> 3] |= 0xff << (7 - (x1 & 7));
+	  }
 	}
 	i += 2;
       }
@@ -2755,8 +2978,22 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
       }
     }
 
+    // map the adaptive template pixels onto the row windows (row 0 is
+    // y-2, row 1 is y-1, row 2 is y)
+    nAT = templ == 0 ? 4 : 1;
+    for (i = 0; i < nAT; ++i) {
+      if (aty[i] >= -2 && aty[i] <= 0 && atx[i] >= -16 && atx[i] <= 8) {
+	atRow[i] = aty[i] + 2;
+	atShift[i] = 15 - atx[i];
+      } else {
+	atRow[i] = -1;
+	atShift[i] = 0;
+      }
+    }
+
     ltp = 0;
-    cx = cx0 = cx1 = cx2 = 0; // make gcc happy
+    sp = NULL;
+    skipBuf = 0;
     for (y = 0; y < h; ++y) {
 
       // check for a "typical" (duplicate) row
@@ -2770,151 +3007,111 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
 	}
       }
 
-      switch (templ) {
-      case 0:
-
-	// set up the context
-	bitmap->getPixelPtr(0, y-2, &cxPtr0);
-	cx0 = bitmap->nextPixel(&cxPtr0);
-	cx0 = (cx0 << 1) | bitmap->nextPixel(&cxPtr0);
-	bitmap->getPixelPtr(0, y-1, &cxPtr1);
-	cx1 = bitmap->nextPixel(&cxPtr1);
-	cx1 = (cx1 << 1) | bitmap->nextPixel(&cxPtr1);
-	cx1 = (cx1 << 1) | bitmap->nextPixel(&cxPtr1);
-	cx2 = 0;
-	bitmap->getPixelPtr(atx[0], y + aty[0], &atPtr0);
-	bitmap->getPixelPtr(atx[1], y + aty[1], &atPtr1);
-	bitmap->getPixelPtr(atx[2], y + aty[2], &atPtr2);
-	bitmap->getPixelPtr(atx[3], y + aty[3], &atPtr3);
-
-	// decode the row
-	for (x = 0; x < w; ++x) {
-
-	  // build the context
-	  cx = (cx0 << 13) | (cx1 << 8) | (cx2 << 4) |
-	       (bitmap->nextPixel(&atPtr0) << 3) |
-	       (bitmap->nextPixel(&atPtr1) << 2) |
-	       (bitmap->nextPixel(&atPtr2) << 1) |
-	       bitmap->nextPixel(&atPtr3);
-
-	  // check for a skipped pixel
-	  if (useSkip && skip->getPixel(x, y)) {
-	    pix = 0;
-
-	  // decode the pixel
-	  } else if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-	    bitmap->setPixel(x, y);
-	  }
+      // a zero-width region has no pixels (and no bitmap data)
+      if (line <= 0) {
+	continue;
+      }
 
-	  // update the context
-	  cx0 = ((cx0 << 1) | bitmap->nextPixel(&cxPtr0)) & 0x07;
-	  cx1 = ((cx1 << 1) | bitmap->nextPixel(&cxPtr1)) & 0x1f;
-	  cx2 = ((cx2 << 1) | pix) & 0x0f;
+      // set up the row windows
+      rowPtr = bitmap->getDataPtr() + y * line;
+      if (y >= 2) {
+	p0 = rowPtr - 2 * line;
+	buf0 = *p0++ << 8;
+      } else {
+	p0 = NULL;
+	buf0 = 0;
+      }
+      if (y >= 1) {
+	p1 = rowPtr - line;
+	buf1 = *p1++ << 8;
+      } else {
+	p1 = NULL;
+	buf1 = 0;
+      }
+      buf2 = 0;
+      if (useSkip) {
+	sp = skip->getDataPtr() + y * skip->getLineSize();
+	skipBuf = *sp++ << 8;
+      }
+      for (i = 0; i < nAT; ++i) {
+	if (atRow[i] < 0) {
+	  bitmap->getPixelPtr(atx[i], y + aty[i], &atPtr[i]);
 	}
-	break;
-
-      case 1:
-
-	// set up the context
-	bitmap->getPixelPtr(0, y-2, &cxPtr0);
-	cx0 = bitmap->nextPixel(&cxPtr0);
-	cx0 = (cx0 << 1) | bitmap->nextPixel(&cxPtr0);
-	cx0 = (cx0 << 1) | bitmap->nextPixel(&cxPtr0);
-	bitmap->getPixelPtr(0, y-1, &cxPtr1);
-	cx1 = bitmap->nextPixel(&cxPtr1);
-	cx1 = (cx1 << 1) | bitmap->nextPixel(&cxPtr1);
-	cx1 = (cx1 << 1) | bitmap->nextPixel(&cxPtr1);
-	cx2 = 0;
-	bitmap->getPixelPtr(atx[0], y + aty[0], &atPtr0);
-
-	// decode the row
-	for (x = 0; x < w; ++x) {
-
-	  // build the context
-	  cx = (cx0 << 9) | (cx1 << 4) | (cx2 << 1) |
-	       bitmap->nextPixel(&atPtr0);
+      }
 
-	  // check for a skipped pixel
-	  if (useSkip && skip->getPixel(x, y)) {
-	    pix = 0;
+      // decode the row, one output byte at a time
+      for (x0 = 0; x0 < w; x0 += 8) {
 
-	  // decode the pixel
-	  } else if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-	    bitmap->setPixel(x, y);
+	// shift the next byte of each reference row into its window
+	if (x0 + 8 < w) {
+	  if (p0) {
+	    buf0 |= *p0++;
 	  }
-
-	  // update the context
-	  cx0 = ((cx0 << 1) | bitmap->nextPixel(&cxPtr0)) & 0x0f;
-	  cx1 = ((cx1 << 1) | bitmap->nextPixel(&cxPtr1)) & 0x1f;
-	  cx2 = ((cx2 << 1) | pix) & 0x07;
-	}
-	break;
-
-      case 2:
-
-	// set up the context
-	bitmap->getPixelPtr(0, y-2, &cxPtr0);
-	cx0 = bitmap->nextPixel(&cxPtr0);
-	cx0 = (cx0 << 1) | bitmap->nextPixel(&cxPtr0);
-	bitmap->getPixelPtr(0, y-1, &cxPtr1);
-	cx1 = bitmap->nextPixel(&cxPtr1);
-	cx1 = (cx1 << 1) | bitmap->nextPixel(&cxPtr1);
-	cx2 = 0;
-	bitmap->getPixelPtr(atx[0], y + aty[0], &atPtr0);
-
-	// decode the row
-	for (x = 0; x < w; ++x) {
-
-	  // build the context
-	  cx = (cx0 << 7) | (cx1 << 3) | (cx2 << 1) |
-	       bitmap->nextPixel(&atPtr0);
-
-	  // check for a skipped pixel
-	  if (useSkip && skip->getPixel(x, y)) {
-	    pix = 0;
-
-	  // decode the pixel
-	  } else if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-	    bitmap->setPixel(x, y);
+	  if (p1) {
+	    buf1 |= *p1++;
+	  }
+	  if (sp) {
+	    skipBuf |= *sp++;
 	  }
-
-	  // update the context
-	  cx0 = ((cx0 << 1) | bitmap->nextPixel(&cxPtr0)) & 0x07;
-	  cx1 = ((cx1 << 1) | bitmap->nextPixel(&cxPtr1)) & 0x0f;
-	  cx2 = ((cx2 << 1) | pix) & 0x03;
 	}
-	break;
-
-      case 3:
+	n = w - x0 < 8 ? w - x0 : 8;
+	out = 0;
 
-	// set up the context
-	bitmap->getPixelPtr(0, y-1, &cxPtr1);
-	cx1 = bitmap->nextPixel(&cxPtr1);
-	cx1 = (cx1 << 1) | bitmap->nextPixel(&cxPtr1);
-	cx2 = 0;
-	bitmap->getPixelPtr(atx[0], y + aty[0], &atPtr0);
-
-	// decode the row
-	for (x = 0; x < w; ++x) {
+	for (x1 = 0, mask = 0x80; x1 < n; ++x1, mask >>= 1) {
 
 	  // build the context
-	  cx = (cx1 << 5) | (cx2 << 1) |
-	       bitmap->nextPixel(&atPtr0);
-
-	  // check for a skipped pixel
-	  if (useSkip && skip->getPixel(x, y)) {
-	    pix = 0;
+	  switch (templ) {
+	  case 0:
+	    cx = (((buf0 >> 14) & 0x07) << 13) |
+		 (((buf1 >> 13) & 0x1f) << 8) |
+		 (((buf2 >> 16) & 0x0f) << 4) |
+		 (jbig2WindowPixel(buf0, buf1, buf2, atRow[0], atShift[0],
+				   bitmap, &atPtr[0]) << 3) |
+		 (jbig2WindowPixel(buf0, buf1, buf2, atRow[1], atShift[1],
+				   bitmap, &atPtr[1]) << 2) |
+		 (jbig2WindowPixel(buf0, buf1, buf2, atRow[2], atShift[2],
+				   bitmap, &atPtr[2]) << 1) |
+		 jbig2WindowPixel(buf0, buf1, buf2, atRow[3], atShift[3],
+				  bitmap, &atPtr[3]);
+	    break;
+	  case 1:
+	    cx = (((buf0 >> 13) & 0x0f) << 9) |
+		 (((buf1 >> 13) & 0x1f) << 4) |
+		 (((buf2 >> 16) & 0x07) << 1) |
+		 jbig2WindowPixel(buf0, buf1, buf2, atRow[0], atShift[0],
+				  bitmap, &atPtr[0]);
+	    break;
+	  case 2:
+	    cx = (((buf0 >> 14) & 0x07) << 7) |
+		 (((buf1 >> 14) & 0x0f) << 3) |
+		 (((buf2 >> 16) & 0x03) << 1) |
+		 jbig2WindowPixel(buf0, buf1, buf2, atRow[0], atShift[0],
+				  bitmap, &atPtr[0]);
+	    break;
+	  case 3:
+	  default:
+	    cx = (((buf1 >> 14) & 0x1f) << 5) |
+		 (((buf2 >> 16) & 0x0f) << 1) |
+		 jbig2WindowPixel(buf0, buf1, buf2, atRow[0], atShift[0],
+				  bitmap, &atPtr[0]);
+	    break;
+	  }
 
-	  // decode the pixel
-	  } else if ((pix = arithDecoder->decodeBit(cx, genericRegionStats))) {
-	    bitmap->setPixel(x, y);
+	  // decode the pixel, unless it is skipped
+	  if (!(skipBuf & 0x8000) &&
+	      arithDecoder->decodeBit(cx, genericRegionStats)) {
+	    out |= mask;
+	    buf2 |= 0x8000;
 	  }
 
 	  // update the context
-	  cx1 = ((cx1 << 1) | bitmap->nextPixel(&cxPtr1)) & 0x1f;
-	  cx2 = ((cx2 << 1) | pix) & 0x0f;
+	  buf0 <<= 1;
+	  buf1 <<= 1;
+	  buf2 <<= 1;
+	  skipBuf <<= 1;
 	}
-	break;
+
+	rowPtr[x0 >> 3] = (Guchar)out;
       }
     }
   }
@@ -3017,21 +3214,16 @@ JBIG2Bitmap *JBIG2Stream::readGenericRefinementRegion(int w, int h,
 						      int *atx, int *aty) {
   JBIG2Bitmap *bitmap;
   GBool ltp;
-  Guint ltpCX, cx, cx0, cx2, cx3, cx4, tpgrCX0, tpgrCX1, tpgrCX2;
-  JBIG2BitmapPtr cxPtr0 = {0, 0, 0};
-  JBIG2BitmapPtr cxPtr1 = {0, 0, 0};
-  JBIG2BitmapPtr cxPtr2 = {0, 0, 0};
-  JBIG2BitmapPtr cxPtr3 = {0, 0, 0};
-  JBIG2BitmapPtr cxPtr4 = {0, 0, 0};
-  JBIG2BitmapPtr cxPtr5 = {0, 0, 0};
-  JBIG2BitmapPtr cxPtr6 = {0, 0, 0};
-  JBIG2BitmapPtr tpgrCXPtr0 = {0, 0, 0};
-  JBIG2BitmapPtr tpgrCXPtr1 = {0, 0, 0};
-  JBIG2BitmapPtr tpgrCXPtr2 = {0, 0, 0};
-  int x, y, pix;
+  Guint ltpCX, cx, tpgrCX0, tpgrCX1, tpgrCX2;
+  Guint buf0, buf1, refBuf0, refBuf1, refBuf2, out, mask;
+  JBIG2BitmapPtr atPtr0 = {0, 0, 0}, atPtr1 = {0, 0, 0};
+  int atRow0, atShift0, atRow1, atShift1;
+  Guchar *refRows, *refRow0, *refRow1, *refRow2, *rowPtr, *p0, *r0, *r1, *r2;
+  int x0, x1, y, n, line, refLine;
 
   bitmap = new JBIG2Bitmap(0, w, h);
   bitmap->clearToZero();
+  line = bitmap->getLineSize();
 
   // set up the typical row context
   if (templ) {
@@ -3040,151 +3232,142 @@ JBIG2Bitmap *JBIG2Stream::readGenericRefinementRegion(int w, int h,
     ltpCX = 0x0010;
   }
 
+  // map the adaptive template pixels onto the row windows: the first
+  // one lives in the region bitmap (row 0 is y-1, row 1 is y), the
+  // second one in the reference bitmap (rows 0-2 are y-1..y+1)
+  atRow0 = atRow1 = -1;
+  atShift0 = atShift1 = 0;
+  if (!templ) {
+    if (aty[0] >= -1 && aty[0] <= 0 && atx[0] >= -16 && atx[0] <= 8) {
+      atRow0 = aty[0] + 1;
+      atShift0 = 15 - atx[0];
+    }
+    if (aty[1] >= -1 && aty[1] <= 1 && atx[1] >= -16 && atx[1] <= 8) {
+      atRow1 = aty[1] + 1;
+      atShift1 = 15 - atx[1];
+    }
+  }
+
+  // the reference rows y-1, y, and y+1 are copied into row buffers
+  // aligned with the region bitmap, with two bytes of left margin and
+  // one byte past the right edge, so their windows can be refilled the
+  // same way as the region rows; each row is extracted only once
+  refLine = line + 3;
+  refRows = (Guchar *)gmallocn(3, refLine);
+  refRow0 = refRows;
+  refRow1 = refRows + refLine;
+  refRow2 = refRows + 2 * refLine;
+  refBitmap->getRowShifted(-1 - refDY, -refDX - 16, refRow1, refLine);
+  refBitmap->getRowShifted(-refDY, -refDX - 16, refRow2, refLine);
+
   ltp = 0;
   for (y = 0; y < h; ++y) {
 
-    if (templ) {
-
-      // set up the context
-      bitmap->getPixelPtr(0, y-1, &cxPtr0);
-      cx0 = bitmap->nextPixel(&cxPtr0);
-      bitmap->getPixelPtr(-1, y, &cxPtr1);
-      refBitmap->getPixelPtr(-refDX, y-1-refDY, &cxPtr2);
-      refBitmap->getPixelPtr(-1-refDX, y-refDY, &cxPtr3);
-      cx3 = refBitmap->nextPixel(&cxPtr3);
-      cx3 = (cx3 << 1) | refBitmap->nextPixel(&cxPtr3);
-      refBitmap->getPixelPtr(-refDX, y+1-refDY, &cxPtr4);
-      cx4 = refBitmap->nextPixel(&cxPtr4);
-
-      // set up the typical prediction context
-      tpgrCX0 = tpgrCX1 = tpgrCX2 = 0; // make gcc happy
-      if (tpgrOn) {
-	refBitmap->getPixelPtr(-1-refDX, y-1-refDY, &tpgrCXPtr0);
-	tpgrCX0 = refBitmap->nextPixel(&tpgrCXPtr0);
-	tpgrCX0 = (tpgrCX0 << 1) | refBitmap->nextPixel(&tpgrCXPtr0);
-	tpgrCX0 = (tpgrCX0 << 1) | refBitmap->nextPixel(&tpgrCXPtr0);
-	refBitmap->getPixelPtr(-1-refDX, y-refDY, &tpgrCXPtr1);
-	tpgrCX1 = refBitmap->nextPixel(&tpgrCXPtr1);
-	tpgrCX1 = (tpgrCX1 << 1) | refBitmap->nextPixel(&tpgrCXPtr1);
-	tpgrCX1 = (tpgrCX1 << 1) | refBitmap->nextPixel(&tpgrCXPtr1);
-	refBitmap->getPixelPtr(-1-refDX, y+1-refDY, &tpgrCXPtr2);
-	tpgrCX2 = refBitmap->nextPixel(&tpgrCXPtr2);
-	tpgrCX2 = (tpgrCX2 << 1) | refBitmap->nextPixel(&tpgrCXPtr2);
-	tpgrCX2 = (tpgrCX2 << 1) | refBitmap->nextPixel(&tpgrCXPtr2);
+    // advance the reference rows
+    r0 = refRow0;
+    refRow0 = refRow1;
+    refRow1 = refRow2;
+    refRow2 = r0;
+    refBitmap->getRowShifted(y + 1 - refDY, -refDX - 16, refRow2, refLine);
+
+    // check for a "typical" row
+    if (tpgrOn) {
+      if (arithDecoder->decodeBit(ltpCX, refinementRegionStats)) {
+	ltp = !ltp;
       }
+    }
 
-      for (x = 0; x < w; ++x) {
-
-	// update the context
-	cx0 = ((cx0 << 1) | bitmap->nextPixel(&cxPtr0)) & 7;
-	cx3 = ((cx3 << 1) | refBitmap->nextPixel(&cxPtr3)) & 7;
-	cx4 = ((cx4 << 1) | refBitmap->nextPixel(&cxPtr4)) & 3;
-
-	if (tpgrOn) {
-	  // update the typical predictor context
-	  tpgrCX0 = ((tpgrCX0 << 1) | refBitmap->nextPixel(&tpgrCXPtr0)) & 7;
-	  tpgrCX1 = ((tpgrCX1 << 1) | refBitmap->nextPixel(&tpgrCXPtr1)) & 7;
-	  tpgrCX2 = ((tpgrCX2 << 1) | refBitmap->nextPixel(&tpgrCXPtr2)) & 7;
-
-	  // check for a "typical" pixel
-	  if (arithDecoder->decodeBit(ltpCX, refinementRegionStats)) {
-	    ltp = !ltp;
-	  }
-	  if (tpgrCX0 == 0 && tpgrCX1 == 0 && tpgrCX2 == 0) {
-	    bitmap->clearPixel(x, y);
-	    continue;
-	  } else if (tpgrCX0 == 7 && tpgrCX1 == 7 && tpgrCX2 == 7) {
-	    bitmap->setPixel(x, y);
-	    continue;
-	  }
-	}
-
-	// build the context
-	cx = (cx0 << 7) | (bitmap->nextPixel(&cxPtr1) << 6) |
-	     (refBitmap->nextPixel(&cxPtr2) << 5) |
-	     (cx3 << 2) | cx4;
-
-	// decode the pixel
-	if ((pix = arithDecoder->decodeBit(cx, refinementRegionStats))) {
-	  bitmap->setPixel(x, y);
-	}
-      }
+    // a zero-width region has no pixels (and no bitmap data)
+    if (line <= 0) {
+      continue;
+    }
 
+    // set up the row windows
+    rowPtr = bitmap->getDataPtr() + y * line;
+    if (y >= 1) {
+      p0 = rowPtr - line;
+      buf0 = *p0++ << 8;
     } else {
-
-      // set up the context
-      bitmap->getPixelPtr(0, y-1, &cxPtr0);
-      cx0 = bitmap->nextPixel(&cxPtr0);
-      bitmap->getPixelPtr(-1, y, &cxPtr1);
-      refBitmap->getPixelPtr(-refDX, y-1-refDY, &cxPtr2);
-      cx2 = refBitmap->nextPixel(&cxPtr2);
-      refBitmap->getPixelPtr(-1-refDX, y-refDY, &cxPtr3);
-      cx3 = refBitmap->nextPixel(&cxPtr3);
-      cx3 = (cx3 << 1) | refBitmap->nextPixel(&cxPtr3);
-      refBitmap->getPixelPtr(-1-refDX, y+1-refDY, &cxPtr4);
-      cx4 = refBitmap->nextPixel(&cxPtr4);
-      cx4 = (cx4 << 1) | refBitmap->nextPixel(&cxPtr4);
-      bitmap->getPixelPtr(atx[0], y+aty[0], &cxPtr5);
-      refBitmap->getPixelPtr(atx[1]-refDX, y+aty[1]-refDY, &cxPtr6);
-
-      // set up the typical prediction context
-      tpgrCX0 = tpgrCX1 = tpgrCX2 = 0; // make gcc happy
-      if (tpgrOn) {
-	refBitmap->getPixelPtr(-1-refDX, y-1-refDY, &tpgrCXPtr0);
-	tpgrCX0 = refBitmap->nextPixel(&tpgrCXPtr0);
-	tpgrCX0 = (tpgrCX0 << 1) | refBitmap->nextPixel(&tpgrCXPtr0);
-	tpgrCX0 = (tpgrCX0 << 1) | refBitmap->nextPixel(&tpgrCXPtr0);
-	refBitmap->getPixelPtr(-1-refDX, y-refDY, &tpgrCXPtr1);
-	tpgrCX1 = refBitmap->nextPixel(&tpgrCXPtr1);
-	tpgrCX1 = (tpgrCX1 << 1) | refBitmap->nextPixel(&tpgrCXPtr1);
-	tpgrCX1 = (tpgrCX1 << 1) | refBitmap->nextPixel(&tpgrCXPtr1);
-	refBitmap->getPixelPtr(-1-refDX, y+1-refDY, &tpgrCXPtr2);
-	tpgrCX2 = refBitmap->nextPixel(&tpgrCXPtr2);
-	tpgrCX2 = (tpgrCX2 << 1) | refBitmap->nextPixel(&tpgrCXPtr2);
-	tpgrCX2 = (tpgrCX2 << 1) | refBitmap->nextPixel(&tpgrCXPtr2);
+      p0 = NULL;
+      buf0 = 0;
+    }
+    buf1 = 0;
+    r0 = refRow0;
+    r1 = refRow1;
+    r2 = refRow2;
+    refBuf0 = (r0[0] << 24) | (r0[1] << 16) | (r0[2] << 8);
+    refBuf1 = (r1[0] << 24) | (r1[1] << 16) | (r1[2] << 8);
+    refBuf2 = (r2[0] << 24) | (r2[1] << 16) | (r2[2] << 8);
+    r0 += 3;
+    r1 += 3;
+    r2 += 3;
+    if (atRow0 < 0 && !templ) {
+      bitmap->getPixelPtr(atx[0], y + aty[0], &atPtr0);
+    }
+    if (atRow1 < 0 && !templ) {
+      refBitmap->getPixelPtr(atx[1] - refDX, y + aty[1] - refDY, &atPtr1);
+    }
+
+    // decode the row, one output byte at a time
+    for (x0 = 0; x0 < w; x0 += 8) {
+
+      // shift the next byte of each reference row into its window
+      if (p0 && x0 + 8 < w) {
+	buf0 |= *p0++;
       }
+      refBuf0 |= *r0++;
+      refBuf1 |= *r1++;
+      refBuf2 |= *r2++;
+      n = w - x0 < 8 ? w - x0 : 8;
+      out = 0;
 
-      for (x = 0; x < w; ++x) {
+      for (x1 = 0, mask = 0x80; x1 < n; ++x1, mask >>= 1) {
 
-	// update the context
-	cx0 = ((cx0 << 1) | bitmap->nextPixel(&cxPtr0)) & 3;
-	cx2 = ((cx2 << 1) | refBitmap->nextPixel(&cxPtr2)) & 3;
-	cx3 = ((cx3 << 1) | refBitmap->nextPixel(&cxPtr3)) & 7;
-	cx4 = ((cx4 << 1) | refBitmap->nextPixel(&cxPtr4)) & 7;
-
-	if (tpgrOn) {
-	  // update the typical predictor context
-	  tpgrCX0 = ((tpgrCX0 << 1) | refBitmap->nextPixel(&tpgrCXPtr0)) & 7;
-	  tpgrCX1 = ((tpgrCX1 << 1) | refBitmap->nextPixel(&tpgrCXPtr1)) & 7;
-	  tpgrCX2 = ((tpgrCX2 << 1) | refBitmap->nextPixel(&tpgrCXPtr2)) & 7;
-
-	  // check for a "typical" pixel
-	  if (arithDecoder->decodeBit(ltpCX, refinementRegionStats)) {
-	    ltp = !ltp;
-	  }
-	  if (tpgrCX0 == 0 && tpgrCX1 == 0 && tpgrCX2 == 0) {
-	    bitmap->clearPixel(x, y);
-	    continue;
-	  } else if (tpgrCX0 == 7 && tpgrCX1 == 7 && tpgrCX2 == 7) {
-	    bitmap->setPixel(x, y);
-	    continue;
-	  }
+	// build the context
+	if (templ) {
+	  cx = (((buf0 >> 14) & 7) << 7) |
+	       (((buf1 >> 16) & 1) << 6) |
+	       (((refBuf0 >> 15) & 1) << 5) |
+	       (((refBuf1 >> 14) & 7) << 2) |
+	       ((refBuf2 >> 14) & 3);
+	} else {
+	  cx = (((buf0 >> 14) & 3) << 11) |
+	       (((buf1 >> 16) & 1) << 10) |
+	       (((refBuf0 >> 14) & 3) << 8) |
+	       (((refBuf1 >> 14) & 7) << 5) |
+	       (((refBuf2 >> 14) & 7) << 2) |
+	       (jbig2WindowPixel(buf0, buf1, 0, atRow0, atShift0,
+				 bitmap, &atPtr0) << 1) |
+	       jbig2WindowPixel(refBuf0, refBuf1, refBuf2, atRow1, atShift1,
+				refBitmap, &atPtr1);
 	}
 
-	// build the context
-	cx = (cx0 << 11) | (bitmap->nextPixel(&cxPtr1) << 10) |
-	     (cx2 << 8) | (cx3 << 5) | (cx4 << 2) |
-	     (bitmap->nextPixel(&cxPtr5) << 1) |
-	     refBitmap->nextPixel(&cxPtr6);
-
-	// decode the pixel
-	if ((pix = arithDecoder->decodeBit(cx, refinementRegionStats))) {
-	  bitmap->setPixel(x, y);
+	// check for a "typical" pixel, otherwise decode it
+	tpgrCX0 = (refBuf0 >> 14) & 7;
+	tpgrCX1 = (refBuf1 >> 14) & 7;
+	tpgrCX2 = (refBuf2 >> 14) & 7;
+	if (ltp && tpgrCX0 == 0 && tpgrCX1 == 0 && tpgrCX2 == 0) {
+	  // leave the pixel clear
+	} else if ((ltp && tpgrCX0 == 7 && tpgrCX1 == 7 && tpgrCX2 == 7) ||
+		   arithDecoder->decodeBit(cx, refinementRegionStats)) {
+	  out |= mask;
+	  buf1 |= 0x8000;
 	}
+
+	// update the context
+	buf0 <<= 1;
+	buf1 <<= 1;
+	refBuf0 <<= 1;
+	refBuf1 <<= 1;
+	refBuf2 <<= 1;
       }
+
+      rowPtr[x0 >> 3] = (Guchar)out;
     }
   }
 
+  gfree(refRows);
+
   return bitmap;
 }
 
@@ -3334,10 +3517,11 @@ void JBIG2Stream::discardSegment(Guint segNum) {
   JBIG2Segment *seg;
   int i;
 
+  // global segments may be shared with other streams, so they are
+  // left alone
   for (i = 0; i < globalSegments->getLength(); ++i) {
     seg = (JBIG2Segment *)globalSegments->get(i);
     if (seg->getSegNum() == segNum) {
-      globalSegments->del(i);
       return;
     }
   }
@@ -14,11 +14,15 @@
 #endif
 
 #include "goo/gtypes.h"
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
 #include "Object.h"
 #include "Stream.h"
 
 class GooList;
 class JBIG2Segment;
+class JBIG2Globals;
 class JBIG2Bitmap;
 class JArithmeticDecoder;
 class JArithmeticDecoderStats;
@@ -26,12 +30,45 @@ class JBIG2HuffmanDecoder;
 struct JBIG2HuffmanTable;
 class JBIG2MMRDecoder;
 
+//------------------------------------------------------------------------
+// JBIG2GlobalsCache
+//------------------------------------------------------------------------
+
+// Decoded JBIG2Globals segments, keyed by the globals stream ref.  One
+// cache is kept per document (by the XRef), so the symbol dictionaries,
+// pattern dictionaries, and code tables shared by the pages of a JBIG2
+// document are only decoded once.
+class JBIG2GlobalsCache {
+public:
+
+  JBIG2GlobalsCache();
+  ~JBIG2GlobalsCache();
+
+  // Return the segments decoded from the globals stream <ref>, with an
+  // added reference, or NULL if they are not cached.
+  JBIG2Globals *lookup(Ref ref);
+
+  // Add the segments decoded from the globals stream <ref>.
+  void add(Ref ref, JBIG2Globals *globals);
+
+private:
+
+  GooList *entries;		// [JBIG2GlobalsCacheEntry]
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+};
+
+//------------------------------------------------------------------------
+// JBIG2Stream
 //------------------------------------------------------------------------
 
 class JBIG2Stream: public FilterStream {
 public:
 
-  JBIG2Stream(Stream *strA, Object *globalsStreamA);
+  JBIG2Stream(Stream *strA, Object *globalsStreamA,
+	      Object *globalsStreamRefA = NULL,
+	      JBIG2GlobalsCache *globalsCacheA = NULL);
   virtual ~JBIG2Stream();
   virtual StreamKind getKind() { return strJBIG2; }
   virtual void reset();
@@ -109,12 +146,15 @@ private:
   GBool readLong(int *x);
 
   Object globalsStream;
+  Object globalsStreamRef;
+  JBIG2GlobalsCache *globalsCache;
+  JBIG2Globals *globals;	// decoded global segments (shared)
   Guint pageW, pageH, curPageH;
   Guint pageDefPixel;
   JBIG2Bitmap *pageBitmap;
   Guint defCombOp;
   GooList *segments;		// [JBIG2Segment]
-  GooList *globalSegments;	// [JBIG2Segment]
+  GooList *globalSegments;	// [JBIG2Segment], owned by <globals>
   Stream *curStr;
   Guchar *dataPtr;
   Guchar *dataEnd;
@@ -161,6 +161,9 @@ static Guint signContext[5][5][2] = {
 // point arithmetic used in the IDWT
 #define fracBits 16
 
+// max number of resolution levels dropped for reduced-size output
+#define jpxMaxReduction 5
+
 //------------------------------------------------------------------------
 
 // floor(x / y)
@@ -246,6 +249,10 @@ JPXStream::JPXStream(Stream *strA):
   bitBufLen = 0;
   bitBufSkip = gFalse;
   byteCount = 0;
+
+  reduction = 0;
+  grayOut = gFalse;
+  outWidth = outHeight = 0;
 }
 
 JPXStream::~JPXStream() {
@@ -256,12 +263,13 @@ JPXStream::~JPXStream() {
 void JPXStream::reset() {
   str->reset();
   if (readBoxes()) {
-    curY = img.yOffset;
+    outWidth = jpxCeilDivPow2(img.xSize - img.xOffset, reduction);
+    outHeight = jpxCeilDivPow2(img.ySize - img.yOffset, reduction);
   } else {
     // readBoxes reported an error, so we go immediately to EOF
-    curY = img.ySize;
+    outWidth = outHeight = 0;
   }
-  curX = img.xOffset;
+  curX = curY = 0;
   curComp = 0;
   readBufLen = 0;
 }
@@ -387,27 +395,38 @@ int JPXStream::lookChar() {
 }
 
 void JPXStream::fillReadBuf() {
+  JPXTile *tile;
   JPXTileComp *tileComp;
-  Guint tileIdx, tx, ty;
+  Guint tileIdx, x, y;
   int pix, pixBits;
 
   do {
-    if (curY >= img.ySize) {
+    if (curY >= outHeight) {
       return;
     }
-    tileIdx = ((curY - img.yTileOffset) / img.yTileSize) * img.nXTiles
-              + (curX - img.xTileOffset) / img.xTileSize;
+    // position on the reference grid
+    x = img.xOffset + (curX << reduction);
+    y = img.yOffset + (curY << reduction);
+    tileIdx = ((y - img.yTileOffset) / img.yTileSize) * img.nXTiles
+              + (x - img.xTileOffset) / img.xTileSize;
+    tile = &img.tiles[tileIdx];
+    if (grayOut && !tile->lumaOnly && img.nComps >= 3) {
+      // no luminance component in the codestream -- convert here
+      pix = (getTileCompPixel(&tile->tileComps[0], x, y) * 77 +
+	     getTileCompPixel(&tile->tileComps[1], x, y) * 151 +
+	     getTileCompPixel(&tile->tileComps[2], x, y) * 28) >> 8;
+      pixBits = tile->tileComps[0].prec;
+    } else {
 #if 1 //~ ignore the palette, assume the PDF ColorSpace object is valid
-    tileComp = &img.tiles[tileIdx].tileComps[curComp];
+      tileComp = &tile->tileComps[curComp];
 #else
-    tileComp = &img.tiles[tileIdx].tileComps[havePalette ? 0 : curComp];
+      tileComp = &tile->tileComps[havePalette ? 0 : curComp];
 #endif
-    tx = jpxCeilDiv((curX - img.xTileOffset) % img.xTileSize, tileComp->hSep);
-    ty = jpxCeilDiv((curY - img.yTileOffset) % img.yTileSize, tileComp->vSep);
-    pix = (int)tileComp->data[ty * (tileComp->x1 - tileComp->x0) + tx];
-    pixBits = tileComp->prec;
+      pix = getTileCompPixel(tileComp, x, y);
+      pixBits = tileComp->prec;
+    }
 #if 1 //~ ignore the palette, assume the PDF ColorSpace object is valid
-    if (++curComp == img.nComps) {
+    if (++curComp == (grayOut ? 1 : img.nComps)) {
 #else
     if (havePalette) {
       if (pix >= 0 && pix < palette.nEntries) {
@@ -419,8 +438,8 @@ void JPXStream::fillReadBuf() {
     if (++curComp == (Guint)(havePalette ? palette.nComps : img.nComps)) {
 #endif
       curComp = 0;
-      if (++curX == img.xSize) {
-	curX = img.xOffset;
+      if (++curX == outWidth) {
+	curX = 0;
 	++curY;
       }
     }
@@ -433,6 +452,23 @@ void JPXStream::fillReadBuf() {
   } while (readBufLen < 8);
 }
 
+// Get the sample of <tileComp> at reference grid position (<x>, <y>).
+int JPXStream::getTileCompPixel(JPXTileComp *tileComp, Guint x, Guint y) {
+  Guint tx, ty;
+
+  tx = jpxCeilDiv((x - img.xTileOffset) % img.xTileSize, tileComp->hSep)
+       >> tileComp->reduction;
+  ty = jpxCeilDiv((y - img.yTileOffset) % img.yTileSize, tileComp->vSep)
+       >> tileComp->reduction;
+  if (tx >= tileComp->w) {
+    tx = tileComp->w - 1;
+  }
+  if (ty >= tileComp->h) {
+    ty = tileComp->h - 1;
+  }
+  return tileComp->data[ty * tileComp->w + tx];
+}
+
 GooString *JPXStream::getPSFilter(int psLevel, const char *indent) {
   return NULL;
 }
@@ -441,6 +477,21 @@ GBool JPXStream::isBinary(GBool last) {
   return str->isBinary(gTrue);
 }
 
+void JPXStream::setReducedDecode(int minWidth, int minHeight,
+				 int *widthA, int *heightA, GBool *grayA) {
+  // each dropped resolution level halves the image; components with
+  // fewer decomposition levels than this are subsampled instead
+  reduction = 0;
+  while (reduction < jpxMaxReduction &&
+	 jpxCeilDivPow2(*widthA, reduction + 1) >= minWidth &&
+	 jpxCeilDivPow2(*heightA, reduction + 1) >= minHeight) {
+    ++reduction;
+  }
+  *widthA = jpxCeilDivPow2(*widthA, reduction);
+  *heightA = jpxCeilDivPow2(*heightA, reduction);
+  grayOut = *grayA;
+}
+
 void JPXStream::getImageParams(int *bitsPerComponent,
 			       StreamColorSpaceMode *csMode) {
   Guint boxType, boxLen, dataLen, csEnum;
@@ -1369,7 +1420,7 @@ GBool JPXStream::readCodestream(Guint len) {
   //----- finish decoding the image
   for (i = 0; i < img.nXTiles * img.nYTiles; ++i) {
     tile = &img.tiles[i];
-    for (comp = 0; comp < img.nComps; ++comp) {
+    for (comp = 0; comp < (tile->lumaOnly ? 1 : img.nComps); ++comp) {
       tileComp = &tile->tileComps[comp];
       inverseTransform(tileComp);
     }
@@ -1394,7 +1445,7 @@ GBool JPXStream::readTilePart() {
   Guint tileIdx, tilePartLen, tilePartIdx, nTileParts;
   GBool tilePartToEOC;
   Guint precinctSize, style;
-  Guint n, nSBs, nx, ny, sbx0, sby0, comp, segLen;
+  Guint n, nSBs, nx, ny, sbx0, sby0, comp, segLen, tileReduction;
   Guint i, j, k, cbX, cbY, r, pre, sb, cbi;
   int segType, level;
 
@@ -1764,6 +1815,17 @@ GBool JPXStream::readTilePart() {
     tile->precinct = 0;
     tile->layer = 0;
     tile->maxNDecompLevels = 0;
+    // with the irreversible/reversible color transform, component 0
+    // is the luminance, so gray output doesn't need the other two
+    tile->lumaOnly = grayOut && tile->multiComp == 1 && img.nComps >= 3;
+    // all components are reduced by the same amount, so that the
+    // multi-component transform still sees matching samples
+    tileReduction = reduction;
+    for (comp = 0; comp < img.nComps; ++comp) {
+      if (tile->tileComps[comp].nDecompLevels < tileReduction) {
+	tileReduction = tile->tileComps[comp].nDecompLevels;
+      }
+    }
     for (comp = 0; comp < img.nComps; ++comp) {
       tileComp = &tile->tileComps[comp];
       if (tileComp->nDecompLevels > tile->maxNDecompLevels) {
@@ -1775,15 +1837,21 @@ GBool JPXStream::readTilePart() {
       tileComp->y1 = jpxCeilDiv(tile->y1, tileComp->hSep);
       tileComp->cbW = 1 << tileComp->codeBlockW;
       tileComp->cbH = 1 << tileComp->codeBlockH;
-      tileComp->data = (int *)gmallocn((tileComp->x1 - tileComp->x0) *
-				       (tileComp->y1 - tileComp->y0),
-				       sizeof(int));
-      if (tileComp->x1 - tileComp->x0 > tileComp->y1 - tileComp->y0) {
-	n = tileComp->x1 - tileComp->x0;
-      } else {
-	n = tileComp->y1 - tileComp->y0;
+      tileComp->reduction = tileReduction;
+      tileComp->w = jpxCeilDivPow2(tileComp->x1, tileComp->reduction) -
+	            jpxCeilDivPow2(tileComp->x0, tileComp->reduction);
+      tileComp->h = jpxCeilDivPow2(tileComp->y1, tileComp->reduction) -
+	            jpxCeilDivPow2(tileComp->y0, tileComp->reduction);
+      if (!(tile->lumaOnly && comp > 0)) {
+	tileComp->data = (int *)gmallocn(tileComp->w * tileComp->h,
+					 sizeof(int));
+	if (tileComp->w > tileComp->h) {
+	  n = tileComp->w;
+	} else {
+	  n = tileComp->h;
+	}
+	tileComp->buf = (int *)gmallocn(n + 8, sizeof(int));
       }
-      tileComp->buf = (int *)gmallocn(n + 8, sizeof(int));
       for (r = 0; r <= tileComp->nDecompLevels; ++r) {
 	resLevel = &tileComp->resLevels[r];
 	k = r == 0 ? tileComp->nDecompLevels
@@ -1884,17 +1952,21 @@ GBool JPXStream::readTilePart() {
 		cb->lBlock = 3;
 		cb->nextPass = jpxPassCleanup;
 		cb->nZeroBitPlanes = 0;
-		cb->coeffs =
-		    (JPXCoeff *)gmallocn((1 << (tileComp->codeBlockW
-						+ tileComp->codeBlockH)),
-					 sizeof(JPXCoeff));
-		for (cbi = 0;
-		     cbi < (Guint)(1 << (tileComp->codeBlockW
-					 + tileComp->codeBlockH));
-		     ++cbi) {
-		  cb->coeffs[cbi].flags = 0;
-		  cb->coeffs[cbi].len = 0;
-		  cb->coeffs[cbi].mag = 0;
+		if (isSkippedLevel(tile, comp, r)) {
+		  cb->coeffs = NULL;
+		} else {
+		  cb->coeffs =
+		      (JPXCoeff *)gmallocn((1 << (tileComp->codeBlockW
+						  + tileComp->codeBlockH)),
+					   sizeof(JPXCoeff));
+		  for (cbi = 0;
+		       cbi < (Guint)(1 << (tileComp->codeBlockW
+					   + tileComp->codeBlockH));
+		       ++cbi) {
+		    cb->coeffs[cbi].flags = 0;
+		    cb->coeffs[cbi].len = 0;
+		    cb->coeffs[cbi].mag = 0;
+		  }
 		}
 		cb->arithDecoder = NULL;
 		cb->stats = NULL;
@@ -2122,8 +2194,15 @@ GBool JPXStream::readTilePartData(Guint tileIdx,
 	for (cbX = 0; cbX < subband->nXCBs; ++cbX) {
 	  cb = &subband->cbs[cbY * subband->nXCBs + cbX];
 	  if (cb->included) {
-	    if (!readCodeBlockData(tileComp, resLevel, precinct, subband,
-				   tile->res, sb, cb)) {
+	    if (isSkippedLevel(tile, tile->comp, tile->res)) {
+	      // not needed for the requested output
+	      for (i = 0; i < cb->dataLen; ++i) {
+		if (str->getChar() == EOF) {
+		  break;
+		}
+	      }
+	    } else if (!readCodeBlockData(tileComp, resLevel, precinct,
+					  subband, tile->res, sb, cb)) {
 	      return gFalse;
 	    }
 	    tilePartLen -= cb->dataLen;
@@ -2575,8 +2654,7 @@ void JPXStream::inverseTransform(JPXTileComp *tileComp) {
       for (y = cb->y0, coeff0 = cb->coeffs;
 	   y < cb->y1;
 	   ++y, coeff0 += tileComp->cbW) {
-	dataPtr = &tileComp->data[(y - subband->y0)
-				  * (tileComp->x1 - tileComp->x0)
+	dataPtr = &tileComp->data[(y - subband->y0) * tileComp->w
 				  + (cb->x0 - subband->x0)];
 	for (x = cb->x0, coeff = coeff0; x < cb->x1; ++x, ++coeff) {
 	  val = (int)coeff->mag;
@@ -2611,9 +2689,9 @@ void JPXStream::inverseTransform(JPXTileComp *tileComp) {
     }
   }
 
-  //----- IDWT for each level
+  //----- IDWT for each level (stopping early for reduced output)
 
-  for (r = 1; r <= tileComp->nDecompLevels; ++r) {
+  for (r = 1; r <= tileComp->nDecompLevels - tileComp->reduction; ++r) {
     resLevel = &tileComp->resLevels[r];
 
     // (n)LL is already in the upper-left corner of the
@@ -2663,9 +2741,8 @@ void JPXStream::inverseTransformLevel(JPXTileComp *tileComp,
   // spread out LL
   for (yy = resLevel->y1 - 1; yy >= (int)resLevel->y0; --yy) {
     for (xx = resLevel->x1 - 1; xx >= (int)resLevel->x0; --xx) {
-      tileComp->data[(2 * yy - ny0) * (tileComp->x1 - tileComp->x0)
-		     + (2 * xx - nx0)] =
-	  tileComp->data[(yy - resLevel->y0) * (tileComp->x1 - tileComp->x0)
+      tileComp->data[(2 * yy - ny0) * tileComp->w + (2 * xx - nx0)] =
+	  tileComp->data[(yy - resLevel->y0) * tileComp->w
 			 + (xx - resLevel->x0)];
     }
   }
@@ -2710,8 +2787,7 @@ void JPXStream::inverseTransformLevel(JPXTileComp *tileComp,
 	for (y = cb->y0, coeff0 = cb->coeffs;
 	     y < cb->y1;
 	     ++y, coeff0 += tileComp->cbW) {
-	  dataPtr = &tileComp->data[(2 * y + yo - ny0)
-				    * (tileComp->x1 - tileComp->x0)
+	  dataPtr = &tileComp->data[(2 * y + yo - ny0) * tileComp->w
 				    + (2 * cb->x0 + xo - nx0)];
 	  for (x = cb->x0, coeff = coeff0; x < cb->x1; ++x, ++coeff) {
 	    val = (int)coeff->mag;
@@ -2751,14 +2827,13 @@ void JPXStream::inverseTransformLevel(JPXTileComp *tileComp,
   dataPtr = tileComp->data;
   for (y = 0; y < ny1 - ny0; ++y) {
     inverseTransform1D(tileComp, dataPtr, 1, nx0, nx1);
-    dataPtr += tileComp->x1 - tileComp->x0;
+    dataPtr += tileComp->w;
   }
 
   //----- vertical (column) transforms
   dataPtr = tileComp->data;
   for (x = 0; x < nx1 - nx0; ++x) {
-    inverseTransform1D(tileComp, dataPtr,
-		       tileComp->x1 - tileComp->x0, ny0, ny1);
+    inverseTransform1D(tileComp, dataPtr, tileComp->w, ny0, ny1);
     ++dataPtr;
   }
 }
@@ -2887,7 +2962,7 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
 
   //----- inverse multi-component transform
 
-  if (tile->multiComp == 1) {
+  if (tile->multiComp == 1 && !tile->lumaOnly) {
     cover(86);
     if (img.nComps < 3 ||
 	tile->tileComps[0].hSep != tile->tileComps[1].hSep ||
@@ -2901,8 +2976,8 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
     if (tile->tileComps[0].transform == 0) {
       cover(87);
       j = 0;
-      for (y = 0; y < tile->tileComps[0].y1 - tile->tileComps[0].y0; ++y) {
-	for (x = 0; x < tile->tileComps[0].x1 - tile->tileComps[0].x0; ++x) {
+      for (y = 0; y < tile->tileComps[0].h; ++y) {
+	for (x = 0; x < tile->tileComps[0].w; ++x) {
 	  d0 = tile->tileComps[0].data[j];
 	  d1 = tile->tileComps[1].data[j];
 	  d2 = tile->tileComps[2].data[j];
@@ -2918,8 +2993,8 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
     } else {
       cover(88);
       j = 0;
-      for (y = 0; y < tile->tileComps[0].y1 - tile->tileComps[0].y0; ++y) {
-	for (x = 0; x < tile->tileComps[0].x1 - tile->tileComps[0].x0; ++x) {
+      for (y = 0; y < tile->tileComps[0].h; ++y) {
+	for (x = 0; x < tile->tileComps[0].w; ++x) {
 	  d0 = tile->tileComps[0].data[j];
 	  d1 = tile->tileComps[1].data[j];
 	  d2 = tile->tileComps[2].data[j];
@@ -2933,7 +3008,7 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
   }
 
   //----- DC level shift
-  for (comp = 0; comp < img.nComps; ++comp) {
+  for (comp = 0; comp < (tile->lumaOnly ? 1 : img.nComps); ++comp) {
     tileComp = &tile->tileComps[comp];
 
     // signed: clip
@@ -2942,8 +3017,8 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
       minVal = -(1 << (tileComp->prec - 1));
       maxVal = (1 << (tileComp->prec - 1)) - 1;
       dataPtr = tileComp->data;
-      for (y = 0; y < tileComp->y1 - tileComp->y0; ++y) {
-	for (x = 0; x < tileComp->x1 - tileComp->x0; ++x) {
+      for (y = 0; y < tileComp->h; ++y) {
+	for (x = 0; x < tileComp->w; ++x) {
 	  coeff = *dataPtr;
 	  if (tileComp->transform == 0) {
 	    cover(109);
@@ -2966,8 +3041,8 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
       maxVal = (1 << tileComp->prec) - 1;
       zeroVal = 1 << (tileComp->prec - 1);
       dataPtr = tileComp->data;
-      for (y = 0; y < tileComp->y1 - tileComp->y0; ++y) {
-	for (x = 0; x < tileComp->x1 - tileComp->x0; ++x) {
+      for (y = 0; y < tileComp->h; ++y) {
+	for (x = 0; x < tileComp->w; ++x) {
 	  coeff = *dataPtr;
 	  if (tileComp->transform == 0) {
 	    cover(112);
@@ -214,6 +214,10 @@ struct JPXTileComp {
   Guint x0, y0, x1, y1;		// bounds of the tile-comp, in ref coords
   Guint cbW;			// code-block width
   Guint cbH;			// code-block height
+  Guint reduction;		// number of resolution levels that are
+				//   not decoded
+  Guint w, h;			// size of the decoded data (this is also
+				//   the row stride of data)
 
   //----- image data
   int *data;			// the decoded image data
@@ -237,6 +241,7 @@ struct JPXTile {
   Guint x0, y0, x1, y1;		// bounds of the tile, in ref coords
   Guint maxNDecompLevels;	// max number of decomposition levels used
 				//   in any component in this tile
+  GBool lumaOnly;		// decode only the luminance component
 
   //----- progression order loop counters
   Guint comp;			//   component
@@ -283,6 +288,8 @@ public:
   virtual GBool isBinary(GBool last = gTrue);
   virtual void getImageParams(int *bitsPerComponent,
 			      StreamColorSpaceMode *csMode);
+  virtual void setReducedDecode(int minWidth, int minHeight,
+				int *widthA, int *heightA, GBool *grayA);
 
 private:
 
@@ -309,6 +316,11 @@ private:
 			  int *data, Guint stride,
 			  Guint i0, Guint i1);
   GBool inverseMultiCompAndDC(JPXTile *tile);
+  int getTileCompPixel(JPXTileComp *tileComp, Guint x, Guint y);
+  GBool isSkippedLevel(JPXTile *tile, Guint comp, Guint r)
+    { return r > tile->tileComps[comp].nDecompLevels -
+	         tile->tileComps[comp].reduction ||
+	     (tile->lumaOnly && comp > 0); }
   GBool readBoxHdr(Guint *boxType, Guint *boxLen, Guint *dataLen);
   int readMarkerHdr(int *segType, Guint *segLen);
   GBool readUByte(Guint *x);
@@ -341,7 +353,11 @@ private:
 				//   (for bit stuffing)
   Guint byteCount;		// number of available bytes left
 
-  Guint curX, curY, curComp;	// current position for lookChar/getChar
+  Guint reduction;		// number of resolution levels to drop
+  GBool grayOut;		// produce one gray component per pixel
+  Guint outWidth, outHeight;	// size of the (reduced) output image
+  Guint curX, curY, curComp;	// current position for lookChar/getChar,
+				//   in output image coordinates
   Guint readBuf;		// read buffer
   Guint readBufLen;		// number of valid bits in readBuf
 };
@@ -408,7 +408,7 @@ Object *Lexer::getObj(Object *obj, int objNum) {
   case ']':
     tokBuf[0] = c;
     tokBuf[1] = '\0';
-    obj->initCmd(tokBuf);
+    obj->initCmd(tokBuf, 1);
     break;
 
   // hex string or dict punctuation
@@ -420,7 +420,7 @@ Object *Lexer::getObj(Object *obj, int objNum) {
       getChar();
       tokBuf[0] = tokBuf[1] = '<';
       tokBuf[2] = '\0';
-      obj->initCmd(tokBuf);
+      obj->initCmd(tokBuf, 2);
 
     // hex string
     } else {
@@ -478,7 +478,7 @@ Object *Lexer::getObj(Object *obj, int objNum) {
       getChar();
       tokBuf[0] = tokBuf[1] = '>';
       tokBuf[2] = '\0';
-      obj->initCmd(tokBuf);
+      obj->initCmd(tokBuf, 2);
     } else {
       error(getPos(), "Illegal character '>'");
       obj->initError();
@@ -514,7 +514,7 @@ Object *Lexer::getObj(Object *obj, int objNum) {
     } else if (tokBuf[0] == 'n' && !strcmp(tokBuf, "null")) {
       obj->initNull();
     } else {
-      obj->initCmd(tokBuf);
+      obj->initCmd(tokBuf, n);
     }
     break;
   }
@@ -15,26 +15,30 @@
 
 #include "CharTypes.h"
 
-struct NameToCharCodeEntry;
+class GooStrHash;
 
 //------------------------------------------------------------------------
 
 class NameToCharCode {
 public:
 
-  NameToCharCode();
+  // <sizeHint> is the expected number of names.
+  NameToCharCode(int sizeHint = 0);
   ~NameToCharCode();
 
+  // Add a mapping, replacing any earlier one for <name>.  <name> is
+  // copied.
   void add(const char *name, CharCode c);
+
+  // Same, but <name> is referenced in place and must outlive this
+  // object (e.g., an entry in a built-in table).
+  void addStatic(const char *name, CharCode c);
+
   CharCode lookup(char *name);
 
 private:
 
-  int hash(const char *name);
-
-  NameToCharCodeEntry *tab;
-  int size;
-  int len;
+  GooStrHash *tab;
 };
 
 #endif
@@ -13,6 +13,7 @@
 #endif
 
 #include <stddef.h>
+#include "goo/GooStrHash.h"
 #include "Object.h"
 #include "Array.h"
 #include "Dict.h"
@@ -20,6 +21,221 @@
 #include "Stream.h"
 #include "XRef.h"
 
+//------------------------------------------------------------------------
+// command table
+//------------------------------------------------------------------------
+
+const char objCmdNames[objNumCmds][objCmdSlotSize] = {
+  "\"", "'", "B", "B*", "BDC", "BI", "BMC", "BT",
+  "BX", "CS", "DP", "Do", "EI", "EMC", "ET", "EX",
+  "F", "G", "ID", "J", "K", "M", "MP", "Q",
+  "RG", "S", "SC", "SCN", "T*", "TD", "TJ", "TL",
+  "Tc", "Td", "Tf", "Tj", "Tm", "Tr", "Ts", "Tw",
+  "Tz", "W", "W*", "b", "b*", "c", "cm", "cs",
+  "d", "d0", "d1", "f", "f*", "g", "gs", "h",
+  "i", "j", "k", "l", "m", "n", "q", "re",
+  "rg", "ri", "s", "sc", "scn", "sh", "v", "w",
+  "y", "[", "]", "<<", ">>", "R", "obj"
+};
+
+// Perfect hash for objCmdNames: the (up to three) characters of a
+// command are packed into an integer, which is hashed by
+// multiplication; the top eight bits of the product index
+// objCmdHash.  The multiplier was found by searching for one that
+// gives no collisions among the names above -- it has to be searched
+// for again if the table changes.
+#define objCmdHashMul 0x9b3ed083U
+
+static const signed char objCmdHash[256] = {
+  -1, -1, -1, -1, -1, -1,  2, 67, -1, 45, -1, -1, -1, -1, 17, -1,
+  42, 55, -1, -1, -1, -1, -1, -1, 30, 60, -1, 75, -1, -1, 23, -1,
+  -1, -1, -1, 39, -1, 24, -1, -1, 38, 52, 71, -1, -1, -1, -1, 73,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 32, -1, -1, 28, -1,
+  47, 69, -1, -1, -1, -1, -1,  4, 57, -1, -1, -1, -1, 27, 13, -1,
+  -1, -1, -1, 22,  3, 25, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  72, -1, -1, -1, -1, 74, -1, 64, -1, -1, -1, 49, -1, -1, 43, 15,
+  -1, -1, -1, 16, 14, -1, 53, -1, -1, 11, 33, 20, -1,  6, 59, -1,
+  -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, -1, -1, -1, -1, 70, -1,
+  -1, -1, -1, -1, -1, -1, 31, -1, -1, -1, -1, -1, -1,  8,  0, 29,
+  68, -1,  7, -1, 48, -1,  1, -1, -1, -1, 50, -1, 56, 54, -1, 36,
+  -1, 21, 78, -1, 61, -1, -1, -1, -1, -1, 77, -1, 44, 66, -1, -1,
+  -1, 12, 41, -1, -1, 26, -1, -1, 46, -1, -1, -1, -1, -1, -1, 76,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 51, -1, 10, -1, 40,
+  19, -1, -1, 58, -1, 65, -1, -1, -1, 37, 63, -1, -1, -1, -1,  5,
+  -1, -1, 35, -1, 18, -1, -1, 34, -1, -1, -1, -1, -1, -1, -1,  9
+};
+
+int objLookupCmd(const char *s, int n) {
+  const char *name;
+  Guint key;
+  int i;
+
+  if (n < 1 || n > objCmdSlotSize - 1) {
+    return -1;
+  }
+  key = (Guchar)s[0];
+  if (n > 1) {
+    key |= (Guint)(Guchar)s[1] << 8;
+    if (n > 2) {
+      key |= (Guint)(Guchar)s[2] << 16;
+    }
+  }
+  i = objCmdHash[(key * objCmdHashMul) >> 24];
+  if (i < 0) {
+    return -1;
+  }
+  name = objCmdNames[i];
+  if (name[0] != s[0] ||
+      (n > 1 && name[1] != s[1]) ||
+      (n > 2 && name[2] != s[2]) ||
+      name[n] != '\0') {
+    return -1;
+  }
+  return i;
+}
+
+//------------------------------------------------------------------------
+// name atoms
+//------------------------------------------------------------------------
+
+// Atoms are allocated from chunks of this size; longer names get
+// their own block.
+#define objAtomChunkSize 4096
+
+// Initial size of the atom hash table (a power of two).
+#define objAtomTabInitSize 512
+
+// Header of each block of atoms, linking all blocks so that they can
+// be freed.
+struct ObjAtomBlock {
+  ObjAtomBlock *next;
+};
+
+static char **atomTab = NULL;	// open addressing, NULL = empty slot
+static int atomTabSize = 0;
+static int atomTabLen = 0;
+static ObjAtomBlock *atomBlocks = NULL; // all blocks, newest first
+static char *atomChunk = NULL;	// free space in the current chunk
+static int atomChunkLeft = 0;
+static int atomRefCnt = 0;	// number of open documents
+
+// Atoms use the GooStrHash hash function, so that their stored hash
+// can be used to look them up in a GooStrHash.
+static inline Guint objAtomHashStr(const char *s, int n) {
+  return GooStrHash::hash(s, n);
+}
+
+// Return the slot holding the atom for the <n>-char string <s> (with
+// hash <h>), or the empty slot where it would go.
+static inline char **objAtomSlot(const char *s, int n, Guint h) {
+  char *a;
+  int i;
+
+  i = h & (atomTabSize - 1);
+  while ((a = atomTab[i])) {
+    if (a == s ||
+	(objAtomHash(a) == h && !memcmp(a, s, n) && a[n] == '\0')) {
+      break;
+    }
+    i = (i + 1) & (atomTabSize - 1);
+  }
+  return &atomTab[i];
+}
+
+// Allocate a block of <size> bytes for atoms.
+static void *objAtomNewBlock(int size) {
+  ObjAtomBlock *blk;
+
+  blk = (ObjAtomBlock *)gmalloc(sizeof(ObjAtomBlock) + size);
+  blk->next = atomBlocks;
+  atomBlocks = blk;
+  return blk + 1;
+}
+
+char *objAtom(const char *s) {
+  char **slot, **oldTab;
+  char *a;
+  Guint h;
+  int n, need, oldSize, i;
+
+  n = strlen(s);
+  h = objAtomHashStr(s, n);
+  if (atomTab) {
+    slot = objAtomSlot(s, n, h);
+    if (*slot) {
+      return *slot;
+    }
+  }
+
+  // keep the table at most half full
+  if (2 * (atomTabLen + 1) > atomTabSize) {
+    oldTab = atomTab;
+    oldSize = atomTabSize;
+    atomTabSize = oldSize ? 2 * oldSize : objAtomTabInitSize;
+    atomTab = (char **)gmallocn(atomTabSize, sizeof(char *));
+    memset(atomTab, 0, atomTabSize * sizeof(char *));
+    for (i = 0; i < oldSize; ++i) {
+      if ((a = oldTab[i])) {
+	*objAtomSlot(a, strlen(a), objAtomHash(a)) = a;
+      }
+    }
+    gfree(oldTab);
+  }
+  slot = objAtomSlot(s, n, h);
+
+  // hash value, then the name, padded so the next hash is aligned
+  need = (sizeof(Guint) + n + 1 + sizeof(Guint) - 1) & ~(sizeof(Guint) - 1);
+  if (need > objAtomChunkSize / 4) {
+    a = (char *)objAtomNewBlock(need);
+  } else {
+    if (need > atomChunkLeft) {
+      atomChunk = (char *)objAtomNewBlock(objAtomChunkSize);
+      atomChunkLeft = objAtomChunkSize;
+    }
+    a = atomChunk;
+    atomChunk += need;
+    atomChunkLeft -= need;
+  }
+  *(Guint *)a = h;
+  a += sizeof(Guint);
+  memcpy(a, s, n + 1);
+  *slot = a;
+  ++atomTabLen;
+  return a;
+}
+
+char *objFindAtom(const char *s) {
+  int n;
+
+  if (!atomTab) {
+    return NULL;
+  }
+  n = strlen(s);
+  return *objAtomSlot(s, n, objAtomHashStr(s, n));
+}
+
+void objAtomsIncRefCnt() {
+  ++atomRefCnt;
+}
+
+void objAtomsDecRefCnt() {
+  ObjAtomBlock *blk;
+
+  if (--atomRefCnt > 0) {
+    return;
+  }
+  atomRefCnt = 0;
+  while ((blk = atomBlocks)) {
+    atomBlocks = blk->next;
+    gfree(blk);
+  }
+  gfree(atomTab);
+  atomTab = NULL;
+  atomTabSize = atomTabLen = 0;
+  atomChunk = NULL;
+  atomChunkLeft = 0;
+}
+
 //------------------------------------------------------------------------
 // Object
 //------------------------------------------------------------------------
@@ -77,9 +293,6 @@ Object *Object::copy(Object *obj) {
   case objString:
     obj->string = string->copy();
     break;
-  case objName:
-    obj->name = copyString(name);
-    break;
   case objArray:
     array->incRef();
     break;
@@ -90,7 +303,9 @@ Object *Object::copy(Object *obj) {
     stream->incRef();
     break;
   case objCmd:
-    obj->cmd = copyString(cmd);
+    if (!isTableCmd()) {
+      obj->cmd = copyString(cmd);
+    }
     break;
   default:
     break;
@@ -111,9 +326,6 @@ void Object::free() {
   case objString:
     delete string;
     break;
-  case objName:
-    gfree(name);
-    break;
   case objArray:
     if (!array->decRef()) {
       delete array;
@@ -130,7 +342,9 @@ void Object::free() {
     }
     break;
   case objCmd:
-    gfree(cmd);
+    if (!isTableCmd()) {
+      gfree(cmd);
+    }
     break;
   default:
     break;
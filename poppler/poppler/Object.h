@@ -78,6 +78,49 @@ enum ObjType {
 
 #define numObjTypes 14		// total number of object types
 
+//------------------------------------------------------------------------
+// command table
+//------------------------------------------------------------------------
+
+// Commands that are stored without allocating a copy of the name: the
+// content stream operators plus the punctuation and keywords used by
+// Parser.  Each name sits in a fixed-size slot, so that a command's
+// name pointer can be mapped back to its index.
+#define objNumCmds 79
+#define objCmdSlotSize 4
+
+extern const char objCmdNames[objNumCmds][objCmdSlotSize];
+
+// Return the index in objCmdNames of the <n>-character command <s>,
+// or -1 if it isn't there.
+extern int objLookupCmd(const char *s, int n);
+
+//------------------------------------------------------------------------
+// name atoms
+//------------------------------------------------------------------------
+
+// Name objects and dictionary keys all point to a single shared copy
+// (an "atom") of each distinct name, so that equal names have equal
+// pointers.  Each atom is preceded by its hash value.  The atom table
+// is shared by all documents: each PDFDoc holds a reference to it,
+// and when the last one is deleted, every atom is freed -- so name
+// objects must not outlive the last document.
+
+// Add or drop a reference to the atom table.
+extern void objAtomsIncRefCnt();
+extern void objAtomsDecRefCnt();
+
+// Return the atom for <s>, adding it if necessary.
+extern char *objAtom(const char *s);
+
+// Return the atom for <s>, or NULL if there isn't one -- in which
+// case no name object or dictionary key is equal to <s>.
+extern char *objFindAtom(const char *s);
+
+// Return the hash value of <atom>.
+static inline Guint objAtomHash(const char *atom)
+  { return ((const Guint *)atom)[-1]; }
+
 //------------------------------------------------------------------------
 // Object
 //------------------------------------------------------------------------
@@ -107,7 +150,7 @@ public:
   Object *initString(GooString *stringA)
     { initObj(objString); string = stringA; return this; }
   Object *initName(const char *nameA)
-    { initObj(objName); name = copyString(nameA); return this; }
+    { initObj(objName); name = objAtom(nameA); return this; }
   Object *initNull()
     { initObj(objNull); return this; }
   Object *initArray(XRef *xref);
@@ -118,6 +161,11 @@ public:
     { initObj(objRef); ref.num = numA; ref.gen = genA; return this; }
   Object *initCmd(char *cmdA)
     { initObj(objCmd); cmd = copyString(cmdA); return this; }
+  Object *initCmd(char *cmdA, int n)
+    { int i = objLookupCmd(cmdA, n);
+      initObj(objCmd);
+      cmd = i >= 0 ? (char *)objCmdNames[i] : copyString(cmdA);
+      return this; }
   Object *initError()
     { initObj(objError); return this; }
   Object *initEOF()
@@ -157,7 +205,7 @@ public:
 
   // Special type checking.
   GBool isName(const char *nameA)
-    { return type == objName && !strcmp(name, nameA); }
+    { return type == objName && (name == nameA || !strcmp(name, nameA)); }
   GBool isDict(char *dictType);
   GBool isStream(char *dictType);
   GBool isCmd(const char *cmdA)
@@ -178,6 +226,9 @@ public:
   int getRefNum() { return ref.num; }
   int getRefGen() { return ref.gen; }
   char *getCmd() { return cmd; }
+  int getCmdIndex()		// index in objCmdNames, or -1
+    { return isTableCmd() ? (int)(cmd - objCmdNames[0]) / objCmdSlotSize
+                          : -1; }
 
   // Array accessors.
   int arrayGetLength();
@@ -216,6 +267,9 @@ public:
 
 private:
 
+  GBool isTableCmd()
+    { return cmd >= objCmdNames[0] && cmd < objCmdNames[objNumCmds]; }
+
   ObjType type;			// object type
   union {			// value for each type:
     GBool booln;		//   boolean
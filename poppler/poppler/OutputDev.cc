@@ -70,6 +70,17 @@ void OutputDev::updateAll(GfxState *state) {
   updateFont(state);
 }
 
+void OutputDev::drawGlyphRun(GfxState *state, GfxGlyphPos *glyphs,
+			     int nGlyphs) {
+  int i;
+
+  for (i = 0; i < nGlyphs; ++i) {
+    drawChar(state, glyphs[i].x, glyphs[i].y, glyphs[i].dx, glyphs[i].dy,
+	     glyphs[i].originX, glyphs[i].originY,
+	     glyphs[i].code, glyphs[i].nBytes, NULL, 0);
+  }
+}
+
 GBool OutputDev::beginType3Char(GfxState *state, FixedPoint x, FixedPoint y,
 				FixedPoint dx, FixedPoint dy,
 				CharCode code, Unicode *u, int uLen) {
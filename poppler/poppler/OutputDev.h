@@ -35,6 +35,20 @@ class Catalog;
 class Page;
 class Function;
 
+//------------------------------------------------------------------------
+// GfxGlyphPos
+//------------------------------------------------------------------------
+
+// One character of a string passed to drawGlyphRun() -- the values
+// drawChar() would otherwise receive for it.
+struct GfxGlyphPos {
+  FixedPoint x, y;		// position, in user space
+  FixedPoint dx, dy;		// displacement
+  FixedPoint originX, originY;	// origin offset (vertical writing)
+  CharCode code;
+  int nBytes;			// number of bytes in the string
+};
+
 //------------------------------------------------------------------------
 // OutputDev
 //------------------------------------------------------------------------
@@ -57,6 +71,12 @@ public:
   // Does this device use drawChar() or drawString()?
   virtual GBool useDrawChar() = 0;
 
+  // Does this device take each string as a single drawGlyphRun() call
+  // instead of one drawChar() call per character?  Only asked if
+  // useDrawChar() returns true; Type 3 characters always go through
+  // beginType3Char().
+  virtual GBool useDrawGlyphRun() { return gFalse; }
+
   // Does this device use tilingPatternFill()?  If this returns false,
   // tiling pattern fills will be reduced to a series of other drawing
   // operations.
@@ -184,6 +204,13 @@ public:
 			FixedPoint /*originX*/, FixedPoint /*originY*/,
 			CharCode /*code*/, int /*nBytes*/, Unicode * /*u*/, int /*uLen*/) {}
   virtual void drawString(GfxState * /*state*/, GooString * /*s*/) {}
+  // Draw the <nGlyphs> characters of one string, which share the
+  // font, colors and render mode in <state>.  It is called after the
+  // whole string has been laid out, so the current point in <state>
+  // is already past its end.  The default calls drawChar() for each
+  // character (without Unicode mappings).
+  virtual void drawGlyphRun(GfxState *state, GfxGlyphPos *glyphs,
+			    int nGlyphs);
   virtual GBool beginType3Char(GfxState * /*state*/, FixedPoint /*x*/, FixedPoint /*y*/,
 			       FixedPoint /*dx*/, FixedPoint /*dy*/,
 			       CharCode /*code*/, Unicode * /*u*/, int /*uLen*/);
@@ -56,6 +56,7 @@ PDFDoc::PDFDoc(GooString *fileNameA, GooString *ownerPassword,
   Object obj;
   GooString *fileName1, *fileName2;
 
+  objAtomsIncRefCnt();
   ok = gFalse;
   errCode = errNone;
 
@@ -114,6 +115,7 @@ PDFDoc::PDFDoc(wchar_t *fileNameA, int fileNameLen, GooString *ownerPassword,
   Object obj;
   int i;
 
+  objAtomsIncRefCnt();
   ok = gFalse;
   errCode = errNone;
 
@@ -164,6 +166,7 @@ PDFDoc::PDFDoc(wchar_t *fileNameA, int fileNameLen, GooString *ownerPassword,
 
 PDFDoc::PDFDoc(BaseStream *strA, GooString *ownerPassword,
 	       GooString *userPassword, void *guiDataA) {
+  objAtomsIncRefCnt();
   ok = gFalse;
   errCode = errNone;
   guiData = guiDataA;
@@ -251,6 +254,7 @@ PDFDoc::~PDFDoc() {
   if (fileName) {
     delete fileName;
   }
+  objAtomsDecRefCnt();
 }
 
 
@@ -44,8 +44,8 @@ Object *Parser::getObj(Object *obj, Guchar *fileKey,
   Object obj2;
   int num;
   DecryptStream *decrypt;
-  GooString *s, *s2;
-  int c;
+  GooString *s;
+  int c, n;
 
   // refill buffer after inline image data
   if (inlineImg == 2) {
@@ -76,11 +76,10 @@ Object *Parser::getObj(Object *obj, Guchar *fileKey,
 	error(getPos(), "Dictionary key must be a name object");
 	shift();
       } else {
-	// buf1 might go away in shift(), so construct the key
-	key = copyString(buf1.getName());
+	// buf1 might go away in shift(), but its name is an atom
+	key = buf1.getName();
 	shift();
 	if (buf1.isEOF() || buf1.isError()) {
-	  gfree(key);
 	  break;
 	}
 	obj->dictAdd(key, getObj(&obj2, fileKey, encAlgorithm, keyLength, objNum, objGen));
@@ -116,19 +115,24 @@ Object *Parser::getObj(Object *obj, Guchar *fileKey,
 
   // string
   } else if (buf1.isString() && fileKey) {
+    // decrypt in place and hand the string over: the plaintext is
+    // never longer than the ciphertext, and the decrypter always reads
+    // ahead of the position being written
     s = buf1.getString();
-    s2 = new GooString();
     obj2.initNull();
     decrypt = new DecryptStream(new MemStream(s->getCString(), 0,
 					      s->getLength(), &obj2),
 				fileKey, encAlgorithm, keyLength,
 				objNum, objGen);
     decrypt->reset();
+    n = 0;
     while ((c = decrypt->getChar()) != EOF) {
-      s2->append((char)c);
+      s->setChar(n++, (char)c);
     }
     delete decrypt;
-    obj->initString(s2);
+    s->del(n, s->getLength() - n);
+    buf1.shallowCopy(obj);
+    buf1.initNull();
     shift();
 
   // simple object
@@ -21,6 +21,7 @@
 #include "GfxFont.h"
 #include "Link.h"
 #include "CharCodeToUnicode.h"
+#include "EmbFontCache.h"
 #include "FontEncodingTables.h"
 #include "fofi/FoFiTrueType.h"
 #include "splash/SplashBitmap.h"
@@ -30,6 +31,7 @@
 #include "splash/SplashPath.h"
 #include "splash/SplashState.h"
 #include "splash/SplashErrorCodes.h"
+#include "splash/SplashMath.h"
 #include "splash/SplashFontEngine.h"
 #include "splash/SplashFont.h"
 #include "splash/SplashFontFile.h"
@@ -540,6 +542,1071 @@ struct T3GlyphStack {
   T3GlyphStack *next;		// next object on stack
 };
 
+//------------------------------------------------------------------------
+// SplashOutImageCache
+//------------------------------------------------------------------------
+
+// An image XObject that has been decoded and scaled down to the size
+// it was drawn at.  Dimensions that were being enlarged are kept at
+// the image's own size, so drawing the cached pixels with
+// Splash::drawImage gives exactly the same result as drawing the
+// original stream.
+struct SplashOutImageCacheEntry {
+  Ref ref;			// image XObject
+  int scaledWidth, scaledHeight;// device size the image was drawn at
+  SplashColorMode mode;		// pixel format
+  GBool alpha;			// true if there is an alpha channel
+  int width, height;		// size of the cached pixels
+  SplashColorPtr data;		// pixels, in raster order
+  Guchar *alphaData;		// alpha values, or NULL
+  int size;			// total size of data and alphaData, in bytes
+  SplashOutImageCacheEntry *next; // next entry, in MRU order
+};
+
+class SplashOutImageCache {
+public:
+
+  SplashOutImageCache(int maxBytesA);
+  ~SplashOutImageCache();
+
+  // Look up an image, moving it to the head of the MRU list.  Returns
+  // NULL (and counts a miss) if it isn't cached.
+  SplashOutImageCacheEntry *lookup(Ref ref, int scaledWidth,
+				   int scaledHeight, SplashColorMode mode,
+				   GBool alpha);
+
+  // Add an entry with space for the pixels, throwing out least
+  // recently used entries to stay under the size limit.  Returns NULL
+  // if the image alone is larger than the limit.
+  SplashOutImageCacheEntry *add(Ref ref, int scaledWidth, int scaledHeight,
+				SplashColorMode mode, GBool alpha,
+				int width, int height);
+
+  // Remove all entries (the statistics are kept).
+  void clear();
+
+  // Change the size limit.
+  void setMaxBytes(int maxBytesA);
+
+  int getHits() { return hits; }
+  int getMisses() { return misses; }
+  int getBytes() { return bytes; }
+
+private:
+
+  void freeEntry(SplashOutImageCacheEntry *entry);
+  void shrink(int maxBytesA);
+
+  SplashOutImageCacheEntry *entries;	// cached images, MRU first
+  int maxBytes;			// size limit, in bytes
+  int bytes;			// current size, in bytes
+  int hits, misses;		// lookup statistics
+};
+
+SplashOutImageCache::SplashOutImageCache(int maxBytesA) {
+  entries = NULL;
+  maxBytes = maxBytesA;
+  bytes = 0;
+  hits = misses = 0;
+}
+
+SplashOutImageCache::~SplashOutImageCache() {
+  clear();
+}
+
+SplashOutImageCacheEntry *SplashOutImageCache::lookup(Ref ref,
+						      int scaledWidth,
+						      int scaledHeight,
+						      SplashColorMode mode,
+						      GBool alpha) {
+  SplashOutImageCacheEntry *entry, *prev;
+
+  for (prev = NULL, entry = entries; entry; prev = entry, entry = entry->next) {
+    if (entry->ref.num == ref.num && entry->ref.gen == ref.gen &&
+	entry->scaledWidth == scaledWidth &&
+	entry->scaledHeight == scaledHeight &&
+	entry->mode == mode && entry->alpha == alpha) {
+      if (prev) {
+	prev->next = entry->next;
+	entry->next = entries;
+	entries = entry;
+      }
+      ++hits;
+      return entry;
+    }
+  }
+  ++misses;
+  return NULL;
+}
+
+SplashOutImageCacheEntry *SplashOutImageCache::add(Ref ref, int scaledWidth,
+						   int scaledHeight,
+						   SplashColorMode mode,
+						   GBool alpha,
+						   int width, int height) {
+  SplashOutImageCacheEntry *entry;
+  int size;
+
+  if (width > maxBytes / height) {
+    return NULL;
+  }
+  size = width * height * splashColorModeNComps[mode];
+  if (alpha) {
+    size += width * height;
+  }
+  if (size > maxBytes) {
+    return NULL;
+  }
+  shrink(maxBytes - size);
+
+  entry = new SplashOutImageCacheEntry;
+  entry->ref = ref;
+  entry->scaledWidth = scaledWidth;
+  entry->scaledHeight = scaledHeight;
+  entry->mode = mode;
+  entry->alpha = alpha;
+  entry->width = width;
+  entry->height = height;
+  entry->data = (SplashColorPtr)gmallocn(width * height,
+					 splashColorModeNComps[mode]);
+  entry->alphaData = alpha ? (Guchar *)gmallocn(width, height) : NULL;
+  entry->size = size;
+  entry->next = entries;
+  entries = entry;
+  bytes += size;
+  return entry;
+}
+
+void SplashOutImageCache::clear() {
+  shrink(0);
+}
+
+void SplashOutImageCache::setMaxBytes(int maxBytesA) {
+  maxBytes = maxBytesA;
+  shrink(maxBytes);
+}
+
+void SplashOutImageCache::freeEntry(SplashOutImageCacheEntry *entry) {
+  bytes -= entry->size;
+  gfree(entry->data);
+  gfree(entry->alphaData);
+  delete entry;
+}
+
+// Throw out least recently used entries until the cache holds no more
+// than <maxBytesA> bytes.
+void SplashOutImageCache::shrink(int maxBytesA) {
+  SplashOutImageCacheEntry **p;
+
+  while (bytes > maxBytesA) {
+    for (p = &entries; (*p)->next; p = &(*p)->next) ;
+    freeEntry(*p);
+    *p = NULL;
+  }
+}
+
+//------------------------------------------------------------------------
+// SplashOutShadingPattern
+//------------------------------------------------------------------------
+
+// number of entries in the color lookup table of an axial or radial
+// shading
+#define splashOutShadingLUTSize 256
+
+// Axial and radial shadings.  Each device pixel is mapped to the
+// shading parameter s (0 at the start of the shading, 1 at its end)
+// and its color is looked up in a table sampled from the shading
+// function.  The coefficients are set up in double precision once per
+// shading; the per-pixel math uses 64-bit integers, with s in 16.16
+// fixed point.
+class SplashOutShadingPattern: public SplashPattern {
+public:
+
+  // <lutA> has splashOutShadingLUTSize entries of splashMaxColorComps
+  // bytes each; the pattern takes ownership of it.
+  SplashOutShadingPattern(Guchar *lutA, GBool extend0A, GBool extend1A);
+
+  virtual ~SplashOutShadingPattern();
+
+  virtual GBool getColor(int x, int y, SplashColorPtr c);
+
+  virtual void getColorSpan(int x0, int x1, int y,
+			    SplashColorPtr c, Guchar *paint);
+
+  virtual GBool isStatic() { return gFalse; }
+
+protected:
+
+  // Compute s for the center of device pixel (<x>, <y>).  Returns
+  // false if no part of the shading (including its extensions) covers
+  // the pixel.
+  virtual GBool getParameter(int x, int y, FixPtInt64 *s) = 0;
+
+  Guchar *copyLUT();
+
+  // Copy the color for <s> into <c>.
+  void lookup(FixPtInt64 s, SplashColorPtr c)
+  {
+    int i;
+
+    if (s <= 0) {
+      i = 0;
+    } else if (s >= 0x10000) {
+      i = splashOutShadingLUTSize - 1;
+    } else {
+      i = (int)((s * (splashOutShadingLUTSize - 1) + 0x8000) >> 16);
+    }
+    splashColorCopy(c, &lut[i * splashMaxColorComps]);
+  }
+
+  Guchar *lut;
+  GBool extend0, extend1;
+};
+
+SplashOutShadingPattern::SplashOutShadingPattern(Guchar *lutA,
+						 GBool extend0A,
+						 GBool extend1A) {
+  lut = lutA;
+  extend0 = extend0A;
+  extend1 = extend1A;
+}
+
+SplashOutShadingPattern::~SplashOutShadingPattern() {
+  gfree(lut);
+}
+
+GBool SplashOutShadingPattern::getColor(int x, int y, SplashColorPtr c) {
+  FixPtInt64 s;
+
+  if (!getParameter(x, y, &s)) {
+    return gFalse;
+  }
+  lookup(s, c);
+  return gTrue;
+}
+
+void SplashOutShadingPattern::getColorSpan(int x0, int x1, int y,
+					   SplashColorPtr c, Guchar *paint) {
+  FixPtInt64 s;
+  int x;
+
+  for (x = x0; x <= x1; ++x, c += splashMaxColorComps) {
+    if ((*paint++ = (Guchar)getParameter(x, y, &s))) {
+      lookup(s, c);
+    }
+  }
+}
+
+Guchar *SplashOutShadingPattern::copyLUT() {
+  Guchar *lutA;
+
+  lutA = (Guchar *)gmallocn(splashOutShadingLUTSize, splashMaxColorComps);
+  memcpy(lutA, lut, splashOutShadingLUTSize * splashMaxColorComps);
+  return lutA;
+}
+
+// Convert a double to 32.32 fixed point.
+static inline FixPtInt64 splashOutFix32(double x) {
+  return (FixPtInt64)(x * 4294967296.0);
+}
+
+//------------------------------------------------------------------------
+// SplashOutAxialPattern
+//------------------------------------------------------------------------
+
+// s is an affine function of the device coordinates:
+// s = a * x + b * y + c (with a, b, c in 32.32 fixed point).
+class SplashOutAxialPattern: public SplashOutShadingPattern {
+public:
+
+  SplashOutAxialPattern(Guchar *lutA, GBool extend0A, GBool extend1A,
+			FixPtInt64 aA, FixPtInt64 bA, FixPtInt64 cA);
+
+  virtual SplashPattern *copy()
+    { return new SplashOutAxialPattern(copyLUT(), extend0, extend1,
+				       a, b, c); }
+
+  virtual void getColorSpan(int x0, int x1, int y,
+			    SplashColorPtr cc, Guchar *paint);
+
+protected:
+
+  virtual GBool getParameter(int x, int y, FixPtInt64 *s);
+
+private:
+
+  FixPtInt64 a, b, c;
+};
+
+SplashOutAxialPattern::SplashOutAxialPattern(Guchar *lutA,
+					     GBool extend0A, GBool extend1A,
+					     FixPtInt64 aA, FixPtInt64 bA,
+					     FixPtInt64 cA):
+  SplashOutShadingPattern(lutA, extend0A, extend1A)
+{
+  a = aA;
+  b = bA;
+  c = cA;
+}
+
+GBool SplashOutAxialPattern::getParameter(int x, int y, FixPtInt64 *s) {
+  FixPtInt64 t;
+
+  t = (a * x + b * y + c) >> 16;
+  if ((t < 0 && !extend0) || (t > 0x10000 && !extend1)) {
+    return gFalse;
+  }
+  *s = t;
+  return gTrue;
+}
+
+// Smallest t (16.16) for which lookup uses the second table entry,
+// and smallest t for which it uses the last one.
+#define splashOutAxialFirstT \
+  ((0x8000 + splashOutShadingLUTSize - 2) / (splashOutShadingLUTSize - 1))
+#define splashOutAxialLastT \
+  ((((splashOutShadingLUTSize - 1) << 16) - 0x8000 + \
+    splashOutShadingLUTSize - 2) / (splashOutShadingLUTSize - 1))
+
+// s is stepped along the row, which is split into runs where t is
+// before the start, at the first table entry, between the first and
+// last entries, at the last entry, or beyond the end.  Only the runs
+// in between need a table index per pixel; the others are filled.
+// This gives exactly the same colors as getParameter and lookup.
+void SplashOutAxialPattern::getColorSpan(int x0, int x1, int y,
+					 SplashColorPtr cc, Guchar *paint) {
+  FixPtInt64 s32, t, lo, hi, k;
+  int x, n, i, j;
+  GBool loOpen, hiOpen;
+
+  s32 = a * x0 + b * y + c;
+  for (x = x0; x <= x1; x += n) {
+
+    // the run's range of t, and its table index (-1: not painted, -2:
+    // per pixel)
+    t = s32 >> 16;
+    lo = hi = 0;
+    loOpen = hiOpen = gFalse;
+    if (t < 0) {
+      loOpen = gTrue;
+      hi = -1;
+      i = extend0 ? 0 : -1;
+    } else if (t < splashOutAxialFirstT) {
+      hi = splashOutAxialFirstT - 1;
+      i = 0;
+    } else if (t < splashOutAxialLastT) {
+      lo = splashOutAxialFirstT;
+      hi = splashOutAxialLastT - 1;
+      i = -2;
+    } else if (t <= 0x10000) {
+      lo = splashOutAxialLastT;
+      hi = 0x10000;
+      i = splashOutShadingLUTSize - 1;
+    } else {
+      lo = 0x10001;
+      hiOpen = gTrue;
+      i = extend1 ? splashOutShadingLUTSize - 1 : -1;
+    }
+
+    // the number of pixels until t leaves [lo, hi]
+    n = x1 - x + 1;
+    if (a > 0 && !hiOpen) {
+      k = (((hi + 1) << 16) - s32 + a - 1) / a;
+      if (k < n) {
+	n = (int)k;
+      }
+    } else if (a < 0 && !loOpen) {
+      k = (s32 - (lo << 16)) / -a + 1;
+      if (k < n) {
+	n = (int)k;
+      }
+    }
+
+    if (i == -2) {
+      for (j = 0; j < n; ++j, s32 += a, cc += splashMaxColorComps) {
+	*paint++ = 1;
+	splashColorCopy(cc, &lut[(int)((((s32 >> 16) *
+					 (splashOutShadingLUTSize - 1)) +
+					0x8000) >> 16) * splashMaxColorComps]);
+      }
+    } else if (i >= 0) {
+      memset(paint, 1, n);
+      paint += n;
+      for (j = 0; j < n; ++j, cc += splashMaxColorComps) {
+	splashColorCopy(cc, &lut[i * splashMaxColorComps]);
+      }
+      s32 += n * a;
+    } else {
+      memset(paint, 0, n);
+      paint += n;
+      cc += n * splashMaxColorComps;
+      s32 += n * a;
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// SplashOutRadialPattern
+//------------------------------------------------------------------------
+
+// Points are in "pixel units": shading space, relative to the first
+// circle's center and scaled so that a device pixel is at least one
+// unit wide, with 10 fraction bits.  Coordinates (and the extension
+// limits) must stay below splashOutRadialMaxCoord units, which keeps
+// all of the products below in 64 bits.
+#define splashOutRadialFracBits 10
+#define splashOutRadialMaxCoord (1 << 19)
+
+// longest run of pixels that getColorSpan fills with one color
+#define splashOutRadialChunk 64
+
+// The circle of the shading at one value of s: its center and radius
+// squared in pixel units (rounded to splashOutRadialFracBits), and
+// a * s for the vertex test (in units of 2^-40, as the b of
+// SplashOutRadialPattern).
+struct SplashOutRadialBound {
+  int cx, cy;
+  FixPtInt64 r2;
+  FixPtInt64 at;
+};
+
+// s is the larger root (or, if that one is out of range, the smaller
+// one) of
+//
+//   a * s^2 - 2 * b * s + c = 0
+//
+// which is the power of the pixel with respect to the circle at s:
+// |p - s * dc|^2 - (r0 + s * dr)^2.  With the geometry scaled to at
+// most 1 (dc, dr and a) and the point in pixel units (b and c), the
+// roots are only compared with fixed values of s: the boundaries
+// between the color table cells and the limits of the (extended)
+// domain.  Each comparison is the sign of the power with respect to
+// one circle, which is exact in integer arithmetic (the circle is
+// rounded to 2^-10 pixel), plus a test of the parabola's vertex,
+// b / a.  getParameter and getColorSpan compute the same point for a
+// pixel, so they agree exactly.
+class SplashOutRadialPattern: public SplashOutShadingPattern {
+public:
+
+  // <matA> maps device space to pixel units; <dcxA>, <dcyA> and <drA>
+  // are the difference between the circles, scaled by <geomScale>,
+  // which is the size of the geometry in pixel units; <r0A> is the
+  // first radius in pixel units.
+  SplashOutRadialPattern(Guchar *lutA, GBool extend0A, GBool extend1A,
+			 double *matA, double dcxA, double dcyA,
+			 double r0A, double drA, double geomScale);
+
+  virtual SplashPattern *copy()
+    { return new SplashOutRadialPattern(this); }
+
+  virtual void getColorSpan(int x0, int x1, int y,
+			    SplashColorPtr cc, Guchar *paint);
+
+protected:
+
+  virtual GBool getParameter(int x, int y, FixPtInt64 *s);
+
+private:
+
+  SplashOutRadialPattern(SplashOutRadialPattern *pattern);
+
+  void setBound(SplashOutRadialBound *bd, double t, double r0A,
+		double geomScale, double dcxA, double dcyA, double drA);
+
+  // The power of (<px>, <py>) with respect to <bd>, multiplied by the
+  // sign <sg> of a: negative if <bd> is between the roots.
+  FixPtInt64 power(int px, int py, int sg, SplashOutRadialBound *bd) {
+    FixPtInt64 dx, dy, q;
+
+    dx = px - bd->cx;
+    dy = py - bd->cy;
+    q = dx * dx + dy * dy - bd->r2;
+    return sg > 0 ? q : -q;
+  }
+
+  // Is the larger root above <bd>?  Returns 2 if that is because <bd>
+  // is between the roots (which shows that the roots exist), 1 if it
+  // is because the vertex is above <bd> (which assumes that they do),
+  // or 0.  <b> is b with a's sign <sg>.
+  int rootAbove(int px, int py, FixPtInt64 b, int sg,
+		SplashOutRadialBound *bd) {
+    if (power(px, py, sg, bd) < 0) {
+      return 2;
+    }
+    return (sg > 0 ? b > bd->at : b < bd->at) ? 1 : 0;
+  }
+
+  // Is the smaller root below <bd>?  (Assumes that the roots exist.)
+  GBool rootBelow(int px, int py, FixPtInt64 b, int sg,
+		  SplashOutRadialBound *bd) {
+    return power(px, py, sg, bd) < 0 ||
+           (sg > 0 ? b < bd->at : b > bd->at);
+  }
+
+  // Is the smaller root at or below <bd>?  (Assumes that the roots
+  // exist.)
+  GBool rootAtOrBelow(int px, int py, FixPtInt64 b, int sg,
+		      SplashOutRadialBound *bd) {
+    return power(px, py, sg, bd) <= 0 ||
+           (sg > 0 ? b < bd->at : b > bd->at);
+  }
+
+  GBool rootsExist(int px, int py, FixPtInt64 b);
+
+  // The test at cellBd[<j>] for findCell: rootAbove for the larger
+  // root, and "is the smaller root above" for the smaller one.
+  int cellTest(int px, int py, FixPtInt64 b, int sg, int j,
+	       GBool smaller) {
+    if (smaller) {
+      return !rootAtOrBelow(px, py, b, sg, &cellBd[j]);
+    }
+    return rootAbove(px, py, b, sg, &cellBd[j]);
+  }
+
+  int findCell(int px, int py, FixPtInt64 b, int sg, int hint,
+	       GBool smaller, int *code);
+
+  // Return the color table index for the point (<px>, <py>), or -1 if
+  // it isn't painted.  <*cell1> and <*cell2> are the table cells of
+  // the previous point's larger and smaller root; they are updated.
+  int getIndex(int px, int py, int *cell1, int *cell2);
+
+  // Chunks of a row: is the power with respect to <bd> negative (or
+  // positive) at every point stepped from (<ax>, <ay>) to (<bx>, <by>)?
+  GBool chunkInside(int ax, int ay, int bx, int by,
+		    SplashOutRadialBound *bd);
+  GBool chunkOutside(int ax, int ay, int bx, int by,
+		     SplashOutRadialBound *bd);
+  GBool chunkPowerNeg(int ax, int ay, int bx, int by, SplashOutRadialBound *bd)
+    { return sgnA > 0 ? chunkInside(ax, ay, bx, by, bd)
+                      : chunkOutside(ax, ay, bx, by, bd); }
+  GBool chunkPowerPos(int ax, int ay, int bx, int by, SplashOutRadialBound *bd)
+    { return sgnA > 0 ? chunkOutside(ax, ay, bx, by, bd)
+                      : chunkInside(ax, ay, bx, by, bd); }
+
+  // Is the vertex above (or, if <above> is false, at or below) <bd> at
+  // every point of the chunk?
+  GBool chunkVertex(int ax, int ay, int bx, int by,
+		    SplashOutRadialBound *bd, GBool above);
+
+  // Is the discriminant positive (<sign> > 0: the roots exist) or
+  // negative (they don't) at every point of the chunk?
+  GBool chunkDisc(int ax, int ay, int bx, int by, int sign);
+
+  // Does getIndex return <i> at every point of the chunk?
+  GBool chunkIndex(int i, int ax, int ay, int bx, int by);
+
+  FixPtInt64 mat[6];		// device -> pixel units, 32.32
+  int dcx, dcy;			// dc, scaled (2^-30)
+  FixPtInt64 r0dr;		// r0 * dr, scaled (2^-40)
+  int sgnA;			// sign of a (0 if a is zero)
+  double dcxD, dcyD, r0D, drD, aD; // the geometry, for rootsExist
+  double circleErr;		// bound on the rounding of the circles
+  SplashOutRadialBound		// boundaries between table cells
+    cellBd[splashOutShadingLUTSize - 1];
+  GBool loInf, hiInf;		// set if s is unlimited below/above
+  SplashOutRadialBound loBd, hiBd; // limits of the (extended) domain
+  int cell1, cell2;		// getParameter's cells
+};
+
+SplashOutRadialPattern::SplashOutRadialPattern(Guchar *lutA,
+					       GBool extend0A, GBool extend1A,
+					       double *matA,
+					       double dcxA, double dcyA,
+					       double r0A, double drA,
+					       double geomScale):
+  SplashOutShadingPattern(lutA, extend0A, extend1A)
+{
+  double tMax;
+  int i;
+
+  for (i = 0; i < 6; ++i) {
+    mat[i] = splashOutFix32(matA[i]);
+  }
+  dcx = (int)(dcxA * (1 << 30));
+  dcy = (int)(dcyA * (1 << 30));
+  r0dr = (FixPtInt64)(r0A * drA * 1099511627776.0);
+  aD = dcxA * dcxA + dcyA * dcyA - drA * drA;
+  sgnA = aD > 0 ? 1 : aD < 0 ? -1 : 0;
+  dcxD = dcxA;
+  dcyD = dcyA;
+  r0D = r0A;
+  drD = drA;
+
+  // s is valid in [lo, hi]: [0, 1], extended up to where the radius
+  // becomes negative
+  loInf = extend0 && drA <= 0;
+  hiInf = extend1 && drA >= 0;
+  setBound(&loBd, (extend0 && drA > 0) ? -r0A / (drA * geomScale) : 0,
+	   r0A, geomScale, dcxA, dcyA, drA);
+  setBound(&hiBd, (extend1 && drA < 0) ? r0A / (-drA * geomScale) : 1,
+	   r0A, geomScale, dcxA, dcyA, drA);
+
+  // the circles' centers and radii are rounded to 2^-11 pixel, which
+  // changes the power by at most 2^-10 * (|dx| + |dy| + r); this is
+  // the part that doesn't depend on the point
+  tMax = geomScale;
+  if (extend0 && drA > 0 && r0A / drA > tMax) {
+    tMax = r0A / drA;
+  }
+  if (extend1 && drA < 0 && r0A / -drA > tMax) {
+    tMax = r0A / -drA;
+  }
+  circleErr = (tMax * (fabs(dcxA) + fabs(dcyA) + fabs(drA)) + r0A + 1) /
+              (1 << splashOutRadialFracBits);
+
+  // cell i holds the values of s that lookup maps to table entry i
+  for (i = 0; i < splashOutShadingLUTSize - 1; ++i) {
+    setBound(&cellBd[i], (2 * i + 1) / (2.0 * (splashOutShadingLUTSize - 1)),
+	     r0A, geomScale, dcxA, dcyA, drA);
+  }
+  cell1 = cell2 = splashOutShadingLUTSize / 2;
+}
+
+SplashOutRadialPattern::SplashOutRadialPattern(
+			    SplashOutRadialPattern *pattern):
+  SplashOutShadingPattern(pattern->copyLUT(), pattern->extend0,
+			  pattern->extend1)
+{
+  int i;
+
+  for (i = 0; i < 6; ++i) {
+    mat[i] = pattern->mat[i];
+  }
+  dcx = pattern->dcx;
+  dcy = pattern->dcy;
+  r0dr = pattern->r0dr;
+  sgnA = pattern->sgnA;
+  dcxD = pattern->dcxD;
+  dcyD = pattern->dcyD;
+  r0D = pattern->r0D;
+  drD = pattern->drD;
+  aD = pattern->aD;
+  circleErr = pattern->circleErr;
+  memcpy(cellBd, pattern->cellBd, sizeof(cellBd));
+  loInf = pattern->loInf;
+  hiInf = pattern->hiInf;
+  loBd = pattern->loBd;
+  hiBd = pattern->hiBd;
+  cell1 = cell2 = splashOutShadingLUTSize / 2;
+}
+
+void SplashOutRadialPattern::setBound(SplashOutRadialBound *bd, double t,
+				      double r0A, double geomScale,
+				      double dcxA, double dcyA, double drA) {
+  double st;
+  int r;
+
+  st = t * geomScale;
+  bd->cx = (int)floor(st * dcxA * (1 << splashOutRadialFracBits) + 0.5);
+  bd->cy = (int)floor(st * dcyA * (1 << splashOutRadialFracBits) + 0.5);
+  r = (int)floor((r0A + st * drA) * (1 << splashOutRadialFracBits) + 0.5);
+  bd->r2 = (FixPtInt64)r * r;
+  bd->at = (FixPtInt64)((dcxA * dcxA + dcyA * dcyA - drA * drA) * st *
+			1099511627776.0);
+}
+
+// Do the roots exist?  b^2 - a * c is the power with respect to the
+// circle at the vertex, times -a.  Close to the (possibly degenerate)
+// envelope of the circles, the integer terms above lose too much to
+// their rounding, so this is done in double precision; it is only
+// needed where the comparisons haven't shown that the roots exist.
+GBool SplashOutRadialPattern::rootsExist(int px, int py, FixPtInt64 b) {
+  double x, y, t, dx, dy, r;
+
+  if (sgnA == 0) {
+    return b != 0;
+  }
+  x = (double)px / (1 << splashOutRadialFracBits);
+  y = (double)py / (1 << splashOutRadialFracBits);
+  t = (x * dcxD + y * dcyD + r0D * drD) / aD;
+  dx = x - t * dcxD;
+  dy = y - t * dcyD;
+  r = r0D + t * drD;
+  return aD * (dx * dx + dy * dy - r * r) <= 0;
+}
+
+// Find the table cell of a root: the first i for which the test at
+// cellBd[i] fails (n - 1 if none does).  The search starts at <hint>
+// and gallops away from it, so a cell next to the previous pixel's
+// takes two tests, and one across the table takes a few more than
+// log2(n).  <*code> is set to the test's result at cellBd[i-1].
+int SplashOutRadialPattern::findCell(int px, int py, FixPtInt64 b, int sg,
+				     int hint, GBool smaller, int *code) {
+  int yes, no, step, m, k;
+
+  *code = 0;
+  if (hint < splashOutShadingLUTSize - 1 &&
+      (k = cellTest(px, py, b, sg, hint, smaller))) {
+    yes = hint;
+    *code = k;
+    for (step = 1; ; step *= 2) {
+      no = yes + step;
+      if (no >= splashOutShadingLUTSize - 1) {
+	no = splashOutShadingLUTSize - 1;
+	break;
+      }
+      if (!(k = cellTest(px, py, b, sg, no, smaller))) {
+	break;
+      }
+      yes = no;
+      *code = k;
+    }
+  } else {
+    no = hint;
+    for (step = 1; ; step *= 2) {
+      yes = no - step;
+      if (yes < 0) {
+	yes = -1;
+	break;
+      }
+      if ((k = cellTest(px, py, b, sg, yes, smaller))) {
+	*code = k;
+	break;
+      }
+      no = yes;
+    }
+  }
+  while (no - yes > 1) {
+    m = (yes + no) / 2;
+    if ((k = cellTest(px, py, b, sg, m, smaller))) {
+      yes = m;
+      *code = k;
+    } else {
+      no = m;
+    }
+  }
+  return no;
+}
+
+int SplashOutRadialPattern::getIndex(int px, int py,
+				     int *cell1A, int *cell2A) {
+  FixPtInt64 b;
+  int sg, i, k, lo;
+
+  b = (FixPtInt64)px * dcx + (FixPtInt64)py * dcy + r0dr;
+  sg = sgnA;
+  if (sg == 0) {
+    // a linear equation: make the power increase with s, so that the
+    // root is above the boundaries where it is negative
+    sg = b > 0 ? -1 : 1;
+  }
+
+  // cell i (0 < i < n - 1) is (cellBd[i-1], cellBd[i]]; cell 0 and
+  // cell n - 1 extend to infinity.  lo is rootAbove at cellBd[i-1].
+  i = *cell1A;
+  if (!(i > 0 && i < splashOutShadingLUTSize - 1 &&
+	!rootAbove(px, py, b, sg, &cellBd[i]) &&
+	(lo = rootAbove(px, py, b, sg, &cellBd[i - 1])))) {
+    i = findCell(px, py, b, sg, i, gFalse, &lo);
+    *cell1A = i;
+  }
+
+  // the larger root is in (0, 1), where the radius isn't negative
+  if (i > 0 && i < splashOutShadingLUTSize - 1) {
+    return (lo == 2 || rootsExist(px, py, b)) ? i : -1;
+  }
+
+  // the larger root is below the start: if it isn't in the extension,
+  // neither is the smaller one
+  if (i == 0) {
+    if (!loInf) {
+      if (power(px, py, sg, &loBd) <= 0) {
+	return 0;
+      }
+      if (!(sg > 0 ? b > loBd.at : b < loBd.at)) {
+	return -1;
+      }
+    }
+    return rootsExist(px, py, b) ? 0 : -1;
+  }
+
+  // the larger root is beyond the end: if it isn't in the extension,
+  // fall back to the smaller one
+  if (hiInf || !(k = rootAbove(px, py, b, sg, &hiBd))) {
+    return (lo == 2 || rootsExist(px, py, b))
+             ? splashOutShadingLUTSize - 1 : -1;
+  }
+  if (sgnA == 0 || (k == 1 && power(px, py, sg, &hiBd) != 0)) {
+    return -1;
+  }
+
+  // the smaller root is at or below the end; cell i is as above
+  i = findCell(px, py, b, sg, *cell2A, gTrue, &k);
+  *cell2A = i;
+  if (i == 0 && !loInf && rootBelow(px, py, b, sg, &loBd)) {
+    return -1;
+  }
+  return i;
+}
+
+GBool SplashOutRadialPattern::getParameter(int x, int y, FixPtInt64 *s) {
+  FixPtInt64 px, py;
+  int i;
+
+  px = mat[0] * x + mat[2] * y + mat[4];
+  py = mat[1] * x + mat[3] * y + mat[5];
+  if (px >= ((FixPtInt64)splashOutRadialMaxCoord << 32) ||
+      px <= -((FixPtInt64)splashOutRadialMaxCoord << 32) ||
+      py >= ((FixPtInt64)splashOutRadialMaxCoord << 32) ||
+      py <= -((FixPtInt64)splashOutRadialMaxCoord << 32)) {
+    return gFalse;
+  }
+  i = getIndex((int)(px >> (32 - splashOutRadialFracBits)),
+	       (int)(py >> (32 - splashOutRadialFracBits)), &cell1, &cell2);
+  if (i < 0) {
+    return gFalse;
+  }
+  // lookup maps this back to i
+  *s = ((FixPtInt64)i << 16) / (splashOutShadingLUTSize - 1);
+  return gTrue;
+}
+
+// The points stepped along a row are within one unit (in each
+// coordinate) of the segment between the first and the last one: the
+// truncation error is at most one unit at each of them.  Over such a
+// unit, the power changes by less than 2 * (|dx| + |dy|) + 2 units,
+// where (dx, dy) is the point relative to the circle's center, and b
+// changes by less than |dcx| + |dcy|.
+GBool SplashOutRadialPattern::chunkInside(int ax, int ay, int bx, int by,
+					  SplashOutRadialBound *bd) {
+  FixPtInt64 dxa, dya, dxb, dyb, err;
+
+  // the power is convex along the segment
+  dxa = (FixPtInt64)ax - bd->cx;
+  dya = (FixPtInt64)ay - bd->cy;
+  dxb = (FixPtInt64)bx - bd->cx;
+  dyb = (FixPtInt64)by - bd->cy;
+  err = 2 * ((dxa < 0 ? -dxa : dxa) > (dxb < 0 ? -dxb : dxb)
+	       ? (dxa < 0 ? -dxa : dxa) : (dxb < 0 ? -dxb : dxb)) +
+        2 * ((dya < 0 ? -dya : dya) > (dyb < 0 ? -dyb : dyb)
+	       ? (dya < 0 ? -dya : dya) : (dyb < 0 ? -dyb : dyb)) + 2;
+  return dxa * dxa + dya * dya - bd->r2 + err < 0 &&
+         dxb * dxb + dyb * dyb - bd->r2 + err < 0;
+}
+
+GBool SplashOutRadialPattern::chunkOutside(int ax, int ay, int bx, int by,
+					   SplashOutRadialBound *bd) {
+  double ux, uy, vx, vy, vv, t, wx, wy, r2, err;
+
+  // the smallest power on the segment, in double precision, with a
+  // relative allowance for its rounding
+  ux = (double)ax - bd->cx;
+  uy = (double)ay - bd->cy;
+  vx = (double)bx - ax;
+  vy = (double)by - ay;
+  vv = vx * vx + vy * vy;
+  t = vv > 0 ? -(ux * vx + uy * vy) / vv : 0;
+  if (t < 0) {
+    t = 0;
+  } else if (t > 1) {
+    t = 1;
+  }
+  wx = ux + t * vx;
+  wy = uy + t * vy;
+  r2 = (double)bd->r2;
+  err = 2 * (fabs(ux) > fabs(ux + vx) ? fabs(ux) : fabs(ux + vx)) +
+        2 * (fabs(uy) > fabs(uy + vy) ? fabs(uy) : fabs(uy + vy)) + 2 +
+        (wx * wx + wy * wy + r2) * 1e-12;
+  return wx * wx + wy * wy - r2 > err;
+}
+
+GBool SplashOutRadialPattern::chunkVertex(int ax, int ay, int bx, int by,
+					  SplashOutRadialBound *bd,
+					  GBool above) {
+  FixPtInt64 ba, bb, err;
+
+  ba = (FixPtInt64)ax * dcx + (FixPtInt64)ay * dcy + r0dr;
+  bb = (FixPtInt64)bx * dcx + (FixPtInt64)by * dcy + r0dr;
+  err = (FixPtInt64)abs(dcx) + abs(dcy);
+  if ((sgnA > 0) == above) {
+    return ba - err > bd->at && bb - err > bd->at;
+  }
+  return ba + err < bd->at && bb + err < bd->at;
+}
+
+// Along the chunk, the discriminant is a quadratic in the position;
+// its extreme values are at the ends or at its vertex.  It changes by
+// less than |grad| * 2^-10 (plus a little for the curvature) from the
+// segment to the stepped points.  Where there are no roots, the
+// minimum of the power over s is -disc / |a|, which must also stay
+// above the rounding of the circles, so that all of getIndex's power
+// tests agree.
+GBool SplashOutRadialPattern::chunkDisc(int ax, int ay, int bx, int by,
+					int sign) {
+  double ux, uy, vx, vy, b0, bv, c0, alpha, beta, gamma, d0, d1, dm, t;
+  double xMax, yMax, bMax, err;
+
+  ux = (double)ax / (1 << splashOutRadialFracBits);
+  uy = (double)ay / (1 << splashOutRadialFracBits);
+  vx = (double)(bx - ax) / (1 << splashOutRadialFracBits);
+  vy = (double)(by - ay) / (1 << splashOutRadialFracBits);
+  b0 = ux * dcxD + uy * dcyD + r0D * drD;
+  bv = vx * dcxD + vy * dcyD;
+  c0 = ux * ux + uy * uy - r0D * r0D;
+  alpha = bv * bv - aD * (vx * vx + vy * vy);
+  beta = b0 * bv - aD * (ux * vx + uy * vy);
+  gamma = b0 * b0 - aD * c0;
+  d0 = gamma;
+  d1 = alpha + 2 * beta + gamma;
+  dm = d0;
+  if (alpha != 0) {
+    t = -beta / alpha;
+    if (t > 0 && t < 1) {
+      dm = gamma + beta * t;
+    }
+  }
+
+  xMax = fabs(ux) > fabs(ux + vx) ? fabs(ux) : fabs(ux + vx);
+  yMax = fabs(uy) > fabs(uy + vy) ? fabs(uy) : fabs(uy + vy);
+  bMax = fabs(b0) > fabs(b0 + bv) ? fabs(b0) : fabs(b0 + bv);
+  err = (2 * bMax * (fabs(dcxD) + fabs(dcyD)) +
+	 2 * fabs(aD) * (xMax + yMax)) / (1 << splashOutRadialFracBits) +
+        1e-4 +
+        (bMax * bMax + fabs(aD) * (xMax * xMax + yMax * yMax +
+				   r0D * r0D)) * 1e-12;
+  if (sign > 0) {
+    return d0 > err && d1 > err && dm > err;
+  }
+  err += fabs(aD) * ((xMax + yMax) / (1 << splashOutRadialFracBits) +
+		     circleErr);
+  return d0 < -err && d1 < -err && dm < -err;
+}
+
+// A chunk is filled only if each point in it satisfies the tests that
+// getIndex makes, with the roots shown to exist: <i> if the cell's
+// lower boundary is between the roots, or below the vertex (for cell
+// 0: the start of the domain is between the roots, or the start is
+// unlimited), and the upper one is neither (or, at the top, the end
+// is unlimited); -1 if there are no roots, if the two limits are
+// between them, or if both roots are beyond one of the limits.
+GBool SplashOutRadialPattern::chunkIndex(int i, int ax, int ay,
+					 int bx, int by) {
+  SplashOutRadialBound *bd;
+
+  if (sgnA == 0) {
+    return gFalse;
+  }
+  if (i < 0) {
+    return chunkDisc(ax, ay, bx, by, -1) ||
+           (!loInf && !hiInf &&
+	    chunkPowerNeg(ax, ay, bx, by, &hiBd) &&
+	    chunkPowerNeg(ax, ay, bx, by, &loBd)) ||
+           (!hiInf &&
+	    chunkVertex(ax, ay, bx, by, &hiBd, gTrue) &&
+	    chunkPowerPos(ax, ay, bx, by, &hiBd)) ||
+           (!loInf &&
+	    chunkVertex(ax, ay, bx, by, &loBd, gFalse) &&
+	    chunkPowerPos(ax, ay, bx, by, &loBd));
+  }
+  if (i == 0) {
+    if (loInf ? !chunkDisc(ax, ay, bx, by, 1)
+              : !chunkPowerNeg(ax, ay, bx, by, &loBd)) {
+      return gFalse;
+    }
+    bd = &cellBd[0];
+  } else {
+    bd = &cellBd[i - 1];
+    if (!chunkPowerNeg(ax, ay, bx, by, bd) &&
+	!(chunkVertex(ax, ay, bx, by, bd, gTrue) &&
+	  chunkDisc(ax, ay, bx, by, 1))) {
+      return gFalse;
+    }
+    if (i < splashOutShadingLUTSize - 1) {
+      bd = &cellBd[i];
+    } else if (!hiInf) {
+      bd = &hiBd;
+    } else {
+      return gTrue;
+    }
+  }
+  return chunkVertex(ax, ay, bx, by, bd, gFalse) &&
+         chunkPowerPos(ax, ay, bx, by, bd);
+}
+
+// The point is stepped along the row, and each pixel's cells start at
+// the previous pixel's, so it usually takes two comparisons.  Where
+// the cells are wide, chunks of up to splashOutRadialChunk pixels get
+// the first pixel's color; the chunk length adapts to how often that
+// works.
+void SplashOutRadialPattern::getColorSpan(int x0, int x1, int y,
+					  SplashColorPtr cc, Guchar *paint) {
+  FixPtInt64 px, py, pxEnd, pyEnd;
+  int x, i, n, k, c1, c2, ax, ay, bx, by, tryX, wait, failI;
+
+  px = mat[0] * x0 + mat[2] * y + mat[4];
+  py = mat[1] * x0 + mat[3] * y + mat[5];
+  pxEnd = px + mat[0] * (x1 - x0);
+  pyEnd = py + mat[1] * (x1 - x0);
+  if (px >= ((FixPtInt64)splashOutRadialMaxCoord << 32) ||
+      px <= -((FixPtInt64)splashOutRadialMaxCoord << 32) ||
+      py >= ((FixPtInt64)splashOutRadialMaxCoord << 32) ||
+      py <= -((FixPtInt64)splashOutRadialMaxCoord << 32) ||
+      pxEnd >= ((FixPtInt64)splashOutRadialMaxCoord << 32) ||
+      pxEnd <= -((FixPtInt64)splashOutRadialMaxCoord << 32) ||
+      pyEnd >= ((FixPtInt64)splashOutRadialMaxCoord << 32) ||
+      pyEnd <= -((FixPtInt64)splashOutRadialMaxCoord << 32)) {
+    memset(paint, 0, x1 - x0 + 1);
+    return;
+  }
+  c1 = cell1;
+  c2 = cell2;
+  n = splashOutRadialChunk;
+  tryX = x0;
+  wait = 4;
+  failI = -2;
+  for (x = x0; x <= x1; ++x, cc += splashMaxColorComps) {
+    ax = (int)(px >> (32 - splashOutRadialFracBits));
+    ay = (int)(py >> (32 - splashOutRadialFracBits));
+    i = getIndex(ax, ay, &c1, &c2);
+    if (i >= 0) {
+      *paint++ = 1;
+      splashColorCopy(cc, &lut[i * splashMaxColorComps]);
+    } else {
+      *paint++ = 0;
+    }
+    px += mat[0];
+    py += mat[1];
+    if ((x >= tryX || (i != failI && n > 8)) && x < x1) {
+      k = x1 - x < n ? x1 - x : n;
+      bx = (int)((px + mat[0] * (k - 1)) >> (32 - splashOutRadialFracBits));
+      by = (int)((py + mat[1] * (k - 1)) >> (32 - splashOutRadialFracBits));
+      if (chunkIndex(i, ax, ay, bx, by)) {
+	px += mat[0] * k;
+	py += mat[1] * k;
+	x += k;
+	if (i >= 0) {
+	  for (; k > 0; --k) {
+	    cc += splashMaxColorComps;
+	    *paint++ = 1;
+	    splashColorCopy(cc, &lut[i * splashMaxColorComps]);
+	  }
+	} else {
+	  memset(paint, 0, k);
+	  paint += k;
+	  cc += k * splashMaxColorComps;
+	}
+	if (n < splashOutRadialChunk) {
+	  n *= 2;
+	}
+	wait = 4;
+      } else {
+	// where the cells are about a pixel wide, back off
+	if (n > 4) {
+	  n /= 2;
+	  wait = n;
+	} else if (wait < splashOutRadialChunk) {
+	  wait *= 2;
+	}
+	tryX = x + wait;
+	failI = i;
+      }
+    }
+  }
+  cell1 = c1;
+  cell2 = c2;
+}
+
 //------------------------------------------------------------------------
 // SplashTransparencyGroup
 //------------------------------------------------------------------------
@@ -567,6 +1634,8 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
 				 SplashColorPtr paperColorA,
 				 GBool bitmapTopDownA,
 				 GBool allowAntialiasA) {
+  GooString *fontCacheDir;
+
   colorMode = colorModeA;
   bitmapRowPad = bitmapRowPadA;
   bitmapTopDown = bitmapTopDownA;
@@ -586,15 +1655,26 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
   splash->clear(paperColor, 0);
 
   fontEngine = NULL;
+  fontCacheSize = splashFontCacheSize;
+  glyphCacheSize = splashGlyphCacheSize;
+  embFontCache = NULL;
+  if ((fontCacheDir = globalParams->getFontCacheDir())) {
+    embFontCache = new EmbFontCache(fontCacheDir);
+    delete fontCacheDir;
+  }
 
   nT3Fonts = 0;
   t3GlyphStack = NULL;
 
   font = NULL;
+  charRun = NULL;
+  charRunSize = 0;
   needFontUpdate = gFalse;
   textClipPath = NULL;
 
   transpGroupStack = NULL;
+
+  imageCache = new SplashOutImageCache(splashOutImageCacheSize);
 }
 
 void SplashOutputDev::setupScreenParams(FixedPoint hDPI, FixedPoint vDPI) {
@@ -654,6 +1734,10 @@ SplashOutputDev::~SplashOutputDev() {
   for (i = 0; i < nT3Fonts; ++i) {
     delete t3FontCache[i];
   }
+  delete imageCache;
+  if (embFontCache) {
+    delete embFontCache;
+  }
   if (fontEngine) {
     delete fontEngine;
   }
@@ -663,6 +1747,7 @@ SplashOutputDev::~SplashOutputDev() {
   if (bitmap) {
     delete bitmap;
   }
+  gfree(charRun);
 }
 
 void SplashOutputDev::startDoc(XRef *xrefA) {
@@ -682,10 +1767,13 @@ void SplashOutputDev::startDoc(XRef *xrefA) {
 				    allowAntialias &&
 				      globalParams->getAntialias() &&
 				      colorMode != splashModeMono1);
+  fontEngine->setFontCacheSize(fontCacheSize);
+  fontEngine->getGlyphCache()->setMaxBytes(glyphCacheSize);
   for (i = 0; i < nT3Fonts; ++i) {
     delete t3FontCache[i];
   }
   nT3Fonts = 0;
+  imageCache->clear();
 }
 
 void SplashOutputDev::startPage(int pageNum, GfxState *state) {
@@ -707,6 +1795,9 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state) {
   } else {
     w = h = 1;
   }
+  if (fontEngine) {
+    fontEngine->resetStats();
+  }
   if (splash) {
     delete splash;
   }
@@ -890,8 +1981,23 @@ SplashPattern *SplashOutputDev::getColor(GfxGray gray, GfxRGB *rgb,
 #else
 SplashPattern *SplashOutputDev::getColor(GfxGray gray, GfxRGB *rgb) {
 #endif
-  SplashPattern *pattern;
   SplashColor color;
+
+#if SPLASH_CMYK
+  convertColor(gray, rgb, cmyk, color);
+#else
+  convertColor(gray, rgb, color);
+#endif
+  return new SplashSolidColor(color);
+}
+
+#if SPLASH_CMYK
+void SplashOutputDev::convertColor(GfxGray gray, GfxRGB *rgb, GfxCMYK *cmyk,
+				   SplashColorPtr color) {
+#else
+void SplashOutputDev::convertColor(GfxGray gray, GfxRGB *rgb,
+				   SplashColorPtr color) {
+#endif
   GfxColorComp r, g, b;
 
   if (reverseVideo) {
@@ -905,13 +2011,11 @@ SplashPattern *SplashOutputDev::getColor(GfxGray gray, GfxRGB *rgb) {
     b = rgb->b;
   }
 
-  pattern = NULL; // make gcc happy
   switch (colorMode) {
   case splashModeMono1:
   case splashModeMono4:
   case splashModeMono8:
     color[0] = colToByte(gray);
-    pattern = new SplashSolidColor(color);
     break;
   case splashModeXBGR8:
     color[3] = 255;
@@ -920,7 +2024,6 @@ SplashPattern *SplashOutputDev::getColor(GfxGray gray, GfxRGB *rgb) {
     color[0] = colToByte(r);
     color[1] = colToByte(g);
     color[2] = colToByte(b);
-    pattern = new SplashSolidColor(color);
     break;
 #if SPLASH_CMYK
   case splashModeCMYK8:
@@ -928,12 +2031,9 @@ SplashPattern *SplashOutputDev::getColor(GfxGray gray, GfxRGB *rgb) {
     color[1] = colToByte(cmyk->m);
     color[2] = colToByte(cmyk->y);
     color[3] = colToByte(cmyk->k);
-    pattern = new SplashSolidColor(color);
     break;
 #endif
   }
-
-  return pattern;
 }
 
 void SplashOutputDev::updateBlendMode(GfxState *state) {
@@ -965,6 +2065,8 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
   char *tmpBuf;
   int tmpBufLen;
   Gushort *codeToGID;
+  GooString *cacheKey;
+  GBool cacheHit;
   DisplayFontParam *dfp;
   FixedPoint *textMat;
   FixedPoint m11, m12, m21, m22, fontSize;
@@ -978,6 +2080,10 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
   font = NULL;
   fileName = NULL;
   tmpBuf = NULL;
+  codeToGID = NULL;
+  n = 0;
+  cacheKey = NULL;
+  cacheHit = gFalse;
   substIdx = -1;
   dfp = NULL;
 
@@ -997,9 +2103,19 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
 
   } else {
 
-    // if there is an embedded font, write it to disk
+    // if there is an embedded font, read it into memory -- the
+    // SplashFontSrc owns the buffer and FreeType reads it in place;
+    // fonts seen before (in any document) come from the converted
+    // font cache, along with their code-to-GID maps
     if (gfxFont->getEmbeddedFontID(&embRef)) {
-      tmpBuf = gfxFont->readEmbFontFile(xref, &tmpBufLen);
+      if (embFontCache &&
+	  (cacheKey = embFontCache->getKey(gfxFont, xref))) {
+	cacheHit = embFontCache->lookup(cacheKey, &tmpBuf, &tmpBufLen,
+					&codeToGID, &n);
+      }
+      if (!cacheHit) {
+	tmpBuf = gfxFont->readEmbFontFile(xref, &tmpBufLen);
+      }
       if (! tmpBuf)
 	goto err2;
 
@@ -1073,17 +2189,20 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
       break;
     case fontTrueType:
     case fontTrueTypeOT:
+      // on a cache hit, codeToGID and n were read from the cache
+      if (!cacheHit) {
 	if (fileName)
-	 ff = FoFiTrueType::load(fileName->getCString());
+	  ff = FoFiTrueType::load(fileName->getCString());
 	else
-	ff = FoFiTrueType::make(tmpBuf, tmpBufLen);
-      if (ff) {
-	codeToGID = ((Gfx8BitFont *)gfxFont)->getCodeToGIDMap(ff);
-	n = 256;
-	delete ff;
-      } else {
-	codeToGID = NULL;
-	n = 0;
+	  ff = FoFiTrueType::make(tmpBuf, tmpBufLen);
+	if (ff) {
+	  codeToGID = ((Gfx8BitFont *)gfxFont)->getCodeToGIDMap(ff);
+	  n = 256;
+	  delete ff;
+	} else {
+	  codeToGID = NULL;
+	  n = 0;
+	}
       }
       if (!(fontFile = fontEngine->loadTrueTypeFont(
 			   id,
@@ -1118,8 +2237,6 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
       break;
     case fontCIDType2:
     case fontCIDType2OT:
-      codeToGID = NULL;
-      n = 0;
       if (((GfxCIDFont *)gfxFont)->getCIDToGID()) {
 	n = ((GfxCIDFont *)gfxFont)->getCIDToGIDLen();
 	if (n) {
@@ -1127,7 +2244,8 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
 	  memcpy(codeToGID, ((GfxCIDFont *)gfxFont)->getCIDToGID(),
 		  n * sizeof(Gushort));
 	}
-      } else {
+      // on a cache hit, codeToGID and n were read from the cache
+      } else if (!cacheHit) {
 	if (fileName)
 	  ff = FoFiTrueType::load(fileName->getCString());
 	else
@@ -1152,6 +2270,16 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
       goto err2;
     }
     fontFile->doAdjustMatrix = gTrue;
+    if (cacheKey) {
+      if (!cacheHit) {
+	if (EmbFontCache::needsCodeToGIDMap(gfxFont)) {
+	  embFontCache->store(cacheKey, tmpBuf, tmpBufLen, codeToGID, n);
+	} else {
+	  embFontCache->store(cacheKey, tmpBuf, tmpBufLen, NULL, 0);
+	}
+      }
+      delete cacheKey;
+    }
   }
 
   // get the font matrix
@@ -1208,6 +2336,9 @@ void SplashOutputDev::doUpdateFont(GfxState *state) {
 
  err2:
   delete id;
+  if (cacheKey) {
+    delete cacheKey;
+  }
  err1:
   if (fontsrc && !fontsrc->isFile)
       fontsrc->unref();
@@ -1253,6 +2384,222 @@ void SplashOutputDev::eoFill(GfxState *state) {
   delete path;
 }
 
+GBool SplashOutputDev::axialShadedFill(GfxState *state,
+				       GfxAxialShading *shading) {
+  FixedPoint *ctm;
+  FixedPoint x0F, y0F, x1F, y1F;
+  double m[6], x0, y0, dx, dy, ddx, ddy, qx, qy, px0, py0, den;
+  double a, b, c;
+
+  if (shading->getColorSpace()->isNonMarking()) {
+    return gTrue;
+  }
+
+  // t is constant along the lines perpendicular to the axis (in user
+  // space); with D = the axis and Q = the direction of those lines
+  // (both in device space), and P0 = the start of the axis:
+  //   s = ((p - P0) x Q) / (D x Q)
+  ctm = state->getCTM();
+  m[0] = ctm[0]; m[1] = ctm[1]; m[2] = ctm[2];
+  m[3] = ctm[3]; m[4] = ctm[4]; m[5] = ctm[5];
+  shading->getCoords(&x0F, &y0F, &x1F, &y1F);
+  x0 = x0F;
+  y0 = y0F;
+  dx = (double)x1F - x0;
+  dy = (double)y1F - y0;
+  ddx = m[0] * dx + m[2] * dy;
+  ddy = m[1] * dx + m[3] * dy;
+  qx = -m[0] * dy + m[2] * dx;
+  qy = -m[1] * dy + m[3] * dx;
+  px0 = m[0] * x0 + m[2] * y0 + m[4];
+  py0 = m[1] * x0 + m[3] * y0 + m[5];
+  den = ddx * qy - ddy * qx;
+  if (den == 0) {
+    return gFalse;
+  }
+  a = qy / den;
+  b = -qx / den;
+  c = ((0.5 - px0) * qy - (0.5 - py0) * qx) / den;
+
+  // leave axes shorter than a thousandth of a pixel, or very far from
+  // the page, to the generic code
+  if (fabs(a) > 1024 || fabs(b) > 1024 || fabs(c) > (1 << 24)) {
+    return gFalse;
+  }
+
+  return shadedFill(state, new SplashOutAxialPattern(
+			      makeShadingLUT(shading, shading->getDomain0(),
+					     shading->getDomain1()),
+			      shading->getExtend0(), shading->getExtend1(),
+			      splashOutFix32(a), splashOutFix32(b),
+			      splashOutFix32(c)));
+}
+
+GBool SplashOutputDev::radialShadedFill(GfxState *state,
+					GfxRadialShading *shading) {
+  FixedPoint *ctm;
+  FixedPoint x0F, y0F, r0F, x1F, y1F, r1F;
+  FixedPoint xMinF, yMinF, xMaxF, yMaxF;
+  double m[6], im[4], mat[6];
+  double x0, y0, r0, dcx, dcy, dr, det, f2, unit, scale, t, x, y;
+  int i;
+
+  if (shading->getColorSpace()->isNonMarking()) {
+    return gTrue;
+  }
+
+  ctm = state->getCTM();
+  m[0] = ctm[0]; m[1] = ctm[1]; m[2] = ctm[2];
+  m[3] = ctm[3]; m[4] = ctm[4]; m[5] = ctm[5];
+  det = m[0] * m[3] - m[1] * m[2];
+  if (det == 0) {
+    return gFalse;
+  }
+  im[0] = m[3] / det;
+  im[1] = -m[1] / det;
+  im[2] = -m[2] / det;
+  im[3] = m[0] / det;
+
+  // the pixel unit is the smallest singular value of the inverse CTM:
+  // no shading space vector of that length is longer than a pixel
+  // (the inverse's determinant is 1 / det)
+  f2 = im[0] * im[0] + im[1] * im[1] + im[2] * im[2] + im[3] * im[3];
+  t = 2 / fabs(det);
+  unit = 0.5 * (sqrt(f2 + t) - sqrt(f2 > t ? f2 - t : 0));
+  if (!(unit > 0)) {
+    return gFalse;
+  }
+
+  // the geometry is scaled so that the largest of dc and the two radii
+  // is 1; leave negative radii, and circles smaller than a thousandth
+  // of a pixel, to the generic code
+  shading->getCoords(&x0F, &y0F, &r0F, &x1F, &y1F, &r1F);
+  x0 = x0F;
+  y0 = y0F;
+  r0 = r0F;
+  dcx = (double)x1F - x0;
+  dcy = (double)y1F - y0;
+  dr = (double)r1F - r0;
+  if (r0 < 0 || r0 + dr < 0) {
+    return gFalse;
+  }
+  scale = fabs(dcx);
+  if (fabs(dcy) > scale) {
+    scale = fabs(dcy);
+  }
+  if (r0 > scale) {
+    scale = r0;
+  }
+  if (r0 + dr > scale) {
+    scale = r0 + dr;
+  }
+  if (scale / unit < 1.0 / 1024 ||
+      scale / unit >= splashOutRadialMaxCoord) {
+    return gFalse;
+  }
+
+  // device pixel center -> pixel units, relative to the first
+  // circle's center; very skewed matrices are left to the generic code
+  for (i = 0; i < 4; ++i) {
+    mat[i] = im[i] / unit;
+    if (fabs(mat[i]) > 1024) {
+      return gFalse;
+    }
+  }
+  mat[4] = (im[0] * (0.5 - m[4]) + im[2] * (0.5 - m[5]) - x0) / unit;
+  mat[5] = (im[1] * (0.5 - m[4]) + im[3] * (0.5 - m[5]) - y0) / unit;
+
+  // the painted area, and the extension limits where the radius
+  // becomes zero, must be within splashOutRadialMaxCoord
+  state->getClipBBox(&xMinF, &yMinF, &xMaxF, &yMaxF);
+  for (i = 0; i < 4; ++i) {
+    x = (i & 1) ? (double)xMaxF + 2 : (double)xMinF - 2;
+    y = (i & 2) ? (double)yMaxF + 2 : (double)yMinF - 2;
+    if (fabs(mat[0] * x + mat[2] * y + mat[4]) >= splashOutRadialMaxCoord ||
+	fabs(mat[1] * x + mat[3] * y + mat[5]) >= splashOutRadialMaxCoord) {
+      return gFalse;
+    }
+  }
+  if ((shading->getExtend0() && dr > 0) ||
+      (shading->getExtend1() && dr < 0)) {
+    if (fabs(r0 / dr) * scale / unit >= splashOutRadialMaxCoord) {
+      return gFalse;
+    }
+  }
+
+  return shadedFill(state, new SplashOutRadialPattern(
+			      makeShadingLUT(shading, shading->getDomain0(),
+					     shading->getDomain1()),
+			      shading->getExtend0(), shading->getExtend1(),
+			      mat, dcx / scale, dcy / scale, r0 / unit,
+			      dr / scale, scale / unit));
+}
+
+// Sample the shading function at splashOutShadingLUTSize evenly
+// spaced points of [t0, t1].
+Guchar *SplashOutputDev::makeShadingLUT(GfxShading *shading,
+					FixedPoint t0, FixedPoint t1) {
+  Guchar *lut;
+  GfxColorSpace *colorSpace;
+  GfxColor color;
+  GfxGray gray;
+  GfxRGB rgb;
+#if SPLASH_CMYK
+  GfxCMYK cmyk;
+#endif
+  FixedPoint t;
+  int i;
+
+  lut = (Guchar *)gmallocn(splashOutShadingLUTSize, splashMaxColorComps);
+  colorSpace = shading->getColorSpace();
+  for (i = 0; i < splashOutShadingLUTSize; ++i) {
+    t = t0 + (t1 - t0) * i / (splashOutShadingLUTSize - 1);
+    if (shading->getType() == 2) {
+      ((GfxAxialShading *)shading)->getColor(t, &color);
+    } else {
+      ((GfxRadialShading *)shading)->getColor(t, &color);
+    }
+    colorSpace->getGray(&color, &gray);
+    colorSpace->getRGB(&color, &rgb);
+#if SPLASH_CMYK
+    colorSpace->getCMYK(&color, &cmyk);
+    convertColor(gray, &rgb, &cmyk, &lut[i * splashMaxColorComps]);
+#else
+    convertColor(gray, &rgb, &lut[i * splashMaxColorComps]);
+#endif
+  }
+  return lut;
+}
+
+// Fill the clip region with <pattern>, which is deleted afterward.
+// The region is built in device space: inverting a shading-space CTM
+// (e.g., one that maps the unit square to the page) in fixed point
+// is not precise enough.
+GBool SplashOutputDev::shadedFill(GfxState *state, SplashPattern *pattern) {
+  SplashPath *path;
+  SplashCoord savedMatrix[6], identity[6];
+  FixedPoint xMin, yMin, xMax, yMax;
+  int i;
+
+  state->getClipBBox(&xMin, &yMin, &xMax, &yMax);
+  path = new SplashPath();
+  path->moveTo((SplashCoord)xMin, (SplashCoord)yMin);
+  path->lineTo((SplashCoord)xMax, (SplashCoord)yMin);
+  path->lineTo((SplashCoord)xMax, (SplashCoord)yMax);
+  path->lineTo((SplashCoord)xMin, (SplashCoord)yMax);
+  path->close();
+  for (i = 0; i < 6; ++i) {
+    savedMatrix[i] = splash->getMatrix()[i];
+    identity[i] = (i == 0 || i == 3) ? 1 : 0;
+  }
+  splash->setMatrix(identity);
+  splash->shadedFill(path, pattern);
+  splash->setMatrix(savedMatrix);
+  delete path;
+  delete pattern;
+  return gTrue;
+}
+
 void SplashOutputDev::clip(GfxState *state) {
   SplashPath *path;
 
@@ -1282,9 +2629,17 @@ void SplashOutputDev::clipToStrokePath(GfxState *state) {
 SplashPath *SplashOutputDev::convertPath(GfxState * /*state*/, GfxPath *path) {
   SplashPath *sPath;
   GfxSubpath *subpath;
-  int i, j;
+  int n, i, j;
 
-  sPath = new SplashPath();
+  // the converted path only lives until the operator that painted or
+  // clipped with it returns, so its points go in the same arena as the
+  // GfxPath (if any) -- sized up front, with one extra point per
+  // subpath for close()
+  n = 0;
+  for (i = 0; i < path->getNumSubpaths(); ++i) {
+    n += path->getSubpath(i)->getNumPoints() + 1;
+  }
+  sPath = new SplashPath(path->getArena(), n);
   for (i = 0; i < path->getNumSubpaths(); ++i) {
     subpath = path->getSubpath(i);
     if (subpath->getNumPoints() > 0) {
@@ -1370,6 +2725,37 @@ void SplashOutputDev::drawChar(GfxState *state, FixedPoint x, FixedPoint y,
   }
 }
 
+void SplashOutputDev::drawGlyphRun(GfxState *state, GfxGlyphPos *glyphs,
+				   int nGlyphs) {
+  int render, i;
+
+  // stroked and clipping text needs a glyph path per character
+  render = state->getRender();
+  if (render != 0) {
+    OutputDev::drawGlyphRun(state, glyphs, nGlyphs);
+    return;
+  }
+
+  if (needFontUpdate) {
+    doUpdateFont(state);
+  }
+  if (!font || state->getFillColorSpace()->isNonMarking()) {
+    return;
+  }
+
+  if (nGlyphs > charRunSize) {
+    charRunSize = nGlyphs;
+    charRun = (SplashCharPos *)greallocn(charRun, charRunSize,
+					 sizeof(SplashCharPos));
+  }
+  for (i = 0; i < nGlyphs; ++i) {
+    charRun[i].x = (SplashCoord)(glyphs[i].x - glyphs[i].originX);
+    charRun[i].y = (SplashCoord)(glyphs[i].y - glyphs[i].originY);
+    charRun[i].c = (int)glyphs[i].code;
+  }
+  splash->fillChars(charRun, nGlyphs, font);
+}
+
 GBool SplashOutputDev::beginType3Char(GfxState *state, FixedPoint x, FixedPoint y,
 				      FixedPoint dx, FixedPoint dy,
 				      CharCode code, Unicode *u, int uLen) {
@@ -1660,15 +3046,36 @@ GBool SplashOutputDev::imageMaskSrc(void *data, SplashColorPtr line) {
   SplashOutImageMaskData *imgMaskData = (SplashOutImageMaskData *)data;
   Guchar *p;
   SplashColorPtr q;
-  int x;
+  Guchar inv;
+  int x, c, i, n;
 
   if (imgMaskData->y == imgMaskData->height) {
     return gFalse;
   }
-  for (x = 0, p = imgMaskData->imgStr->getLine(), q = line;
-       x < imgMaskData->width;
-       ++x) {
-    *q++ = *p++ ^ imgMaskData->invert;
+
+  // expand the packed 1-bit row directly, folding in the inversion
+  // one byte (eight pixels) at a time
+  p = imgMaskData->imgStr->getPackedLine();
+  q = line;
+  inv = imgMaskData->invert ? 0xff : 0x00;
+  for (x = 0; x + 8 <= imgMaskData->width; x += 8) {
+    c = *p++ ^ inv;
+    q[0] = (Guchar)((c >> 7) & 1);
+    q[1] = (Guchar)((c >> 6) & 1);
+    q[2] = (Guchar)((c >> 5) & 1);
+    q[3] = (Guchar)((c >> 4) & 1);
+    q[4] = (Guchar)((c >> 3) & 1);
+    q[5] = (Guchar)((c >> 2) & 1);
+    q[6] = (Guchar)((c >> 1) & 1);
+    q[7] = (Guchar)(c & 1);
+    q += 8;
+  }
+  if (x < imgMaskData->width) {
+    c = *p ^ inv;
+    n = imgMaskData->width - x;
+    for (i = 0; i < n; ++i) {
+      *q++ = (Guchar)((c >> (7 - i)) & 1);
+    }
   }
   ++imgMaskData->y;
   return gTrue;
@@ -1706,7 +3113,7 @@ void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
 			t3GlyphStack != NULL);
   if (inlineImg) {
     while (imgMaskData.y < height) {
-      imgMaskData.imgStr->getLine();
+      imgMaskData.imgStr->getPackedLine();
       ++imgMaskData.y;
     }
   }
@@ -1721,6 +3128,9 @@ struct SplashOutImageData {
   SplashColorPtr lookup;
   int *maskColors;
   SplashColorMode colorMode;
+  int nComps;			// components per pixel delivered by imgStr
+  GBool grayDecoded;		// set if imgStr delivers the gray values
+				//   of a plain RGB image (see drawImage)
   int width, height, y;
 };
 
@@ -1740,7 +3150,7 @@ GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr colorLine,
     return gFalse;
   }
 
-  nComps = imgData->colorMap->getNumPixelComps();
+  nComps = imgData->nComps;
 
   if (imgData->lookup) {
     switch (imgData->colorMode) {
@@ -1794,24 +3204,15 @@ GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr colorLine,
     case splashModeMono1:
     case splashModeMono4:
     case splashModeMono8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, p += nComps) {
-		if (nComps == 1) {
-			*q++ = *p;
-		} else if (nComps == 3) {
-			*q++ = (p[0] * 77 +  p[1] * 151 + p[2] * 28) >> 8;
-		} else {
-			int c = p[0];
-			int m = p[1];
-			int y = p[2];
-			int k = p[3];
-			int gray = 3 * (255 - (c + k)) / 10 + 6 * (255 - (m + k)) / 10 + (255 - (y + k)) / 9;
-			*q++ = (gray > 255 ? 255 : (gray < 0 ? 0 : gray));
- 		}
+      p = imgData->imgStr->getLine();
+      if (imgData->grayDecoded) {
+	// the decoder has already converted the image to gray
+	memcpy(colorLine, p, imgData->width);
+      } else {
+	imgData->colorMap->getGrayLine(p, colorLine, imgData->width);
       }
-	break;
-	case splashModeXBGR8:
+      break;
+    case splashModeXBGR8:
     case splashModeRGB8:
     case splashModeBGR8:
       for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
@@ -1863,7 +3264,16 @@ GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr colorLine,
 
   nComps = imgData->colorMap->getNumPixelComps();
 
-  for (x = 0, p = imgData->imgStr->getLine(), q = colorLine, aq = alphaLine;
+  // in the mono modes, convert the whole row up front
+  p = imgData->imgStr->getLine();
+  if (!imgData->lookup &&
+      (imgData->colorMode == splashModeMono1 ||
+       imgData->colorMode == splashModeMono4 ||
+       imgData->colorMode == splashModeMono8)) {
+    imgData->colorMap->getGrayLine(p, colorLine, imgData->width);
+  }
+
+  for (x = 0, q = colorLine, aq = alphaLine;
        x < imgData->width;
        ++x, p += nComps) {
     alpha = 0;
@@ -1914,13 +3324,8 @@ GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr colorLine,
       case splashModeMono1:
       case splashModeMono4:
       case splashModeMono8:
-	if (nComps == 1) {
-		*q++ = *p;
-	} else {
-		*q++ = (p[0] * 77 +  p[1] * 151 + p[2] * 28) >> 8;
-	}
-//	imgData->colorMap->getGray(p, &gray);
-//	*q++ = colToByte(gray);
+	// converted above
+	++q;
 	*aq++ = alpha;
 	break;
       case splashModeXBGR8:
@@ -1951,6 +3356,53 @@ GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr colorLine,
   return gTrue;
 }
 
+struct SplashOutCachedImageData {
+  SplashOutImageCacheEntry *entry;
+  int y;
+};
+
+GBool SplashOutputDev::cachedImageSrc(void *data, SplashColorPtr colorLine,
+				      Guchar *alphaLine) {
+  SplashOutCachedImageData *imgData = (SplashOutCachedImageData *)data;
+  SplashOutImageCacheEntry *entry = imgData->entry;
+  int rowSize;
+
+  if (imgData->y == entry->height) {
+    return gFalse;
+  }
+  rowSize = entry->width * splashColorModeNComps[entry->mode];
+  memcpy(colorLine, entry->data + imgData->y * rowSize, rowSize);
+  if (alphaLine) {
+    memcpy(alphaLine, entry->alphaData + imgData->y * entry->width,
+	   entry->width);
+  }
+  ++imgData->y;
+  return gTrue;
+}
+
+// Returns true if <colorMap> maps samples to DeviceRGB (directly or
+// as the alternate of an ICCBased space) with the identity decode,
+// i.e., if the gray value of a pixel is the luma of its samples --
+// which is what a decoder that outputs gray computes.
+static GBool splashOutIsPlainRGB(GfxImageColorMap *colorMap) {
+  GfxColorSpace *colorSpace;
+  int i;
+
+  colorSpace = colorMap->getColorSpace();
+  if (colorSpace->getMode() == csICCBased) {
+    colorSpace = ((GfxICCBasedColorSpace *)colorSpace)->getAlt();
+  }
+  if (colorSpace->getMode() != csDeviceRGB) {
+    return gFalse;
+  }
+  for (i = 0; i < 3; ++i) {
+    if (colorMap->getDecodeLow(i) != 0 || colorMap->getDecodeHigh(i) != 1) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
 void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
 				int width, int height,
 				GfxImageColorMap *colorMap,
@@ -1961,6 +3413,8 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   FixedPoint *ctm;
   SplashCoord mat[6];
   SplashOutImageData imgData;
+  SplashOutCachedImageData cachedData;
+  SplashOutImageCacheEntry *cacheEntry;
   SplashColorMode srcMode;
   SplashImageSource src;
   GfxGray gray;
@@ -1969,7 +3423,8 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   GfxCMYK cmyk;
 #endif
   Guchar pix;
-  int n, i;
+  GBool grayOut, cacheable;
+  int scaledWidth, scaledHeight, n, i;
 
   ctm = state->getCTM();
   mat[0] = ctm[0];
@@ -1979,8 +3434,52 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   mat[4] = ctm[2] + ctm[4];
   mat[5] = ctm[3] + ctm[5];
 
+  if (colorMode == splashModeMono1 || colorMode == splashModeMono4) {
+    srcMode = splashModeMono8;
+  } else {
+    srcMode = colorMode;
+  }
+
+  // image XObjects are kept in the cache at the size they are drawn
+  // at, so redrawing the page doesn't need to decode them again
+  cacheable = !inlineImg && ref && ref->isRef() &&
+              Splash::getImageScaledSize(mat, &scaledWidth, &scaledHeight);
+  if (cacheable) {
+    cacheEntry = imageCache->lookup(ref->getRef(), scaledWidth, scaledHeight,
+				    srcMode, maskColors != NULL);
+    if (cacheEntry) {
+      cachedData.entry = cacheEntry;
+      cachedData.y = 0;
+      splash->drawImage(&cachedImageSrc, &cachedData, srcMode,
+			cacheEntry->alpha, cacheEntry->width,
+			cacheEntry->height, mat);
+      return;
+    }
+  }
+
+  // let the decoder drop the resolution (and, in the mono modes, the
+  // chroma of plain RGB images) that would be averaged away by Splash
+  // anyway; mat maps the unit square, so it is not affected by the
+  // size change (indexed images are left alone: their samples can't
+  // be averaged)
+  imgData.nComps = colorMap->getNumPixelComps();
+  imgData.grayDecoded = gFalse;
+  if (!inlineImg && colorMap->getColorSpace()->getMode() != csIndexed) {
+    grayOut = (colorMode == splashModeMono1 || colorMode == splashModeMono4 ||
+		colorMode == splashModeMono8) &&
+              imgData.nComps == 3 && !maskColors &&
+              splashOutIsPlainRGB(colorMap);
+    str->setReducedDecode(splashCeil(splashDist(0, 0, mat[0], mat[1])),
+			  splashCeil(splashDist(0, 0, mat[2], mat[3])),
+			  &width, &height, &grayOut);
+    if (grayOut) {
+      imgData.nComps = 1;
+      imgData.grayDecoded = gTrue;
+    }
+  }
+
   imgData.imgStr = new ImageStream(str, width,
-				   colorMap->getNumPixelComps(),
+				   imgData.nComps,
 				   colorMap->getBits());
   imgData.imgStr->reset();
   imgData.colorMap = colorMap;
@@ -2046,14 +3545,29 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
     }
   }
 
-  if (colorMode == splashModeMono1 || colorMode == splashModeMono4) {
-    srcMode = splashModeMono8;
+  src = maskColors ? &alphaImageSrc : &imageSrc;
+  cacheEntry = NULL;
+  if (cacheable) {
+    // dimensions that are being enlarged are cached at the image's
+    // own size
+    cacheEntry = imageCache->add(ref->getRef(), scaledWidth, scaledHeight,
+				 srcMode, maskColors != NULL,
+				 width < scaledWidth ? width : scaledWidth,
+				 height < scaledHeight ? height : scaledHeight);
+  }
+  if (cacheEntry) {
+    Splash::scaleImage(src, &imgData, srcMode, cacheEntry->alpha,
+		       width, height, cacheEntry->width, cacheEntry->height,
+		       cacheEntry->data, cacheEntry->alphaData);
+    cachedData.entry = cacheEntry;
+    cachedData.y = 0;
+    splash->drawImage(&cachedImageSrc, &cachedData, srcMode,
+		      cacheEntry->alpha, cacheEntry->width,
+		      cacheEntry->height, mat);
   } else {
-    srcMode = colorMode;
+    splash->drawImage(src, &imgData, srcMode, maskColors ? gTrue : gFalse,
+		      width, height, mat);
   }
-  src = maskColors ? &alphaImageSrc : &imageSrc;
-  splash->drawImage(src, &imgData, srcMode, maskColors ? gTrue : gFalse,
-		    width, height, mat);
   if (inlineImg) {
     while (imgData.y < height) {
       imgData.imgStr->getLine();
@@ -2095,7 +3609,16 @@ GBool SplashOutputDev::maskedImageSrc(void *data, SplashColorPtr colorLine,
 
   nComps = imgData->colorMap->getNumPixelComps();
 
-  for (x = 0, p = imgData->imgStr->getLine(), q = colorLine, aq = alphaLine;
+  // in the mono modes, convert the whole row up front
+  p = imgData->imgStr->getLine();
+  if (!imgData->lookup &&
+      (imgData->colorMode == splashModeMono1 ||
+       imgData->colorMode == splashModeMono4 ||
+       imgData->colorMode == splashModeMono8)) {
+    imgData->colorMap->getGrayLine(p, colorLine, imgData->width);
+  }
+
+  for (x = 0, q = colorLine, aq = alphaLine;
        x < imgData->width;
        ++x, p += nComps) {
     imgData->mask->getPixel(x, imgData->y, maskColor);
@@ -2140,13 +3663,8 @@ GBool SplashOutputDev::maskedImageSrc(void *data, SplashColorPtr colorLine,
       case splashModeMono1:
       case splashModeMono4:
       case splashModeMono8:
-	if (nComps == 1) {
-		*q++ = *p;
-	} else {
-		*q++ = (p[0] * 77 +  p[1] * 151 + p[2] * 28) >> 8;
-	}
-//	imgData->colorMap->getGray(p, &gray);
-//	*q++ = colToByte(gray);
+	// converted above
+	++q;
 	*aq++ = alpha;
 	break;
       case splashModeXBGR8:
@@ -2373,6 +3891,8 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
 				       maskColorMap->getBits());
   imgMaskData.imgStr->reset();
   imgMaskData.colorMap = maskColorMap;
+  imgMaskData.nComps = maskColorMap->getNumPixelComps();
+  imgMaskData.grayDecoded = gFalse;
   imgMaskData.maskColors = NULL;
   imgMaskData.colorMode = splashModeMono8;
   imgMaskData.width = maskWidth;
@@ -2406,6 +3926,8 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
 				   colorMap->getBits());
   imgData.imgStr->reset();
   imgData.colorMap = colorMap;
+  imgData.nComps = colorMap->getNumPixelComps();
+  imgData.grayDecoded = gFalse;
   imgData.maskColors = NULL;
   imgData.colorMode = colorMode;
   imgData.width = width;
@@ -2826,6 +4348,64 @@ void SplashOutputDev::setFillColor(int r, int g, int b) {
 #endif
 }
 
+void SplashOutputDev::setImageCacheSize(int maxBytes) {
+  imageCache->setMaxBytes(maxBytes);
+}
+
+int SplashOutputDev::getImageCacheHits() {
+  return imageCache->getHits();
+}
+
+int SplashOutputDev::getImageCacheMisses() {
+  return imageCache->getMisses();
+}
+
+int SplashOutputDev::getImageCacheBytes() {
+  return imageCache->getBytes();
+}
+
+void SplashOutputDev::setGlyphCacheSize(int maxBytes) {
+  glyphCacheSize = maxBytes;
+  if (fontEngine) {
+    fontEngine->getGlyphCache()->setMaxBytes(glyphCacheSize);
+  }
+}
+
+int SplashOutputDev::getGlyphCacheHits() {
+  return fontEngine ? fontEngine->getGlyphCache()->getHits() : 0;
+}
+
+int SplashOutputDev::getGlyphCacheMisses() {
+  return fontEngine ? fontEngine->getGlyphCache()->getMisses() : 0;
+}
+
+int SplashOutputDev::getGlyphCacheEvictions() {
+  return fontEngine ? fontEngine->getGlyphCache()->getEvictions() : 0;
+}
+
+int SplashOutputDev::getGlyphCacheBytes() {
+  return fontEngine ? fontEngine->getGlyphCache()->getBytes() : 0;
+}
+
+void SplashOutputDev::setFontCacheSize(int maxBytes) {
+  fontCacheSize = maxBytes;
+  if (fontEngine) {
+    fontEngine->setFontCacheSize(fontCacheSize);
+  }
+}
+
+int SplashOutputDev::getPageFontFilesLoaded() {
+  return fontEngine ? fontEngine->getFontFilesLoaded() : 0;
+}
+
+int SplashOutputDev::getPageFontsCreated() {
+  return fontEngine ? fontEngine->getFontsCreated() : 0;
+}
+
+int SplashOutputDev::getFontCacheBytes() {
+  return fontEngine ? fontEngine->getFontCacheBytes() : 0;
+}
+
 #if 1 //~tmp: turn off anti-aliasing temporarily
 GBool SplashOutputDev::getVectorAntialias() {
   return splash->getVectorAntialias();
@@ -31,12 +31,18 @@ class T3FontCache;
 struct T3FontCacheTag;
 struct T3GlyphStack;
 struct SplashTransparencyGroup;
+class SplashOutImageCache;
+class EmbFontCache;
+struct SplashCharPos;
 
 //------------------------------------------------------------------------
 
 // number of Type 3 fonts to cache
 #define splashOutT3FontCacheSize 8
 
+// default size limit for the decoded image cache, in bytes
+#define splashOutImageCacheSize (4 * 1024 * 1024)
+
 //------------------------------------------------------------------------
 // SplashOutputDev
 //------------------------------------------------------------------------
@@ -62,10 +68,17 @@ public:
   // Does this device use drawChar() or drawString()?
   virtual GBool useDrawChar() { return gTrue; }
 
+  // Does this device use drawGlyphRun()?
+  virtual GBool useDrawGlyphRun() { return gTrue; }
+
   // Does this device use beginType3Char/endType3Char?  Otherwise,
   // text in Type 3 fonts will be drawn with drawChar/drawString.
   virtual GBool interpretType3Chars() { return gTrue; }
 
+  // Does this device use functionShadedFill(), axialShadedFill(), and
+  // radialShadedFill()?
+  virtual GBool useShadedFills() { return gTrue; }
+
   //----- initialization and control
 
   // Start a page.
@@ -103,6 +116,8 @@ public:
   virtual void stroke(GfxState *state);
   virtual void fill(GfxState *state);
   virtual void eoFill(GfxState *state);
+  virtual GBool axialShadedFill(GfxState *state, GfxAxialShading *shading);
+  virtual GBool radialShadedFill(GfxState *state, GfxRadialShading *shading);
 
   //----- path clipping
   virtual void clip(GfxState *state);
@@ -114,6 +129,8 @@ public:
 			FixedPoint dx, FixedPoint dy,
 			FixedPoint originX, FixedPoint originY,
 			CharCode code, int nBytes, Unicode *u, int uLen);
+  virtual void drawGlyphRun(GfxState *state, GfxGlyphPos *glyphs,
+			    int nGlyphs);
   virtual GBool beginType3Char(GfxState *state, FixedPoint x, FixedPoint y,
 			       FixedPoint dx, FixedPoint dy,
 			       CharCode code, Unicode *u, int uLen);
@@ -188,6 +205,40 @@ public:
 
   SplashFont *getCurrentFont() { return font; }
 
+  // Set the size limit for the decoded image cache, in bytes (0
+  // disables the cache).
+  void setImageCacheSize(int maxBytes);
+
+  // Get decoded image cache statistics: the number of images drawn
+  // from the cache, the number that had to be decoded, and the
+  // current size of the cache, in bytes.
+  int getImageCacheHits();
+  int getImageCacheMisses();
+  int getImageCacheBytes();
+
+  // Set the size limit for the glyph bitmap cache shared by all
+  // fonts, in bytes (0 disables the cache).
+  void setGlyphCacheSize(int maxBytes);
+
+  // Get glyph cache statistics for the current document: the number
+  // of glyphs drawn from the cache, the number that had to be
+  // rasterized, the number discarded to make room for others, and the
+  // current size of the cache, in bytes.
+  int getGlyphCacheHits();
+  int getGlyphCacheMisses();
+  int getGlyphCacheEvictions();
+  int getGlyphCacheBytes();
+
+  // Set the size limit for the scaled font cache, in bytes.
+  void setFontCacheSize(int maxBytes);
+
+  // Get the number of font files loaded and scaled fonts created
+  // while rendering the current page, and the current size of the
+  // scaled font cache, in bytes.
+  int getPageFontFilesLoaded();
+  int getPageFontsCreated();
+  int getFontCacheBytes();
+
 #if 1 //~tmp: turn off anti-aliasing temporarily
   virtual GBool getVectorAntialias();
   virtual void setVectorAntialias(GBool vaa);
@@ -198,9 +249,14 @@ private:
   void setupScreenParams(FixedPoint hDPI, FixedPoint vDPI);
 #if SPLASH_CMYK
   SplashPattern *getColor(GfxGray gray, GfxRGB *rgb, GfxCMYK *cmyk);
+  void convertColor(GfxGray gray, GfxRGB *rgb, GfxCMYK *cmyk,
+		    SplashColorPtr color);
 #else
   SplashPattern *getColor(GfxGray gray, GfxRGB *rgb);
+  void convertColor(GfxGray gray, GfxRGB *rgb, SplashColorPtr color);
 #endif
+  Guchar *makeShadingLUT(GfxShading *shading, FixedPoint t0, FixedPoint t1);
+  GBool shadedFill(GfxState *state, SplashPattern *pattern);
   SplashPath *convertPath(GfxState *state, GfxPath *path);
   void doUpdateFont(GfxState *state);
   void drawType3Glyph(T3FontCache *t3Font,
@@ -212,6 +268,8 @@ private:
 			     Guchar *alphaLine);
   static GBool maskedImageSrc(void *data, SplashColorPtr line,
 			      Guchar *alphaLine);
+  static GBool cachedImageSrc(void *data, SplashColorPtr colorLine,
+			      Guchar *alphaLine);
 
   SplashColorMode colorMode;
   int bitmapRowPad;
@@ -227,13 +285,20 @@ private:
   SplashBitmap *bitmap;
   Splash *splash;
   SplashFontEngine *fontEngine;
+  int fontCacheSize;		// font cache size limit, in bytes
+  int glyphCacheSize;		// glyph cache size limit, in bytes
+  EmbFontCache *embFontCache;	// on-disk converted font cache, or NULL
 
   T3FontCache *			// Type 3 font cache
     t3FontCache[splashOutT3FontCacheSize];
   int nT3Fonts;			// number of valid entries in t3FontCache
   T3GlyphStack *t3GlyphStack;	// Type 3 glyph context stack
 
+  SplashOutImageCache *imageCache;	// decoded image cache
+
   SplashFont *font;		// current font
+  SplashCharPos *charRun;	// buffer for drawGlyphRun
+  int charRunSize;
   GBool needFontUpdate;		// set when the font needs to be updated
   SplashPath *textClipPath;	// clipping path built with text object
 
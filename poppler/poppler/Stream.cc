@@ -27,6 +27,7 @@
 #include "Error.h"
 #include "Object.h"
 #include "Lexer.h"
+#include "XRef.h"
 #include "GfxState.h"
 #include "Stream.h"
 #include "JBIG2Stream.h"
@@ -94,6 +95,18 @@ char *Stream::getLine(char *buf, int size) {
   return buf;
 }
 
+int Stream::getChars(int nChars, Guchar *buffer) {
+  int c, i;
+
+  for (i = 0; i < nChars; ++i) {
+    if ((c = getChar()) == EOF) {
+      break;
+    }
+    buffer[i] = (Guchar)c;
+  }
+  return i;
+}
+
 GooString *Stream::getPSFilter(int psLevel, const char *indent) {
   return new GooString();
 }
@@ -151,7 +164,8 @@ Stream *Stream::makeFilter(char *name, Stream *str, Object *params) {
   GBool endOfLine, byteAlign, endOfBlock, black;
   int columns, rows;
   int colorXform;
-  Object globals, obj;
+  Object globals, globalsRef, obj;
+  JBIG2GlobalsCache *globalsCache;
 
   if (!strcmp(name, "ASCIIHexDecode") || !strcmp(name, "AHx")) {
     str = new ASCIIHexStream(str);
@@ -269,11 +283,17 @@ Stream *Stream::makeFilter(char *name, Stream *str, Object *params) {
     }
     str = new FlateStream(str, pred, columns, colors, bits);
   } else if (!strcmp(name, "JBIG2Decode")) {
+    globalsCache = NULL;
     if (params->isDict()) {
       params->dictLookup("JBIG2Globals", &globals);
+      params->dictLookupNF("JBIG2Globals", &globalsRef);
+      if (params->getDict()->getXRef()) {
+	globalsCache = params->getDict()->getXRef()->getJBIG2GlobalsCache();
+      }
     }
-    str = new JBIG2Stream(str, &globals);
+    str = new JBIG2Stream(str, &globals, &globalsRef, globalsCache);
     globals.free();
+    globalsRef.free();
   } else if (!strcmp(name, "JPXDecode")) {
     str = new JPXStream(str);
   } else {
@@ -383,11 +403,18 @@ ImageStream::ImageStream(Stream *strA, int widthA, int nCompsA, int nBitsA) {
     imgLineSize = nVals;
   }
   imgLine = (Guchar *)gmallocn(imgLineSize, sizeof(Guchar));
+  packedLineSize = (nVals * nBits + 7) >> 3;
+  if (nBits == 1) {
+    packedLine = (Guchar *)gmallocn(packedLineSize, sizeof(Guchar));
+  } else {
+    packedLine = NULL;
+  }
   imgIdx = nVals;
 }
 
 ImageStream::~ImageStream() {
   gfree(imgLine);
+  gfree(packedLine);
 }
 
 void ImageStream::reset() {
@@ -407,15 +434,28 @@ GBool ImageStream::getPixel(Guchar *pix) {
   return gTrue;
 }
 
+Guchar *ImageStream::getPackedLine() {
+  int n;
+
+  // past the end of the stream, read 0xff bytes, as getChar() would
+  n = str->getChars(packedLineSize, packedLine);
+  if (n < packedLineSize) {
+    memset(packedLine + n, 0xff, packedLineSize - n);
+  }
+  return packedLine;
+}
+
 Guchar *ImageStream::getLine() {
   Gulong buf, bitMask;
+  Guchar *p;
   int bits;
   int c;
-  int i;
+  int i, n;
 
   if (nBits == 1) {
+    p = getPackedLine();
     for (i = 0; i < nVals; i += 8) {
-      c = str->getChar();
+      c = *p++;
       imgLine[i+0] = (Guchar)((c >> 7) & 1);
       imgLine[i+1] = (Guchar)((c >> 6) & 1);
       imgLine[i+2] = (Guchar)((c >> 5) & 1);
@@ -426,8 +466,9 @@ Guchar *ImageStream::getLine() {
       imgLine[i+7] = (Guchar)(c & 1);
     }
   } else if (nBits == 8) {
-    for (i = 0; i < nVals; ++i) {
-      imgLine[i] = str->getChar();
+    n = str->getChars(nVals, imgLine);
+    if (n < nVals) {
+      memset(imgLine + n, 0xff, nVals - n);
     }
   } else if (nBits == 16) {
     // this is a hack to support 16 bits images, everywhere
@@ -1323,8 +1364,10 @@ CCITTFaxStream::CCITTFaxStream(Stream *strA, int encodingA, GBool endOfLineA,
   // ---> max refLine size = columns + 2
   codingLine = (int *)gmallocn_checkoverflow(columns + 1, sizeof(int));
   refLine = (int *)gmallocn_checkoverflow(columns + 2, sizeof(int));
+  rowSize = (columns + 7) >> 3;
+  rowBuf = (Guchar *)gmallocn_checkoverflow(rowSize, sizeof(Guchar));
 
-  if (codingLine != NULL && refLine != NULL) {
+  if (codingLine != NULL && refLine != NULL && rowBuf != NULL) {
     eof = gFalse;
     codingLine[0] = columns;
   } else {
@@ -1334,15 +1377,14 @@ CCITTFaxStream::CCITTFaxStream(Stream *strA, int encodingA, GBool endOfLineA,
   nextLine2D = encoding < 0;
   inputBits = 0;
   a0i = 0;
-  outputBits = 0;
-
-  buf = EOF;
+  rowIdx = rowSize;
 }
 
 CCITTFaxStream::~CCITTFaxStream() {
   delete str;
   gfree(refLine);
   gfree(codingLine);
+  gfree(rowBuf);
 }
 
 void CCITTFaxStream::unfilteredReset () {
@@ -1352,8 +1394,7 @@ void CCITTFaxStream::unfilteredReset () {
   nextLine2D = encoding < 0;
   inputBits = 0;
   a0i = 0;
-  outputBits = 0;
-  buf = EOF;
+  rowIdx = rowSize;
 }
 
 void CCITTFaxStream::reset() {
@@ -1361,7 +1402,7 @@ void CCITTFaxStream::reset() {
 
   unfilteredReset();
 
-  if (codingLine != NULL && refLine != NULL) {
+  if (codingLine != NULL && refLine != NULL && rowBuf != NULL) {
     eof = gFalse;
     codingLine[0] = columns;
   } else {
@@ -1420,345 +1461,338 @@ inline void CCITTFaxStream::addPixelsNeg(int a1, int blackPixels) {
   }
 }
 
-int CCITTFaxStream::lookChar() {
+int CCITTFaxStream::getChars(int nChars, Guchar *buffer) {
+  int n, i;
+
+  for (i = 0; i < nChars; i += n) {
+    if (rowIdx >= rowSize && !readRow()) {
+      break;
+    }
+    n = rowSize - rowIdx;
+    if (n > nChars - i) {
+      n = nChars - i;
+    }
+    memcpy(buffer + i, rowBuf + rowIdx, n);
+    rowIdx += n;
+  }
+  return i;
+}
+
+// Decode the next row into rowBuf.  Returns false at end of stream.
+GBool CCITTFaxStream::readRow() {
   short code1, code2, code3;
-  int b1i, blackPixels, i, bits;
+  int b1i, blackPixels, i;
   GBool gotEOL;
 
-  if (buf != EOF) {
-    return buf;
+  if (eof) {
+    return gFalse;
   }
 
-  // read the next row
-  if (outputBits == 0) {
+  err = gFalse;
 
-    // if at eof just return EOF
-    if (eof) {
-      return EOF;
+  // 2-D encoding
+  if (nextLine2D) {
+    for (i = 0; codingLine[i] < columns; ++i) {
+      refLine[i] = codingLine[i];
     }
-
-    err = gFalse;
-
-    // 2-D encoding
-    if (nextLine2D) {
-      for (i = 0; codingLine[i] < columns; ++i) {
-	refLine[i] = codingLine[i];
-      }
-      refLine[i++] = columns;
-      refLine[i] = columns;
-      codingLine[0] = 0;
-      a0i = 0;
-      b1i = 0;
-      blackPixels = 0;
-      // invariant:
-      // refLine[b1i-1] <= codingLine[a0i] < refLine[b1i] < refLine[b1i+1]
-      //                                                             <= columns
-      // exception at left edge:
-      //   codingLine[a0i = 0] = refLine[b1i = 0] = 0 is possible
-      // exception at right edge:
-      //   refLine[b1i] = refLine[b1i+1] = columns is possible
-      while (codingLine[a0i] < columns) {
-	code1 = getTwoDimCode();
-	switch (code1) {
-	case twoDimPass:
-	  addPixels(refLine[b1i + 1], blackPixels);
-	  if (refLine[b1i + 1] < columns) {
+    refLine[i++] = columns;
+    refLine[i] = columns;
+    codingLine[0] = 0;
+    a0i = 0;
+    b1i = 0;
+    blackPixels = 0;
+    // invariant:
+    // refLine[b1i-1] <= codingLine[a0i] < refLine[b1i] < refLine[b1i+1]
+    //                                                             <= columns
+    // exception at left edge:
+    //   codingLine[a0i = 0] = refLine[b1i = 0] = 0 is possible
+    // exception at right edge:
+    //   refLine[b1i] = refLine[b1i+1] = columns is possible
+    while (codingLine[a0i] < columns) {
+      code1 = getTwoDimCode();
+      switch (code1) {
+      case twoDimPass:
+	addPixels(refLine[b1i + 1], blackPixels);
+	if (refLine[b1i + 1] < columns) {
+	  b1i += 2;
+	}
+	break;
+      case twoDimHoriz:
+	code1 = code2 = 0;
+	if (blackPixels) {
+	  do {
+	    code1 += code3 = getBlackCode();
+	  } while (code3 >= 64);
+	  do {
+	    code2 += code3 = getWhiteCode();
+	  } while (code3 >= 64);
+	} else {
+	  do {
+	    code1 += code3 = getWhiteCode();
+	  } while (code3 >= 64);
+	  do {
+	    code2 += code3 = getBlackCode();
+	  } while (code3 >= 64);
+	}
+	addPixels(codingLine[a0i] + code1, blackPixels);
+	if (codingLine[a0i] < columns) {
+	  addPixels(codingLine[a0i] + code2, blackPixels ^ 1);
+	}
+	while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	  b1i += 2;
+	}
+	break;
+      case twoDimVertR3:
+	addPixels(refLine[b1i] + 3, blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  ++b1i;
+	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
 	    b1i += 2;
 	  }
-	  break;
-	case twoDimHoriz:
-	  code1 = code2 = 0;
-	  if (blackPixels) {
-	    do {
-	      code1 += code3 = getBlackCode();
-	    } while (code3 >= 64);
-	    do {
-	      code2 += code3 = getWhiteCode();
-	    } while (code3 >= 64);
-	  } else {
-	    do {
-	      code1 += code3 = getWhiteCode();
-	    } while (code3 >= 64);
-	    do {
-	      code2 += code3 = getBlackCode();
-	    } while (code3 >= 64);
-	  }
-	  addPixels(codingLine[a0i] + code1, blackPixels);
-	  if (codingLine[a0i] < columns) {
-	    addPixels(codingLine[a0i] + code2, blackPixels ^ 1);
+	}
+	break;
+      case twoDimVertR2:
+	addPixels(refLine[b1i] + 2, blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  ++b1i;
+	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	    b1i += 2;
 	  }
+	}
+	break;
+      case twoDimVertR1:
+	addPixels(refLine[b1i] + 1, blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  ++b1i;
 	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
 	    b1i += 2;
 	  }
-	  break;
-	case twoDimVertR3:
-	  addPixels(refLine[b1i] + 3, blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
-	    ++b1i;
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
+	}
+	break;
+      case twoDimVert0:
+	addPixels(refLine[b1i], blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  ++b1i;
+	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	    b1i += 2;
 	  }
-	  break;
-	case twoDimVertR2:
-	  addPixels(refLine[b1i] + 2, blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
+	}
+	break;
+      case twoDimVertL3:
+	addPixelsNeg(refLine[b1i] - 3, blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  if (b1i > 0) {
+	    --b1i;
+	  } else {
 	    ++b1i;
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
 	  }
-	  break;
-	case twoDimVertR1:
-	  addPixels(refLine[b1i] + 1, blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
-	    ++b1i;
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
+	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	    b1i += 2;
 	  }
-	  break;
-	case twoDimVert0:
-	  addPixels(refLine[b1i], blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
+	}
+	break;
+      case twoDimVertL2:
+	addPixelsNeg(refLine[b1i] - 2, blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  if (b1i > 0) {
+	    --b1i;
+	  } else {
 	    ++b1i;
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
 	  }
-	  break;
-	case twoDimVertL3:
-	  addPixelsNeg(refLine[b1i] - 3, blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
-	    if (b1i > 0) {
-	      --b1i;
-	    } else {
-	      ++b1i;
-	    }
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
+	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	    b1i += 2;
 	  }
-	  break;
-	case twoDimVertL2:
-	  addPixelsNeg(refLine[b1i] - 2, blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
-	    if (b1i > 0) {
-	      --b1i;
-	    } else {
-	      ++b1i;
-	    }
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
+	}
+	break;
+      case twoDimVertL1:
+	addPixelsNeg(refLine[b1i] - 1, blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  if (b1i > 0) {
+	    --b1i;
+	  } else {
+	    ++b1i;
 	  }
-	  break;
-	case twoDimVertL1:
-	  addPixelsNeg(refLine[b1i] - 1, blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
-	    if (b1i > 0) {
-	      --b1i;
-	    } else {
-	      ++b1i;
-	    }
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
+	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	    b1i += 2;
 	  }
-	  break;
-	case EOF:
-	  addPixels(columns, 0);
-	  eof = gTrue;
-	  break;
-	default:
-	  error(getPos(), "Bad 2D code %04x in CCITTFax stream", code1);
-	  addPixels(columns, 0);
-	  err = gTrue;
-	  break;
 	}
+	break;
+      case EOF:
+	addPixels(columns, 0);
+	eof = gTrue;
+	break;
+      default:
+	error(getPos(), "Bad 2D code %04x in CCITTFax stream", code1);
+	addPixels(columns, 0);
+	err = gTrue;
+	break;
       }
+    }
 
-    // 1-D encoding
-    } else {
-      codingLine[0] = 0;
-      a0i = 0;
-      blackPixels = 0;
-      while (codingLine[a0i] < columns) {
-	code1 = 0;
-	if (blackPixels) {
-	  do {
-	    code1 += code3 = getBlackCode();
-	  } while (code3 >= 64);
-	} else {
-	  do {
-	    code1 += code3 = getWhiteCode();
-	  } while (code3 >= 64);
-	}
-	addPixels(codingLine[a0i] + code1, blackPixels);
-	blackPixels ^= 1;
+  // 1-D encoding
+  } else {
+    codingLine[0] = 0;
+    a0i = 0;
+    blackPixels = 0;
+    while (codingLine[a0i] < columns) {
+      code1 = 0;
+      if (blackPixels) {
+	do {
+	  code1 += code3 = getBlackCode();
+	} while (code3 >= 64);
+      } else {
+	do {
+	  code1 += code3 = getWhiteCode();
+	} while (code3 >= 64);
       }
+      addPixels(codingLine[a0i] + code1, blackPixels);
+      blackPixels ^= 1;
     }
+  }
 
-    // byte-align the row
-    if (byteAlign) {
-      inputBits &= ~7;
-    }
+  // byte-align the row
+  if (byteAlign) {
+    inputBits &= ~7;
+  }
 
-    // check for end-of-line marker, skipping over any extra zero bits
-    gotEOL = gFalse;
-    if (!endOfBlock && row == rows - 1) {
-      eof = gTrue;
-    } else {
+  // check for end-of-line marker, skipping over any extra zero bits
+  gotEOL = gFalse;
+  if (!endOfBlock && row == rows - 1) {
+    eof = gTrue;
+  } else {
+    code1 = lookBits(12);
+    while (code1 == 0) {
+      eatBits(1);
       code1 = lookBits(12);
-      while (code1 == 0) {
-	eatBits(1);
-	code1 = lookBits(12);
-      }
-      if (code1 == 0x001) {
-	eatBits(12);
-	gotEOL = gTrue;
-      } else if (code1 == EOF) {
-	eof = gTrue;
-      }
     }
-
-    // get 2D encoding tag
-    if (!eof && encoding > 0) {
-      nextLine2D = !lookBits(1);
-      eatBits(1);
+    if (code1 == 0x001) {
+      eatBits(12);
+      gotEOL = gTrue;
+    } else if (code1 == EOF) {
+      eof = gTrue;
     }
+  }
 
-    // check for end-of-block marker
-    if (endOfBlock && gotEOL) {
-      code1 = lookBits(12);
-      if (code1 == 0x001) {
-	eatBits(12);
-	if (encoding > 0) {
-	  lookBits(1);
-	  eatBits(1);
-	}
-	if (encoding >= 0) {
-	  for (i = 0; i < 4; ++i) {
-	    code1 = lookBits(12);
-	    if (code1 != 0x001) {
-	      error(getPos(), "Bad RTC code in CCITTFax stream");
-	    }
-	    eatBits(12);
-	    if (encoding > 0) {
-	      lookBits(1);
-	      eatBits(1);
-	    }
+  // get 2D encoding tag
+  if (!eof && encoding > 0) {
+    nextLine2D = !lookBits(1);
+    eatBits(1);
+  }
+
+  // check for end-of-block marker
+  if (endOfBlock && gotEOL) {
+    code1 = lookBits(12);
+    if (code1 == 0x001) {
+      eatBits(12);
+      if (encoding > 0) {
+	lookBits(1);
+	eatBits(1);
+      }
+      if (encoding >= 0) {
+	for (i = 0; i < 4; ++i) {
+	  code1 = lookBits(12);
+	  if (code1 != 0x001) {
+	    error(getPos(), "Bad RTC code in CCITTFax stream");
+	  }
+	  eatBits(12);
+	  if (encoding > 0) {
+	    lookBits(1);
+	    eatBits(1);
 	  }
 	}
-	eof = gTrue;
       }
+      eof = gTrue;
+    }
 
-    // look for an end-of-line marker after an error -- we only do
-    // this if we know the stream contains end-of-line markers because
-    // the "just plow on" technique tends to work better otherwise
-    } else if (err && endOfLine) {
-      while (1) {
-	code1 = lookBits(13);
-	if (code1 == EOF) {
-	  eof = gTrue;
-	  return EOF;
-	}
-	if ((code1 >> 1) == 0x001) {
-	  break;
-	}
-	eatBits(1);
+  // look for an end-of-line marker after an error -- we only do
+  // this if we know the stream contains end-of-line markers because
+  // the "just plow on" technique tends to work better otherwise
+  } else if (err && endOfLine) {
+    while (1) {
+      code1 = lookBits(13);
+      if (code1 == EOF) {
+	eof = gTrue;
+	return gFalse;
       }
-      eatBits(12); 
-      if (encoding > 0) {
-	eatBits(1);
-	nextLine2D = !(code1 & 1);
+      if ((code1 >> 1) == 0x001) {
+	break;
       }
+      eatBits(1);
     }
-
-    // set up for output
-    if (codingLine[0] > 0) {
-      outputBits = codingLine[a0i = 0];
-    } else {
-      outputBits = codingLine[a0i = 1];
+    eatBits(12); 
+    if (encoding > 0) {
+      eatBits(1);
+      nextLine2D = !(code1 & 1);
     }
-
-    ++row;
   }
 
-  // get a byte
-  if (outputBits >= 8) {
-    buf = (a0i & 1) ? 0x00 : 0xff;
-    outputBits -= 8;
-    if (outputBits == 0 && codingLine[a0i] < columns) {
-      ++a0i;
-      outputBits = codingLine[a0i] - codingLine[a0i - 1];
+  ++row;
+
+  fillRow();
+  rowIdx = 0;
+  return gTrue;
+}
+
+// Convert the changing elements in codingLine to packed pixels in
+// rowBuf, setting whole bytes at a time.  White pixels are 1 unless
+// BlackIs1 is set.
+void CCITTFaxStream::fillRow() {
+  int x0, x1, i;
+
+  memset(rowBuf, 0xff, rowSize);
+  for (i = 0; codingLine[i] < columns; i += 2) {
+    x0 = codingLine[i];
+    x1 = codingLine[i + 1] - 1;
+    if (x0 > x1) {
+      continue;
     }
-  } else {
-    bits = 8;
-    buf = 0;
-    do {
-      if (outputBits > bits) {
-	buf <<= bits;
-	if (!(a0i & 1)) {
-	  buf |= 0xff >> (8 - bits);
-	}
-	outputBits -= bits;
-	bits = 0;
-      } else {
-	buf <<= outputBits;
-	if (!(a0i & 1)) {
-	  buf |= 0xff >> (8 - outputBits);
-	}
-	bits -= outputBits;
-	outputBits = 0;
-	if (codingLine[a0i] < columns) {
-	  ++a0i;
-	  outputBits = codingLine[a0i] - codingLine[a0i - 1];
-	} else if (bits > 0) {
-	  buf <<= bits;
-	  bits = 0;
-	}
-      }
-    } while (bits);
+    if ((x0 >> 3) == (x1 >> 3)) {
+      rowBuf[x0 >> 3] &= ~((0xff >> (x0 & 7)) & (0xff << (7 - (x1 & 7))));
+    } else {
+      rowBuf[x0 >> 3] &= ~(0xff >> (x0 & 7));
+      memset(rowBuf + (x0 >> 3) + 1, 0, (x1 >> 3) - (x0 >> 3) - 1);
+      rowBuf[x1 >> 3] &= ~(0xff << (7 - (x1 & 7)));
+    }
+    if (x1 == columns - 1) {
+      break;
+    }
+  }
+  // the padding bits at the end of the row are always 0 before the
+  // BlackIs1 inversion
+  if (columns & 7) {
+    rowBuf[rowSize - 1] &= 0xff << (8 - (columns & 7));
   }
   if (black) {
-    buf ^= 0xff;
+    for (i = 0; i < rowSize; ++i) {
+      rowBuf[i] ^= 0xff;
+    }
   }
-  return buf;
 }
 
+// The code tables are indexed by the next 7 (2D), 12 (white), or 13
+// (black) bits, so each code is found with a single lookup.  Near the
+// end of the stream lookBits() pads with zero bits, which still finds
+// any code that fits in the remaining bits.
+
 short CCITTFaxStream::getTwoDimCode() {
   short code;
   CCITTCode *p;
-  int n;
 
-  code = 0; // make gcc happy
-  if (endOfBlock) {
-    code = lookBits(7);
-    p = &twoDimTab1[code];
-    if (p->bits > 0) {
-      eatBits(p->bits);
-      return p->n;
-    }
-  } else {
-    for (n = 1; n <= 7; ++n) {
-      code = lookBits(n);
-      if (n < 7) {
-	code <<= 7 - n;
-      }
-      p = &twoDimTab1[code];
-      if (p->bits == n) {
-	eatBits(n);
-	return p->n;
-      }
-    }
+  code = lookBits(7);
+  if (code == EOF) {
+    return EOF;
+  }
+  p = &twoDimTab1[code];
+  if (p->bits > 0) {
+    eatBits(p->bits);
+    return p->n;
   }
   error(getPos(), "Bad two dim code (%04x) in CCITTFax stream", code);
   return EOF;
@@ -1767,52 +1801,19 @@ short CCITTFaxStream::getTwoDimCode() {
 short CCITTFaxStream::getWhiteCode() {
   short code;
   CCITTCode *p;
-  int n;
 
-  code = 0; // make gcc happy
-  if (endOfBlock) {
-    code = lookBits(12);
-    if (code == EOF) {
-      return 1;
-    }
-    if ((code >> 5) == 0) {
-      p = &whiteTab1[code];
-    } else {
-      p = &whiteTab2[code >> 3];
-    }
-    if (p->bits > 0) {
-      eatBits(p->bits);
-      return p->n;
-    }
+  code = lookBits(12);
+  if (code == EOF) {
+    return 1;
+  }
+  if ((code >> 5) == 0) {
+    p = &whiteTab1[code];
   } else {
-    for (n = 1; n <= 9; ++n) {
-      code = lookBits(n);
-      if (code == EOF) {
-	return 1;
-      }
-      if (n < 9) {
-	code <<= 9 - n;
-      }
-      p = &whiteTab2[code];
-      if (p->bits == n) {
-	eatBits(n);
-	return p->n;
-      }
-    }
-    for (n = 11; n <= 12; ++n) {
-      code = lookBits(n);
-      if (code == EOF) {
-	return 1;
-      }
-      if (n < 12) {
-	code <<= 12 - n;
-      }
-      p = &whiteTab1[code];
-      if (p->bits == n) {
-	eatBits(n);
-	return p->n;
-      }
-    }
+    p = &whiteTab2[code >> 3];
+  }
+  if (p->bits > 0) {
+    eatBits(p->bits);
+    return p->n;
   }
   error(getPos(), "Bad white code (%04x) in CCITTFax stream", code);
   // eat a bit and return a positive number so that the caller doesn't
@@ -1824,70 +1825,21 @@ short CCITTFaxStream::getWhiteCode() {
 short CCITTFaxStream::getBlackCode() {
   short code;
   CCITTCode *p;
-  int n;
 
-  code = 0; // make gcc happy
-  if (endOfBlock) {
-    code = lookBits(13);
-    if (code == EOF) {
-      return 1;
-    }
-    if ((code >> 7) == 0) {
-      p = &blackTab1[code];
-    } else if ((code >> 9) == 0 && (code >> 7) != 0) {
-      p = &blackTab2[(code >> 1) - 64];
-    } else {
-      p = &blackTab3[code >> 7];
-    }
-    if (p->bits > 0) {
-      eatBits(p->bits);
-      return p->n;
-    }
+  code = lookBits(13);
+  if (code == EOF) {
+    return 1;
+  }
+  if ((code >> 7) == 0) {
+    p = &blackTab1[code];
+  } else if ((code >> 9) == 0) {
+    p = &blackTab2[(code >> 1) - 64];
   } else {
-    for (n = 2; n <= 6; ++n) {
-      code = lookBits(n);
-      if (code == EOF) {
-	return 1;
-      }
-      if (n < 6) {
-	code <<= 6 - n;
-      }
-      p = &blackTab3[code];
-      if (p->bits == n) {
-	eatBits(n);
-	return p->n;
-      }
-    }
-    for (n = 7; n <= 12; ++n) {
-      code = lookBits(n);
-      if (code == EOF) {
-	return 1;
-      }
-      if (n < 12) {
-	code <<= 12 - n;
-      }
-      if (code >= 64) {
-	p = &blackTab2[code - 64];
-	if (p->bits == n) {
-	  eatBits(n);
-	  return p->n;
-	}
-      }
-    }
-    for (n = 10; n <= 13; ++n) {
-      code = lookBits(n);
-      if (code == EOF) {
-	return 1;
-      }
-      if (n < 13) {
-	code <<= 13 - n;
-      }
-      p = &blackTab1[code];
-      if (p->bits == n) {
-	eatBits(n);
-	return p->n;
-      }
-    }
+    p = &blackTab3[code >> 7];
+  }
+  if (p->bits > 0) {
+    eatBits(p->bits);
+    return p->n;
   }
   error(getPos(), "Bad black code (%04x) in CCITTFax stream", code);
   // eat a bit and return a positive number so that the caller doesn't
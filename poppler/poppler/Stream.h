@@ -98,6 +98,12 @@ public:
   // Get next line from stream.
   virtual char *getLine(char *buf, int size);
 
+  // Get the next <nChars> chars from the stream into <buffer>.
+  // Returns the number of chars read, which is less than <nChars> only
+  // at end of stream.  Streams that decode a row at a time override
+  // this to copy whole rows.
+  virtual int getChars(int nChars, Guchar *buffer);
+
   // Get current position in file.
   virtual int getPos() = 0;
 
@@ -129,6 +135,17 @@ public:
   virtual void getImageParams(int * /*bitsPerComponent*/,
 			      StreamColorSpaceMode * /*csMode*/) {}
 
+  // Ask an image decoder for reduced-size output.  On entry,
+  // <*widthA> x <*heightA> is the image size from the image
+  // dictionary and <minWidth> x <minHeight> is the smallest output
+  // that is still useful (normally the device size of the image); if
+  // <*grayA> is set, the caller also accepts single-component gray
+  // output.  On return, the three values describe what the decoder
+  // will actually produce.  Must be called before reset().
+  virtual void setReducedDecode(int /*minWidth*/, int /*minHeight*/,
+				int * /*widthA*/, int * /*heightA*/,
+				GBool *grayA) { *grayA = gFalse; }
+
   // Return the next stream in the "stack".
   virtual Stream *getNextStream() { return NULL; }
 
@@ -283,6 +300,10 @@ public:
   // end of file.
   Guchar *getLine();
 
+  // Returns a pointer to the next line of pixels in packed form, as
+  // read from the stream (rows are padded to a byte boundary).
+  Guchar *getPackedLine();
+
   // Skip an entire line from the image.
   void skipLine();
 
@@ -294,6 +315,8 @@ private:
   int nBits;			// bits per component
   int nVals;			// components per line
   Guchar *imgLine;		// line buffer
+  Guchar *packedLine;		// packed line buffer (for nBits == 1)
+  int packedLineSize;		// bytes per packed line
   int imgIdx;			// current index in imgLine
 };
 
@@ -589,8 +612,10 @@ public:
   virtual StreamKind getKind() { return strCCITTFax; }
   virtual void reset();
   virtual int getChar()
-    { int c = lookChar(); buf = EOF; return c; }
-  virtual int lookChar();
+    { return (rowIdx < rowSize || readRow()) ? rowBuf[rowIdx++] : EOF; }
+  virtual int lookChar()
+    { return (rowIdx < rowSize || readRow()) ? rowBuf[rowIdx] : EOF; }
+  virtual int getChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -614,9 +639,12 @@ private:
   int *refLine;			// reference line changing elements
   int a0i;			// index into codingLine
   GBool err;			// error on current line
-  int outputBits;		// remaining ouput bits
-  int buf;			// character buffer
+  Guchar *rowBuf;		// decoded row, packed 1-bit pixels
+  int rowSize;			// bytes per row
+  int rowIdx;			// index of the next byte in rowBuf
 
+  GBool readRow();
+  void fillRow();
   void addPixels(int a1, int black);
   void addPixelsNeg(int a1, int black);
   short getTwoDimCode();
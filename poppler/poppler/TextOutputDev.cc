@@ -4132,16 +4132,18 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc,
   eopLen = uMap->mapUnicode(0x0c, eop, sizeof(eop));
   pageBreaks = globalParams->getTextPageBreaks();
 
+  // one scratch string is reused for every line
+  s = new GooString();
+
   //~ writing mode (horiz/vert)
 
   // output the page in raw (content stream) order
   if (rawOrder) {
 
     for (word = rawWords; word; word = word->next) {
-      s = new GooString();
+      s->clear();
       dumpFragment(word->text, word->len, uMap, s);
       (*outputFunc)(outputStream, s->getCString(), s->getLength());
-      delete s;
       if (word->next &&
 	  FixedPoint::abs(word->next->base - word->base) <
 	    maxIntraLineDelta * word->fontSize) {
@@ -4210,10 +4212,9 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc,
       }
 
       // print the line
-      s = new GooString();
+      s->clear();
       col += dumpFragment(frag->line->text + frag->start, frag->len, uMap, s);
       (*outputFunc)(outputStream, s->getCString(), s->getLength());
-      delete s;
 
       // print one or more returns if necessary
       if (i == nFrags - 1 ||
@@ -4249,10 +4250,9 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc,
 	  if (line->hyphenated && (line->next || blk->next)) {
 	    --n;
 	  }
-	  s = new GooString();
+	  s->clear();
 	  dumpFragment(line->text, n, uMap, s);
 	  (*outputFunc)(outputStream, s->getCString(), s->getLength());
-	  delete s;
 	  if (!line->hyphenated) {
 	    if (line->next) {
 	      (*outputFunc)(outputStream, space, spaceLen);
@@ -4279,6 +4279,8 @@ void TextPage::dump(void *outputStream, TextOutputFunc outputFunc,
     (*outputFunc)(outputStream, eop, eopLen);
   }
 
+  delete s;
+
   uMap->decRefCnt();
 }
 
@@ -25,6 +25,7 @@
 #include "Error.h"
 #include "ErrorCodes.h"
 #include "XRef.h"
+#include "JBIG2Stream.h"
 
 //------------------------------------------------------------------------
 
@@ -208,6 +209,7 @@ XRef::XRef() {
   streamEnds = NULL;
   streamEndsLen = 0;
   objStr = NULL;
+  jbig2GlobalsCache = NULL;
 }
 
 XRef::XRef(BaseStream *strA) {
@@ -221,6 +223,7 @@ XRef::XRef(BaseStream *strA) {
   streamEnds = NULL;
   streamEndsLen = 0;
   objStr = NULL;
+  jbig2GlobalsCache = NULL;
 
   encrypted = gFalse;
   permFlags = defPermFlags;
@@ -285,6 +288,9 @@ XRef::~XRef() {
   if (objStr) {
     delete objStr;
   }
+  if (jbig2GlobalsCache) {
+    delete jbig2GlobalsCache;
+  }
 }
 
 // Read the 'startxref' position.
@@ -947,6 +953,13 @@ Object *XRef::getDocInfoNF(Object *obj) {
   return trailerDict.dictLookupNF("Info", obj);
 }
 
+JBIG2GlobalsCache *XRef::getJBIG2GlobalsCache() {
+  if (!jbig2GlobalsCache) {
+    jbig2GlobalsCache = new JBIG2GlobalsCache();
+  }
+  return jbig2GlobalsCache;
+}
+
 GBool XRef::getStreamEnd(Guint streamStart, Guint *streamEnd) {
   int a, b, m;
 
@@ -20,6 +20,7 @@ class Dict;
 class Stream;
 class Parser;
 class ObjectStream;
+class JBIG2GlobalsCache;
 
 //------------------------------------------------------------------------
 // XRef
@@ -108,6 +109,9 @@ public:
   XRefEntry *getEntry(int i) { return &entries[i]; }
   Object *getTrailerDict() { return &trailerDict; }
 
+  // Get the cache of decoded JBIG2Globals streams for this document.
+  JBIG2GlobalsCache *getJBIG2GlobalsCache();
+
   // Write access
   void setModifiedObject(Object* o, Ref r);
   Ref addIndirectObject (Object* o);
@@ -130,6 +134,7 @@ private:
 				//   damaged files
   int streamEndsLen;		// number of valid entries in streamEnds
   ObjectStream *objStr;		// cached object stream
+  JBIG2GlobalsCache *jbig2GlobalsCache;	// decoded JBIG2Globals streams
   GBool encrypted;		// true if file is encrypted
   int encRevision;		
   int encVersion;		// encryption algorithm
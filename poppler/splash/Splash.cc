@@ -27,6 +27,17 @@
 #include "Splash.h"
 #include <inkview.h>
 
+// The scan loops in the SplashMonoKernel section use 16-byte vectors
+// when the compiler targets SSE2 or NEON; define SPLASH_NO_SIMD to
+// build the portable versions instead.
+#if !defined(SPLASH_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define splashSSE2 1
+#elif !defined(SPLASH_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define splashNEON 1
+#endif
+
 //------------------------------------------------------------------------
 
 // distance of Bezier control point from center for circle approximation
@@ -79,6 +90,10 @@ struct SplashPipe {
 
   // non-isolated group correction
   int nonIsolatedGroup;
+
+  // set if the pixels can be written with the SplashMonoKernel
+  // routines
+  GBool monoKernel;
 };
 
 SplashPipeResultColorCtrl Splash::pipeResultColorNoAlphaBlend[] = {
@@ -157,6 +172,516 @@ inline void Splash::updateModY(int y) {
   }
 }
 
+//------------------------------------------------------------------------
+// SplashMonoKernel
+//------------------------------------------------------------------------
+
+// Pixel access for the Mono8 and Mono4 destination formats, which are
+// the only ones the viewer renders in.  The span, glyph and image
+// loops below are templates over these, so the per-pixel mode switch
+// in pipeRun is resolved at compile time.  A Mono4 pixel is the high
+// nibble of the 8-bit value; getPixel expands it back to 8 bits.
+
+template<SplashColorMode mode> struct SplashMonoKernel;
+
+template<> struct SplashMonoKernel<splashModeMono8> {
+  static inline void fillSpan(SplashColorPtr row, int x0, int x1, Guchar c)
+    { memset(row + x0, c, x1 - x0 + 1); }
+  static inline void putPixel(SplashColorPtr row, int x, Guchar c)
+    { row[x] = c; }
+  static inline Guchar getPixel(SplashColorPtr row, int x)
+    { return row[x]; }
+};
+
+template<> struct SplashMonoKernel<splashModeMono4> {
+  static inline void fillSpan(SplashColorPtr row, int x0, int x1, Guchar c) {
+    if (x0 & 1) {
+      row[x0 >> 1] = (row[x0 >> 1] & 0xf0) | (c >> 4);
+      ++x0;
+    }
+    if (x0 <= x1 && !(x1 & 1)) {
+      row[x1 >> 1] = (row[x1 >> 1] & 0x0f) | (c & 0xf0);
+      --x1;
+    }
+    if (x0 < x1) {
+      memset(row + (x0 >> 1), (c & 0xf0) | (c >> 4), (x1 - x0 + 1) >> 1);
+    }
+  }
+  static inline void putPixel(SplashColorPtr row, int x, Guchar c) {
+    if (x & 1) {
+      row[x >> 1] = (row[x >> 1] & 0xf0) | (c >> 4);
+    } else {
+      row[x >> 1] = (row[x >> 1] & 0x0f) | (c & 0xf0);
+    }
+  }
+  static inline Guchar getPixel(SplashColorPtr row, int x) {
+    int c;
+
+    c = ((x & 1) ? row[x >> 1] : (row[x >> 1] >> 4)) & 0x0f;
+    return (Guchar)(c | (c << 4));
+  }
+};
+
+// Set the pixels in (x0..x1, y) that are inside the clip region.
+// Updates [*modX0, *modX1] to cover the pixels that were set.
+template<SplashColorMode mode>
+static void splashMonoClippedSpan(SplashClip *clip, SplashColorPtr row,
+				  int x0, int x1, int y, Guchar c,
+				  int *modX0, int *modX1) {
+  int x;
+
+  for (x = x0; x <= x1; ++x) {
+    if (clip->test(x, y)) {
+      SplashMonoKernel<mode>::putPixel(row, x, c);
+      if (x < *modX0) {
+	*modX0 = x;
+      }
+      *modX1 = x;
+    }
+  }
+}
+
+// Set the pixels in (x0..x1, y) that <pattern> paints and that are
+// inside the clip region (unless <noClip> is set).  <buf> has room for
+// (splashMaxColorComps + 1) * (x1 - x0 + 1) bytes.  Updates [*modX0,
+// *modX1] to cover the pixels that were set.
+template<SplashColorMode mode>
+static void splashMonoPatternSpan(SplashPattern *pattern, SplashClip *clip,
+				  GBool noClip, SplashColorPtr row,
+				  int x0, int x1, int y, Guchar *buf,
+				  int *modX0, int *modX1) {
+  SplashColorPtr c;
+  Guchar *paint;
+  int x, mod0, mod1;
+
+  c = buf;
+  paint = buf + splashMaxColorComps * (x1 - x0 + 1);
+  pattern->getColorSpan(x0, x1, y, c, paint);
+  mod0 = *modX0;
+  mod1 = *modX1;
+  for (x = x0; x <= x1; ++x, c += splashMaxColorComps, ++paint) {
+    if (*paint && (noClip || clip->test(x, y))) {
+      SplashMonoKernel<mode>::putPixel(row, x, c[0]);
+      if (x < mod0) {
+	mod0 = x;
+      }
+      mod1 = x;
+    }
+  }
+  *modX0 = mod0;
+  *modX1 = mod1;
+}
+
+#if splashAASize == 4
+
+// Return the first AA buffer byte in [i, n) that has any coverage
+// (in any of the four rows), or n if there is none.
+static inline int splashAAScanEmpty(SplashColorPtr p0, SplashColorPtr p1,
+				    SplashColorPtr p2, SplashColorPtr p3,
+				    int i, int n) {
+#if splashSSE2
+  __m128i v;
+
+  for (; i + 16 <= n; i += 16) {
+    v = _mm_or_si128(_mm_or_si128(_mm_loadu_si128((__m128i *)(p0 + i)),
+				  _mm_loadu_si128((__m128i *)(p1 + i))),
+		     _mm_or_si128(_mm_loadu_si128((__m128i *)(p2 + i)),
+				  _mm_loadu_si128((__m128i *)(p3 + i))));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) != 0xffff) {
+      break;
+    }
+  }
+#elif splashNEON
+  uint64x2_t v;
+
+  for (; i + 16 <= n; i += 16) {
+    v = vreinterpretq_u64_u8(vorrq_u8(vorrq_u8(vld1q_u8(p0 + i),
+					       vld1q_u8(p1 + i)),
+				      vorrq_u8(vld1q_u8(p2 + i),
+					       vld1q_u8(p3 + i))));
+    if (vgetq_lane_u64(v, 0) | vgetq_lane_u64(v, 1)) {
+      break;
+    }
+  }
+#else
+  Guint w0, w1, w2, w3;
+
+  for (; i + 4 <= n; i += 4) {
+    memcpy(&w0, p0 + i, 4);
+    memcpy(&w1, p1 + i, 4);
+    memcpy(&w2, p2 + i, 4);
+    memcpy(&w3, p3 + i, 4);
+    if (w0 | w1 | w2 | w3) {
+      break;
+    }
+  }
+#endif
+  while (i < n && !(p0[i] | p1[i] | p2[i] | p3[i])) {
+    ++i;
+  }
+  return i;
+}
+
+// Return the first AA buffer byte in [i, n) in which at least one of
+// the two pixels has no coverage, or n if there is none.
+static inline int splashAAScanFull(SplashColorPtr p0, SplashColorPtr p1,
+				   SplashColorPtr p2, SplashColorPtr p3,
+				   int i, int n) {
+  int m;
+#if splashSSE2
+  __m128i v, z;
+
+  z = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    v = _mm_or_si128(_mm_or_si128(_mm_loadu_si128((__m128i *)(p0 + i)),
+				  _mm_loadu_si128((__m128i *)(p1 + i))),
+		     _mm_or_si128(_mm_loadu_si128((__m128i *)(p2 + i)),
+				  _mm_loadu_si128((__m128i *)(p3 + i))));
+    if (_mm_movemask_epi8(_mm_or_si128(
+	    _mm_cmpeq_epi8(_mm_and_si128(v, _mm_set1_epi8((char)0xf0)), z),
+	    _mm_cmpeq_epi8(_mm_and_si128(v, _mm_set1_epi8(0x0f)), z)))) {
+      break;
+    }
+  }
+#elif splashNEON
+  uint8x16_t v;
+  uint64x2_t e;
+
+  for (; i + 16 <= n; i += 16) {
+    v = vorrq_u8(vorrq_u8(vld1q_u8(p0 + i), vld1q_u8(p1 + i)),
+		 vorrq_u8(vld1q_u8(p2 + i), vld1q_u8(p3 + i)));
+    e = vreinterpretq_u64_u8(vmvnq_u8(vandq_u8(vtstq_u8(v, vdupq_n_u8(0xf0)),
+					       vtstq_u8(v, vdupq_n_u8(0x0f)))));
+    if (vgetq_lane_u64(e, 0) | vgetq_lane_u64(e, 1)) {
+      break;
+    }
+  }
+#else
+  Guint w, lo, hi;
+
+  // adding 0x0f to a nibble carries into the next bit iff the nibble
+  // is nonzero
+  for (; i + 4 <= n; i += 4) {
+    memcpy(&w, p0 + i, 4);
+    memcpy(&lo, p1 + i, 4);
+    w |= lo;
+    memcpy(&lo, p2 + i, 4);
+    w |= lo;
+    memcpy(&lo, p3 + i, 4);
+    w |= lo;
+    lo = ((w & 0x0f0f0f0f) + 0x0f0f0f0f) & 0x10101010;
+    hi = (((w >> 4) & 0x0f0f0f0f) + 0x0f0f0f0f) & 0x10101010;
+    if ((lo & hi) != 0x10101010) {
+      break;
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    m = p0[i] | p1[i] | p2[i] | p3[i];
+    if (!(m & 0xf0) || !(m & 0x0f)) {
+      break;
+    }
+  }
+  return i;
+}
+
+#endif // splashAASize == 4
+
+// Set the pixels in (x0..x1) that have nonzero coverage in the AA
+// buffer (pipeRun paints any covered pixel fully).  Runs of covered
+// pixels are filled with fillSpan; the AA buffer is scanned a byte
+// (two pixels) or a vector at a time where the run is byte-aligned.
+template<SplashColorMode mode>
+static void splashMonoAALine(SplashBitmap *aaBuf, SplashColorPtr row,
+			     int x0, int x1, Guchar c,
+			     int *modX0, int *modX1) {
+#if splashAASize == 4
+  SplashColorPtr p0, p1, p2, p3;
+  int n, xs;
+
+#define splashAACovered(x) \
+    ((p0[(x) >> 1] | p1[(x) >> 1] | p2[(x) >> 1] | p3[(x) >> 1]) & \
+     (((x) & 1) ? 0x0f : 0xf0))
+
+  p0 = aaBuf->getDataPtr();
+  p1 = p0 + aaBuf->getRowSize();
+  p2 = p1 + aaBuf->getRowSize();
+  p3 = p2 + aaBuf->getRowSize();
+  // bytes [x0 >> 1, n) lie entirely inside (x0..x1) once x0 is even
+  n = (x1 + 1) >> 1;
+  while (x0 <= x1) {
+
+    // skip uncovered pixels
+    if (!(x0 & 1)) {
+      x0 = splashAAScanEmpty(p0, p1, p2, p3, x0 >> 1, n) << 1;
+      if (x0 > x1) {
+	break;
+      }
+    }
+    if (!splashAACovered(x0)) {
+      ++x0;
+      continue;
+    }
+
+    // find the end of the covered run
+    xs = x0++;
+    while (x0 <= x1) {
+      if (!(x0 & 1)) {
+	x0 = splashAAScanFull(p0, p1, p2, p3, x0 >> 1, n) << 1;
+	if (x0 > x1) {
+	  break;
+	}
+      }
+      if (!splashAACovered(x0)) {
+	break;
+      }
+      ++x0;
+    }
+
+    SplashMonoKernel<mode>::fillSpan(row, xs, x0 - 1, c);
+    if (xs < *modX0) {
+      *modX0 = xs;
+    }
+    *modX1 = x0 - 1;
+  }
+
+#undef splashAACovered
+
+#else
+  SplashColorPtr p;
+  int x, xx, yy, t;
+
+  for (x = x0; x <= x1; ++x) {
+    t = 0;
+    for (yy = 0; yy < splashAASize; ++yy) {
+      for (xx = 0; xx < splashAASize; ++xx) {
+	p = aaBuf->getDataPtr() + yy * aaBuf->getRowSize() +
+	    ((x * splashAASize + xx) >> 3);
+	t += (*p >> (7 - ((x * splashAASize + xx) & 7))) & 1;
+      }
+    }
+    if (t != 0) {
+      SplashMonoKernel<mode>::putPixel(row, x, c);
+      if (x < *modX0) {
+	*modX0 = x;
+      }
+      *modX1 = x;
+    }
+  }
+#endif
+}
+
+// Return the first glyph coverage value in p[i..n-1] that is greater
+// than <t>, or n if there is none.
+static inline int splashGlyphScanAbove(Guchar *p, int i, int n, int t) {
+#if splashSSE2
+  __m128i v, tv;
+#elif splashNEON
+  uint64x2_t e;
+#else
+  Guint w;
+#endif
+
+  // most runs of partial coverage are a pixel or two long
+  if (i < n && p[i] > t) {
+    return i;
+  }
+#if splashSSE2
+  tv = _mm_set1_epi8((char)t);
+  for (; i + 16 <= n; i += 16) {
+    v = _mm_loadu_si128((__m128i *)(p + i));
+    // v <= t iff min(v, t) == v
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, tv), v)) != 0xffff) {
+      break;
+    }
+  }
+#elif splashNEON
+  for (; i + 16 <= n; i += 16) {
+    e = vreinterpretq_u64_u8(vcgtq_u8(vld1q_u8(p + i), vdupq_n_u8(t)));
+    if (vgetq_lane_u64(e, 0) | vgetq_lane_u64(e, 1)) {
+      break;
+    }
+  }
+#else
+  for (; i + 4 <= n; i += 4) {
+    memcpy(&w, p + i, 4);
+    if (w) {
+      break;
+    }
+  }
+#endif
+  while (i < n && p[i] <= t) {
+    ++i;
+  }
+  return i;
+}
+
+// Return the first glyph coverage value in p[i..n-1] that is less
+// than <t>, or n if there is none.
+static inline int splashGlyphScanBelow(Guchar *p, int i, int n, int t) {
+#if splashSSE2
+  __m128i v, tv;
+#elif splashNEON
+  uint64x2_t e;
+#else
+  Guint w;
+#endif
+
+  if (i < n && p[i] < t) {
+    return i;
+  }
+#if splashSSE2
+  tv = _mm_set1_epi8((char)t);
+  for (; i + 16 <= n; i += 16) {
+    v = _mm_loadu_si128((__m128i *)(p + i));
+    // v >= t iff max(v, t) == v
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, tv), v)) != 0xffff) {
+      break;
+    }
+  }
+#elif splashNEON
+  for (; i + 16 <= n; i += 16) {
+    e = vreinterpretq_u64_u8(vcltq_u8(vld1q_u8(p + i), vdupq_n_u8(t)));
+    if (vgetq_lane_u64(e, 0) | vgetq_lane_u64(e, 1)) {
+      break;
+    }
+  }
+#else
+  for (; i + 4 <= n; i += 4) {
+    memcpy(&w, p + i, 4);
+    if (w != 0xffffffff) {
+      break;
+    }
+  }
+#endif
+  while (i < n && p[i] >= t) {
+    ++i;
+  }
+  return i;
+}
+
+// Composite an unclipped anti-aliased glyph: coverage of 250 or more
+// paints the glyph color, and lower coverage blends with the
+// destination (Mono4 pixels start blending at 5, Mono8 above 5).
+template<SplashColorMode mode>
+static void splashMonoGlyphAA(SplashBitmap *bitmap, int xStart, int yStart,
+			      int w, int h, Guchar *p, int lineSize,
+			      Guchar c) {
+  SplashColorPtr row;
+  int t, cc, cv, xx, xs, yy;
+
+  t = mode == splashModeMono4 ? 4 : 5;
+  row = &bitmap->getDataPtr()[yStart * bitmap->getRowSize()];
+  for (yy = 0; yy < h; ++yy) {
+    xx = 0;
+    while ((xx = splashGlyphScanAbove(p, xx, w, t)) < w) {
+      cc = p[xx];
+      if (cc >= 250) {
+	xs = xx;
+	xx = splashGlyphScanBelow(p, xx + 1, w, 250);
+	SplashMonoKernel<mode>::fillSpan(row, xStart + xs, xStart + xx - 1, c);
+      } else {
+	cv = SplashMonoKernel<mode>::getPixel(row, xStart + xx);
+	cv += ((c - cv) * cc) >> 8;
+	SplashMonoKernel<mode>::putPixel(row, xStart + xx, (Guchar)cv);
+	++xx;
+      }
+    }
+    p += lineSize;
+    row += bitmap->getRowSize();
+  }
+}
+
+// Return the first bit in [xb, xbEnd) of the packed row <p> that is
+// equal to <set>, or xbEnd if there is none.
+static inline int splashGlyphScanBits(Guchar *p, int xb, int xbEnd,
+				      GBool set) {
+  Guchar skip;
+
+  skip = set ? 0x00 : 0xff;
+  while (xb < xbEnd) {
+    if (!(xb & 7) && xb + 8 <= xbEnd && p[xb >> 3] == skip) {
+      xb += 8;
+    } else if (!(p[xb >> 3] & (0x80 >> (xb & 7))) == !set) {
+      return xb;
+    } else {
+      ++xb;
+    }
+  }
+  return xbEnd;
+}
+
+// Composite an unclipped 1-bit glyph, starting at bit <xOffset> of
+// each glyph row.  Runs of set bits are filled with fillSpan.
+template<SplashColorMode mode>
+static void splashMonoGlyph(SplashBitmap *bitmap, int xStart, int yStart,
+			    int w, int h, Guchar *p, int lineSize,
+			    int xOffset, Guchar c) {
+  SplashColorPtr row;
+  int xb, xs, yy;
+
+  row = &bitmap->getDataPtr()[yStart * bitmap->getRowSize()];
+  xStart -= xOffset;
+  for (yy = 0; yy < h; ++yy) {
+    xb = xOffset;
+    while ((xb = splashGlyphScanBits(p, xb, xOffset + w, gTrue)) <
+	   xOffset + w) {
+      xs = xb;
+      xb = splashGlyphScanBits(p, xb + 1, xOffset + w, gFalse);
+      SplashMonoKernel<mode>::fillSpan(row, xStart + xs, xStart + xb - 1, c);
+    }
+    p += lineSize;
+    row += bitmap->getRowSize();
+  }
+}
+
+// Store the 8-bit gray values <src> as Mono4 pixels (x0..x1) of <row>.
+// Each pair of source bytes a, b packs to (a & 0xf0) | (b >> 4).
+static void splashPackMono4(SplashColorPtr row, SplashColorPtr src,
+			    int x0, int x1) {
+  SplashColorPtr q;
+  int n;
+#if splashSSE2
+  __m128i lo, hi, m;
+#elif splashNEON
+  uint8x16x2_t v;
+#endif
+
+  if (x0 & 1) {
+    SplashMonoKernel<splashModeMono4>::putPixel(row, x0, *src++);
+    ++x0;
+  }
+  q = row + (x0 >> 1);
+  n = (x1 - x0 + 1) >> 1;
+#if splashSSE2
+  // in each little-endian 16-bit lane, a is the low byte and b the high
+  m = _mm_set1_epi16(0x00f0);
+  for (; n >= 16; n -= 16) {
+    lo = _mm_loadu_si128((__m128i *)src);
+    hi = _mm_loadu_si128((__m128i *)(src + 16));
+    lo = _mm_or_si128(_mm_and_si128(lo, m), _mm_srli_epi16(lo, 12));
+    hi = _mm_or_si128(_mm_and_si128(hi, m), _mm_srli_epi16(hi, 12));
+    _mm_storeu_si128((__m128i *)q, _mm_packus_epi16(lo, hi));
+    src += 32;
+    q += 16;
+  }
+#elif splashNEON
+  for (; n >= 16; n -= 16) {
+    v = vld2q_u8(src);
+    vst1q_u8(q, vsriq_n_u8(v.val[0], v.val[1], 4));
+    src += 32;
+    q += 16;
+  }
+#endif
+  for (; n > 0; --n) {
+    *q++ = (src[0] & 0xf0) | (src[1] >> 4);
+    src += 2;
+  }
+  if (x0 <= x1 && !(x1 & 1)) {
+    *q = (*q & 0x0f) | (*src & 0xf0);
+  }
+}
+
 //------------------------------------------------------------------------
 // pipeline
 //------------------------------------------------------------------------
@@ -215,6 +740,15 @@ inline void Splash::pipeInit(SplashPipe *pipe, int x, int y,
   } else {
     pipe->nonIsolatedGroup = 0;
   }
+
+  // opaque, unblended painting into a Mono8 or Mono4 bitmap without an
+  // alpha channel can skip the pipe (shape only decides whether a
+  // pixel is painted at all -- see pipeRun)
+  pipe->monoKernel = (bitmap->mode == splashModeMono8 ||
+		      bitmap->mode == splashModeMono4) &&
+                     !bitmap->alpha && aInput == 1 && !state->softMask &&
+                     !state->blendFunc && !state->inNonIsolatedGroup &&
+                     !nonIsolatedGroup;
 }
 
 inline void Splash::pipeRun(SplashPipe *pipe) {
@@ -229,7 +763,10 @@ inline void Splash::pipeRun(SplashPipe *pipe) {
 
   // dynamic pattern
   if (pipe->pattern) {
-    pipe->pattern->getColor(pipe->x, pipe->y, pipe->cSrcVal);
+    if (!pipe->pattern->getColor(pipe->x, pipe->y, pipe->cSrcVal)) {
+      pipeIncX(pipe);
+      return;
+    }
   }
 
 //  if (pipe->noTransparency && !state->blendFunc) {
@@ -778,7 +1315,64 @@ inline void Splash::drawAAPixel(SplashPipe *pipe, int x, int y) {
 
 inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y,
 			     GBool noClip) {
-  int x;
+  SplashColorPtr row;
+  int x, modX0, modX1;
+
+  if (pipe->monoKernel && pipe->pattern) {
+    if (!patternBuf) {
+      patternBuf = (Guchar *)gmallocn(bitmap->width,
+				      splashMaxColorComps + 1);
+    }
+    row = &bitmap->data[y * bitmap->rowSize];
+    modX0 = x1 + 1;
+    modX1 = x0 - 1;
+    if (bitmap->mode == splashModeMono8) {
+      splashMonoPatternSpan<splashModeMono8>(pipe->pattern, state->clip,
+					     noClip, row, x0, x1, y,
+					     patternBuf, &modX0, &modX1);
+    } else {
+      splashMonoPatternSpan<splashModeMono4>(pipe->pattern, state->clip,
+					     noClip, row, x0, x1, y,
+					     patternBuf, &modX0, &modX1);
+    }
+    if (modX0 <= modX1) {
+      updateModX(modX0);
+      updateModX(modX1);
+      updateModY(y);
+    }
+    return;
+  }
+
+  if (pipe->monoKernel && !pipe->pattern) {
+    row = &bitmap->data[y * bitmap->rowSize];
+    if (noClip) {
+      if (bitmap->mode == splashModeMono8) {
+	SplashMonoKernel<splashModeMono8>::fillSpan(row, x0, x1,
+						    pipe->cSrc[0]);
+      } else {
+	SplashMonoKernel<splashModeMono4>::fillSpan(row, x0, x1,
+						    pipe->cSrc[0]);
+      }
+      modX0 = x0;
+      modX1 = x1;
+    } else {
+      modX0 = x1 + 1;
+      modX1 = x0 - 1;
+      if (bitmap->mode == splashModeMono8) {
+	splashMonoClippedSpan<splashModeMono8>(state->clip, row, x0, x1, y,
+					       pipe->cSrc[0], &modX0, &modX1);
+      } else {
+	splashMonoClippedSpan<splashModeMono4>(state->clip, row, x0, x1, y,
+					       pipe->cSrc[0], &modX0, &modX1);
+      }
+    }
+    if (modX0 <= modX1) {
+      updateModX(modX0);
+      updateModX(modX1);
+      updateModY(y);
+    }
+    return;
+  }
 
   pipeSetXY(pipe, x0, y);
   if (noClip) {
@@ -801,6 +1395,128 @@ inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y,
   }
 }
 
+// Reduce an 8-bit gray value to the four levels of a 2-bit display
+// with an ordered dither.
+static inline Guchar splashDitherPixel(int c, int x, int y) {
+  c -= 48;
+  if (c < 0) c = 0;
+  if ((c & 63) <= dither_matrix[(x&7)+((y&7)<<3)]) {
+    return (Guchar)dither_colors[c >> 6];
+  } else {
+    return (Guchar)dither_colors[(c >> 6) + 1];
+  }
+}
+
+// Mono8/Mono4 version of drawImageSpan, for pipes with monoKernel set.
+// <clip> is NULL if the span is known to be unclipped.
+template<SplashColorMode mode>
+static void splashMonoImageSpan(SplashClip *clip, SplashColorPtr row,
+				SplashColorPtr colorLine, Guchar *alphaLine,
+				int xDir, int x0, int x1, int y, GBool dither,
+				int *modX0, int *modX1) {
+  SplashColorPtr p;
+  Guchar *q;
+  int x;
+
+  p = colorLine;
+  q = alphaLine;
+  for (x = x0; x <= x1; ++x, p += xDir) {
+    if ((!q || *q) && (!clip || clip->test(x, y))) {
+      SplashMonoKernel<mode>::putPixel(row, x,
+				       dither ? splashDitherPixel(*p, x, y)
+				              : *p);
+      if (x < *modX0) {
+	*modX0 = x;
+      }
+      *modX1 = x;
+    }
+    if (q) {
+      q += xDir;
+    }
+  }
+}
+
+// Draw a row of image pixels to (x0..x1, y).  <colorLine> points to
+// the pixel drawn at x0; successive pixels are <xDir> pixels apart in
+// <colorLine> (and <alphaLine>, if non-NULL), so a mirrored row can be
+// drawn without copying it.  Pixels with zero alpha are skipped.
+inline void Splash::drawImageSpan(SplashPipe *pipe, SplashColorPtr colorLine,
+				  Guchar *alphaLine, int nComps, int xDir,
+				  int x0, int x1, int y, GBool noClip,
+				  GBool dither) {
+  SplashColorPtr p, row;
+  Guchar *q;
+  int colorStep, x, i, modX0, modX1;
+
+  if (pipe->monoKernel) {
+    row = &bitmap->data[y * bitmap->rowSize];
+    modX0 = x1 + 1;
+    modX1 = x0 - 1;
+    if (bitmap->mode == splashModeMono8) {
+      if (noClip && !alphaLine && !dither && xDir > 0) {
+	memcpy(row + x0, colorLine, x1 - x0 + 1);
+	modX0 = x0;
+	modX1 = x1;
+      } else {
+	splashMonoImageSpan<splashModeMono8>(noClip ? (SplashClip *)NULL
+					            : state->clip,
+					     row, colorLine, alphaLine, xDir,
+					     x0, x1, y, dither,
+					     &modX0, &modX1);
+      }
+    } else if (noClip && !alphaLine && !dither && xDir > 0) {
+      splashPackMono4(row, colorLine, x0, x1);
+      modX0 = x0;
+      modX1 = x1;
+    } else {
+      splashMonoImageSpan<splashModeMono4>(noClip ? (SplashClip *)NULL
+					          : state->clip,
+					   row, colorLine, alphaLine, xDir,
+					   x0, x1, y, dither, &modX0, &modX1);
+    }
+    if (modX0 <= modX1) {
+      updateModX(modX0);
+      updateModX(modX1);
+      updateModY(y);
+    }
+    return;
+  }
+
+  colorStep = xDir * nComps;
+  p = colorLine;
+  q = alphaLine;
+  pipeSetXY(pipe, x0, y);
+  for (x = x0; x <= x1; ++x, p += colorStep) {
+    if ((q && !*q) || (!noClip && !state->clip->test(x, y))) {
+      pipeIncX(pipe);
+    } else {
+      if (dither) {
+	pipe->cSrc[0] = splashDitherPixel(p[0], x, y);
+	for (i = 1; i < nComps; ++i) {
+	  pipe->cSrc[i] = p[i];
+	}
+      } else {
+	for (i = 0; i < nComps; ++i) {
+	  pipe->cSrc[i] = p[i];
+	}
+      }
+      pipeRun(pipe);
+      if (!noClip) {
+	updateModX(x);
+	updateModY(y);
+      }
+    }
+    if (q) {
+      q += xDir;
+    }
+  }
+  if (noClip) {
+    updateModX(x0);
+    updateModX(x1);
+    updateModY(y);
+  }
+}
+
 inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y) {
 
 #if splashAASize == 4
@@ -812,7 +1528,27 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y) {
   SplashColorPtr p;
   int xx, yy, t;
 #endif
-  int x;
+  SplashColorPtr row;
+  int x, modX0, modX1;
+
+  if (pipe->monoKernel && !pipe->pattern) {
+    row = &bitmap->data[y * bitmap->rowSize];
+    modX0 = x1 + 1;
+    modX1 = x0 - 1;
+    if (bitmap->mode == splashModeMono8) {
+      splashMonoAALine<splashModeMono8>(aaBuf, row, x0, x1, pipe->cSrc[0],
+					&modX0, &modX1);
+    } else {
+      splashMonoAALine<splashModeMono4>(aaBuf, row, x0, x1, pipe->cSrc[0],
+					&modX0, &modX1);
+    }
+    if (modX0 <= modX1) {
+      updateModX(modX0);
+      updateModX(modX1);
+      updateModY(y);
+    }
+    return;
+  }
 
 #if splashAASize == 4
   p0 = aaBuf->getDataPtr() + (x0 >> 1);
@@ -891,6 +1627,7 @@ Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
   } else {
     aaBuf = NULL;
   }
+  patternBuf = NULL;
   clearModRegion();
   debugMode = gFalse;
 }
@@ -914,6 +1651,7 @@ Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
   } else {
     aaBuf = NULL;
   }
+  patternBuf = NULL;
   clearModRegion();
   debugMode = gFalse;
 }
@@ -926,6 +1664,7 @@ Splash::~Splash() {
   if (vectorAntialias) {
     delete aaBuf;
   }
+  gfree(patternBuf);
 }
 
 //------------------------------------------------------------------------
@@ -1625,26 +2364,26 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
 				    SplashPattern *pattern,
 				    SplashCoord alpha) {
   SplashPipe pipe;
-  SplashXPath *xPath;
-  SplashXPathScanner *scanner;
   int xMinI, yMinI, xMaxI, yMaxI, x0, x1, y;
   SplashClipResult clipRes, clipRes2;
 
   if (path->length == 0) {
     return splashErrEmptyPath;
   }
-  xPath = new SplashXPath(path, state->matrix, state->flatness, gTrue);
+  // the path and scanner only live for this fill, so keep them off
+  // the heap
+  SplashXPath xPath(path, state->matrix, state->flatness, gTrue);
   if (vectorAntialias) {
-    xPath->aaScale();
+    xPath.aaScale();
   }
-  xPath->sort();
-  scanner = new SplashXPathScanner(xPath, eo);
+  xPath.sort();
+  SplashXPathScanner scanner(&xPath, eo);
 
   // get the min and max x and y values
   if (vectorAntialias) {
-    scanner->getBBoxAA(&xMinI, &yMinI, &xMaxI, &yMaxI);
+    scanner.getBBoxAA(&xMinI, &yMinI, &xMaxI, &yMaxI);
   } else {
-    scanner->getBBox(&xMinI, &yMinI, &xMaxI, &yMaxI);
+    scanner.getBBox(&xMinI, &yMinI, &xMaxI, &yMaxI);
   }
 
   // check clipping
@@ -1664,7 +2403,7 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
     // draw the spans
     if (vectorAntialias) {
       for (y = yMinI; y <= yMaxI; ++y) {
-	scanner->renderAALine(aaBuf, &x0, &x1, y);
+	scanner.renderAALine(aaBuf, &x0, &x1, y);
 	if (clipRes != splashClipAllInside) {
 	  state->clip->clipAALine(aaBuf, &x0, &x1, y);
 	}
@@ -1672,7 +2411,7 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
       }
     } else {
       for (y = yMinI; y <= yMaxI; ++y) {
-	while (scanner->getNextSpan(y, &x0, &x1)) {
+	while (scanner.getNextSpan(y, &x0, &x1)) {
 	  if (clipRes == splashClipAllInside) {
 	    drawSpan(&pipe, x0, x1, y, gTrue);
 	  } else {
@@ -1683,7 +2422,16 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
 	    if (x1 > state->clip->getXMaxI()) {
 	      x1 = state->clip->getXMaxI();
 	    }
-	    clipRes2 = state->clip->testSpan(x0, x1, y);
+	    if (x0 > x1) {
+	      continue;
+	    }
+	    // the span is inside the clip rectangle now, so it only needs
+	    // per-pixel tests against clip paths
+	    if (state->clip->getNumPaths() == 0) {
+	      clipRes2 = splashClipAllInside;
+	    } else {
+	      clipRes2 = state->clip->testSpan(x0, x1, y);
+	    }
 	    drawSpan(&pipe, x0, x1, y, clipRes2 == splashClipAllInside);
 	  }
 	}
@@ -1692,11 +2440,13 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
   }
   opClipRes = clipRes;
 
-  delete scanner;
-  delete xPath;
   return splashOk;
 }
 
+SplashError Splash::shadedFill(SplashPath *path, SplashPattern *pattern) {
+  return fillWithPattern(path, gFalse, pattern, state->fillAlpha);
+}
+
 SplashError Splash::xorFill(SplashPath *path, GBool eo) {
   SplashPipe pipe;
   SplashXPath *xPath;
@@ -1787,6 +2537,121 @@ SplashError Splash::fillChar(SplashCoord x, SplashCoord y,
   return splashOk;
 }
 
+void Splash::fillChars(SplashCharPos *chars, int n, SplashFont *font) {
+  SplashGlyphBitmap glyph;
+  SplashPipe pipe;
+  SplashColor color;
+  SplashColorPtr solidColor;
+  SplashCoord *matrix;
+  SplashCoord xt, yt;
+  SplashClip *glyphClip;
+  SplashClipResult clipRes, runClipRes;
+  GBool monoKernel, found, noClip;
+  int fxMin, fyMin, fxMax, fyMax, rxMin, ryMin, rxMax, ryMax;
+  int gxMin, gyMin, pipeAA, i;
+
+  if (n <= 0) {
+    return;
+  }
+
+  // the matrix, clip and fill color are shared by the whole run, so
+  // they are fetched once rather than per glyph
+  matrix = state->matrix;
+  solidColor = NULL;
+  if (state->fillPattern->isStatic()) {
+    state->fillPattern->getColor(0, 0, color);
+    solidColor = color;
+  }
+
+  // resolve the device position of every glyph, and the box that
+  // holds their origins
+  rxMin = ryMin = rxMax = ryMax = 0;
+  for (i = 0; i < n; ++i) {
+    xt = chars[i].x * matrix[0] + chars[i].y * matrix[2] + matrix[4];
+    yt = chars[i].x * matrix[1] + chars[i].y * matrix[3] + matrix[5];
+    chars[i].x0 = splashFloor(xt);
+    chars[i].xFrac = splashFloor((xt - chars[i].x0) * splashFontFraction);
+    chars[i].y0 = splashFloor(yt);
+    chars[i].yFrac = splashFloor((yt - chars[i].y0) * splashFontFraction);
+    if (i == 0 || chars[i].x0 < rxMin) {
+      rxMin = chars[i].x0;
+    }
+    if (i == 0 || chars[i].x0 > rxMax) {
+      rxMax = chars[i].x0;
+    }
+    if (i == 0 || chars[i].y0 < ryMin) {
+      ryMin = chars[i].y0;
+    }
+    if (i == 0 || chars[i].y0 > ryMax) {
+      ryMax = chars[i].y0;
+    }
+  }
+
+  // test the clip once, against that box grown by the font bounding
+  // box (whose y axis points up).  If the whole run is inside, getGlyph
+  // skips its clip test, and each glyph is only checked against the run
+  // box -- the font bounding box is not trusted to hold every glyph.
+  font->getBBox(&fxMin, &fyMin, &fxMax, &fyMax);
+  rxMin += fxMin - 2;
+  rxMax += fxMax + 2;
+  ryMin -= fyMax + 2;
+  ryMax -= fyMin - 2;
+  glyphClip = state->clip;
+  if (state->clip->testRect(rxMin, ryMin, rxMax, ryMax) ==
+      splashClipAllInside) {
+    glyphClip = NULL;
+  }
+
+  // glyphs that don't go through the mono kernels share one pipe
+  monoKernel = bitmap->mode == splashModeMono8 ||
+               bitmap->mode == splashModeMono4;
+  pipeAA = -1;
+
+  runClipRes = splashClipAllOutside;
+  found = gFalse;
+  for (i = 0; i < n; ++i) {
+    if (!font->getGlyph(chars[i].c, chars[i].xFrac, chars[i].yFrac, &glyph,
+			chars[i].x0, chars[i].y0, glyphClip, &clipRes)) {
+      continue;
+    }
+    if (!glyphClip) {
+      gxMin = chars[i].x0 - glyph.x;
+      gyMin = chars[i].y0 - glyph.y;
+      if (gxMin < rxMin || gxMin + glyph.w - 1 > rxMax ||
+	  gyMin < ryMin || gyMin + glyph.h - 1 > ryMax) {
+	clipRes = state->clip->testRect(gxMin, gyMin, gxMin + glyph.w - 1,
+					gyMin + glyph.h - 1);
+      }
+    }
+    if (clipRes != splashClipAllOutside) {
+      noClip = clipRes == splashClipAllInside;
+      if (noClip && monoKernel) {
+	fillGlyph2(chars[i].x0, chars[i].y0, &glyph, gTrue, solidColor);
+      } else {
+	if (pipeAA != (int)glyph.aa) {
+	  pipeInit(&pipe, 0, 0, state->fillPattern, NULL, state->fillAlpha,
+		   glyph.aa, gFalse);
+	  pipeAA = (int)glyph.aa;
+	}
+	fillGlyph2(chars[i].x0, chars[i].y0, &glyph, noClip, solidColor,
+		   &pipe);
+      }
+    }
+    if (!found) {
+      runClipRes = clipRes;
+      found = gTrue;
+    } else if (clipRes != runClipRes) {
+      runClipRes = splashClipPartial;
+    }
+    if (glyph.freeData) {
+      gfree(glyph.data);
+    }
+  }
+  if (found) {
+    opClipRes = runClipRes;
+  }
+}
+
 void Splash::fillGlyph(SplashCoord x, SplashCoord y,
 			      SplashGlyphBitmap *glyph) {
   SplashCoord xt, yt;
@@ -1805,15 +2670,18 @@ void Splash::fillGlyph(SplashCoord x, SplashCoord y,
   opClipRes = clipRes;
 }
 
-void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip) {
-  SplashPipe pipe;
+// If <solidColor> is non-NULL, it is the (static) fill pattern's
+// color, which the caller has already looked up.  If <runPipe> is
+// non-NULL, the caller has set it up with pipeInit for the fill
+// pattern, with usesShape equal to glyph->aa.
+void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip,
+			SplashColorPtr solidColor, SplashPipe *runPipe) {
+  SplashPipe glyphPipe;
+  SplashPipe *pipe;
   int alpha0, alpha;
   Guchar *p;
   SplashColor color;
-  Guchar *dest, *destalpha=NULL, csrc, mask;
-  int cc, cv;
   int x1, y1, xx, xx1, yy;
-  int gm;
 
   static SplashCoord V255 = (SplashCoord)255.0;
 
@@ -1822,17 +2690,23 @@ void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip)
   int yStart = y0 - glyph->y;
   int xxLimit = glyph->w;
   int yyLimit = glyph->h;
+  int lineSize = glyph->aa ? glyph->w : (glyph->w + 7) >> 3;
+  int xOffset = 0;
 
   if (yStart < 0)
   {
-    p += glyph->w * -yStart; // move p to the beginning of the first painted row
+    p += lineSize * -yStart; // move p to the beginning of the first painted row
     yyLimit += yStart;
     yStart = 0;
   }
 
   if (xStart < 0)
   {
-    p += -xStart; // move p to the first painted pixel
+    if (glyph->aa) {
+      p += -xStart; // move p to the first painted pixel
+    } else {
+      xOffset = -xStart; // start at this bit of each row
+    }
     xxLimit += xStart;
     xStart = 0;
   }
@@ -1840,128 +2714,80 @@ void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip)
   if (xxLimit + xStart >= bitmap->width) xxLimit = bitmap->width - xStart;
   if (yyLimit + yStart >= bitmap->height) yyLimit = bitmap->height - yStart;
 
-  if (noClip) {
+  if (noClip && (bitmap->mode == splashModeMono8 ||
+		 bitmap->mode == splashModeMono4)) {
 
+    if (solidColor) {
+      color[0] = solidColor[0];
+    } else {
       state->fillPattern->getColor(xStart, yStart, color);
-      csrc =color[0];
+    }
 
-      if (bitmap->mode == splashModeMono4) {
-          gm = (glyph->aa) ? 1 : 0;
+    if (bitmap->mode == splashModeMono8) {
+      if (glyph->aa) {
+	splashMonoGlyphAA<splashModeMono8>(bitmap, xStart, yStart,
+					   xxLimit, yyLimit, p, lineSize,
+					   color[0]);
       } else {
-          gm = (glyph->aa) ? 3 : 2;
+	splashMonoGlyph<splashModeMono8>(bitmap, xStart, yStart,
+					 xxLimit, yyLimit, p, lineSize,
+					 xOffset, color[0]);
       }
-
-      for (yy = 0, y1 = yStart; yy < yyLimit; ++yy, ++y1) {
-	if (bitmap->mode == splashModeMono4) {
-           dest = &bitmap->data[y1 * bitmap->rowSize + (xStart >> 1)];
-	   mask = (xStart & 1) ? 0xf : 0xf0;
-	} else {
-           dest = &bitmap->data[y1 * bitmap->rowSize + xStart];
-	   mask = 0;
-	}
-	//if (bitmap->alpha) destalpha = &bitmap->alpha[y1 * bitmap->width + xStart];
-        for (xx = 0, x1 = xStart; xx < xxLimit; ++xx, ++x1) {
-	    switch (gm) {
-		case 0: // depth 4, no aa
-		    if (p[xx>>3] & (0x80 >> (xx & 7))) {
-			if (mask & 0xf) {
-			   *dest = (*dest & 0xf0) | ((csrc >> 4) & 0xf);
-			} else {
-			   *dest = (*dest & 0x0f) | (csrc & 0xf0);
-			}
-		    }
-		    if (!(mask >>= 4)) {
-			mask = 0xf0;
-			dest++;
-		    }
-		    break;
-		case 1: // depth 4, aa
-		    cc = p[xx];
-		    if (cc >= 5) {
-			if (cc < 250) {
-			    cv = ((mask & 0xf0) ? (*dest >> 4) : *dest) & 0xf;
-			    cv = cv | (cv<<4);
-			    cv += (((csrc - cv) * p[xx]) >> 8);
-			} else {
-			    cv = csrc;
-			}
-			if (mask & 0xf) {
-			   *dest = (*dest & 0xf0) | ((cv >> 4) & 0xf);
-			} else {
-			   *dest = (*dest & 0x0f) | (cv & 0xf0);
-			}
-		    }
-		    if (!(mask >>= 4)) {
-			mask = 0xf0;
-			dest++;
-		    }
-		    break;
-		case 2: // depth 8, no aa
-		    if (p[xx>>3] & (0x80 >> (xx & 7))) *dest = csrc;
-		    dest++;
-		    break;
-		case 3: // depth 8, aa
-		    cc = p[xx];
-		    if (cc >= 250) {
-			*dest = csrc;
-		    } else if (cc > 5) {
-			*dest += (((csrc - *dest) * p[xx]) >> 8);
-		    }
-		    dest++;
-		    break;
-	    }	
-        }
-        p += (glyph->aa ? glyph->w : (glyph->w+7)/8);
+    } else {
+      if (glyph->aa) {
+	splashMonoGlyphAA<splashModeMono4>(bitmap, xStart, yStart,
+					   xxLimit, yyLimit, p, lineSize,
+					   color[0]);
+      } else {
+	splashMonoGlyph<splashModeMono4>(bitmap, xStart, yStart,
+					 xxLimit, yyLimit, p, lineSize,
+					 xOffset, color[0]);
       }
+    }
 
   } else {
+    if (runPipe) {
+      pipe = runPipe;
+    } else {
+      pipe = &glyphPipe;
+      pipeInit(pipe, xStart, yStart, state->fillPattern, NULL,
+	       state->fillAlpha, glyph->aa, gFalse);
+    }
     if (glyph->aa) {
-      pipeInit(&pipe, xStart, yStart,
-               state->fillPattern, NULL, state->fillAlpha, gTrue, gFalse);
       for (yy = 0, y1 = yStart; yy < yyLimit; ++yy, ++y1) {
-        pipeSetXY(&pipe, xStart, y1);
+        pipeSetXY(pipe, xStart, y1);
         for (xx = 0, x1 = xStart; xx < xxLimit; ++xx, ++x1) {
-          if (state->clip->test(x1, y1)) {
+          if (noClip || state->clip->test(x1, y1)) {
             alpha = p[xx];
             if (alpha != 0) {
-              pipe.shape = (SplashCoord)alpha / V255;
-              pipeRun(&pipe);
+              pipe->shape = (SplashCoord)alpha / V255;
+              pipeRun(pipe);
               updateModX(x1);
               updateModY(y1);
             } else {
-              pipeIncX(&pipe);
+              pipeIncX(pipe);
             }
           } else {
-            pipeIncX(&pipe);
+            pipeIncX(pipe);
           }
         }
         p += glyph->w;
       }
     } else {
-      const int widthEight = splashCeil(glyph->w / 8.0);
-
-      pipeInit(&pipe, xStart, yStart,
-               state->fillPattern, NULL, state->fillAlpha, gFalse, gFalse);
       for (yy = 0, y1 = yStart; yy < yyLimit; ++yy, ++y1) {
-        pipeSetXY(&pipe, xStart, y1);
-        for (xx = 0, x1 = xStart; xx < xxLimit; xx += 8) {
-          alpha0 = p[xx / 8];
-          for (xx1 = 0; xx1 < 8 && xx + xx1 < xxLimit; ++xx1, ++x1) {
-            if (state->clip->test(x1, y1)) {
-              if (alpha0 & 0x80) {
-                pipeRun(&pipe);
-                updateModX(x1);
-                updateModY(y1);
-              } else {
-                pipeIncX(&pipe);
-              }
-            } else {
-              pipeIncX(&pipe);
-            }
-            alpha0 <<= 1;
+        pipeSetXY(pipe, xStart, y1);
+        for (xx = 0, xx1 = xOffset, x1 = xStart; xx < xxLimit;
+	     ++xx, ++xx1, ++x1) {
+          alpha0 = p[xx1 >> 3] & (0x80 >> (xx1 & 7));
+          if (alpha0 && (noClip || state->clip->test(x1, y1))) {
+            pipeRun(pipe);
+            updateModX(x1);
+            updateModY(y1);
+          } else {
+            pipeIncX(pipe);
           }
         }
-        p += widthEight;
+        p += lineSize;
       }
     }
   }
@@ -2252,11 +3078,98 @@ SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
 #define DISTERROR(offs, n) \
 	{ c2=addr[offs]+(((n)*c1)>>4); if (c2<0) c2=0; if (c2>255) c2=255; addr[offs]=c2; }
 
+// Area-average <n> rows of <w> source pixels (<colorBuf>, and
+// <alphaBuf> if non-NULL) into one row of <scaledWidth> pixels
+// (<colorLine>, <alphaLine>).  The source columns are stepped through
+// with the same Bresenham scheme as the y direction in drawImage, so
+// each output pixel covers either xp or xp+1 source pixels (or
+// repeats one pixel when the image is being stretched).  All
+// arithmetic is integer: each box sum is divided by multiplying with
+// a 24-bit reciprocal.
+static void scaleImageLine(SplashColorPtr colorBuf, Guchar *alphaBuf,
+			   int w, int n, int nComps,
+			   SplashColorPtr colorLine, Guchar *alphaLine,
+			   int scaledWidth) {
+  SplashColorPtr p, q;
+  Guint recip[2];
+  int div[2];
+  int rowSize, xp, xq, xt, xStep, xSrc, m, d, k, sum, x, i, j, c;
+
+  // there are only two box sizes, so compute their reciprocals up
+  // front; (sum * recip + 2^23) >> 24 is the rounded average as long
+  // as the box has no more than 2^16 pixels
+  xp = w / scaledWidth;
+  xq = w % scaledWidth;
+  for (k = 0; k < 2; ++k) {
+    m = xp + k > 0 ? xp + k : 1;
+    div[k] = d = n * m;
+    recip[k] = d <= 0x10000 ? ((1 << 24) + (d >> 1)) / d : 0;
+  }
+
+  rowSize = w * nComps;
+  xt = 0;
+  xSrc = 0;
+  q = colorLine;
+  for (x = 0; x < scaledWidth; ++x) {
+
+    // x scale Bresenham
+    xStep = xp;
+    xt += xq;
+    if (xt >= scaledWidth) {
+      xt -= scaledWidth;
+      ++xStep;
+    }
+    m = xStep > 0 ? xStep : 1;
+    k = xStep - xp;
+
+    // box sums
+    if (div[k] == 1) {
+      p = colorBuf + xSrc * nComps;
+      for (c = 0; c < nComps; ++c) {
+	*q++ = p[c];
+      }
+    } else if (nComps == 1) {
+      sum = 0;
+      for (i = 0, p = colorBuf + xSrc; i < n; ++i, p += rowSize) {
+	for (j = 0; j < m; ++j) {
+	  sum += p[j];
+	}
+      }
+      *q++ = recip[k] ? (Guchar)(((Guint)sum * recip[k] + 0x800000) >> 24)
+	              : (Guchar)((sum + (div[k] >> 1)) / div[k]);
+    } else {
+      for (c = 0; c < nComps; ++c) {
+	sum = 0;
+	for (i = 0, p = colorBuf + xSrc * nComps + c; i < n; ++i, p += rowSize) {
+	  for (j = 0; j < m * nComps; j += nComps) {
+	    sum += p[j];
+	  }
+	}
+	*q++ = recip[k] ? (Guchar)(((Guint)sum * recip[k] + 0x800000) >> 24)
+		        : (Guchar)((sum + (div[k] >> 1)) / div[k]);
+      }
+    }
+    if (alphaBuf) {
+      sum = 0;
+      for (i = 0, p = alphaBuf + xSrc; i < n; ++i, p += w) {
+	for (j = 0; j < m; ++j) {
+	  sum += p[j];
+	}
+      }
+      alphaLine[x] = recip[k]
+	               ? (Guchar)(((Guint)sum * recip[k] + 0x800000) >> 24)
+	               : (Guchar)((sum + (div[k] >> 1)) / div[k]);
+    }
+
+    xSrc += xStep;
+  }
+}
+
 SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 			      SplashColorMode srcMode, GBool srcAlpha,
 			      int w, int h, SplashCoord *mat) {
   SplashPipe pipe;
-  GBool ok, rot;
+  GBool ok, rot, spanMode, dither, lineOk;
   SplashCoord xScale, yScale, xShear, yShear, yShear1;
   int tx, tx2, ty, ty2, scaledWidth, scaledHeight, xSign, ySign;
   int ulx, uly, llx, lly, urx, ury, lrx, lry;
@@ -2264,22 +3177,13 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
   int xMin, xMax, yMin, yMax;
   SplashClipResult clipRes, clipRes2;
   int yp, yq, yt, yStep, lastYStep;
-  int xp, xq, xt, xStep, xSrc;
   int k1, spanXMin, spanXMax, spanY;
-  SplashColorPtr colorBuf, p;
+  SplashColorPtr colorBuf, colorLine, p;
   SplashColor pix;
-  Guchar *alphaBuf, *q;
-#if SPLASH_CMYK
-  int pixAcc0, pixAcc1, pixAcc2, pixAcc3;
-#else
-  int pixAcc0, pixAcc1, pixAcc2;
-#endif
-  int alphaAcc;
-  SplashCoord pixMul, alphaMul, alpha;
+  Guchar *alphaBuf, *alphaLine, *q;
   int x, y, x1, x2, y2;
   SplashCoord y1;
-  int nComps, n, m, i, j;
-  SplashCoord V1 = (SplashCoord)1;
+  int nComps, n, i;
   SplashCoord V1D255 = (SplashCoord)(1.0 / 255.0);
   int hwdepth = GetHardwareDepth();
 
@@ -2412,25 +3316,22 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
     return splashOk;
   }
 
-  // compute Bresenham parameters for x and y scaling
+  // compute Bresenham parameters for y scaling (x scaling is done in
+  // scaleImageLine)
   yp = h / scaledHeight;
   yq = h % scaledHeight;
-  xp = w / scaledWidth;
-  xq = w % scaledWidth;
 
   // allocate pixel buffers
   colorBuf = (SplashColorPtr)gmalloc((yp + 1) * w * nComps);
+  colorLine = (SplashColorPtr)gmallocn(scaledWidth, nComps);
   if (srcAlpha) {
     alphaBuf = (Guchar *)gmalloc((yp + 1) * w);
+    alphaLine = (Guchar *)gmalloc(scaledWidth);
   } else {
     alphaBuf = NULL;
+    alphaLine = NULL;
   }
 
-  pixAcc0 = pixAcc1 = pixAcc2 = 0; // make gcc happy
-#if SPLASH_CMYK
-  pixAcc3 = 0; // make gcc happy
-#endif
-
   // initialize the pixel pipe
   pipeInit(&pipe, 0, 0, NULL, pix, state->fillAlpha,
 	   srcAlpha || (vectorAntialias && clipRes != splashClipAllInside),
@@ -2439,684 +3340,248 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
     drawAAPixelInit();
   }
 
-  if (srcAlpha) {
+  // upright, unsheared images (by far the most common case) are drawn
+  // a row at a time with drawImageSpan
+  spanMode = !rot && mat[1] == 0 && mat[2] == 0 &&
+             !(vectorAntialias && clipRes != splashClipAllInside);
+  dither = hwdepth <= 2;
 
-    // init y scale Bresenham
-    yt = 0;
-    lastYStep = 1;
+  // init y scale Bresenham
+  yt = 0;
+  lastYStep = 1;
+  lineOk = gFalse;
 
-    for (y = 0; y < scaledHeight; ++y) {
+  for (y = 0; y < scaledHeight; ++y) {
 
-      // y scale Bresenham
-      yStep = yp;
-      yt += yq;
-      if (yt >= scaledHeight) {
-	yt -= scaledHeight;
-	++yStep;
-      }
+    // y scale Bresenham
+    yStep = yp;
+    yt += yq;
+    if (yt >= scaledHeight) {
+      yt -= scaledHeight;
+      ++yStep;
+    }
 
-      // read row(s) from image
-      n = (yp > 0) ? yStep : lastYStep;
-      if (n > 0) {
-	p = colorBuf;
-	q = alphaBuf;
-	for (i = 0; i < n; ++i) {
-	  (*src)(srcData, p, q);
-	  p += w * nComps;
+    // read row(s) from image
+    n = (yp > 0) ? yStep : lastYStep;
+    if (n > 0) {
+      p = colorBuf;
+      q = alphaBuf;
+      for (i = 0; i < n; ++i) {
+	(*src)(srcData, p, q);
+	p += w * nComps;
+	if (q) {
 	  q += w;
 	}
       }
-      lastYStep = yStep;
-
-      // loop-invariant constants
-      k1 = splashRound(xShear * ySign * y);
-  
-      // clipping test
-      if (clipRes != splashClipAllInside &&
-	  !rot &&
-	  (int)(yShear * k1) ==
-	    (int)(yShear * (xSign * (scaledWidth - 1) + k1))) {
-	if (xSign > 0) {
-	  spanXMin = tx + k1;
-	  spanXMax = spanXMin + (scaledWidth - 1);
-	} else {
-	  spanXMax = tx + k1;
-	  spanXMin = spanXMax - (scaledWidth - 1);
-	}
-	spanY = ty + ySign * y + (int)(yShear * k1);
-	clipRes2 = state->clip->testSpan(spanXMin, spanXMax, spanY);
-	if (clipRes2 == splashClipAllOutside) {
-	  continue;
-	}
-      } else {
-	clipRes2 = clipRes;
-      }
-
-      // init x scale Bresenham
-      xt = 0;
-      xSrc = 0;
-
-      // x shear
-      x1 = k1;
-
-      // y shear
-      y1 = (SplashCoord)ySign * y + yShear * x1;
-      // this is a kludge: if yShear1 is negative, then (int)y1 would
-      // change immediately after the first pixel, which is not what
-      // we want
-      if (yShear1 < 0) {
-	y1 += 0.999;
-      }
-
-      // loop-invariant constants
-      n = yStep > 0 ? yStep : 1;
-
-      switch (srcMode) {
-
-      case splashModeMono1:
-      case splashModeMono4:
-      case splashModeMono8:
-	for (x = 0; x < scaledWidth; ++x) {
-
-	  // x scale Bresenham
-	  xStep = xp;
-	  xt += xq;
-	  if (xt >= scaledWidth) {
-	    xt -= scaledWidth;
-	    ++xStep;
-	  }
-
-	  // rotation
-	  if (rot) {
-	    x2 = (int)y1;
-	    y2 = -x1;
-	  } else {
-	    x2 = x1;
-	    y2 = (int)y1;
-	  }
-
-	  // compute the filtered pixel at (x,y) after the x and y scaling
-	  // operations
-	  m = xStep > 0 ? xStep : 1;
-	  alphaAcc = 0;
-	  p = colorBuf + xSrc;
-	  q = alphaBuf + xSrc;
-	  pixAcc0 = 0;
-	  for (i = 0; i < n; ++i) {
-	    for (j = 0; j < m; ++j) {
-	      pixAcc0 += *p++;
-	      alphaAcc += *q++;
-	    }
-	    p += w - m;
-	    q += w - m;
-	  }
-	  pixMul = V1 / (SplashCoord)(n * m);
-	  alphaMul = pixMul * V1D255;
-	  alpha = (SplashCoord)alphaAcc * alphaMul;
-
-	  if (alpha > 0) {
-	    pix[0] = (int)((SplashCoord)pixAcc0 * pixMul);
-
-	    // set pixel
-	    pipe.shape = alpha;
-	    if (vectorAntialias && clipRes != splashClipAllInside) {
-	      drawAAPixel(&pipe, tx + x2, ty + y2);
-	    } else if (hwdepth <= 2) {
-	      drawPixelD(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	    } else {
-	      drawPixel(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	    }
-	  }
-
-	  // x scale Bresenham
-	  xSrc += xStep;
-
-	  // x shear
-	  x1 += xSign;
-
-	  // y shear
-	  y1 += yShear1;
-	}
-	break;
-
-      case splashModeRGB8:
-      case splashModeBGR8:
-	for (x = 0; x < scaledWidth; ++x) {
-
-	  // x scale Bresenham
-	  xStep = xp;
-	  xt += xq;
-	  if (xt >= scaledWidth) {
-	    xt -= scaledWidth;
-	    ++xStep;
-	  }
-
-	  // rotation
-	  if (rot) {
-	    x2 = (int)y1;
-	    y2 = -x1;
-	  } else {
-	    x2 = x1;
-	    y2 = (int)y1;
-	  }
-
-	  // compute the filtered pixel at (x,y) after the x and y scaling
-	  // operations
-	  m = xStep > 0 ? xStep : 1;
-	  alphaAcc = 0;
-	  p = colorBuf + xSrc * 3;
-	  q = alphaBuf + xSrc;
-	  pixAcc0 = pixAcc1 = pixAcc2 = 0;
-	  for (i = 0; i < n; ++i) {
-	    for (j = 0; j < m; ++j) {
-	      pixAcc0 += *p++;
-	      pixAcc1 += *p++;
-	      pixAcc2 += *p++;
-	      alphaAcc += *q++;
-	    }
-	    p += 3 * (w - m);
-	    q += w - m;
-	  }
-	  pixMul = V1 / (SplashCoord)(n * m);
-	  alphaMul = pixMul * V1D255; 
-	  alpha = (SplashCoord)alphaAcc * alphaMul;
-
-	  if (alpha > 0) {
-	    pix[0] = (int)((SplashCoord)pixAcc0 * pixMul);
-	    pix[1] = (int)((SplashCoord)pixAcc1 * pixMul);
-	    pix[2] = (int)((SplashCoord)pixAcc2 * pixMul);
-
-	    // set pixel
-	    pipe.shape = alpha;
-	    if (vectorAntialias && clipRes != splashClipAllInside) {
-	      drawAAPixel(&pipe, tx + x2, ty + y2);
-	    } else if (hwdepth <= 2) {
-	      drawPixelD(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	    } else {
-	      drawPixel(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	    }
-	  }
-
-	  // x scale Bresenham
-	  xSrc += xStep;
-
-	  // x shear
-	  x1 += xSign;
-
-	  // y shear
-	  y1 += yShear1;
-	}
-	break;
-
-      case splashModeXBGR8:
-	for (x = 0; x < scaledWidth; ++x) {
-	  // x scale Bresenham
-	  xStep = xp;
-	  xt += xq;
-	  if (xt >= scaledWidth) {
-	    xt -= scaledWidth;
-	    ++xStep;
-	  }
-
-	  // rotation
-	  if (rot) {
-	    x2 = (int)y1;
-	    y2 = -x1;
-	  } else {
-	    x2 = x1;
-	    y2 = (int)y1;
-	  }
-
-	  // compute the filtered pixel at (x,y) after the x and y scaling
-	  // operations
-	  m = xStep > 0 ? xStep : 1;
-	  alphaAcc = 0;
-	  p = colorBuf + xSrc * 4;
-	  q = alphaBuf + xSrc;
-	  pixAcc0 = pixAcc1 = pixAcc2 = 0;
-	  for (i = 0; i < n; ++i) {
-	    for (j = 0; j < m; ++j) {
-	      pixAcc0 += *p++;
-	      pixAcc1 += *p++;
-	      pixAcc2 += *p++;
-	      *p++;
-	      alphaAcc += *q++;
-	    }
-	    p += 4 * (w - m);
-	    q += w - m;
-	  }
-	  pixMul = V1 / (SplashCoord)(n * m);
-	  alphaMul = pixMul * V1D255;
-	  alpha = (SplashCoord)alphaAcc * alphaMul;
-
-	  if (alpha > 0) {
-	    pix[0] = (int)((SplashCoord)pixAcc0 * pixMul);
-	    pix[1] = (int)((SplashCoord)pixAcc1 * pixMul);
-	    pix[2] = (int)((SplashCoord)pixAcc2 * pixMul);
-	    pix[3] = 255;
-
-	    // set pixel
-	    pipe.shape = alpha;
-	    if (vectorAntialias && clipRes != splashClipAllInside) {
-	      drawAAPixel(&pipe, tx + x2, ty + y2);
-	    } else if (hwdepth <= 2) {
-	      drawPixelD(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	    } else {
-	      drawPixel(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	    }
-	  }
-
-	  // x scale Bresenham
-	  xSrc += xStep;
-
-	  // x shear
-	  x1 += xSign;
-
-	  // y shear
-	  y1 += yShear1;
-	}
-	break;
-
-
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	for (x = 0; x < scaledWidth; ++x) {
-
-	  // x scale Bresenham
-	  xStep = xp;
-	  xt += xq;
-	  if (xt >= scaledWidth) {
-	    xt -= scaledWidth;
-	    ++xStep;
-	  }
-
-	  // rotation
-	  if (rot) {
-	    x2 = (int)y1;
-	    y2 = -x1;
-	  } else {
-	    x2 = x1;
-	    y2 = (int)y1;
-	  }
+      lineOk = gFalse;
+    }
+    lastYStep = yStep;
 
-	  // compute the filtered pixel at (x,y) after the x and y scaling
-	  // operations
-	  m = xStep > 0 ? xStep : 1;
-	  alphaAcc = 0;
-	  p = colorBuf + xSrc * 4;
-	  q = alphaBuf + xSrc;
-	  pixAcc0 = pixAcc1 = pixAcc2 = pixAcc3 = 0;
-	  for (i = 0; i < n; ++i) {
-	    for (j = 0; j < m; ++j) {
-	      pixAcc0 += *p++;
-	      pixAcc1 += *p++;
-	      pixAcc2 += *p++;
-	      pixAcc3 += *p++;
-	      alphaAcc += *q++;
-	    }
-	    p += 4 * (w - m);
-	    q += w - m;
-	  }
-	  pixMul = V1 / (SplashCoord)(n * m);
-	  alphaMul = pixMul * V1D255;
-	  alpha = (SplashCoord)alphaAcc * alphaMul;
-
-	  if (alpha > 0) {
-	    pix[0] = (int)((SplashCoord)pixAcc0 * pixMul);
-	    pix[1] = (int)((SplashCoord)pixAcc1 * pixMul);
-	    pix[2] = (int)((SplashCoord)pixAcc2 * pixMul);
-	    pix[3] = (int)((SplashCoord)pixAcc3 * pixMul);
-
-	    // set pixel
-	    pipe.shape = alpha;
-	    if (vectorAntialias && clipRes != splashClipAllInside) {
-	      drawAAPixel(&pipe, tx + x2, ty + y2);
-	    } else if (hwdepth <= 2) {
-	      drawPixelD(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	    } else {
-	      drawPixel(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	    }
-	  }
+    // loop-invariant constants
+    k1 = splashRound(xShear * ySign * y);
 
-	  // x scale Bresenham
-	  xSrc += xStep;
+    // clipping test
+    if (clipRes != splashClipAllInside &&
+	!rot &&
+	(int)(yShear * k1) ==
+	  (int)(yShear * (xSign * (scaledWidth - 1) + k1))) {
+      if (xSign > 0) {
+	spanXMin = tx + k1;
+	spanXMax = spanXMin + (scaledWidth - 1);
+      } else {
+	spanXMax = tx + k1;
+	spanXMin = spanXMax - (scaledWidth - 1);
+      }
+      spanY = ty + ySign * y + (int)(yShear * k1);
+      clipRes2 = state->clip->testSpan(spanXMin, spanXMax, spanY);
+      if (clipRes2 == splashClipAllOutside) {
+	continue;
+      }
+    } else {
+      clipRes2 = clipRes;
+    }
 
-	  // x shear
-	  x1 += xSign;
+    // scale the source row(s) to the output width -- if the image is
+    // being stretched vertically, the previous line is reused
+    if (!lineOk) {
+      scaleImageLine(colorBuf, alphaBuf, w, yStep > 0 ? yStep : 1, nComps,
+		     colorLine, alphaLine, scaledWidth);
+      lineOk = gTrue;
+    }
 
-	  // y shear
-	  y1 += yShear1;
-	}
-	break;
-#endif // SPLASH_CMYK
+    if (spanMode) {
+      if (xSign > 0) {
+	drawImageSpan(&pipe, colorLine, alphaLine, nComps, 1,
+		      tx, tx + (scaledWidth - 1), ty + ySign * y,
+		      clipRes2 == splashClipAllInside, dither);
+      } else {
+	drawImageSpan(&pipe, colorLine + (scaledWidth - 1) * nComps,
+		      alphaLine ? alphaLine + (scaledWidth - 1) : NULL,
+		      nComps, -1, tx - (scaledWidth - 1), tx, ty + ySign * y,
+		      clipRes2 == splashClipAllInside, dither);
       }
+      continue;
     }
 
-  } else {
+    // x shear
+    x1 = k1;
 
-    // init y scale Bresenham
-    yt = 0;
-    lastYStep = 1;
+    // y shear
+    y1 = (SplashCoord)ySign * y + yShear * x1;
+    // this is a kludge: if yShear1 is negative, then (int)y1 would
+    // change immediately after the first pixel, which is not what
+    // we want
+    if (yShear1 < 0) {
+      y1 += 0.999;
+    }
 
-    for (y = 0; y < scaledHeight; ++y) {
+    for (x = 0, p = colorLine; x < scaledWidth; ++x, p += nComps) {
 
-      // y scale Bresenham
-      yStep = yp;
-      yt += yq;
-      if (yt >= scaledHeight) {
-	yt -= scaledHeight;
-	++yStep;
+      // rotation
+      if (rot) {
+	x2 = (int)y1;
+	y2 = -x1;
+      } else {
+	x2 = x1;
+	y2 = (int)y1;
       }
 
-      // read row(s) from image
-      n = (yp > 0) ? yStep : lastYStep;
-      if (n > 0) {
-	p = colorBuf;
-	for (i = 0; i < n; ++i) {
-	  (*src)(srcData, p, NULL);
-	  p += w * nComps;
+      if (!alphaLine || alphaLine[x]) {
+	for (i = 0; i < nComps; ++i) {
+	  pix[i] = p[i];
 	}
-      }
-      lastYStep = yStep;
-
-      // loop-invariant constants
-      k1 = splashRound(xShear * ySign * y);
 
-      // clipping test
-      if (clipRes != splashClipAllInside &&
-	  !rot &&
-	  (int)(yShear * k1) ==
-	    (int)(yShear * (xSign * (scaledWidth - 1) + k1))) {
-	if (xSign > 0) {
-	  spanXMin = tx + k1;
-	  spanXMax = spanXMin + (scaledWidth - 1);
+	// set pixel
+	pipe.shape = alphaLine ? (SplashCoord)alphaLine[x] * V1D255
+	                       : (SplashCoord)1;
+	if (vectorAntialias && clipRes != splashClipAllInside) {
+	  drawAAPixel(&pipe, tx + x2, ty + y2);
+	} else if (dither) {
+	  drawPixelD(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
 	} else {
-	  spanXMax = tx + k1;
-	  spanXMin = spanXMax - (scaledWidth - 1);
-	}
-	spanY = ty + ySign * y + (int)(yShear * k1);
-	clipRes2 = state->clip->testSpan(spanXMin, spanXMax, spanY);
-	if (clipRes2 == splashClipAllOutside) {
-	  continue;
+	  drawPixel(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
 	}
-      } else {
-	clipRes2 = clipRes;
       }
 
-      // init x scale Bresenham
-      xt = 0;
-      xSrc = 0;
-
       // x shear
-      x1 = k1;
+      x1 += xSign;
 
       // y shear
-      y1 = (SplashCoord)ySign * y + yShear * x1;
-      // this is a kludge: if yShear1 is negative, then (int)y1 would
-      // change immediately after the first pixel, which is not what
-      // we want
-      if (yShear1 < 0) {
-	y1 += 0.999;
-      }
-
-      // loop-invariant constants
-      n = yStep > 0 ? yStep : 1;
-
-      switch (srcMode) {
-
-      case splashModeMono1:
-      case splashModeMono4:
-      case splashModeMono8:
-
-	for (x = 0; x < scaledWidth; ++x) {
-
-	  // x scale Bresenham
-	  xStep = xp;
-	  xt += xq;
-	  if (xt >= scaledWidth) {
-	    xt -= scaledWidth;
-	    ++xStep;
-	  }
-
-	  // rotation
-	  if (rot) {
-	    x2 = (int)y1;
-	    y2 = -x1;
-	  } else {
-	    x2 = x1;
-	    y2 = (int)y1;
-	  }
-
-	  // compute the filtered pixel at (x,y) after the x and y scaling
-	  // operations
-	  m = xStep > 0 ? xStep : 1;
-	  p = colorBuf + xSrc;
-	  pixAcc0 = 0;
-	  for (i = 0; i < n; ++i) {
-	    for (j = 0; j < m; ++j) {
-	      pixAcc0 += *p++;
-	    }
-	    p += w - m;
-	  }
-	  pixMul = (SplashCoord)1 / (SplashCoord)(n * m);
-
-	  pix[0] = (int)((SplashCoord)pixAcc0 * pixMul);
-
-	  // set pixel
-	  if (vectorAntialias && clipRes != splashClipAllInside) {
-	    pipe.shape = (SplashCoord)1;
-	    drawAAPixel(&pipe, tx + x2, ty + y2);
-	  } else if (hwdepth <= 2) {
-	      drawPixelD(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	  } else {
-	      drawPixel(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	  }
-
-	  // x scale Bresenham
-	  xSrc += xStep;
-
-	  // x shear
-	  x1 += xSign;
-
-	  // y shear
-	  y1 += yShear1;
-	}
-	break;
-
-      case splashModeRGB8:
-      case splashModeBGR8:
-	for (x = 0; x < scaledWidth; ++x) {
-
-	  // x scale Bresenham
-	  xStep = xp;
-	  xt += xq;
-	  if (xt >= scaledWidth) {
-	    xt -= scaledWidth;
-	    ++xStep;
-	  }
-
-	  // rotation
-	  if (rot) {
-	    x2 = (int)y1;
-	    y2 = -x1;
-	  } else {
-	    x2 = x1;
-	    y2 = (int)y1;
-	  }
-
-	  // compute the filtered pixel at (x,y) after the x and y scaling
-	  // operations
-	  m = xStep > 0 ? xStep : 1;
-	  p = colorBuf + xSrc * 3;
-	  pixAcc0 = pixAcc1 = pixAcc2 = 0;
-	  for (i = 0; i < n; ++i) {
-	    for (j = 0; j < m; ++j) {
-	      pixAcc0 += *p++;
-	      pixAcc1 += *p++;
-	      pixAcc2 += *p++;
-	    }
-	    p += 3 * (w - m);
-	  }
-	  pixMul = (SplashCoord)1 / (SplashCoord)(n * m);
-
-	  pix[0] = (int)((SplashCoord)pixAcc0 * pixMul);
-	  pix[1] = (int)((SplashCoord)pixAcc1 * pixMul);
-	  pix[2] = (int)((SplashCoord)pixAcc2 * pixMul);
-
-	  // set pixel
-	  if (vectorAntialias && clipRes != splashClipAllInside) {
-	    pipe.shape = (SplashCoord)1;
-	    drawAAPixel(&pipe, tx + x2, ty + y2);
-	  } else if (hwdepth <= 2) {
-	      drawPixelD(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	  } else {
-	      drawPixel(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	  }
-
-	  // x scale Bresenham
-	  xSrc += xStep;
-
-	  // x shear
-	  x1 += xSign;
-
-	  // y shear
-	  y1 += yShear1;
-	}
-	break;
-
-      case splashModeXBGR8:
-	for (x = 0; x < scaledWidth; ++x) {
+      y1 += yShear1;
+    }
+  }
 
-	  // x scale Bresenham
-	  xStep = xp;
-	  xt += xq;
-	  if (xt >= scaledWidth) {
-	    xt -= scaledWidth;
-	    ++xStep;
-	  }
+  gfree(colorBuf);
+  gfree(colorLine);
+  gfree(alphaBuf);
+  gfree(alphaLine);
+  return splashOk;
+}
 
-	  // rotation
-	  if (rot) {
-	    x2 = (int)y1;
-	    y2 = -x1;
-	  } else {
-	    x2 = x1;
-	    y2 = (int)y1;
-	  }
+GBool Splash::getImageScaledSize(SplashCoord *mat,
+				 int *scaledWidth, int *scaledHeight) {
+  SplashCoord xScale, yScale;
+  int tx, tx2, ty, ty2;
 
-	  // compute the filtered pixel at (x,y) after the x and y scaling
-	  // operations
-	  m = xStep > 0 ? xStep : 1;
-	  p = colorBuf + xSrc * 4;
-	  pixAcc0 = pixAcc1 = pixAcc2 = 0;
-	  for (i = 0; i < n; ++i) {
-	    for (j = 0; j < m; ++j) {
-	      pixAcc0 += *p++;
-	      pixAcc1 += *p++;
-	      pixAcc2 += *p++;
-	      *p++;
-	    }
-	    p += 4 * (w - m);
-	  }
-	  pixMul = (SplashCoord)1 / (SplashCoord)(n * m);
-
-	  pix[0] = (int)((SplashCoord)pixAcc0 * pixMul);
-	  pix[1] = (int)((SplashCoord)pixAcc1 * pixMul);
-	  pix[2] = (int)((SplashCoord)pixAcc2 * pixMul);
-	  pix[3] = 255;
-
-	  // set pixel
-	  if (vectorAntialias && clipRes != splashClipAllInside) {
-	    pipe.shape = (SplashCoord)1;
-	    drawAAPixel(&pipe, tx + x2, ty + y2);
-	  } else if (hwdepth <= 2) {
-	      drawPixelD(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	  } else {
-	      drawPixel(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	  }
-
-	  // x scale Bresenham
-	  xSrc += xStep;
+  // this matches the computation in drawImage
+  if (splashAbs(mat[0] * mat[3] - mat[1] * mat[2]) < 0.000001) {
+    return gFalse;
+  }
+  if (splashAbs(mat[1]) > splashAbs(mat[0])) {
+    xScale = -mat[1];
+    yScale = mat[2] - (mat[0] * mat[3]) / mat[1];
+  } else {
+    xScale = mat[0];
+    yScale = mat[3] - (mat[1] * mat[2]) / mat[0];
+  }
+  if (xScale >= 0) {
+    tx = splashFloor(mat[4] - 0.01);
+    tx2 = splashFloor(mat[4] + xScale + 0.01);
+  } else {
+    tx = splashFloor(mat[4] + 0.01);
+    tx2 = splashFloor(mat[4] + xScale - 0.01);
+  }
+  *scaledWidth = abs(tx2 - tx) + 1;
+  if (yScale >= 0) {
+    ty = splashFloor(mat[5] - 0.01);
+    ty2 = splashFloor(mat[5] + yScale + 0.01);
+  } else {
+    ty = splashFloor(mat[5] + 0.01);
+    ty2 = splashFloor(mat[5] + yScale - 0.01);
+  }
+  *scaledHeight = abs(ty2 - ty) + 1;
+  return gTrue;
+}
 
-	  // x shear
-	  x1 += xSign;
+void Splash::scaleImage(SplashImageSource src, void *srcData,
+			SplashColorMode srcMode, GBool srcAlpha,
+			int w, int h, int scaledWidth, int scaledHeight,
+			SplashColorPtr colorBuf, Guchar *alphaBuf) {
+  SplashColorPtr lineBuf, p, q;
+  Guchar *lineAlphaBuf, *pa, *qa;
+  int nComps, yp, yq, yt, yStep, lastYStep, y, n, i;
 
-	  // y shear
-	  y1 += yShear1;
-	}
-	break;
+  nComps = splashColorModeNComps[srcMode];
 
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	for (x = 0; x < scaledWidth; ++x) {
-
-	  // x scale Bresenham
-	  xStep = xp;
-	  xt += xq;
-	  if (xt >= scaledWidth) {
-	    xt -= scaledWidth;
-	    ++xStep;
-	  }
+  // compute Bresenham parameters for y scaling
+  yp = h / scaledHeight;
+  yq = h % scaledHeight;
 
-	  // rotation
-	  if (rot) {
-	    x2 = (int)y1;
-	    y2 = -x1;
-	  } else {
-	    x2 = x1;
-	    y2 = (int)y1;
-	  }
+  // allocate pixel buffers
+  lineBuf = (SplashColorPtr)gmalloc((yp + 1) * w * nComps);
+  if (srcAlpha) {
+    lineAlphaBuf = (Guchar *)gmalloc((yp + 1) * w);
+  } else {
+    lineAlphaBuf = NULL;
+  }
 
-	  // compute the filtered pixel at (x,y) after the x and y scaling
-	  // operations
-	  m = xStep > 0 ? xStep : 1;
-	  p = colorBuf + xSrc * 4;
-	  pixAcc0 = pixAcc1 = pixAcc2 = pixAcc3 = 0;
-	  for (i = 0; i < n; ++i) {
-	    for (j = 0; j < m; ++j) {
-	      pixAcc0 += *p++;
-	      pixAcc1 += *p++;
-	      pixAcc2 += *p++;
-	      pixAcc3 += *p++;
-	    }
-	    p += 4 * (w - m);
-	  }
-	  pixMul = (SplashCoord)1 / (SplashCoord)(n * m);
-
-	  pix[0] = (int)((SplashCoord)pixAcc0 * pixMul);
-	  pix[1] = (int)((SplashCoord)pixAcc1 * pixMul);
-	  pix[2] = (int)((SplashCoord)pixAcc2 * pixMul);
-	  pix[3] = (int)((SplashCoord)pixAcc3 * pixMul);
-
-	  // set pixel
-	  if (vectorAntialias && clipRes != splashClipAllInside) {
-	    pipe.shape = (SplashCoord)1;
-	    drawAAPixel(&pipe, tx + x2, ty + y2);
-	  } else if (hwdepth <= 2) {
-	      drawPixelD(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	  } else {
-	      drawPixel(&pipe, tx + x2, ty + y2, clipRes2 == splashClipAllInside);
-	  }
+  // init y scale Bresenham
+  yt = 0;
+  lastYStep = 1;
 
-	  // x scale Bresenham
-	  xSrc += xStep;
+  q = colorBuf;
+  qa = alphaBuf;
+  for (y = 0; y < scaledHeight; ++y) {
 
-	  // x shear
-	  x1 += xSign;
+    // y scale Bresenham
+    yStep = yp;
+    yt += yq;
+    if (yt >= scaledHeight) {
+      yt -= scaledHeight;
+      ++yStep;
+    }
 
-	  // y shear
-	  y1 += yShear1;
+    // read row(s) from image and scale them, or repeat the previous
+    // row if the image is being stretched
+    n = (yp > 0) ? yStep : lastYStep;
+    if (n > 0) {
+      p = lineBuf;
+      pa = lineAlphaBuf;
+      for (i = 0; i < n; ++i) {
+	(*src)(srcData, p, pa);
+	p += w * nComps;
+	if (pa) {
+	  pa += w;
 	}
-	break;
-#endif // SPLASH_CMYK
+      }
+      scaleImageLine(lineBuf, lineAlphaBuf, w, yStep > 0 ? yStep : 1, nComps,
+		     q, qa, scaledWidth);
+    } else {
+      memcpy(q, q - scaledWidth * nComps, scaledWidth * nComps);
+      if (qa) {
+	memcpy(qa, qa - scaledWidth, scaledWidth);
       }
     }
+    lastYStep = yStep;
 
+    q += scaledWidth * nComps;
+    if (qa) {
+      qa += scaledWidth;
+    }
   }
 
-  gfree(colorBuf);
-  gfree(alphaBuf);
-  return splashOk;
+  gfree(lineBuf);
+  gfree(lineAlphaBuf);
 }
 
 SplashError Splash::composite(SplashBitmap *src, int xSrc, int ySrc,
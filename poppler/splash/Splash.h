@@ -38,6 +38,14 @@ typedef GBool (*SplashImageMaskSource)(void *data, SplashColorPtr pixel);
 typedef GBool (*SplashImageSource)(void *data, SplashColorPtr colorLine,
 				   Guchar *alphaLine);
 
+// One character of a glyph run (see Splash::fillChars).
+struct SplashCharPos {
+  SplashCoord x, y;		// position, in user space
+  int c;			// char code
+  int x0, y0;			// device pixel and glyph subpixel offset,
+  int xFrac, yFrac;		//   set by fillChars
+};
+
 //------------------------------------------------------------------------
 
 enum SplashPipeResultColorCtrl {
@@ -141,12 +149,22 @@ public:
   // Fill a path using the current fill pattern.
   SplashError fill(SplashPath *path, GBool eo);
 
+  // Fill a path using <pattern> (typically a shading) instead of the
+  // current fill pattern.  Pixels for which <pattern> returns no
+  // color are left untouched.
+  SplashError shadedFill(SplashPath *path, SplashPattern *pattern);
+
   // Fill a path, XORing with the current fill pattern.
   SplashError xorFill(SplashPath *path, GBool eo);
 
   // Draw a character, using the current fill pattern.
   SplashError fillChar(SplashCoord x, SplashCoord y, int c, SplashFont *font);
 
+  // Draw the <n> characters of a glyph run, all in <font>, using the
+  // current fill pattern.  Characters with no glyph are skipped.  The
+  // device position fields of <chars> are filled in along the way.
+  void fillChars(SplashCharPos *chars, int n, SplashFont *font);
+
   // Draw a glyph, using the current fill pattern.  This function does
   // not free any data, i.e., it ignores glyph->freeData.
   void fillGlyph(SplashCoord x, SplashCoord y,
@@ -188,6 +206,24 @@ public:
 			SplashColorMode srcMode, GBool srcAlpha,
 			int w, int h, SplashCoord *mat);
 
+  // Compute the size, in device pixels, at which drawImage renders an
+  // image with transform <mat>.  Returns false if the matrix is
+  // singular.
+  static GBool getImageScaledSize(SplashCoord *mat,
+				  int *scaledWidth, int *scaledHeight);
+
+  // Read a <w>x<h> image from <src> and scale it to <scaledWidth> x
+  // <scaledHeight> with the same filter drawImage uses, storing the
+  // pixels (in <srcMode>) in <colorBuf> and, if <srcAlpha> is set,
+  // the alpha values in <alphaBuf>.  Drawing the result with
+  // drawImage gives the same output as drawing the original image, as
+  // long as each scaled dimension either matches the device size or
+  // is left at the original size.
+  static void scaleImage(SplashImageSource src, void *srcData,
+			 SplashColorMode srcMode, GBool srcAlpha,
+			 int w, int h, int scaledWidth, int scaledHeight,
+			 SplashColorPtr colorBuf, Guchar *alphaBuf);
+
   // Composite a rectangular region from <src> onto this Splash
   // object.
   SplashError composite(SplashBitmap *src, int xSrc, int ySrc,
@@ -249,6 +285,9 @@ private:
   void drawAAPixel(SplashPipe *pipe, int x, int y);
   void drawSpan(SplashPipe *pipe, int x0, int x1, int y, GBool noClip);
   void drawAALine(SplashPipe *pipe, int x0, int x1, int y);
+  void drawImageSpan(SplashPipe *pipe, SplashColorPtr colorLine,
+		     Guchar *alphaLine, int nComps, int xDir,
+		     int x0, int x1, int y, GBool noClip, GBool dither);
   void transform(SplashCoord *matrix, SplashCoord xi, SplashCoord yi,
 		 SplashCoord *xo, SplashCoord *yo);
   void updateModX(int x);
@@ -266,7 +305,8 @@ private:
   SplashPath *makeDashedPath(SplashPath *xPath);
   SplashError fillWithPattern(SplashPath *path, GBool eo,
 			      SplashPattern *pattern, SplashCoord alpha);
-  void fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noclip);
+  void fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noclip,
+		  SplashColorPtr solidColor = NULL, SplashPipe *runPipe = NULL);
   void dumpPath(SplashPath *path);
   void dumpXPath(SplashXPath *path);
 
@@ -279,6 +319,8 @@ private:
   SplashState *state;
   SplashBitmap *aaBuf;
   int aaBufY;
+  Guchar *patternBuf;		// one row of dynamic pattern colors and
+				//   paint flags - used by drawSpan
   SplashBitmap *alpha0Bitmap;	// for non-isolated groups, this is the
 				//   bitmap containing the alpha0 values
   int alpha0X, alpha0Y;		// offset within alpha0Bitmap
@@ -47,10 +47,16 @@ SplashFTFont::SplashFTFont(SplashFTFontFile *fontFileA, SplashCoord *matA,
 {
   FT_Face face;
   double div;
+  SplashCoord bxMin, byMin, bxMax, byMax;
+  long memUsed0;
   int x, y;
 
   face = fontFileA->face;
+  memUsed0 = fontFileA->engine->getMemUsed();
+  ftMemSize = 0;
+  glyphLoaded = gFalse;
   if (FT_New_Size(face, &sizeObj)) {
+    sizeObj = NULL;
     return;
   }
   face->size = sizeObj;
@@ -58,57 +64,57 @@ SplashFTFont::SplashFTFont(SplashFTFontFile *fontFileA, SplashCoord *matA,
   if (FT_Set_Pixel_Sizes(face, 0, (int)size)) {
     return;
   }
+  ftMemSize = (int)(fontFileA->engine->getMemUsed() - memUsed0);
   // if the textMat values are too small, FreeType's fixed point
   // arithmetic doesn't work so well
   textScale = splashSqrt(textMat[2]*textMat[2] + textMat[3]*textMat[3]) / size;
 
   div = face->bbox.xMax > 20000 ? 65536 : 1;
 
+  // scale the font bounding box to text space first -- in font units,
+  // the products with the matrix overflow fixed point coordinates
+  bxMin = (SplashCoord)(face->bbox.xMin / (div * face->units_per_EM));
+  byMin = (SplashCoord)(face->bbox.yMin / (div * face->units_per_EM));
+  bxMax = (SplashCoord)(face->bbox.xMax / (div * face->units_per_EM));
+  byMax = (SplashCoord)(face->bbox.yMax / (div * face->units_per_EM));
+
   // transform the four corners of the font bounding box -- the min
   // and max values form the bounding box of the transformed font
-  x = (int)((mat[0] * face->bbox.xMin + mat[2] * face->bbox.yMin) /
-	    (div * face->units_per_EM));
+  x = (int)(mat[0] * bxMin + mat[2] * byMin);
   xMin = xMax = x;
-  y = (int)((mat[1] * face->bbox.xMin + mat[3] * face->bbox.yMin) /
-	    (div * face->units_per_EM));
+  y = (int)(mat[1] * bxMin + mat[3] * byMin);
   yMin = yMax = y;
-  x = (int)((mat[0] * face->bbox.xMin + mat[2] * face->bbox.yMax) /
-	    (div * face->units_per_EM));
+  x = (int)(mat[0] * bxMin + mat[2] * byMax);
   if (x < xMin) {
     xMin = x;
   } else if (x > xMax) {
     xMax = x;
   }
-  y = (int)((mat[1] * face->bbox.xMin + mat[3] * face->bbox.yMax) /
-	    (div * face->units_per_EM));
+  y = (int)(mat[1] * bxMin + mat[3] * byMax);
   if (y < yMin) {
     yMin = y;
   } else if (y > yMax) {
     yMax = y;
   }
-  x = (int)((mat[0] * face->bbox.xMax + mat[2] * face->bbox.yMin) /
-	    (div * face->units_per_EM));
+  x = (int)(mat[0] * bxMax + mat[2] * byMin);
   if (x < xMin) {
     xMin = x;
   } else if (x > xMax) {
     xMax = x;
   }
-  y = (int)((mat[1] * face->bbox.xMax + mat[3] * face->bbox.yMin) /
-	    (div * face->units_per_EM));
+  y = (int)(mat[1] * bxMax + mat[3] * byMin);
   if (y < yMin) {
     yMin = y;
   } else if (y > yMax) {
     yMax = y;
   }
-  x = (int)((mat[0] * face->bbox.xMax + mat[2] * face->bbox.yMax) /
-	    (div * face->units_per_EM));
+  x = (int)(mat[0] * bxMax + mat[2] * byMax);
   if (x < xMin) {
     xMin = x;
   } else if (x > xMax) {
     xMax = x;
   }
-  y = (int)((mat[1] * face->bbox.xMax + mat[3] * face->bbox.yMax) /
-	    (div * face->units_per_EM));
+  y = (int)(mat[1] * bxMax + mat[3] * byMax);
   if (y < yMin) {
     yMin = y;
   } else if (y > yMax) {
@@ -148,6 +154,38 @@ SplashFTFont::SplashFTFont(SplashFTFontFile *fontFileA, SplashCoord *matA,
 }
 
 SplashFTFont::~SplashFTFont() {
+  if (sizeObj) {
+    FT_Done_Size(sizeObj);
+  }
+}
+
+int SplashFTFont::getMemSize() {
+  return (int)sizeof(SplashFTFont) + ftMemSize;
+}
+
+// FreeType allocates the per-size hinting state (e.g., the TrueType
+// CVT, storage area and twilight zone) on the first glyph load, not
+// in FT_Set_Pixel_Sizes, so that load is added to ftMemSize; the font
+// engine picks up the new size (see SplashFontEngine::getFont).
+FT_Error SplashFTFont::loadGlyph(FT_Face face, FT_UInt gid, FT_Int32 flags) {
+  SplashFTFontEngine *engine;
+  FT_Error err;
+  long memUsed0, memUsed1;
+
+  if (glyphLoaded) {
+    return FT_Load_Glyph(face, gid, flags);
+  }
+  engine = ((SplashFTFontFile *)fontFile)->engine;
+  memUsed0 = engine->getMemUsed();
+  err = FT_Load_Glyph(face, gid, flags);
+  memUsed1 = engine->getMemUsed();
+  // the load also frees the previous glyph's bitmap, so the difference
+  // can be negative
+  if (memUsed1 > memUsed0) {
+    ftMemSize += (int)(memUsed1 - memUsed0);
+  }
+  glyphLoaded = gTrue;
+  return err;
 }
 
 GBool SplashFTFont::getGlyph(int c, int xFrac, int yFrac,
@@ -185,7 +223,7 @@ GBool SplashFTFont::makeGlyph(int c, int xFrac, int yFrac,
 
   // if we have the FT2 bytecode interpreter, autohinting won't be used
 #ifdef TT_CONFIG_OPTION_BYTECODE_INTERPRETER
-  if (FT_Load_Glyph(ff->face, gid,
+  if (loadGlyph(ff->face, gid,
 		    aa ? FT_LOAD_NO_BITMAP : FT_LOAD_DEFAULT)) {
     return gFalse;
   }
@@ -194,7 +232,7 @@ GBool SplashFTFont::makeGlyph(int c, int xFrac, int yFrac,
   // font subsets), so turn it off if anti-aliasing is enabled; if
   // anti-aliasing is disabled, this seems to be a tossup - some fonts
   // look better with hinting, some without, so leave hinting on
-  if (FT_Load_Glyph(ff->face, gid,
+  if (loadGlyph(ff->face, gid,
 		    aa ? FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP
                        : FT_LOAD_DEFAULT)) {
     return gFalse;
@@ -208,13 +246,17 @@ GBool SplashFTFont::makeGlyph(int c, int xFrac, int yFrac,
   bitmap->w = splashRound(glyphMetrics->width / 64.0);
   bitmap->h = splashRound(glyphMetrics->height / 64.0);
 
-  *clipRes = clip->testRect(x0 - bitmap->x,
-                            y0 - bitmap->y,
-                            x0 - bitmap->x + bitmap->w - 1,
-                            y0 - bitmap->y + bitmap->h - 1);
-  if (*clipRes == splashClipAllOutside) {
-    bitmap->freeData = gFalse;
-    return gTrue;
+  if (clip) {
+    *clipRes = clip->testRect(x0 - bitmap->x,
+			      y0 - bitmap->y,
+			      x0 - bitmap->x + bitmap->w - 1,
+			      y0 - bitmap->y + bitmap->h - 1);
+    if (*clipRes == splashClipAllOutside) {
+      bitmap->freeData = gFalse;
+      return gTrue;
+    }
+  } else {
+    *clipRes = splashClipAllInside;
   }
 
   if (FT_Render_Glyph(slot, aa ? ft_render_mode_normal
@@ -262,6 +304,7 @@ double SplashFTFont::getGlyphAdvance(int c)
   offset.x = 0;
   offset.y = 0;
 
+  ff->face->size = sizeObj;
   FT_Set_Transform(ff->face, &identityMatrix, &offset);
 
   if (ff->codeToGID && c < ff->codeToGIDLen) {
@@ -276,7 +319,7 @@ double SplashFTFont::getGlyphAdvance(int c)
 
   // if we have the FT2 bytecode interpreter, autohinting won't be used
 #ifdef TT_CONFIG_OPTION_BYTECODE_INTERPRETER
-  if (FT_Load_Glyph(ff->face, gid,
+  if (loadGlyph(ff->face, gid,
 		    aa ? FT_LOAD_NO_BITMAP : FT_LOAD_DEFAULT)) {
     return -1;
   }
@@ -285,7 +328,7 @@ double SplashFTFont::getGlyphAdvance(int c)
   // font subsets), so turn it off if anti-aliasing is enabled; if
   // anti-aliasing is disabled, this seems to be a tossup - some fonts
   // look better with hinting, some without, so leave hinting on
-  if (FT_Load_Glyph(ff->face, gid,
+  if (loadGlyph(ff->face, gid,
 		    aa ? FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP
                        : FT_LOAD_DEFAULT)) {
     return -1;
@@ -336,7 +379,7 @@ SplashPath *SplashFTFont::getGlyphPath(int c) {
     // skip the TrueType notdef glyph
     return NULL;
   }
-  if (FT_Load_Glyph(ff->face, gid, FT_LOAD_NO_BITMAP)) {
+  if (loadGlyph(ff->face, gid, FT_LOAD_NO_BITMAP)) {
     return NULL;
   }
   if (FT_Get_Glyph(slot, &glyph)) {
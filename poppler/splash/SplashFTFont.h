@@ -46,9 +46,17 @@ public:
   // Return the advance of a glyph. (in 0..1 range)
   virtual double getGlyphAdvance(int c);
 
+  // Return the approximate memory used by this font instance.
+  virtual int getMemSize();
+
 private:
 
+  FT_Error loadGlyph(FT_Face face, FT_UInt gid, FT_Int32 flags);
+
   FT_Size sizeObj;
+  int ftMemSize;		// bytes allocated by FreeType for sizeObj
+  GBool glyphLoaded;		// set once the first glyph load has been
+				//   added to ftMemSize
   FT_Matrix matrix;
   FT_Matrix textMatrix;
   SplashCoord textScale;
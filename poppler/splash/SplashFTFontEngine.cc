@@ -13,59 +13,100 @@
 #endif
 
 #include <stdio.h>
-#ifdef HAVE_UNISTD_H
-#include <unistd.h>
-#endif
+#include <stdlib.h>
 #include "goo/gmem.h"
 #include "goo/GooString.h"
-#include "goo/gfile.h"
 #include "fofi/FoFiTrueType.h"
 #include "fofi/FoFiType1C.h"
 #include "SplashFTFontFile.h"
 #include "SplashFTFontEngine.h"
+#include FT_MODULE_H
 #include <inkview.h>
 
-#ifdef VMS
-#if (__VMS_VER < 70000000)
-extern "C" int unlink(char *filename);
-#endif
-#endif
-
-//------------------------------------------------------------------------
-
-#if 0
-static void fileWrite(void *stream, char *data, int len) {
-  iv_fwrite(data, 1, len, (FILE *)stream);
-}
-#endif
-
 //------------------------------------------------------------------------
 // SplashFTFontEngine
 //------------------------------------------------------------------------
 
-SplashFTFontEngine::SplashFTFontEngine(GBool aaA, FT_Library libA) {
-  FT_Int major, minor, patch;
+// FreeType allocations are prefixed with their size, so that ftFree
+// can update memUsed.
+union SplashFTMemHeader {
+  long size;
+  double align;
+};
 
+SplashFTFontEngine::SplashFTFontEngine(GBool aaA) {
   aa = aaA;
-  lib = libA;
-
-  // as of FT 2.1.8, CID fonts are indexed by CID instead of GID
-  FT_Library_Version(lib, &major, &minor, &patch);
-  useCIDs = major > 2 ||
-            (major == 2 && (minor > 1 || (minor == 1 && patch > 7)));
+  lib = NULL;
+  useCIDs = gFalse;
+  memory.user = this;
+  memory.alloc = &ftAlloc;
+  memory.free = &ftFree;
+  memory.realloc = &ftRealloc;
+  memUsed = 0;
 }
 
 SplashFTFontEngine *SplashFTFontEngine::init(GBool aaA) {
-  FT_Library libA;
+  SplashFTFontEngine *engine;
+  FT_Int major, minor, patch;
 
-  if (FT_Init_FreeType(&libA)) {
+  engine = new SplashFTFontEngine(aaA);
+  if (FT_New_Library(&engine->memory, &engine->lib)) {
+    delete engine;
     return NULL;
   }
-  return new SplashFTFontEngine(aaA, libA);
+  FT_Add_Default_Modules(engine->lib);
+
+  // as of FT 2.1.8, CID fonts are indexed by CID instead of GID
+  FT_Library_Version(engine->lib, &major, &minor, &patch);
+  engine->useCIDs = major > 2 ||
+                    (major == 2 && (minor > 1 ||
+				    (minor == 1 && patch > 7)));
+  return engine;
 }
 
 SplashFTFontEngine::~SplashFTFontEngine() {
-  FT_Done_FreeType(lib);
+  if (lib) {
+    FT_Done_Library(lib);
+  }
+}
+
+void *SplashFTFontEngine::ftAlloc(FT_Memory memory, long size) {
+  SplashFTMemHeader *p;
+
+  if (!(p = (SplashFTMemHeader *)malloc(sizeof(SplashFTMemHeader) + size))) {
+    return NULL;
+  }
+  p->size = size;
+  ((SplashFTFontEngine *)memory->user)->memUsed += size;
+  return p + 1;
+}
+
+void SplashFTFontEngine::ftFree(FT_Memory memory, void *block) {
+  SplashFTMemHeader *p;
+
+  if (block) {
+    p = (SplashFTMemHeader *)block - 1;
+    ((SplashFTFontEngine *)memory->user)->memUsed -= p->size;
+    free(p);
+  }
+}
+
+void *SplashFTFontEngine::ftRealloc(FT_Memory memory, long curSize,
+				    long newSize, void *block) {
+  SplashFTMemHeader *p;
+
+  if (!block) {
+    return ftAlloc(memory, newSize);
+  }
+  p = (SplashFTMemHeader *)block - 1;
+  curSize = p->size;
+  if (!(p = (SplashFTMemHeader *)realloc(p, sizeof(SplashFTMemHeader) +
+					  newSize))) {
+    return NULL;
+  }
+  p->size = newSize;
+  ((SplashFTFontEngine *)memory->user)->memUsed += newSize - curSize;
+  return p + 1;
 }
 
 SplashFontFile *SplashFTFontEngine::loadType1Font(SplashFontFileID *idA,
@@ -155,43 +196,11 @@ SplashFontFile *SplashFTFontEngine::loadTrueTypeFont(SplashFontFileID *idA,
 						     Gushort *codeToGID,
 						     int codeToGIDLen,
 						     int faceIndex) {
-#if 0
-  FoFiTrueType *ff;
-  GooString *tmpFileName;
-  FILE *tmpFile;
-  SplashFontFile *ret;
-
-  if (!(ff = FoFiTrueType::load(fileName))) {
-    return NULL;
-  }
-  tmpFileName = NULL;
-  if (!openTempFile(&tmpFileName, &tmpFile, "wb", NULL)) {
-    delete ff;
-    return NULL;
-  }
-  ff->writeTTF(&fileWrite, tmpFile);
-  delete ff;
-  fclose(tmpFile);
-  ret = SplashFTFontFile::loadTrueTypeFont(this, idA,
-					   tmpFileName->getCString(),
-					   gTrue, codeToGID, codeToGIDLen,
-					   faceIndex);
-  if (ret) {
-    if (deleteFile) {
-      unlink(fileName);
-    }
-  } else {
-    unlink(tmpFileName->getCString());
-  }
-  delete tmpFileName;
-  return ret;
-#else
   SplashFontFile *ret;
   ret = SplashFTFontFile::loadTrueTypeFont(this, idA, src,
 					   codeToGID, codeToGIDLen,
 					   faceIndex);
   return ret;
-#endif
 }
 
 #endif // HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
@@ -15,6 +15,7 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_SYSTEM_H
 #include "goo/gtypes.h"
 
 class SplashFontFile;
@@ -41,13 +42,23 @@ public:
   SplashFontFile *loadTrueTypeFont(SplashFontFileID *idA, SplashFontSrc *src,
 				   Gushort *codeToGID, int codeToGIDLen, int faceIndex = 0);
 
+  // Return the number of bytes currently allocated by FreeType.
+  long getMemUsed() { return memUsed; }
+
 private:
 
-  SplashFTFontEngine(GBool aaA, FT_Library libA);
+  SplashFTFontEngine(GBool aaA);
+
+  static void *ftAlloc(FT_Memory memory, long size);
+  static void ftFree(FT_Memory memory, void *block);
+  static void *ftRealloc(FT_Memory memory, long curSize, long newSize,
+			 void *block);
 
   GBool aa;
   FT_Library lib;
   GBool useCIDs;
+  struct FT_MemoryRec_ memory;	// FreeType allocator, which keeps
+  long memUsed;			//   track of memUsed
 
   friend class SplashFTFontFile;
   friend class SplashFTFont;
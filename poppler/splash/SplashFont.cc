@@ -19,19 +19,228 @@
 
 //------------------------------------------------------------------------
 
-struct SplashFontCacheTag {
+struct SplashGlyphCacheEntry {
+  Guint fontID;			// font file's glyph cache ID
+  SplashCoord mat[4];		// font transform matrix
+  GBool aa;			// anti-aliased
   int c;
   short xFrac, yFrac;		// x and y fractions
-  int mru;			// valid bit (0x80000000) and MRU index
   int x, y, w, h;		// offset and size of glyph
+  Guchar *data;			// bitmap data
+  int bytes;			// total memory used by this entry
+  Guint hash;
+  SplashGlyphCacheEntry *next;	// next entry in the hash bucket
+  SplashGlyphCacheEntry *prev;	// next more recently used entry
+  SplashGlyphCacheEntry *older;	// next less recently used entry
 };
 
+//------------------------------------------------------------------------
+// SplashGlyphCache
+//------------------------------------------------------------------------
+
+#define splashGlyphCacheInitSize 256
+
+SplashGlyphCache::SplashGlyphCache(int maxBytesA) {
+  int i;
+
+  size = splashGlyphCacheInitSize;
+  tab = (SplashGlyphCacheEntry **)gmallocn(size,
+					   sizeof(SplashGlyphCacheEntry *));
+  for (i = 0; i < size; ++i) {
+    tab[i] = NULL;
+  }
+  len = 0;
+  head = tail = NULL;
+  maxBytes = maxBytesA;
+  bytes = 0;
+  hits = misses = evictions = 0;
+}
+
+SplashGlyphCache::~SplashGlyphCache() {
+  clear();
+  gfree(tab);
+}
+
+Guint SplashGlyphCache::hash(SplashFont *font, int c, int xFrac, int yFrac) {
+  Guint h;
+
+  h = font->glyphCacheHash ^ ((Guint)c * 0x9e3779b1);
+  h ^= (Guint)((xFrac << splashFontFractionBits) | yFrac) << 24;
+  return h ^ (h >> 15);
+}
+
+GBool SplashGlyphCache::lookup(SplashFont *font, int c, int xFrac, int yFrac,
+			       SplashGlyphBitmap *bitmap) {
+  SplashGlyphCacheEntry *entry;
+  Guint h, fontID;
+
+  h = hash(font, c, xFrac, yFrac);
+  fontID = font->fontFile->getGlyphCacheID();
+  for (entry = tab[h & (size - 1)]; entry; entry = entry->next) {
+    if (entry->hash == h &&
+	entry->c == c &&
+	(int)entry->xFrac == xFrac &&
+	(int)entry->yFrac == yFrac &&
+	entry->fontID == fontID &&
+	entry->aa == font->aa &&
+	entry->mat[0] == font->mat[0] && entry->mat[1] == font->mat[1] &&
+	entry->mat[2] == font->mat[2] && entry->mat[3] == font->mat[3]) {
+      break;
+    }
+  }
+  if (!entry) {
+    ++misses;
+    return gFalse;
+  }
+  ++hits;
+
+  // move the entry to the front of the LRU list
+  if (entry != head) {
+    entry->prev->older = entry->older;
+    if (entry->older) {
+      entry->older->prev = entry->prev;
+    } else {
+      tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->older = head;
+    head->prev = entry;
+    head = entry;
+  }
+
+  bitmap->x = entry->x;
+  bitmap->y = entry->y;
+  bitmap->w = entry->w;
+  bitmap->h = entry->h;
+  bitmap->aa = entry->aa;
+  bitmap->data = entry->data;
+  bitmap->freeData = gFalse;
+  return gTrue;
+}
+
+Guchar *SplashGlyphCache::add(SplashFont *font, int c, int xFrac, int yFrac,
+			      SplashGlyphBitmap *bitmap) {
+  SplashGlyphCacheEntry *entry;
+  int dataSize, entryBytes, i;
+
+  if (bitmap->aa) {
+    dataSize = bitmap->w * bitmap->h;
+  } else {
+    dataSize = ((bitmap->w + 7) >> 3) * bitmap->h;
+  }
+  entryBytes = (int)sizeof(SplashGlyphCacheEntry) + dataSize;
+  if (entryBytes > maxBytes) {
+    return NULL;
+  }
+  shrink(maxBytes - entryBytes);
+
+  entry = (SplashGlyphCacheEntry *)gmalloc(entryBytes);
+  entry->fontID = font->fontFile->getGlyphCacheID();
+  for (i = 0; i < 4; ++i) {
+    entry->mat[i] = font->mat[i];
+  }
+  entry->aa = font->aa;
+  entry->c = c;
+  entry->xFrac = (short)xFrac;
+  entry->yFrac = (short)yFrac;
+  entry->x = bitmap->x;
+  entry->y = bitmap->y;
+  entry->w = bitmap->w;
+  entry->h = bitmap->h;
+  entry->data = (Guchar *)(entry + 1);
+  memcpy(entry->data, bitmap->data, dataSize);
+  entry->bytes = entryBytes;
+  entry->hash = hash(font, c, xFrac, yFrac);
+
+  if (len >= size) {
+    expand();
+  }
+  entry->next = tab[entry->hash & (size - 1)];
+  tab[entry->hash & (size - 1)] = entry;
+  entry->prev = NULL;
+  entry->older = head;
+  if (head) {
+    head->prev = entry;
+  } else {
+    tail = entry;
+  }
+  head = entry;
+  ++len;
+  bytes += entryBytes;
+  return entry->data;
+}
+
+void SplashGlyphCache::setMaxBytes(int maxBytesA) {
+  maxBytes = maxBytesA;
+  shrink(maxBytes);
+}
+
+void SplashGlyphCache::clear() {
+  shrink(0);
+}
+
+// Remove an entry from its hash bucket and the LRU list, and free it.
+void SplashGlyphCache::unlink(SplashGlyphCacheEntry *entry) {
+  SplashGlyphCacheEntry **p;
+
+  for (p = &tab[entry->hash & (size - 1)]; *p != entry; p = &(*p)->next) ;
+  *p = entry->next;
+  if (entry->prev) {
+    entry->prev->older = entry->older;
+  } else {
+    head = entry->older;
+  }
+  if (entry->older) {
+    entry->older->prev = entry->prev;
+  } else {
+    tail = entry->prev;
+  }
+  --len;
+  bytes -= entry->bytes;
+  gfree(entry);
+}
+
+// Discard least recently used entries until the cache uses no more
+// than <maxBytesA> bytes.
+void SplashGlyphCache::shrink(int maxBytesA) {
+  while (tail && bytes > maxBytesA) {
+    unlink(tail);
+    ++evictions;
+  }
+}
+
+// Double the number of hash buckets.
+void SplashGlyphCache::expand() {
+  SplashGlyphCacheEntry **oldTab;
+  SplashGlyphCacheEntry *entry;
+  int oldSize, i;
+
+  oldSize = size;
+  oldTab = tab;
+  size *= 2;
+  tab = (SplashGlyphCacheEntry **)gmallocn(size,
+					   sizeof(SplashGlyphCacheEntry *));
+  for (i = 0; i < size; ++i) {
+    tab[i] = NULL;
+  }
+  for (i = 0; i < oldSize; ++i) {
+    while ((entry = oldTab[i])) {
+      oldTab[i] = entry->next;
+      entry->next = tab[entry->hash & (size - 1)];
+      tab[entry->hash & (size - 1)] = entry;
+    }
+  }
+  gfree(oldTab);
+}
+
 //------------------------------------------------------------------------
 // SplashFont
 //------------------------------------------------------------------------
 
 SplashFont::SplashFont(SplashFontFile *fontFileA, SplashCoord *matA,
 		       SplashCoord *textMatA, GBool aaA) {
+  int i;
+
   fontFile = fontFileA;
   fontFile->incRefCnt();
   mat[0] = matA[0];
@@ -44,64 +253,30 @@ SplashFont::SplashFont(SplashFontFile *fontFileA, SplashCoord *matA,
   textMat[3] = textMatA[3];
   aa = aaA;
 
-  cache = NULL;
-  cacheTags = NULL;
+  glyphCache = NULL;
+  glyphCacheHash = fontFile->getGlyphCacheID() * 0x01000193;
+  for (i = 0; i < 4; ++i) {
+    glyphCacheHash = glyphCacheHash * 31 + splashHashCoord(mat[i]);
+  }
 
   xMin = yMin = xMax = yMax = 0;
 }
 
 void SplashFont::initCache() {
-  int i;
-
   // this should be (max - min + 1), but we add some padding to
   // deal with rounding errors
   glyphW = xMax - xMin + 3;
   glyphH = yMax - yMin + 3;
-  if (aa) {
-    glyphSize = glyphW * glyphH;
-  } else {
-    glyphSize = ((glyphW + 7) >> 3) * glyphH;
-  }
-
-  // set up the glyph pixmap cache
-  cacheAssoc = 16;
-  if (glyphSize <= 256) {
-    cacheSets = 8;
-  } else if (glyphSize <= 512) {
-    cacheSets = 8;
-  } else if (glyphSize <= 1024) {
-    cacheSets = 4;
-  } else {
-    cacheSets = 2;
-  }
-  cache = (Guchar *)gmallocn_checkoverflow(cacheSets* cacheAssoc, glyphSize);
-  if (cache != NULL) {
-    cacheTags = (SplashFontCacheTag *)gmallocn(cacheSets * cacheAssoc,
-					     sizeof(SplashFontCacheTag));
-    for (i = 0; i < cacheSets * cacheAssoc; ++i) {
-      cacheTags[i].mru = i & (cacheAssoc - 1);
-    }
-  } else {
-    cacheAssoc = 0;
-  }
 }
 
 SplashFont::~SplashFont() {
   fontFile->decRefCnt();
-  if (cache) {
-    gfree(cache);
-  }
-  if (cacheTags) {
-    gfree(cacheTags);
-  }
 }
 
 GBool SplashFont::getGlyph(int c, int xFrac, int yFrac,
 			   SplashGlyphBitmap *bitmap, int x0, int y0, SplashClip *clip, SplashClipResult *clipRes) {
   SplashGlyphBitmap bitmap2;
-  int size;
   Guchar *p;
-  int i, j, k;
 
   // no fractional coordinates for large glyphs or non-anti-aliased
   // glyphs
@@ -110,35 +285,16 @@ GBool SplashFont::getGlyph(int c, int xFrac, int yFrac,
   }
 
   // check the cache
-  i = (c & (cacheSets - 1)) * cacheAssoc;
-  for (j = 0; j < cacheAssoc; ++j) {
-    if ((cacheTags[i+j].mru & 0x80000000) &&
-	cacheTags[i+j].c == c &&
-	(int)cacheTags[i+j].xFrac == xFrac &&
-	(int)cacheTags[i+j].yFrac == yFrac) {
-      bitmap->x = cacheTags[i+j].x;
-      bitmap->y = cacheTags[i+j].y;
-      bitmap->w = cacheTags[i+j].w;
-      bitmap->h = cacheTags[i+j].h;
-      for (k = 0; k < cacheAssoc; ++k) {
-	if (k != j &&
-	    (cacheTags[i+k].mru & 0x7fffffff) <
-	      (cacheTags[i+j].mru & 0x7fffffff)) {
-	  ++cacheTags[i+k].mru;
-	}
-      }
-      cacheTags[i+j].mru = 0x80000000;
-      bitmap->aa = aa;
-      bitmap->data = cache + (i+j) * glyphSize;
-      bitmap->freeData = gFalse;
-
+  if (glyphCache && glyphCache->lookup(this, c, xFrac, yFrac, bitmap)) {
+    if (clip) {
       *clipRes = clip->testRect(x0 - bitmap->x,
-                                y0 - bitmap->y,
-                                x0 - bitmap->x + bitmap->w - 1,
-                                y0 - bitmap->y + bitmap->h - 1);
-
-      return gTrue;
+				y0 - bitmap->y,
+				x0 - bitmap->x + bitmap->w - 1,
+				y0 - bitmap->y + bitmap->h - 1);
+    } else {
+      *clipRes = splashClipAllInside;
     }
+    return gTrue;
   }
 
   // generate the glyph bitmap
@@ -155,47 +311,22 @@ GBool SplashFont::getGlyph(int c, int xFrac, int yFrac,
 
   // if the glyph doesn't fit in the bounding box, return a temporary
   // uncached bitmap
-  if (bitmap2.w > glyphW || bitmap2.h > glyphH) {
+  if (!glyphCache || bitmap2.w > glyphW || bitmap2.h > glyphH) {
     *bitmap = bitmap2;
     return gTrue;
   }
 
   // insert glyph pixmap in cache
-  if (aa) {
-    size = bitmap2.w * bitmap2.h;
-  } else {
-    size = ((bitmap2.w + 7) >> 3) * bitmap2.h;
-  }
-  p = NULL; // make gcc happy
-  if (cacheAssoc == 0)
-  {
-    // we had problems on the malloc of the cache, so ignore it
+  if (!(p = glyphCache->add(this, c, xFrac, yFrac, &bitmap2))) {
+    // too large for the cache
     *bitmap = bitmap2;
+    return gTrue;
   }
-  else
-  {
-    for (j = 0; j < cacheAssoc; ++j) {
-      if ((cacheTags[i+j].mru & 0x7fffffff) == cacheAssoc - 1) {
-        cacheTags[i+j].mru = 0x80000000;
-        cacheTags[i+j].c = c;
-        cacheTags[i+j].xFrac = (short)xFrac;
-        cacheTags[i+j].yFrac = (short)yFrac;
-        cacheTags[i+j].x = bitmap2.x;
-        cacheTags[i+j].y = bitmap2.y;
-        cacheTags[i+j].w = bitmap2.w;
-        cacheTags[i+j].h = bitmap2.h;
-        p = cache + (i+j) * glyphSize;
-        memcpy(p, bitmap2.data, size);
-      } else {
-        ++cacheTags[i+j].mru;
-      }
-    }
-    *bitmap = bitmap2;
-    bitmap->data = p;
-    bitmap->freeData = gFalse;
-    if (bitmap2.freeData) {
-      gfree(bitmap2.data);
-    }
+  *bitmap = bitmap2;
+  bitmap->data = p;
+  bitmap->freeData = gFalse;
+  if (bitmap2.freeData) {
+    gfree(bitmap2.data);
   }
   return gTrue;
 }
@@ -16,8 +16,9 @@
 #include "SplashClip.h"
 
 struct SplashGlyphBitmap;
-struct SplashFontCacheTag;
+struct SplashGlyphCacheEntry;
 class SplashFontFile;
+class SplashFont;
 class SplashPath;
 
 //------------------------------------------------------------------------
@@ -29,6 +30,69 @@ class SplashPath;
 #define splashFontFractionMul \
                        ((SplashCoord)1 / (SplashCoord)splashFontFraction)
 
+// Default size limit for the glyph cache, in bytes.
+#define splashGlyphCacheSize (1024 * 1024)
+
+//------------------------------------------------------------------------
+// SplashGlyphCache
+//------------------------------------------------------------------------
+
+// Rasterized glyph bitmaps for all fonts, keyed by font file, font
+// matrix, char code and fractional position.  The cache is limited by
+// a byte count rather than a number of glyphs per font: when it is
+// full, the least recently used glyphs are discarded, regardless of
+// which font they belong to.  Because glyphs are keyed by font file
+// and matrix (not by SplashFont object), they survive the SplashFont
+// being dropped from the font engine's cache and recreated.
+
+class SplashGlyphCache {
+public:
+
+  SplashGlyphCache(int maxBytesA);
+  ~SplashGlyphCache();
+
+  // Look up a glyph.  On success, fills in <bitmap> (whose data is
+  // owned by the cache and stays valid until the next call to add,
+  // setMaxBytes or clear) and returns true.
+  GBool lookup(SplashFont *font, int c, int xFrac, int yFrac,
+	       SplashGlyphBitmap *bitmap);
+
+  // Add a glyph, discarding least recently used glyphs as needed.
+  // Returns a pointer to the cached copy of the bitmap data, or NULL
+  // if the glyph is too large to be cached.
+  Guchar *add(SplashFont *font, int c, int xFrac, int yFrac,
+	      SplashGlyphBitmap *bitmap);
+
+  // Change the size limit, discarding glyphs as needed.
+  void setMaxBytes(int maxBytesA);
+
+  // Discard all glyphs.
+  void clear();
+
+  // Statistics: lookups that found a glyph, lookups that didn't,
+  // glyphs discarded to make room, and current size in bytes.
+  int getHits() { return hits; }
+  int getMisses() { return misses; }
+  int getEvictions() { return evictions; }
+  int getBytes() { return bytes; }
+
+private:
+
+  Guint hash(SplashFont *font, int c, int xFrac, int yFrac);
+  void unlink(SplashGlyphCacheEntry *entry);
+  void shrink(int maxBytesA);
+  void expand();
+
+  SplashGlyphCacheEntry **tab;	// hash table
+  int size;			// number of hash table buckets
+  int len;			// number of glyphs in the cache
+  SplashGlyphCacheEntry *head;	// most recently used glyph
+  SplashGlyphCacheEntry *tail;	// least recently used glyph
+  int maxBytes;
+  int bytes;
+  int hits, misses, evictions;
+};
+
 //------------------------------------------------------------------------
 // SplashFont
 //------------------------------------------------------------------------
@@ -43,6 +107,11 @@ public:
   // constructor has a chance to compute the bbox.
   void initCache();
 
+  // Set the glyph cache used by getGlyph.  With no glyph cache,
+  // glyphs are rasterized on every call.
+  void setGlyphCache(SplashGlyphCache *glyphCacheA)
+    { glyphCache = glyphCacheA; }
+
   virtual ~SplashFont();
 
   SplashFontFile *getFontFile() { return fontFile; }
@@ -63,12 +132,14 @@ public:
   // the numerators of fractions in [0, 1), where the denominator is
   // splashFontFraction = 1 << splashFontFractionBits.  Subclasses
   // should override this to zero out xFrac and/or yFrac if they don't
-  // support fractional coordinates.
+  // support fractional coordinates.  The glyph's box at (<x0>, <y0>)
+  // is tested against <clip>; if <clip> is NULL, the caller has
+  // already done that and *<clipRes> is set to splashClipAllInside.
   virtual GBool getGlyph(int c, int xFrac, int yFrac,
 			 SplashGlyphBitmap *bitmap, int x0, int y0, SplashClip *clip, SplashClipResult *clipRes);
 
-  // Rasterize a glyph.  The <xFrac> and <yFrac> values are the same
-  // as described for getGlyph.
+  // Rasterize a glyph.  The <xFrac>, <yFrac> and <clip> values are
+  // the same as described for getGlyph.
   virtual GBool makeGlyph(int c, int xFrac, int yFrac,
 			  SplashGlyphBitmap *bitmap, int x0, int y0, SplashClip *clip, SplashClipResult *clipRes) = 0;
 
@@ -79,6 +150,11 @@ public:
   // < 0 means not known
   virtual double getGlyphAdvance(int c) { return -1; }
 
+  // Return the approximate memory used by this font instance, not
+  // counting its glyphs in the glyph cache or the font file.  This
+  // may grow when the first glyph is loaded.
+  virtual int getMemSize() { return (int)sizeof(SplashFont); }
+
   // Return the font transform matrix.
   SplashCoord *getMatrix() { return mat; }
 
@@ -97,14 +173,12 @@ protected:
 				//   (text space -> user space)
   GBool aa;			// anti-aliasing
   int xMin, yMin, xMax, yMax;	// glyph bounding box
-  Guchar *cache;		// glyph bitmap cache
-  SplashFontCacheTag *		// cache tags
-    cacheTags;
-  int glyphW, glyphH;		// size of glyph bitmaps
-  int glyphSize;		// size of glyph bitmaps, in bytes
-  int cacheSets;		// number of sets in cache
-  int cacheAssoc;		// cache associativity (glyphs per set)
+  SplashGlyphCache *glyphCache;	// glyph bitmap cache
+  Guint glyphCacheHash;		// hash of the font file and matrix
+  int glyphW, glyphH;		// max size of cached glyph bitmaps
   SplashCoord size;
+
+  friend class SplashGlyphCache;
 };
 
 #endif
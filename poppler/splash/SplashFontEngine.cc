@@ -41,6 +41,17 @@ extern "C" int unlink(char *filename);
 #endif
 #endif
 
+//------------------------------------------------------------------------
+
+struct SplashFontCacheEntry {
+  SplashFont *font;
+  Guint hash;			// hash of font file and matrices
+  int memSize;			// font->getMemSize()
+  SplashFontCacheEntry *next;	// next entry in the hash bucket
+  SplashFontCacheEntry *prev;	// next more recently used entry
+  SplashFontCacheEntry *older;	// next less recently used entry
+};
+
 //------------------------------------------------------------------------
 // SplashFontEngine
 //------------------------------------------------------------------------
@@ -55,9 +66,17 @@ SplashFontEngine::SplashFontEngine(
 				   GBool aa) {
   int i;
 
-  for (i = 0; i < splashFontCacheSize; ++i) {
+  for (i = 0; i < splashFontCacheHashSize; ++i) {
     fontCache[i] = NULL;
   }
+  fontCacheHead = fontCacheTail = NULL;
+  fontCacheBytes = 0;
+  fontCacheMaxBytes = splashFontCacheSize;
+  for (i = 0; i < splashFontFileCacheSize; ++i) {
+    fontFiles[i] = NULL;
+  }
+  glyphCache = new SplashGlyphCache(splashGlyphCacheSize);
+  nFontFilesLoaded = nFontsCreated = 0;
 
 #if HAVE_T1LIB_H
   if (enableT1lib) {
@@ -78,11 +97,15 @@ SplashFontEngine::SplashFontEngine(
 SplashFontEngine::~SplashFontEngine() {
   int i;
 
-  for (i = 0; i < splashFontCacheSize; ++i) {
-    if (fontCache[i]) {
-      delete fontCache[i];
+  while (fontCacheTail) {
+    removeFont(fontCacheTail);
+  }
+  for (i = 0; i < splashFontFileCacheSize; ++i) {
+    if (fontFiles[i]) {
+      fontFiles[i]->decRefCnt();
     }
   }
+  delete glyphCache;
 
 #if HAVE_T1LIB_H
   if (t1Engine) {
@@ -98,19 +121,58 @@ SplashFontEngine::~SplashFontEngine() {
 
 SplashFontFile *SplashFontEngine::getFontFile(SplashFontFileID *id) {
   SplashFontFile *fontFile;
-  int i;
+  SplashFontCacheEntry *entry;
+  int i, j;
 
-  for (i = 0; i < splashFontCacheSize; ++i) {
-    if (fontCache[i]) {
-      fontFile = fontCache[i]->getFontFile();
-      if (fontFile && fontFile->getID()->matches(id)) {
-	return fontFile;
+  for (i = 0; i < splashFontFileCacheSize && fontFiles[i]; ++i) {
+    if (fontFiles[i]->getID()->matches(id)) {
+      fontFile = fontFiles[i];
+      for (j = i; j > 0; --j) {
+	fontFiles[j] = fontFiles[j-1];
       }
+      fontFiles[0] = fontFile;
+      return fontFile;
+    }
+  }
+
+  // the font file may have been dropped from fontFiles while scaled
+  // fonts made from it are still cached
+  for (entry = fontCacheHead; entry; entry = entry->older) {
+    fontFile = entry->font->getFontFile();
+    if (fontFile->getID()->matches(id)) {
+      return addFontFile(fontFile);
     }
   }
   return NULL;
 }
 
+// Add a font file to the front of fontFiles, holding a reference to
+// it, and drop the least recently used one if the list is full.
+SplashFontFile *SplashFontEngine::addFontFile(SplashFontFile *fontFile) {
+  int i;
+
+  if (!fontFile) {
+    return NULL;
+  }
+  fontFile->incRefCnt();
+  if (fontFiles[splashFontFileCacheSize - 1]) {
+    fontFiles[splashFontFileCacheSize - 1]->decRefCnt();
+  }
+  for (i = splashFontFileCacheSize - 1; i > 0; --i) {
+    fontFiles[i] = fontFiles[i-1];
+  }
+  fontFiles[0] = fontFile;
+  return fontFile;
+}
+
+void SplashFontEngine::setFontCacheSize(int maxBytes) {
+  fontCacheMaxBytes = maxBytes;
+  while (fontCacheBytes > fontCacheMaxBytes &&
+	 fontCacheTail != fontCacheHead) {
+    removeFont(fontCacheTail);
+  }
+}
+
 SplashFontFile *SplashFontEngine::loadType1Font(SplashFontFileID *idA,
 						SplashFontSrc *src,
 						char **enc) {
@@ -137,7 +199,10 @@ SplashFontFile *SplashFontEngine::loadType1Font(SplashFontFileID *idA,
     src->unref();
 #endif
 
-  return fontFile;
+  if (fontFile) {
+    ++nFontFilesLoaded;
+  }
+  return addFontFile(fontFile);
 }
 
 SplashFontFile *SplashFontEngine::loadType1CFont(SplashFontFileID *idA,
@@ -166,7 +231,10 @@ SplashFontFile *SplashFontEngine::loadType1CFont(SplashFontFileID *idA,
     src->unref();
 #endif
 
-  return fontFile;
+  if (fontFile) {
+    ++nFontFilesLoaded;
+  }
+  return addFontFile(fontFile);
 }
 
 SplashFontFile *SplashFontEngine::loadOpenTypeT1CFont(SplashFontFileID *idA,
@@ -188,7 +256,10 @@ SplashFontFile *SplashFontEngine::loadOpenTypeT1CFont(SplashFontFileID *idA,
   if (src->isFile)
     src->unref();
 
-  return fontFile;
+  if (fontFile) {
+    ++nFontFilesLoaded;
+  }
+  return addFontFile(fontFile);
 }
 
 SplashFontFile *SplashFontEngine::loadCIDFont(SplashFontFileID *idA,
@@ -211,7 +282,10 @@ SplashFontFile *SplashFontEngine::loadCIDFont(SplashFontFileID *idA,
     src->unref();
 #endif
 
-  return fontFile;
+  if (fontFile) {
+    ++nFontFilesLoaded;
+  }
+  return addFontFile(fontFile);
 }
 
 SplashFontFile *SplashFontEngine::loadOpenTypeCFFFont(SplashFontFileID *idA,
@@ -232,7 +306,10 @@ SplashFontFile *SplashFontEngine::loadOpenTypeCFFFont(SplashFontFileID *idA,
   if (src->isFile)
     src->unref();
 
-  return fontFile;
+  if (fontFile) {
+    ++nFontFilesLoaded;
+  }
+  return addFontFile(fontFile);
 }
 
 SplashFontFile *SplashFontEngine::loadTrueTypeFont(SplashFontFileID *idA,
@@ -263,15 +340,30 @@ SplashFontFile *SplashFontEngine::loadTrueTypeFont(SplashFontFileID *idA,
     src->unref();
 #endif
 
-  return fontFile;
+  if (fontFile) {
+    ++nFontFilesLoaded;
+  }
+  return addFontFile(fontFile);
 }
 
 SplashFont *SplashFontEngine::getFont(SplashFontFile *fontFile,
 				      SplashCoord *textMat,
 				      SplashCoord *ctm) {
   SplashCoord mat[4];
+  SplashFontCacheEntry *entry;
   SplashFont *font;
-  int i, j;
+  Guint h;
+  int memSize;
+
+  // the most recently used font is the only one that can have loaded
+  // glyphs since the last call, and a font's first glyph load can
+  // grow it (see SplashFTFont::loadGlyph)
+  if (fontCacheHead &&
+      (memSize = fontCacheHead->font->getMemSize())
+        != fontCacheHead->memSize) {
+    fontCacheBytes += memSize - fontCacheHead->memSize;
+    fontCacheHead->memSize = memSize;
+  }
 
   mat[0] = textMat[0] * ctm[0] + textMat[1] * ctm[2];
   mat[1] = -(textMat[0] * ctm[1] + textMat[1] * ctm[3]);
@@ -283,27 +375,88 @@ SplashFont *SplashFontEngine::getFont(SplashFontFile *fontFile,
     mat[2] = 0;     mat[3] = 0.01;
   }
 
-  font = fontCache[0];
-  if (font && font->matches(fontFile, mat, textMat)) {
-    return font;
-  }
-  for (i = 1; i < splashFontCacheSize; ++i) {
-    font = fontCache[i];
-    if (font && font->matches(fontFile, mat, textMat)) {
-      for (j = i; j > 0; --j) {
-	fontCache[j] = fontCache[j-1];
+  h = hashFont(fontFile, mat, textMat);
+  for (entry = fontCache[h % splashFontCacheHashSize];
+       entry;
+       entry = entry->next) {
+    if (entry->hash == h && entry->font->matches(fontFile, mat, textMat)) {
+      if (entry != fontCacheHead) {
+	entry->prev->older = entry->older;
+	if (entry->older) {
+	  entry->older->prev = entry->prev;
+	} else {
+	  fontCacheTail = entry->prev;
+	}
+	entry->prev = NULL;
+	entry->older = fontCacheHead;
+	fontCacheHead->prev = entry;
+	fontCacheHead = entry;
       }
-      fontCache[0] = font;
-      return font;
+      return entry->font;
     }
   }
+
   font = fontFile->makeFont(mat, textMat);
-  if (fontCache[splashFontCacheSize - 1]) {
-    delete fontCache[splashFontCacheSize - 1];
+  font->setGlyphCache(glyphCache);
+  ++nFontsCreated;
+  entry = (SplashFontCacheEntry *)gmalloc(sizeof(SplashFontCacheEntry));
+  entry->font = font;
+  entry->hash = h;
+  entry->memSize = font->getMemSize();
+  entry->next = fontCache[h % splashFontCacheHashSize];
+  fontCache[h % splashFontCacheHashSize] = entry;
+  entry->prev = NULL;
+  entry->older = fontCacheHead;
+  if (fontCacheHead) {
+    fontCacheHead->prev = entry;
+  } else {
+    fontCacheTail = entry;
   }
-  for (j = splashFontCacheSize - 1; j > 0; --j) {
-    fontCache[j] = fontCache[j-1];
+  fontCacheHead = entry;
+  fontCacheBytes += entry->memSize;
+
+  // discard least recently used fonts to get back under the size
+  // limit (the new font's file is referenced by the font itself, so
+  // it stays loaded)
+  while (fontCacheBytes > fontCacheMaxBytes && fontCacheTail != entry) {
+    removeFont(fontCacheTail);
   }
-  fontCache[0] = font;
+
   return font;
 }
+
+Guint SplashFontEngine::hashFont(SplashFontFile *fontFile, SplashCoord *mat,
+				 SplashCoord *textMat) {
+  Guint h;
+  int i;
+
+  h = fontFile->getGlyphCacheID();
+  for (i = 0; i < 4; ++i) {
+    h = h * 31 + splashHashCoord(mat[i]);
+    h = h * 31 + splashHashCoord(textMat[i]);
+  }
+  return h;
+}
+
+// Remove a font from the font cache and delete it.
+void SplashFontEngine::removeFont(SplashFontCacheEntry *entry) {
+  SplashFontCacheEntry **p;
+
+  for (p = &fontCache[entry->hash % splashFontCacheHashSize];
+       *p != entry;
+       p = &(*p)->next) ;
+  *p = entry->next;
+  if (entry->prev) {
+    entry->prev->older = entry->older;
+  } else {
+    fontCacheHead = entry->older;
+  }
+  if (entry->older) {
+    entry->older->prev = entry->prev;
+  } else {
+    fontCacheTail = entry->prev;
+  }
+  fontCacheBytes -= entry->memSize;
+  delete entry->font;
+  gfree(entry);
+}
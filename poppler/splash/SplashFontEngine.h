@@ -21,10 +21,21 @@ class SplashFontFile;
 class SplashFontFileID;
 class SplashFont;
 class SplashFontSrc;
+class SplashGlyphCache;
+struct SplashFontCacheEntry;
 
 //------------------------------------------------------------------------
 
-#define splashFontCacheSize 16
+// Default size limit for the scaled font cache, in bytes, as measured
+// by SplashFont::getMemSize.
+#define splashFontCacheSize (256 * 1024)
+
+// Number of hash buckets in the scaled font cache.
+#define splashFontCacheHashSize 128
+
+// Number of font files kept loaded, whether or not any scaled fonts
+// made from them are in the font cache.
+#define splashFontFileCacheSize 32
 
 //------------------------------------------------------------------------
 // SplashFontEngine
@@ -49,6 +60,10 @@ public:
   // matching entry in the cache.
   SplashFontFile *getFontFile(SplashFontFileID *id);
 
+  // Set the size limit for the scaled font cache, in bytes.  The most
+  // recently used font is always kept.
+  void setFontCacheSize(int maxBytes);
+
   // Load fonts - these create new SplashFontFile objects.
   SplashFontFile *loadType1Font(SplashFontFileID *idA, SplashFontSrc *src, char **enc);
   SplashFontFile *loadType1CFont(SplashFontFileID *idA, SplashFontSrc *src, char **enc);
@@ -69,9 +84,35 @@ public:
   SplashFont *getFont(SplashFontFile *fontFile,
 		      SplashCoord *textMat, SplashCoord *ctm);
 
+  // Get the glyph bitmap cache shared by all fonts.
+  SplashGlyphCache *getGlyphCache() { return glyphCache; }
+
+  // Statistics: the number of font files loaded and scaled fonts
+  // created since the last call to resetStats, and the current size
+  // of the scaled font cache, in bytes.
+  int getFontFilesLoaded() { return nFontFilesLoaded; }
+  int getFontsCreated() { return nFontsCreated; }
+  int getFontCacheBytes() { return fontCacheBytes; }
+  void resetStats() { nFontFilesLoaded = nFontsCreated = 0; }
+
 private:
 
-  SplashFont *fontCache[splashFontCacheSize];
+  SplashFontFile *addFontFile(SplashFontFile *fontFile);
+  Guint hashFont(SplashFontFile *fontFile, SplashCoord *mat,
+		 SplashCoord *textMat);
+  void removeFont(SplashFontCacheEntry *entry);
+
+  SplashFontCacheEntry *		// scaled font cache: hash table
+    fontCache[splashFontCacheHashSize];
+  SplashFontCacheEntry *fontCacheHead;	// most recently used font
+  SplashFontCacheEntry *fontCacheTail;	// least recently used font
+  int fontCacheBytes;		// total size of the cached fonts
+  int fontCacheMaxBytes;	// size limit for the font cache
+  SplashFontFile *		// loaded font files, most recently
+    fontFiles[splashFontFileCacheSize];	//   used first
+  SplashGlyphCache *glyphCache;
+  int nFontFilesLoaded;
+  int nFontsCreated;
 
 #if HAVE_T1LIB_H
   SplashT1FontEngine *t1Engine;
@@ -29,11 +29,14 @@ extern "C" int unlink(char *filename);
 // SplashFontFile
 //------------------------------------------------------------------------
 
+static Guint nextGlyphCacheID = 0;
+
 SplashFontFile::SplashFontFile(SplashFontFileID *idA, SplashFontSrc *srcA) {
   id = idA;
   src = srcA;
   src->ref();
   refCnt = 0;
+  glyphCacheID = nextGlyphCacheID++;
   doAdjustMatrix = gFalse;
 }
 
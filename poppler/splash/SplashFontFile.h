@@ -55,6 +55,10 @@ public:
   // Get the font file ID.
   SplashFontFileID *getID() { return id; }
 
+  // Get the number that identifies this font file in glyph cache
+  // keys.  Unlike the object's address, it is never reused.
+  Guint getGlyphCacheID() { return glyphCacheID; }
+
   // Increment the reference count.
   void incRefCnt();
 
@@ -71,6 +75,7 @@ protected:
   SplashFontFileID *id;
   SplashFontSrc *src;
   int refCnt;
+  Guint glyphCacheID;
 
   friend class SplashFontEngine;
 };
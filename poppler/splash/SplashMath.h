@@ -62,6 +62,15 @@ static inline SplashCoord splashPow(SplashCoord x, SplashCoord y) {
 #endif
 }
 
+// Hash a coordinate; equal coordinates have equal hashes.
+static inline Guint splashHashCoord(SplashCoord x) {
+#if USE_FIXEDPOINT
+  return (Guint)x.getRaw();
+#else
+  return (Guint)(int)(x * 256);
+#endif
+}
+
 static inline SplashCoord splashDist(SplashCoord x0, SplashCoord y0,
 				     SplashCoord x1, SplashCoord y1) {
   SplashCoord dx, dy;
@@ -12,6 +12,7 @@
 
 #include <string.h>
 #include "goo/gmem.h"
+#include "goo/GooArena.h"
 #include "SplashErrorCodes.h"
 #include "SplashPath.h"
 
@@ -30,16 +31,28 @@
 // 3. open subpath with two or more points
 //    [curSubpath < length - 1]
 
-SplashPath::SplashPath() {
-  pts = NULL;
-  flags = NULL;
-  length = size = 0;
+SplashPath::SplashPath(GooArena *arenaA, int sizeA) {
+  arena = arenaA;
+  size = sizeA;
+  if (size <= 0) {
+    pts = NULL;
+    flags = NULL;
+    size = 0;
+  } else if (arena) {
+    pts = (SplashPathPoint *)arena->allocn(size, sizeof(SplashPathPoint));
+    flags = (Guchar *)arena->allocn(size, sizeof(Guchar));
+  } else {
+    pts = (SplashPathPoint *)gmallocn(size, sizeof(SplashPathPoint));
+    flags = (Guchar *)gmallocn(size, sizeof(Guchar));
+  }
+  length = 0;
   curSubpath = 0;
   hints = NULL;
   hintsLength = hintsSize = 0;
 }
 
 SplashPath::SplashPath(SplashPath *path) {
+  arena = NULL;
   length = path->length;
   size = path->size;
   pts = (SplashPathPoint *)gmallocn(size, sizeof(SplashPathPoint));
@@ -57,22 +70,35 @@ SplashPath::SplashPath(SplashPath *path) {
 }
 
 SplashPath::~SplashPath() {
-  gfree(pts);
-  gfree(flags);
+  // arena points are reclaimed with the arena
+  if (!arena) {
+    gfree(pts);
+    gfree(flags);
+  }
   gfree(hints);
 }
 
 // Add space for <nPts> more points.
 void SplashPath::grow(int nPts) {
+  int oldSize;
+
   if (length + nPts > size) {
+    oldSize = size;
     if (size == 0) {
       size = 32;
     }
     while (size < length + nPts) {
       size *= 2;
     }
-    pts = (SplashPathPoint *)greallocn(pts, size, sizeof(SplashPathPoint));
-    flags = (Guchar *)greallocn(flags, size, sizeof(Guchar));
+    if (arena) {
+      pts = (SplashPathPoint *)arena->reallocn(pts, oldSize, size,
+					       sizeof(SplashPathPoint));
+      flags = (Guchar *)arena->reallocn(flags, oldSize, size,
+					sizeof(Guchar));
+    } else {
+      pts = (SplashPathPoint *)greallocn(pts, size, sizeof(SplashPathPoint));
+      flags = (Guchar *)greallocn(flags, size, sizeof(Guchar));
+    }
   }
 }
 
@@ -13,6 +13,8 @@
 
 #include "SplashTypes.h"
 
+class GooArena;
+
 //------------------------------------------------------------------------
 // SplashPathPoint
 //------------------------------------------------------------------------
@@ -54,10 +56,12 @@ struct SplashPathHint {
 class SplashPath {
 public:
 
-  // Create an empty path.
-  SplashPath();
+  // Create an empty path, with room for <sizeA> points.  If <arenaA>
+  // is non-NULL, the points are allocated from it, so the path must be
+  // deleted before the arena is released or reset.
+  SplashPath(GooArena *arenaA = NULL, int sizeA = 0);
 
-  // Copy a path.
+  // Copy a path (to the heap).
   SplashPath *copy() { return new SplashPath(this); }
 
   ~SplashPath();
@@ -108,6 +112,7 @@ private:
   Guchar *flags;		// array of flags
   int length, size;		// length/size of the pts and flags arrays
   int curSubpath;		// index of first point in last subpath
+  GooArena *arena;		// arena holding pts and flags, or NULL
 
   SplashPathHint *hints;	// list of hints
   int hintsLength, hintsSize;
@@ -24,6 +24,16 @@ SplashPattern::SplashPattern() {
 SplashPattern::~SplashPattern() {
 }
 
+void SplashPattern::getColorSpan(int x0, int x1, int y,
+				 SplashColorPtr c, Guchar *paint) {
+  int x;
+
+  for (x = x0; x <= x1; ++x) {
+    *paint++ = (Guchar)getColor(x, y, c);
+    c += splashMaxColorComps;
+  }
+}
+
 //------------------------------------------------------------------------
 // SplashSolidColor
 //------------------------------------------------------------------------
@@ -35,6 +45,7 @@ SplashSolidColor::SplashSolidColor(SplashColorPtr colorA) {
 SplashSolidColor::~SplashSolidColor() {
 }
 
-void SplashSolidColor::getColor(int x, int y, SplashColorPtr c) {
+GBool SplashSolidColor::getColor(int x, int y, SplashColorPtr c) {
   splashColorCopy(c, color);
+  return gTrue;
 }
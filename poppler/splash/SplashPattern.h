@@ -28,8 +28,17 @@ public:
 
   virtual ~SplashPattern();
 
-  // Return the color value for a specific pixel.
-  virtual void getColor(int x, int y, SplashColorPtr c) = 0;
+  // Return the color value for a specific pixel.  Returns false if
+  // the pattern does not paint this pixel (e.g., outside of a shading
+  // that isn't extended), in which case <c> is not set.
+  virtual GBool getColor(int x, int y, SplashColorPtr c) = 0;
+
+  // Return the colors for the pixels (<x0>..<x1>, <y>) in <c>
+  // (splashMaxColorComps bytes per pixel), and set <paint>[i] to
+  // whether pixel <x0> + i is painted.  The default implementation
+  // calls getColor for each pixel.
+  virtual void getColorSpan(int x0, int x1, int y,
+			    SplashColorPtr c, Guchar *paint);
 
   // Returns true if this pattern object will return the same color
   // value for all pixels.
@@ -51,7 +60,7 @@ public:
 
   virtual ~SplashSolidColor();
 
-  virtual void getColor(int x, int y, SplashColorPtr c);
+  virtual GBool getColor(int x, int y, SplashColorPtr c);
 
   virtual GBool isStatic() { return gTrue; }
 
@@ -213,10 +213,14 @@ GBool SplashT1Font::makeGlyph(int c, int xFrac, int yFrac,
     bitmap->freeData = gTrue;
   }
 
-  *clipRes = clip->testRect(x0 - bitmap->x,
-                            y0 - bitmap->y,
-                            x0 - bitmap->x + bitmap->w - 1,
-                            y0 - bitmap->y + bitmap->h - 1);
+  if (clip) {
+    *clipRes = clip->testRect(x0 - bitmap->x,
+			      y0 - bitmap->y,
+			      x0 - bitmap->x + bitmap->w - 1,
+			      y0 - bitmap->y + bitmap->h - 1);
+  } else {
+    *clipRes = splashClipAllInside;
+  }
 
   return gTrue;
 }
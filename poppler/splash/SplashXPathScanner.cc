@@ -20,14 +20,21 @@
 
 //------------------------------------------------------------------------
 
+// An active edge: a segment that intersects the current scanline,
+// along with its intersection with that scanline.
 struct SplashIntersect {
   int x0, x1;			// intersection of segment with [y, y+1)
   int count;			// EO/NZWN counter increment
+  SplashXPathSeg *seg;		// the segment
+  SplashCoord ySegMin, ySegMax;	// y range of <seg>
+  SplashCoord xNext;		// intersection of <seg> (unclamped) with
+				//   the top edge of scanline <yNext>
+  int yNext;
 };
 
-static int cmpIntersect(const void *p0, const void *p1) {
-  return ((SplashIntersect *)p0)->x0 - ((SplashIntersect *)p1)->x0;
-}
+struct SplashXPathSpan {
+  int x0, x1;			// span is [x0, x1]
+};
 
 //------------------------------------------------------------------------
 // SplashXPathScanner
@@ -93,10 +100,14 @@ SplashXPathScanner::SplashXPathScanner(SplashXPath *xPathA, GBool eoA) {
   xPathIdx = 0;
   inter = NULL;
   interLen = interSize = 0;
+  spans = NULL;
+  spanLen = spanSize = 0;
+  spanIdx = 0;
 }
 
 SplashXPathScanner::~SplashXPathScanner() {
   gfree(inter);
+  gfree(spans);
 }
 
 void SplashXPathScanner::getBBoxAA(int *xMinA, int *yMinA,
@@ -111,9 +122,9 @@ void SplashXPathScanner::getSpanBounds(int y, int *spanXMin, int *spanXMax) {
   if (interY != y) {
     computeIntersections(y);
   }
-  if (interLen > 0) {
-    *spanXMin = inter[0].x0;
-    *spanXMax = inter[interLen - 1].x1;
+  if (spanLen > 0) {
+    *spanXMin = spans[0].x0;
+    *spanXMax = spans[spanLen - 1].x1;
   } else {
     *spanXMin = xMax + 1;
     *spanXMax = xMax;
@@ -121,19 +132,24 @@ void SplashXPathScanner::getSpanBounds(int y, int *spanXMin, int *spanXMax) {
 }
 
 GBool SplashXPathScanner::test(int x, int y) {
-  int count, i;
+  int a, b, m;
 
   if (interY != y) {
     computeIntersections(y);
   }
-  count = 0;
-  for (i = 0; i < interLen && inter[i].x0 <= x; ++i) {
-    if (x <= inter[i].x1) {
-      return gTrue;
+
+  // binary search for the last span with x0 <= x
+  a = -1;
+  b = spanLen;
+  while (b - a > 1) {
+    m = (a + b) / 2;
+    if (spans[m].x0 <= x) {
+      a = m;
+    } else {
+      b = m;
     }
-    count += inter[i].count;
   }
-  return eo ? (count & 1) : (count != 0);
+  return a >= 0 && x <= spans[a].x1;
 }
 
 GBool SplashXPathScanner::testSpan(int x0, int x1, int y) {
@@ -169,50 +185,46 @@ GBool SplashXPathScanner::testSpan(int x0, int x1, int y) {
 }
 
 GBool SplashXPathScanner::getNextSpan(int y, int *x0, int *x1) {
-  int xx0, xx1;
-
   if (interY != y) {
     computeIntersections(y);
   }
-  if (interIdx >= interLen) {
+  if (spanIdx >= spanLen) {
     return gFalse;
   }
-  xx0 = inter[interIdx].x0;
-  xx1 = inter[interIdx].x1;
-  interCount += inter[interIdx].count;
-  ++interIdx;
-  while (interIdx < interLen &&
-	 (inter[interIdx].x0 <= xx1 ||
-	  (eo ? (interCount & 1) : (interCount != 0)))) {
-    if (inter[interIdx].x1 > xx1) {
-      xx1 = inter[interIdx].x1;
-    }
-    interCount += inter[interIdx].count;
-    ++interIdx;
-  }
-  *x0 = xx0;
-  *x1 = xx1;
+  *x0 = spans[spanIdx].x0;
+  *x1 = spans[spanIdx].x1;
+  ++spanIdx;
   return gTrue;
 }
 
 void SplashXPathScanner::computeIntersections(int y) {
   SplashCoord xSegMin, xSegMax, ySegMin, ySegMax, xx0, xx1;
   SplashXPathSeg *seg;
-  int i, j;
+  SplashIntersect *e, tmp;
+  int xx0I, xx1I, count, i, j;
+
+  // the active edge table only moves forward -- start over if we're
+  // asked for an earlier scanline
+  if (y < interY) {
+    xPathIdx = 0;
+    interLen = 0;
+  }
 
-  // find the first segment that intersects [y, y+1)
-  i = (y >= interY) ? xPathIdx : 0;
-  while (i < xPath->length &&
-	 xPath->segs[i].y0 < y && xPath->segs[i].y1 < y) {
-    ++i;
+  // drop the edges that end above y
+  for (i = j = 0; i < interLen; ++i) {
+    if (inter[i].ySegMax >= y) {
+      if (i != j) {
+	inter[j] = inter[i];
+      }
+      ++j;
+    }
   }
-  xPathIdx = i;
+  interLen = j;
 
-  // find all of the segments that intersect [y, y+1) and create an
-  // Intersect element for each one
-  interLen = 0;
-  for (j = i; j < xPath->length; ++j) {
-    seg = &xPath->segs[j];
+  // add the edges that start above y+1 (the segments are sorted by
+  // upper y, so these are the next ones in <xPath>)
+  while (xPathIdx < xPath->length) {
+    seg = &xPath->segs[xPathIdx];
     if (seg->flags & splashXPathFlip) {
       ySegMin = seg->y1;
       ySegMax = seg->y0;
@@ -220,16 +232,13 @@ void SplashXPathScanner::computeIntersections(int y) {
       ySegMin = seg->y0;
       ySegMax = seg->y1;
     }
-
-    // ensure that:      ySegMin < y+1
-    //              y <= ySegMax
     if (ySegMin >= y + 1) {
       break;
     }
+    ++xPathIdx;
     if (ySegMax < y) {
       continue;
     }
-
     if (interLen == interSize) {
       if (interSize == 0) {
 	interSize = 16;
@@ -239,7 +248,17 @@ void SplashXPathScanner::computeIntersections(int y) {
       inter = (SplashIntersect *)greallocn(inter, interSize,
 					   sizeof(SplashIntersect));
     }
+    e = &inter[interLen++];
+    e->seg = seg;
+    e->ySegMin = ySegMin;
+    e->ySegMax = ySegMax;
+    e->yNext = y - 1;
+  }
 
+  // compute the intersection of each active edge with [y, y+1)
+  for (i = 0; i < interLen; ++i) {
+    e = &inter[i];
+    seg = e->seg;
     if (seg->flags & splashXPathHoriz) {
       xx0 = seg->x0;
       xx1 = seg->x1;
@@ -253,10 +272,17 @@ void SplashXPathScanner::computeIntersections(int y) {
 	xSegMin = seg->x1;
 	xSegMax = seg->x0;
       }
-      // intersection with top edge
-      xx0 = seg->x0 + ((SplashCoord)y - seg->y0) * seg->dxdy;
+      // intersection with top edge -- this is the bottom edge
+      // intersection from the previous scanline, if we computed one
+      if (e->yNext == y) {
+	xx0 = e->xNext;
+      } else {
+	xx0 = seg->x0 + ((SplashCoord)y - seg->y0) * seg->dxdy;
+      }
       // intersection with bottom edge
       xx1 = seg->x0 + ((SplashCoord)y + 1 - seg->y0) * seg->dxdy;
+      e->xNext = xx1;
+      e->yNext = y + 1;
       // the segment may not actually extend to the top and/or bottom edges
       if (xx0 < xSegMin) {
 	xx0 = xSegMin;
@@ -270,33 +296,72 @@ void SplashXPathScanner::computeIntersections(int y) {
       }
     }
     if (xx0 < xx1) {
-      inter[interLen].x0 = splashFloor(xx0);
-      inter[interLen].x1 = splashFloor(xx1);
+      e->x0 = splashFloor(xx0);
+      e->x1 = splashFloor(xx1);
     } else {
-      inter[interLen].x0 = splashFloor(xx1);
-      inter[interLen].x1 = splashFloor(xx0);
+      e->x0 = splashFloor(xx1);
+      e->x1 = splashFloor(xx0);
     }
-    if (ySegMin <= y &&
-	(SplashCoord)y < ySegMax &&
+    if (e->ySegMin <= y &&
+	(SplashCoord)y < e->ySegMax &&
 	!(seg->flags & splashXPathHoriz)) {
-      inter[interLen].count = eo ? 1
-	                         : (seg->flags & splashXPathFlip) ? 1 : -1;
+      e->count = eo ? 1 : (seg->flags & splashXPathFlip) ? 1 : -1;
     } else {
-      inter[interLen].count = 0;
+      e->count = 0;
     }
-    ++interLen;
   }
 
-  qsort(inter, interLen, sizeof(SplashIntersect), &cmpIntersect);
+  // sort by x0 -- the table is kept in the previous scanline's order,
+  // which is nearly sorted, so an insertion sort is close to linear
+  for (i = 1; i < interLen; ++i) {
+    if (inter[i].x0 < inter[i-1].x0) {
+      tmp = inter[i];
+      for (j = i; j > 0 && inter[j-1].x0 > tmp.x0; --j) {
+	inter[j] = inter[j-1];
+      }
+      inter[j] = tmp;
+    }
+  }
+
+  // merge the intersections into spans
+  spanLen = 0;
+  count = 0;
+  i = 0;
+  while (i < interLen) {
+    xx0I = inter[i].x0;
+    xx1I = inter[i].x1;
+    count += inter[i].count;
+    ++i;
+    while (i < interLen &&
+	   (inter[i].x0 <= xx1I ||
+	    (eo ? (count & 1) : (count != 0)))) {
+      if (inter[i].x1 > xx1I) {
+	xx1I = inter[i].x1;
+      }
+      count += inter[i].count;
+      ++i;
+    }
+    if (spanLen == spanSize) {
+      if (spanSize == 0) {
+	spanSize = 16;
+      } else {
+	spanSize *= 2;
+      }
+      spans = (SplashXPathSpan *)greallocn(spans, spanSize,
+					   sizeof(SplashXPathSpan));
+    }
+    spans[spanLen].x0 = xx0I;
+    spans[spanLen].x1 = xx1I;
+    ++spanLen;
+  }
 
   interY = y;
-  interIdx = 0;
-  interCount = 0;
+  spanIdx = 0;
 }
 
 void SplashXPathScanner::renderAALine(SplashBitmap *aaBuf,
 				      int *x0, int *x1, int y) {
-  int xx0, xx1, xx, xxMin, xxMax, yy;
+  int xx0, xx1, xx, xxMin, xxMax, yy, i;
   Guchar mask;
   SplashColorPtr p;
 
@@ -305,20 +370,9 @@ void SplashXPathScanner::renderAALine(SplashBitmap *aaBuf,
   xxMax = -1;
   for (yy = 0; yy < splashAASize; ++yy) {
     computeIntersections(splashAASize * y + yy);
-    while (interIdx < interLen) {
-      xx0 = inter[interIdx].x0;
-      xx1 = inter[interIdx].x1;
-      interCount += inter[interIdx].count;
-      ++interIdx;
-      while (interIdx < interLen &&
-	     (inter[interIdx].x0 <= xx1 ||
-	      (eo ? (interCount & 1) : (interCount != 0)))) {
-	if (inter[interIdx].x1 > xx1) {
-	  xx1 = inter[interIdx].x1;
-	}
-	interCount += inter[interIdx].count;
-	++interIdx;
-      }
+    for (i = 0; i < spanLen; ++i) {
+      xx0 = spans[i].x0;
+      xx1 = spans[i].x1;
       if (xx0 < 0) {
 	xx0 = 0;
       }
@@ -359,27 +413,16 @@ void SplashXPathScanner::renderAALine(SplashBitmap *aaBuf,
 
 void SplashXPathScanner::clipAALine(SplashBitmap *aaBuf,
 				    int *x0, int *x1, int y) {
-  int xx0, xx1, xx, yy;
+  int xx0, xx1, xx, yy, i;
   Guchar mask;
   SplashColorPtr p;
 
   for (yy = 0; yy < splashAASize; ++yy) {
     xx = *x0 * splashAASize;
     computeIntersections(splashAASize * y + yy);
-    while (interIdx < interLen && xx < (*x1 + 1) * splashAASize) {
-      xx0 = inter[interIdx].x0;
-      xx1 = inter[interIdx].x1;
-      interCount += inter[interIdx].count;
-      ++interIdx;
-      while (interIdx < interLen &&
-	     (inter[interIdx].x0 <= xx1 ||
-	      (eo ? (interCount & 1) : (interCount != 0)))) {
-	if (inter[interIdx].x1 > xx1) {
-	  xx1 = inter[interIdx].x1;
-	}
-	interCount += inter[interIdx].count;
-	++interIdx;
-      }
+    for (i = 0; i < spanLen && xx < (*x1 + 1) * splashAASize; ++i) {
+      xx0 = spans[i].x0;
+      xx1 = spans[i].x1;
       if (xx0 > aaBuf->getWidth()) {
 	xx0 = aaBuf->getWidth();
       }
@@ -16,6 +16,7 @@
 class SplashXPath;
 class SplashBitmap;
 struct SplashIntersect;
+struct SplashXPathSpan;
 
 //------------------------------------------------------------------------
 // SplashXPathScanner
@@ -71,15 +72,19 @@ private:
   int xMin, yMin, xMax, yMax;
 
   int interY;			// current y value
-  int interIdx;			// current index into <inter> - used by
-				//   getNextSpan 
-  int interCount;		// current EO/NZWN counter - used by
-				//   getNextSpan
-  int xPathIdx;			// current index into <xPath> - used by
+  int xPathIdx;			// index of the first segment in <xPath>
+				//   not yet added to <inter> - used by
 				//   computeIntersections
-  SplashIntersect *inter;	// intersections array for <interY>
-  int interLen;			// number of intersections in <inter>
+  SplashIntersect *inter;	// active edge table for <interY>, sorted
+				//   by x0
+  int interLen;			// number of active edges in <inter>
   int interSize;		// size of the <inter> array
+  SplashXPathSpan *spans;	// spans inside the path at <interY>,
+				//   sorted by x0
+  int spanLen;			// number of spans in <spans>
+  int spanSize;			// size of the <spans> array
+  int spanIdx;			// current index into <spans> - used by
+				//   getNextSpan
 };
 
 #endif
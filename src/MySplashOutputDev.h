@@ -88,6 +88,11 @@ class MySplashOutputDev: public SplashOutputDev
 		{
 			return gTrue;
 		}
+		// reflow needs to see every character in drawChar
+		virtual GBool useDrawGlyphRun()
+		{
+			return ! reflow;
+		}
 		virtual GBool needNonText()
 		{
 			return gTrue;
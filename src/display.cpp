@@ -8,6 +8,12 @@
 static int slx, sly, slw, slh, slpage = -1, slscale, slorn, watermark = -1;
 static int after_hand_move = 0;
 static pid_t bgpid = 0;
+static DisplayListCache *dlcache = NULL;
+
+#define MAXINPUTFD 8
+
+static int inputfd[MAXINPUTFD], ninputfd = -1;
+static int input_pending = 0, page_stale = 0;
 
 void bg_monitor()
 {
@@ -43,6 +49,80 @@ void kill_bgpainter()
 
 }
 
+// The input devices are read alongside inkview, so that a render can
+// tell when a key press or touch is waiting in inkview's queue.
+static void open_input_devices()
+{
+
+	char buf[32];
+	int i, fd;
+
+	ninputfd = 0;
+	for (i = 0; i < MAXINPUTFD; i++)
+	{
+		sprintf(buf, "/dev/input/event%i", i);
+		fd = open(buf, O_RDONLY | O_NONBLOCK);
+		if (fd == -1) continue;
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		inputfd[ninputfd++] = fd;
+	}
+
+}
+
+// Returns the number of key presses and touches read since the last
+// call; releases, autorepeat and motion are skipped.  A touch may report
+// several buttons at once, so each input frame counts once.
+static int read_input_presses()
+{
+
+	struct pollfd pfd[MAXINPUTFD];
+	struct input_event ev[16];
+	int i, j, n, count, press;
+
+	if (ninputfd == -1) open_input_devices();
+	if (ninputfd == 0) return 0;
+	for (i = 0; i < ninputfd; i++)
+	{
+		pfd[i].fd = inputfd[i];
+		pfd[i].events = POLLIN;
+	}
+	if (poll(pfd, ninputfd, 0) <= 0) return 0;
+
+	count = 0;
+	for (i = 0; i < ninputfd; i++)
+	{
+		if (! (pfd[i].revents & POLLIN)) continue;
+		press = 0;
+		while ((n = read(inputfd[i], ev, sizeof(ev))) > 0)
+		{
+			n /= sizeof(struct input_event);
+			for (j = 0; j < n; j++)
+			{
+				if (ev[j].type == EV_KEY && ev[j].value == 1)
+				{
+					press = 1;
+				}
+				else if (ev[j].type == EV_SYN && ev[j].code == SYN_REPORT)
+				{
+					count += press;
+					press = 0;
+				}
+			}
+		}
+		count += press;
+	}
+	return count;
+
+}
+
+static GBool render_abort_check(void* data)
+{
+
+	if (! input_pending && read_input_presses() > 0) input_pending = 1;
+	return input_pending ? gTrue : gFalse;
+
+}
+
 void draw_wait_thumbnail()
 {
 	if (thw == 0 || thh == 0) return;
@@ -253,7 +333,7 @@ int is_page_cached(int pagenum, int sc, int orn)
 
 }
 
-void display_slice(int pagenum, int sc, double res, GBool withreflow, int x, int y, int  w, int h)
+GBool display_slice(int pagenum, int sc, double res, GBool withreflow, int x, int y, int  w, int h, GBool interruptible)
 {
 
 	/*
@@ -288,7 +368,7 @@ void display_slice(int pagenum, int sc, double res, GBool withreflow, int x, int
 	if (is_page_cached(pagenum, sc, orn))
 	{
 		fprintf(stderr, "+%i:%i (%i,%i,%i,%i)\n", pagenum, sc, x, y, w, h);
-		return;
+		return gTrue;
 	}
 
 	fprintf(stderr, "-%i:%i (%i,%i,%i,%i)\n", pagenum, sc, x, y, w, h);
@@ -298,7 +378,34 @@ void display_slice(int pagenum, int sc, double res, GBool withreflow, int x, int
 		slscale = sc;
 		slorn = orn;
 	}
-	doc->displayPage(splashOut, pagenum, res, res, 0, withreflow, !withreflow, gFalse);
+	if (withreflow)
+	{
+		doc->displayPage(splashOut, pagenum, res, res, 0, withreflow, !withreflow, gFalse);
+		return gTrue;
+	}
+
+	// recently viewed pages are replayed from their display lists
+	// when only the zoom changes
+	if (dlcache == NULL) dlcache = new DisplayListCache();
+	if (! interruptible)
+	{
+		dlcache->displayPage(doc, splashOut, pagenum, res, res, 0, gFalse, gTrue, gFalse);
+		return gTrue;
+	}
+
+	// Presses read so far (including the one that asked for this render,
+	// and any made in menus or dialogs) have been handled by inkview
+	// already; only those made during the render interrupt it.
+	read_input_presses();
+	input_pending = 0;
+	dlcache->displayPage(doc, splashOut, pagenum, res, res, 0, gFalse, gTrue, gFalse, render_abort_check, NULL);
+	if (input_pending)
+	{
+		fprintf(stderr, "!%i:%i\n", pagenum, sc);
+		slpage = -1;
+		return gFalse;
+	}
+	return gTrue;
 
 }
 
@@ -445,7 +552,9 @@ int get_fit_scale()
 
 }
 
-static void draw_page_image()
+// Returns 0 if the render was interrupted by input; the screen is then
+// left as it was.
+static int draw_page_image()
 {
 
 	int sw, sh, pw, ph, x, y, w, h, dx, row, orn, i, grads;
@@ -459,7 +568,6 @@ static void draw_page_image()
 	{
 		draw_wait_thumbnail();
 	}
-	ClearScreen();
 
 	SetOrientation(orient);
 	sw = ScreenWidth();
@@ -491,7 +599,7 @@ static void draw_page_image()
 		splashOut->setup(gFalse, 0, 0, 0, sw, sh - panelh, 0, 0, 0, 0, res);
 		if (scale > 100 && scale <= 199 && ! after_hand_move)
 		{
-			display_slice(cpage, scale, res, gFalse, 0, offy, pw, sh - panelh);
+			if (! display_slice(cpage, scale, res, gFalse, 0, offy, pw, sh - panelh, gTrue)) return 0;
 			//doc->displayPageSlice(splashOut, cpage, res, res, 0, gFalse, gTrue/*gFalse*/, gFalse, 0, offy, pw, sh);
 			dx = center_image(sw, NULL);
 			offx = dx;
@@ -499,7 +607,7 @@ static void draw_page_image()
 		}
 		else
 		{
-			display_slice(cpage, scale, res, gFalse, offx, offy, sw, sh - panelh);
+			if (! display_slice(cpage, scale, res, gFalse, offx, offy, sw, sh - panelh, gTrue)) return 0;
 			//doc->displayPageSlice(splashOut, cpage, res, res, 0, gFalse, gTrue/*gFalse*/, gFalse, offx, offy, sw, sh);
 		}
 		nsubpages = 1;
@@ -536,6 +644,7 @@ static void draw_page_image()
 
 	}
 
+	ClearScreen();
 	get_bitmap_data(&data, &w, &h, &row);
 
 	Stretch(data, USE4 ? IMAGE_GRAY4 : IMAGE_GRAY8, w, h, row, scrx - dx, scry, w, h, 0);
@@ -577,6 +686,7 @@ static void draw_page_image()
 	if (thiy < 0) thiy = 0;
 	if (thiy + thih > 100) thiy = 100 - thih;
 	after_hand_move = 0;
+	return 1;
 
 }
 
@@ -709,6 +819,13 @@ void draw_bmk_flag(int update)
 	if (update) PartialUpdate(x, y, bmk_flag->width, bmk_flag->height);
 }
 
+// Draws the page again if the input that interrupted its render didn't
+// lead to another out_page().
+static void redraw_timer()
+{
+	if (page_stale) out_page(1);
+}
+
 void out_page(int full)
 {
     char buf[32];
@@ -716,7 +833,12 @@ void out_page(int full)
 
     if (reflow_mode || scale > 50)
     {
-            draw_page_image();
+            if (! draw_page_image())
+            {
+                    page_stale = 1;
+                    SetHardTimer("REDRAW", redraw_timer, 500);
+                    return;
+            }
     }
     else
     {
@@ -724,6 +846,7 @@ void out_page(int full)
             n = draw_pages();
             SetHardTimer("BGPAINT", bg_monitor, 500);
     }
+    page_stale = 0;
 
     if (zoom_mode)
     {
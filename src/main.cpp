@@ -1221,6 +1221,7 @@ int main(int argc, char** argv)
 	globalParams->setEnableFreeType("yes");
 	globalParams->setAntialias((char*)(ivstate.antialiasing ? "yes" : "no"));
 	globalParams->setVectorAntialias("no");
+	globalParams->setFontCacheDir(CACHEDIR "/pdffonts");
 
 	filename = new GooString(FileName);
 	doc = new PDFDoc(filename, NULL, NULL);
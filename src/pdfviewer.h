@@ -25,6 +25,9 @@
 #include <stddef.h>
 #include <math.h>
 #include <sys/wait.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <linux/input.h>
 #include <inkview.h>
 #include <inkinternal.h>
 
@@ -44,6 +47,7 @@
 #include "OutputDev.h"
 #include "TextOutputDev.h"
 #include "SplashOutputDev.h"
+#include "DisplayList.h"
 #include "splash/SplashBitmap.h"
 #include "splash/Splash.h"
 
@@ -128,7 +132,7 @@ void find_off_x(int step);
 void find_off_xy(int xstep, int ystep);
 int get_fit_scale();
 void draw_wait_thumbnail();
-void display_slice(int pagenum, int sc, double res, GBool withreflow, int x, int y, int  w, int h);
+GBool display_slice(int pagenum, int sc, double res, GBool withreflow, int x, int y, int  w, int h, GBool interruptible = gFalse);
 void get_bitmap_data(unsigned char** data, int* w, int* h, int* row);
 void out_page(int full);
 void draw_bmk_flag(int update);